@@ -0,0 +1,14 @@
+# Sanitizers of the tests on the host (native env), for the compiler and the linker
+Import("env")
+env.Append(
+  LINKFLAGS=[
+    "-fsanitize=address,undefined",
+    "-fno-omit-frame-pointer"
+  ]
+)
+env.Append(
+  CCFLAGS=[
+    "-fsanitize=address,undefined",
+    "-fno-omit-frame-pointer"
+  ]
+)
@@ -0,0 +1,131 @@
+/*
+ * @file
+ * @brief Implementation of a lightweight tracer of the boot phases (LEDs test, BLE, Wi-Fi, CoAP fetches, parsing, AIM starts)
+ * 
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "boot_trace.h"
+
+LOG_MODULE_REGISTER(MPAI_BOOT_TRACE, LOG_LEVEL_INF);
+
+/************* STATIC *************/
+static mpai_boot_trace_event_t boot_trace_events[MPAI_BOOT_TRACE_MAX_EVENTS];
+static size_t boot_trace_count = 0;
+static int8_t boot_trace_depth = 0;
+
+/* hardware cycles extended to 64 bits (the 32 bits counter wraps in less than a minute at 80MHz) */
+static uint32_t boot_trace_last_cycles = 0;
+static uint64_t boot_trace_high_cycles = 0;
+
+/************* PRIVATE HEADER *************/
+int _boot_trace_begin(const char* phase, const char* detail, bool concurrent);
+uint64_t _boot_trace_now();
+
+/************* PUBLIC **************/
+int MPAI_Boot_Trace_Begin(const char* phase, const char* detail)
+{
+	return _boot_trace_begin(phase, detail, false);
+}
+
+int MPAI_Boot_Trace_Begin_Concurrent(const char* phase, const char* detail)
+{
+	return _boot_trace_begin(phase, detail, true);
+}
+
+void MPAI_Boot_Trace_End(int trace_id)
+{
+	unsigned int key = irq_lock();
+	if (trace_id >= 0 && trace_id < boot_trace_count && boot_trace_events[trace_id]._end_cycles == 0)
+	{
+		boot_trace_events[trace_id]._end_cycles = _boot_trace_now();
+		if (!boot_trace_events[trace_id]._concurrent)
+		{
+			boot_trace_depth--;
+		}
+	}
+	irq_unlock(key);
+}
+
+void MPAI_Boot_Trace_Report()
+{
+	LOG_INF("Boot trace (%zu phases, %u cycles/s):", boot_trace_count, sys_clock_hw_cycles_per_sec());
+	for (size_t i = 0; i < boot_trace_count; i++)
+	{
+		mpai_boot_trace_event_t* event = &boot_trace_events[i];
+		// log arguments are 32 bits wide: microseconds are enough for the whole boot
+		uint32_t start_us = (uint32_t)k_cyc_to_us_floor64(event->_start_cycles);
+		if (event->_end_cycles == 0)
+		{
+			LOG_INF("%*s%s %s: started at %u us, not ended", event->_depth * 2, "", event->_phase, log_strdup(event->_detail), start_us);
+			continue;
+		}
+		uint64_t cycles = event->_end_cycles - event->_start_cycles;
+		LOG_INF("%*s%s %s: started at %u us, took %u us (%u cycles)", event->_depth * 2, "", event->_phase, log_strdup(event->_detail),
+				start_us, (uint32_t)k_cyc_to_us_floor64(cycles), (uint32_t)cycles);
+	}
+}
+
+const mpai_boot_trace_event_t* MPAI_Boot_Trace_Get_Events(size_t* count)
+{
+	*count = boot_trace_count;
+	return boot_trace_events;
+}
+
+int64_t MPAI_Boot_Trace_Get_Duration_Us(const char* phase, const char* detail)
+{
+	for (size_t i = 0; i < boot_trace_count; i++)
+	{
+		mpai_boot_trace_event_t* event = &boot_trace_events[i];
+		if (strcmp(event->_phase, phase) == 0 && (detail == NULL || strcmp(event->_detail, detail) == 0))
+		{
+			if (event->_end_cycles == 0)
+			{
+				return -1;
+			}
+			return k_cyc_to_us_floor64(event->_end_cycles - event->_start_cycles);
+		}
+	}
+	return -1;
+}
+
+/************* PRIVATE IMPLEMENTATION *************/
+int _boot_trace_begin(const char* phase, const char* detail, bool concurrent)
+{
+	unsigned int key = irq_lock();
+	if (boot_trace_count >= MPAI_BOOT_TRACE_MAX_EVENTS)
+	{
+		irq_unlock(key);
+		return -1;
+	}
+	int trace_id = boot_trace_count++;
+	mpai_boot_trace_event_t* event = &boot_trace_events[trace_id];
+	event->_phase = phase;
+	event->_detail[0] = '\0';
+	if (detail != NULL)
+	{
+		strncpy(event->_detail, detail, MPAI_BOOT_TRACE_DETAIL_LEN - 1);
+		event->_detail[MPAI_BOOT_TRACE_DETAIL_LEN - 1] = '\0';
+	}
+	// concurrent phases end in any order: they don't nest the next ones
+	event->_depth = concurrent ? boot_trace_depth : boot_trace_depth++;
+	event->_concurrent = concurrent;
+	event->_end_cycles = 0;
+	event->_start_cycles = _boot_trace_now();
+	irq_unlock(key);
+
+	return trace_id;
+}
+
+uint64_t _boot_trace_now()
+{
+	uint32_t cycles = k_cycle_get_32();
+	if (cycles < boot_trace_last_cycles)
+	{
+		boot_trace_high_cycles += (uint64_t)1 << 32;
+	}
+	boot_trace_last_cycles = cycles;
+	return boot_trace_high_cycles | cycles;
+}
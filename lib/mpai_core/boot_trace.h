@@ -0,0 +1,91 @@
+/*
+ * @file
+ * @brief Headers of a lightweight tracer of the boot phases (LEDs test, BLE, Wi-Fi, CoAP fetches, parsing, AIM starts)
+ * 
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_BOOT_TRACE_H
+#define MPAI_BOOT_TRACE_H
+
+#include <core_common.h>
+
+/* Max number of phases traced during the boot */
+#define MPAI_BOOT_TRACE_MAX_EVENTS 32
+/* Max length of the detail of a phase (i.e. AIM name or CoAP path) */
+#define MPAI_BOOT_TRACE_DETAIL_LEN 32
+
+/* Phase traced, with timestamps in cycles of the hardware clock */
+typedef struct _mpai_boot_trace_event_t {
+	const char* _phase;
+	char _detail[MPAI_BOOT_TRACE_DETAIL_LEN];
+	uint64_t _start_cycles;
+	uint64_t _end_cycles;				// 0 until the phase is ended
+	int8_t _depth;						// nesting level of the phase
+	bool _concurrent;					// traced with MPAI_Boot_Trace_Begin_Concurrent
+} mpai_boot_trace_event_t;
+
+#ifdef CONFIG_MPAI_BOOT_TRACE
+	#define MPAI_BOOT_TRACE_BEGIN(phase, detail) MPAI_Boot_Trace_Begin(phase, detail)
+	#define MPAI_BOOT_TRACE_BEGIN_CONCURRENT(phase, detail) MPAI_Boot_Trace_Begin_Concurrent(phase, detail)
+	#define MPAI_BOOT_TRACE_END(trace_id) MPAI_Boot_Trace_End(trace_id)
+	#define MPAI_BOOT_TRACE_REPORT() MPAI_Boot_Trace_Report()
+#else
+	#define MPAI_BOOT_TRACE_BEGIN(phase, detail) (-1)
+	#define MPAI_BOOT_TRACE_BEGIN_CONCURRENT(phase, detail) (-1)
+	#define MPAI_BOOT_TRACE_END(trace_id) ((void)(trace_id))
+	#define MPAI_BOOT_TRACE_REPORT()
+#endif
+
+/**
+ * @brief Start tracing a boot phase
+ * 
+ * @param phase name of the phase (it has to be a static string)
+ * @param detail optional detail of the phase, copied (NULL if not used)
+ * @return int identifier of the trace, to use ending the phase (-1 if there is no more space)
+ */
+int MPAI_Boot_Trace_Begin(const char* phase, const char* detail);
+
+/**
+ * @brief Start tracing a boot phase that runs concurrently with its siblings (i.e. CoAP fetches in flight together):
+ * it's traced at the current nesting level and the phases started after it aren't nested in it, whatever order they end in
+ * 
+ * @param phase name of the phase (it has to be a static string)
+ * @param detail optional detail of the phase, copied (NULL if not used)
+ * @return int identifier of the trace, to use ending the phase (-1 if there is no more space)
+ */
+int MPAI_Boot_Trace_Begin_Concurrent(const char* phase, const char* detail);
+
+/**
+ * @brief End tracing a boot phase
+ * 
+ * @param trace_id identifier returned by MPAI_Boot_Trace_Begin
+ */
+void MPAI_Boot_Trace_End(int trace_id);
+
+/**
+ * @brief Print the report of all the phases traced to the log
+ * 
+ */
+void MPAI_Boot_Trace_Report();
+
+/**
+ * @brief Get the phases traced until now
+ * 
+ * @param count number of phases traced
+ * @return const mpai_boot_trace_event_t* 
+ */
+const mpai_boot_trace_event_t* MPAI_Boot_Trace_Get_Events(size_t* count);
+
+/**
+ * @brief Get the duration of the first phase traced with the specified name
+ * 
+ * @param phase name of the phase
+ * @param detail detail of the phase (NULL to ignore it)
+ * @return int64_t duration in microseconds (-1 if not found or not ended)
+ */
+int64_t MPAI_Boot_Trace_Get_Duration_Us(const char* phase, const char* detail);
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * @file
+ * @brief Implementation of the cache of MPAI Config Store
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "config_cache.h"
+
+LOG_MODULE_REGISTER(MPAI_CONFIG_CACHE, LOG_LEVEL_INF);
+
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+
+BUILD_ASSERT(CONFIG_MPAI_CONFIG_CACHE_SLOT_SIZE % FLASH_SECTOR_SIZE == 0, "Slots of the config cache have to be multiple of the flash sector");
+BUILD_ASSERT(CONFIG_MPAI_CONFIG_CACHE_SLOTS <= 32, "Too many slots in the config cache");
+
+/* Max size of a configuration in a slot */
+#define CONFIG_CACHE_CAPACITY (CONFIG_MPAI_CONFIG_CACHE_SLOT_SIZE - sizeof(mpai_config_cache_header_t))
+/* Size of the chunks read to check the CRC */
+#define CONFIG_CACHE_CHUNK_SIZE 256
+
+static const struct device* config_cache_flash_dev = NULL;
+/* Slots being written, one bit for each slot: they are never chosen by other writers */
+static uint32_t config_cache_writing = 0;
+K_MUTEX_DEFINE(config_cache_lock);
+
+/************* PRIVATE HEADER *************/
+/* flash device, initialized at first use */
+const struct device* _config_cache_flash();
+/* offset of a slot in flash */
+off_t _config_cache_slot_offset(size_t slot);
+/* read the header of a slot, returning true if it's valid */
+bool _config_cache_read_header(const struct device* flash_dev, size_t slot, mpai_config_cache_header_t* header);
+/* check the CRC of the configuration in a slot */
+bool _config_cache_check_crc(const struct device* flash_dev, size_t slot, const mpai_config_cache_header_t* header);
+/* choose the slot to write a path: an empty one, otherwise the oldest one not being written and not the current copy of the path */
+int _config_cache_choose_slot(const struct device* flash_dev, const char* path);
+
+/************* PUBLIC **************/
+bool MPAI_Config_Cache_Lookup(const char* path, mpai_config_cache_entry_t* entry)
+{
+	const struct device* flash_dev = _config_cache_flash();
+	mpai_config_cache_header_t header;
+	bool found = false;
+
+	if (flash_dev == NULL || strlen(path) >= MPAI_CONFIG_CACHE_PATH_LEN)
+	{
+		return false;
+	}
+
+	k_mutex_lock(&config_cache_lock, K_FOREVER);
+	for (size_t slot = 0; slot < CONFIG_MPAI_CONFIG_CACHE_SLOTS; slot++)
+	{
+		if (_config_cache_read_header(flash_dev, slot, &header) && strcmp(header._path, path) == 0 &&
+			(!found || header._sequence > entry->_header._sequence))
+		{
+			entry->_slot = slot;
+			entry->_header = header;
+			found = true;
+		}
+	}
+	if (found && !_config_cache_check_crc(flash_dev, entry->_slot, &entry->_header))
+	{
+		LOG_WRN("Config %s in cache corrupted: CRC mismatch", log_strdup(path));
+		found = false;
+	}
+	k_mutex_unlock(&config_cache_lock);
+
+	return found;
+}
+
+int MPAI_Config_Cache_Read(const mpai_config_cache_entry_t* entry, size_t offset, uint8_t* buf, size_t len)
+{
+	const struct device* flash_dev = _config_cache_flash();
+	if (flash_dev == NULL)
+	{
+		return -ENODEV;
+	}
+	if (offset + len > entry->_header._len)
+	{
+		return -EINVAL;
+	}
+	return read_flash_region(flash_dev, _config_cache_slot_offset(entry->_slot) + sizeof(mpai_config_cache_header_t) + offset, len, buf);
+}
+
+char* MPAI_Config_Cache_Read_All(const mpai_config_cache_entry_t* entry)
+{
+	char* config = (char *)k_malloc(entry->_header._len + 1);
+	if (config == NULL)
+	{
+		LOG_ERR("Not enough memory to read config %s from cache", log_strdup(entry->_header._path));
+		return NULL;
+	}
+	// the copy could be replaced after the lookup: the CRC is checked again
+	if (MPAI_Config_Cache_Read(entry, 0, (uint8_t *)config, entry->_header._len) != 0 ||
+		crc32_ieee((const uint8_t *)config, entry->_header._len) != entry->_header._crc)
+	{
+		k_free(config);
+		return NULL;
+	}
+	config[entry->_header._len] = '\0';
+	return config;
+}
+
+const uint8_t* MPAI_Config_Cache_Map(const mpai_config_cache_entry_t* entry)
+{
+	const struct device* flash_dev = _config_cache_flash();
+	if (flash_dev == NULL)
+	{
+		return NULL;
+	}
+	const uint8_t* config = map_flash_region(flash_dev, _config_cache_slot_offset(entry->_slot) + sizeof(mpai_config_cache_header_t), entry->_header._len);
+	// the copy could be replaced after the lookup: the CRC is checked again
+	if (config != NULL && crc32_ieee(config, entry->_header._len) != entry->_header._crc)
+	{
+		unmap_flash_region(flash_dev, config);
+		return NULL;
+	}
+	return config;
+}
+
+void MPAI_Config_Cache_Unmap(const uint8_t* config)
+{
+	const struct device* flash_dev = _config_cache_flash();
+	if (flash_dev != NULL)
+	{
+		unmap_flash_region(flash_dev, config);
+	}
+}
+
+bool MPAI_Config_Cache_Write_Begin(mpai_config_cache_writer_t* writer, const char* path)
+{
+	memset(writer, 0, sizeof(mpai_config_cache_writer_t));
+	writer->_failed = true;
+
+	writer->_flash_dev = _config_cache_flash();
+	if (writer->_flash_dev == NULL || strlen(path) >= MPAI_CONFIG_CACHE_PATH_LEN)
+	{
+		return false;
+	}
+
+	k_mutex_lock(&config_cache_lock, K_FOREVER);
+	int slot = _config_cache_choose_slot(writer->_flash_dev, path);
+	if (slot >= 0)
+	{
+		config_cache_writing |= BIT(slot);
+	}
+	k_mutex_unlock(&config_cache_lock);
+
+	if (slot < 0)
+	{
+		LOG_WRN("No slot available in cache for config %s", log_strdup(path));
+		return false;
+	}
+	writer->_slot = slot;
+	strcpy(writer->_header._path, path);
+
+	if (erase_flash_region(writer->_flash_dev, _config_cache_slot_offset(writer->_slot), CONFIG_MPAI_CONFIG_CACHE_SLOT_SIZE) != 0)
+	{
+		MPAI_Config_Cache_Write_Abort(writer);
+		return false;
+	}
+	writer->_failed = false;
+	return true;
+}
+
+bool MPAI_Config_Cache_Write(mpai_config_cache_writer_t* writer, const uint8_t* block, size_t len)
+{
+	if (writer->_failed)
+	{
+		return false;
+	}
+	if (writer->_header._len + len > CONFIG_CACHE_CAPACITY)
+	{
+		LOG_WRN("Config %s too large for the cache", log_strdup(writer->_header._path));
+		writer->_failed = true;
+		return false;
+	}
+	if (len > 0 && write_flash_region(writer->_flash_dev, _config_cache_slot_offset(writer->_slot) + sizeof(mpai_config_cache_header_t) + writer->_header._len, len, block) != 0)
+	{
+		writer->_failed = true;
+		return false;
+	}
+	writer->_header._crc = crc32_ieee_update(writer->_header._crc, block, len);
+	writer->_header._len += len;
+	return true;
+}
+
+bool MPAI_Config_Cache_Write_End(mpai_config_cache_writer_t* writer, const uint8_t* etag, size_t etag_len, int content_format)
+{
+	mpai_config_cache_header_t header;
+	uint32_t sequence = 0;
+	bool written = false;
+
+	if (writer->_failed)
+	{
+		MPAI_Config_Cache_Write_Abort(writer);
+		return false;
+	}
+
+	writer->_header._magic = MPAI_CONFIG_CACHE_MAGIC;
+	writer->_header._etag_len = etag != NULL ? MIN(etag_len, MPAI_CONFIG_CACHE_ETAG_MAX_LEN) : 0;
+	if (writer->_header._etag_len > 0)
+	{
+		memcpy(writer->_header._etag, etag, writer->_header._etag_len);
+	}
+	writer->_header._content_format = content_format;
+
+	k_mutex_lock(&config_cache_lock, K_FOREVER);
+	for (size_t slot = 0; slot < CONFIG_MPAI_CONFIG_CACHE_SLOTS; slot++)
+	{
+		if (slot != writer->_slot && _config_cache_read_header(writer->_flash_dev, slot, &header))
+		{
+			sequence = MAX(sequence, header._sequence);
+		}
+	}
+	writer->_header._sequence = sequence + 1;
+
+	// the header makes the new copy valid: until it's written, the previous copy is used
+	if (write_flash_region(writer->_flash_dev, _config_cache_slot_offset(writer->_slot), sizeof(mpai_config_cache_header_t), &writer->_header) == 0)
+	{
+		written = true;
+		for (size_t slot = 0; slot < CONFIG_MPAI_CONFIG_CACHE_SLOTS; slot++)
+		{
+			if (slot != writer->_slot && _config_cache_read_header(writer->_flash_dev, slot, &header) && strcmp(header._path, writer->_header._path) == 0)
+			{
+				erase_flash_region(writer->_flash_dev, _config_cache_slot_offset(slot), CONFIG_MPAI_CONFIG_CACHE_SLOT_SIZE);
+			}
+		}
+	}
+	config_cache_writing &= ~BIT(writer->_slot);
+	k_mutex_unlock(&config_cache_lock);
+
+	if (written)
+	{
+		LOG_INF("Config %s cached: %d bytes", log_strdup(writer->_header._path), writer->_header._len);
+	}
+	return written;
+}
+
+void MPAI_Config_Cache_Write_Abort(mpai_config_cache_writer_t* writer)
+{
+	if (writer->_flash_dev == NULL || writer->_header._path[0] == '\0')
+	{
+		return;
+	}
+	// the slot has no valid header, so it's empty for the next writers
+	k_mutex_lock(&config_cache_lock, K_FOREVER);
+	config_cache_writing &= ~BIT(writer->_slot);
+	k_mutex_unlock(&config_cache_lock);
+	writer->_header._path[0] = '\0';
+	writer->_failed = true;
+}
+
+bool MPAI_Config_Cache_Put(const char* path, const uint8_t* config, size_t len, const uint8_t* etag, size_t etag_len, int content_format)
+{
+	mpai_config_cache_writer_t writer;
+
+	if (!MPAI_Config_Cache_Write_Begin(&writer, path))
+	{
+		return false;
+	}
+	MPAI_Config_Cache_Write(&writer, config, len);
+	return MPAI_Config_Cache_Write_End(&writer, etag, etag_len, content_format);
+}
+
+/************* PRIVATE **************/
+const struct device* _config_cache_flash()
+{
+	if (config_cache_flash_dev == NULL)
+	{
+		config_cache_flash_dev = init_flash();
+	}
+	return config_cache_flash_dev;
+}
+
+off_t _config_cache_slot_offset(size_t slot)
+{
+	return FLASH_CONFIG_CACHE_REGION_OFFSET + slot * CONFIG_MPAI_CONFIG_CACHE_SLOT_SIZE;
+}
+
+bool _config_cache_read_header(const struct device* flash_dev, size_t slot, mpai_config_cache_header_t* header)
+{
+	if (read_flash_region(flash_dev, _config_cache_slot_offset(slot), sizeof(mpai_config_cache_header_t), header) != 0)
+	{
+		return false;
+	}
+	return header->_magic == MPAI_CONFIG_CACHE_MAGIC && header->_len <= CONFIG_CACHE_CAPACITY &&
+		   header->_etag_len <= MPAI_CONFIG_CACHE_ETAG_MAX_LEN && strnlen(header->_path, MPAI_CONFIG_CACHE_PATH_LEN) < MPAI_CONFIG_CACHE_PATH_LEN;
+}
+
+bool _config_cache_check_crc(const struct device* flash_dev, size_t slot, const mpai_config_cache_header_t* header)
+{
+#ifdef FLASH_MEMORY_MAPPED
+	// read in place
+	const uint8_t* config = map_flash_region(flash_dev, _config_cache_slot_offset(slot) + sizeof(mpai_config_cache_header_t), header->_len);
+	if (config == NULL)
+	{
+		return false;
+	}
+	bool valid = crc32_ieee(config, header->_len) == header->_crc;
+	unmap_flash_region(flash_dev, config);
+	return valid;
+#else
+	uint8_t chunk[CONFIG_CACHE_CHUNK_SIZE];
+	off_t offset = _config_cache_slot_offset(slot) + sizeof(mpai_config_cache_header_t);
+	uint32_t crc = 0;
+
+	for (size_t read = 0; read < header->_len; read += CONFIG_CACHE_CHUNK_SIZE)
+	{
+		size_t len = MIN(header->_len - read, CONFIG_CACHE_CHUNK_SIZE);
+		if (read_flash_region(flash_dev, offset + read, len, chunk) != 0)
+		{
+			return false;
+		}
+		crc = crc32_ieee_update(crc, chunk, len);
+	}
+	return crc == header->_crc;
+#endif
+}
+
+int _config_cache_choose_slot(const struct device* flash_dev, const char* path)
+{
+	mpai_config_cache_header_t header;
+	uint32_t newest_sequence = 0;
+	uint32_t oldest_sequence = UINT32_MAX;
+	int newest = -1;
+	int oldest = -1;
+
+	for (size_t slot = 0; slot < CONFIG_MPAI_CONFIG_CACHE_SLOTS; slot++)
+	{
+		if ((config_cache_writing & BIT(slot)) != 0)
+		{
+			continue;
+		}
+		if (!_config_cache_read_header(flash_dev, slot, &header))
+		{
+			return slot;
+		}
+		if (strcmp(header._path, path) == 0 && (newest < 0 || header._sequence > newest_sequence))
+		{
+			newest = slot;
+			newest_sequence = header._sequence;
+		}
+	}
+	for (size_t slot = 0; slot < CONFIG_MPAI_CONFIG_CACHE_SLOTS; slot++)
+	{
+		if ((config_cache_writing & BIT(slot)) == 0 && (int)slot != newest &&
+			_config_cache_read_header(flash_dev, slot, &header) && header._sequence <= oldest_sequence)
+		{
+			oldest = slot;
+			oldest_sequence = header._sequence;
+		}
+	}
+	return oldest;
+}
+
+#endif
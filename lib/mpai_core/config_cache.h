@@ -0,0 +1,148 @@
+/*
+ * @file
+ * @brief Headers of the cache of MPAI Config Store: configurations retrieved are stored in flash with their ETag,
+ * so boots can use them without network and revalidate them with conditional requests
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_CONFIG_CACHE_H
+#define MPAI_CONFIG_CACHE_H
+
+#include <core_common.h>
+#include <flash_store.h>
+#include <sys/crc.h>
+
+/* "MPCC" */
+#define MPAI_CONFIG_CACHE_MAGIC 0x4D504343
+#define MPAI_CONFIG_CACHE_PATH_LEN 48
+#define MPAI_CONFIG_CACHE_ETAG_MAX_LEN 8
+
+/* Header of a slot, written after the configuration: a slot whose writing was interrupted has no valid header */
+typedef struct _mpai_config_cache_header_t {
+	uint32_t _magic;
+	uint32_t _sequence;							// the highest one is the newest copy of a path
+	char _path[MPAI_CONFIG_CACHE_PATH_LEN];
+	uint8_t _etag[MPAI_CONFIG_CACHE_ETAG_MAX_LEN];
+	uint8_t _etag_len;							// 0 if MPAI Config Store didn't send it: the copy can't be revalidated, only replaced
+	int16_t _content_format;
+	uint32_t _len;
+	uint32_t _crc;								// CRC32 of the configuration
+} mpai_config_cache_header_t;
+
+/* Configuration found in cache */
+typedef struct _mpai_config_cache_entry_t {
+	size_t _slot;
+	mpai_config_cache_header_t _header;
+} mpai_config_cache_entry_t;
+
+/* Configuration written in cache block by block: the previous copy is kept until the new one is complete */
+typedef struct _mpai_config_cache_writer_t {
+	const struct device* _flash_dev;
+	size_t _slot;
+	mpai_config_cache_header_t _header;
+	bool _failed;
+} mpai_config_cache_writer_t;
+
+/**
+ * @brief Find the newest copy of a configuration in cache, checking its CRC
+ *
+ * @param path path of the configuration on MPAI Config Store
+ * @param entry where the copy found is described
+ * @return true if a valid copy is found
+ * @return false
+ */
+bool MPAI_Config_Cache_Lookup(const char* path, mpai_config_cache_entry_t* entry);
+
+/**
+ * @brief Read a chunk of a configuration in cache
+ *
+ * @param entry copy found by MPAI_Config_Cache_Lookup
+ * @param offset
+ * @param buf
+ * @param len
+ * @return int 0 on success
+ */
+int MPAI_Config_Cache_Read(const mpai_config_cache_entry_t* entry, size_t offset, uint8_t* buf, size_t len);
+
+/**
+ * @brief Read an entire configuration in cache
+ *
+ * @param entry copy found by MPAI_Config_Cache_Lookup
+ * @return char* configuration terminated by '\0', to be freed by the caller (NULL on error)
+ */
+char* MPAI_Config_Cache_Read_All(const mpai_config_cache_entry_t* entry);
+
+/**
+ * @brief Map an entire configuration in cache to read it in place, without copying it
+ * (it's copied in memory if the flash memory can't be mapped). The flash memory isn't written until it's unmapped
+ *
+ * @param entry copy found by MPAI_Config_Cache_Lookup
+ * @return const uint8_t* configuration (not terminated), to be unmapped by the caller (NULL on error)
+ */
+const uint8_t* MPAI_Config_Cache_Map(const mpai_config_cache_entry_t* entry);
+
+/**
+ * @brief Unmap a configuration mapped by MPAI_Config_Cache_Map
+ *
+ * @param config
+ */
+void MPAI_Config_Cache_Unmap(const uint8_t* config);
+
+/**
+ * @brief Start writing a configuration in cache, in a slot not used by its current copy
+ *
+ * @param writer
+ * @param path path of the configuration on MPAI Config Store
+ * @return true
+ * @return false if the path is too long or the flash memory is not available
+ */
+bool MPAI_Config_Cache_Write_Begin(mpai_config_cache_writer_t* writer, const char* path);
+
+/**
+ * @brief Append a block to the configuration being written (a configuration larger than the slot is not cached)
+ *
+ * @param writer
+ * @param block
+ * @param len
+ * @return true
+ * @return false
+ */
+bool MPAI_Config_Cache_Write(mpai_config_cache_writer_t* writer, const uint8_t* block, size_t len);
+
+/**
+ * @brief Complete the configuration being written, replacing the previous copy
+ *
+ * @param writer
+ * @param etag ETag sent by MPAI Config Store (NULL if not sent)
+ * @param etag_len
+ * @param content_format Content-Format of the configuration (-1 if not declared)
+ * @return true
+ * @return false if the configuration was not written (the previous copy is kept)
+ */
+bool MPAI_Config_Cache_Write_End(mpai_config_cache_writer_t* writer, const uint8_t* etag, size_t etag_len, int content_format);
+
+/**
+ * @brief Discard the configuration being written, keeping the previous copy
+ *
+ * @param writer
+ */
+void MPAI_Config_Cache_Write_Abort(mpai_config_cache_writer_t* writer);
+
+/**
+ * @brief Write an entire configuration in cache
+ *
+ * @param path path of the configuration on MPAI Config Store
+ * @param config
+ * @param len
+ * @param etag ETag sent by MPAI Config Store (NULL if not sent)
+ * @param etag_len
+ * @param content_format Content-Format of the configuration (-1 if not declared)
+ * @return true
+ * @return false
+ */
+bool MPAI_Config_Cache_Put(const char* path, const uint8_t* config, size_t len, const uint8_t* etag, size_t etag_len, int content_format);
+
+#endif
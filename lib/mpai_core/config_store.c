@@ -11,7 +11,355 @@
 
 LOG_MODULE_REGISTER(MPAI_CONFIG_STORE, LOG_LEVEL_INF);
 
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+/* Resource observed: the path has to stay valid until the observation is cancelled */
+typedef struct _config_store_observation_t {
+	coap_client_observation_t _observation;
+	MPAI_CONFIG_STORE_RESOURCE_TYPE _type;
+	char* _full_name;
+	const char* _path[2];
+	mpai_config_store_notification_callback_t* _callback;
+	void* _user_data;
+} config_store_observation_t;
+
+static config_store_observation_t config_store_observations[CONFIG_MPAI_CONFIG_STORE_OBSERVE_MAX];
+static size_t config_store_observations_count = 0;
+K_MUTEX_DEFINE(config_store_observations_lock);
+#endif
+
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+/* size of stack area used by the revalidation thread */
+#define CONFIG_STORE_REVALIDATION_STACKSIZE 4096
+/* scheduling priority used by the revalidation thread: lower than the AIMs */
+#define CONFIG_STORE_REVALIDATION_PRIORITY 8
+/* size of the chunks streamed from cache */
+#define CONFIG_STORE_CACHE_CHUNK_SIZE 256
+
+/* Request of Get_Concurrent sent to MPAI Config Store, with its copy in cache */
+typedef struct _config_store_cached_request_t {
+	const mpai_config_store_request_t* _request;
+	size_t _idx;							// index in the requests of the caller
+	char* _full_name;
+	bool _cached;
+	mpai_config_cache_entry_t _entry;
+	mpai_config_cache_writer_t _writer;		// new copy, written block by block while it's streamed
+	bool _streamed;							// blocks passed to the caller: the copy in cache can't be used anymore
+	bool _last;
+	large_coap_response_t _response;
+} config_store_cached_request_t;
+
+/* Requests of Get_Concurrent sent to MPAI Config Store */
+typedef struct _config_store_cached_get_t {
+	config_store_cached_request_t _requests[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+	size_t _count;
+	bool _deliver_cached;					// false if only the cache has to be updated (revalidation in background)
+	int _fallbacks;							// requests failed, but served from cache
+	mpai_config_store_callback_t* _callback;
+	void* _user_data;
+} config_store_cached_get_t;
+
+/* Copy in cache to revalidate in background */
+typedef struct _config_store_revalidation_t {
+	void* _fifo_reserved;
+	MPAI_CONFIG_STORE_RESOURCE_TYPE _type;
+	bool _streamed;
+	char _name[];
+} config_store_revalidation_t;
+
+K_FIFO_DEFINE(config_store_revalidation_fifo);
+K_THREAD_STACK_DEFINE(config_store_revalidation_stack_area, CONFIG_STORE_REVALIDATION_STACKSIZE);
+static struct k_thread config_store_revalidation_thread;
+static atomic_t config_store_revalidation_started = ATOMIC_INIT(0);
+static atomic_t config_store_revalidation_pending = ATOMIC_INIT(0);
+#endif
+
 /************* PRIVATE *************/
+#ifdef CONFIG_MPAI_CONFIG_STORE_USES_COAP
+static const char* _config_store_base_path(MPAI_CONFIG_STORE_RESOURCE_TYPE type)
+{
+	switch (type)
+	{
+	case MPAI_CONFIG_STORE_AIF:
+		return AIF_CONFIG[0];
+	case MPAI_CONFIG_STORE_AIW:
+		return AIW_CONFIG[0];
+	case MPAI_CONFIG_STORE_PARAMETERS:
+		return PARAMETERS_CONFIG[0];
+	default:
+		return AIM_CONFIG[0];
+	}
+}
+#endif
+
+#ifdef CONFIG_MPAI_CONFIG_STORE_USES_COAP
+static uint16_t _config_store_accept_format(const mpai_config_store_request_t* request)
+{
+#ifdef CONFIG_MPAI_CONFIG_STORE_CBOR
+	// only streamed configurations can be decoded from CBOR, the entire ones are handled as strings
+	if (request->_block_callback != NULL)
+	{
+		return MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR;
+	}
+#endif
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+static void _config_store_deliver_cached(const mpai_config_store_request_t* request, size_t idx, const mpai_config_cache_entry_t* entry, mpai_config_store_callback_t* callback, void* user_data)
+{
+	if (request->_block_callback == NULL)
+	{
+		callback(idx, MPAI_Config_Cache_Read_All(entry), user_data);
+		return;
+	}
+
+	size_t len = entry->_header._len;
+	size_t offset = 0;
+#ifdef FLASH_MEMORY_MAPPED
+	// the chunks are read in place, from the flash memory mapped
+	const uint8_t* config = MPAI_Config_Cache_Map(entry);
+	while (config != NULL)
+	{
+		size_t chunk_len = MIN(len - offset, CONFIG_STORE_CACHE_CHUNK_SIZE);
+		if (request->_block_callback(idx, config + offset, chunk_len, offset + chunk_len == len, entry->_header._content_format, user_data) < 0)
+		{
+			break;
+		}
+		offset += chunk_len;
+		if (offset >= len)
+		{
+			break;
+		}
+	}
+	MPAI_Config_Cache_Unmap(config);
+#else
+	uint8_t chunk[CONFIG_STORE_CACHE_CHUNK_SIZE];
+	do
+	{
+		size_t chunk_len = MIN(len - offset, CONFIG_STORE_CACHE_CHUNK_SIZE);
+		if (MPAI_Config_Cache_Read(entry, offset, chunk, chunk_len) != 0 ||
+			request->_block_callback(idx, chunk, chunk_len, offset + chunk_len == len, entry->_header._content_format, user_data) < 0)
+		{
+			break;
+		}
+		offset += chunk_len;
+	} while (offset < len);
+#endif
+	callback(idx, NULL, user_data);
+}
+
+static int _config_store_cached_block_callback(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data)
+{
+	config_store_cached_get_t* get = (config_store_cached_get_t*)user_data;
+	config_store_cached_request_t* cached_request = &get->_requests[idx];
+
+	if (!cached_request->_streamed)
+	{
+		cached_request->_streamed = true;
+		MPAI_Config_Cache_Write_Begin(&cached_request->_writer, cached_request->_full_name);
+	}
+	MPAI_Config_Cache_Write(&cached_request->_writer, block, len);
+
+	int r = cached_request->_request->_block_callback(cached_request->_idx, block, len, last, content_format, get->_user_data);
+	cached_request->_last = last && r >= 0;
+	return r;
+}
+
+static void _config_store_cached_callback(size_t idx, char* result, void* user_data)
+{
+	config_store_cached_get_t* get = (config_store_cached_get_t*)user_data;
+	config_store_cached_request_t* cached_request = &get->_requests[idx];
+	const large_coap_response_t* response = &cached_request->_response;
+	bool stored = false;
+
+	if (response->_valid)
+	{
+		// the copy in cache is up to date: MPAI Config Store didn't send it again
+		if (get->_deliver_cached)
+		{
+			_config_store_deliver_cached(cached_request->_request, cached_request->_idx, &cached_request->_entry, get->_callback, get->_user_data);
+			return;
+		}
+	}
+	else if (result != NULL)
+	{
+		stored = MPAI_Config_Cache_Put(cached_request->_full_name, (const uint8_t*)result, strlen(result), response->_etag, response->_etag_len, response->_content_format);
+	}
+	else if (cached_request->_streamed && cached_request->_last)
+	{
+		stored = MPAI_Config_Cache_Write_End(&cached_request->_writer, response->_etag, response->_etag_len, response->_content_format);
+	}
+	else if (cached_request->_streamed)
+	{
+		MPAI_Config_Cache_Write_Abort(&cached_request->_writer);
+	}
+	else if (cached_request->_cached && get->_deliver_cached)
+	{
+		LOG_WRN("Config %s not retrieved from MPAI Config Store: using the copy in cache", log_strdup(cached_request->_full_name));
+		get->_fallbacks++;
+		_config_store_deliver_cached(cached_request->_request, cached_request->_idx, &cached_request->_entry, get->_callback, get->_user_data);
+		return;
+	}
+
+	if (stored && !get->_deliver_cached)
+	{
+		LOG_INF("Config %s changed on MPAI Config Store: the new copy in cache is used from the next boot", log_strdup(cached_request->_full_name));
+	}
+	get->_callback(cached_request->_idx, result, get->_user_data);
+}
+
+static void _config_store_revalidate_later(const mpai_config_store_request_t* request);
+
+static int _config_store_get_cached(const mpai_config_store_request_t* requests, size_t count, bool deliver_cached, mpai_config_store_callback_t* callback, void* user_data)
+{
+	char* config_paths[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS][2];
+	large_coap_request_t large_requests[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+
+	// too large for the stack of the callers
+	config_store_cached_get_t* get = (config_store_cached_get_t*)k_calloc(1, sizeof(config_store_cached_get_t));
+	if (get == NULL)
+	{
+		return -ENOMEM;
+	}
+	get->_deliver_cached = deliver_cached;
+	get->_callback = callback;
+	get->_user_data = user_data;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		config_store_cached_request_t* cached_request = &get->_requests[get->_count];
+		cached_request->_request = &requests[i];
+		cached_request->_idx = i;
+		cached_request->_full_name = append_strings(_config_store_base_path(requests[i]._type), requests[i]._name);
+		// entire configurations are handled as strings: a copy in CBOR can be used only by streamed requests
+		cached_request->_cached = MPAI_Config_Cache_Lookup(cached_request->_full_name, &cached_request->_entry) &&
+								  (requests[i]._block_callback != NULL || cached_request->_entry._header._content_format != MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR);
+
+		if (cached_request->_cached && deliver_cached && requests[i]._cache_policy == MPAI_CONFIG_STORE_CACHE_FIRST)
+		{
+			LOG_INF("Config %s used from cache", log_strdup(cached_request->_full_name));
+			_config_store_deliver_cached(&requests[i], i, &cached_request->_entry, callback, user_data);
+			_config_store_revalidate_later(&requests[i]);
+			k_free(cached_request->_full_name);
+			memset(cached_request, 0, sizeof(config_store_cached_request_t));
+			continue;
+		}
+
+		config_paths[get->_count][0] = cached_request->_full_name;/*TODO: UNION DEFAULT OPTIONS*/
+		config_paths[get->_count][1] = NULL;
+		large_coap_request_t* large_request = &large_requests[get->_count];
+		large_request->_path = (const char* const*)config_paths[get->_count];
+		large_request->_block_callback = requests[i]._block_callback != NULL ? _config_store_cached_block_callback : NULL;
+		large_request->_accept_format = _config_store_accept_format(&requests[i]);
+		// conditional request: if the copy in cache is still valid, it's not sent again
+		large_request->_etag = cached_request->_cached ? cached_request->_entry._header._etag : NULL;
+		large_request->_etag_len = cached_request->_cached ? cached_request->_entry._header._etag_len : 0;
+		large_request->_response = &cached_request->_response;
+		get->_count++;
+	}
+
+	int failed = 0;
+	if (get->_count > 0)
+	{
+		failed = get_large_coap_msgs_concurrent(get_coap_client(), large_requests, get->_count, _config_store_cached_callback, get);
+		if (failed > 0)
+		{
+			failed -= get->_fallbacks;
+		}
+	}
+
+	for (size_t i = 0; i < get->_count; i++)
+	{
+		k_free(get->_requests[i]._full_name);
+	}
+	k_free(get);
+	return failed;
+}
+
+static int _config_store_revalidation_block_callback(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data)
+{
+	// only the cache is updated
+	return 0;
+}
+
+static void _config_store_revalidation_callback(size_t idx, char* result, void* user_data)
+{
+	k_free(result);
+}
+
+static void _config_store_revalidation(void *dummy1, void *dummy2, void *dummy3)
+{
+	config_store_revalidation_t* revalidations[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+	mpai_config_store_request_t requests[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+
+	while (true)
+	{
+		// copies queued together are revalidated concurrently
+		size_t count = 0;
+		revalidations[count++] = k_fifo_get(&config_store_revalidation_fifo, K_FOREVER);
+		while (count < MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS &&
+			   (revalidations[count] = k_fifo_get(&config_store_revalidation_fifo, K_NO_WAIT)) != NULL)
+		{
+			count++;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			requests[i] = (mpai_config_store_request_t){
+				._type = revalidations[i]->_type,
+				._name = revalidations[i]->_name,
+				._block_callback = revalidations[i]->_streamed ? _config_store_revalidation_block_callback : NULL,
+				._cache_policy = MPAI_CONFIG_STORE_CACHE_REVALIDATE};
+		}
+		int failed = _config_store_get_cached(requests, count, false, _config_store_revalidation_callback, NULL);
+		if (failed != 0)
+		{
+			LOG_WRN("Unable to revalidate copies in cache with MPAI Config Store: %d", failed);
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			k_free(revalidations[i]);
+		}
+		atomic_sub(&config_store_revalidation_pending, count);
+	}
+}
+
+static void _config_store_revalidate_later(const mpai_config_store_request_t* request)
+{
+	config_store_revalidation_t* revalidation = (config_store_revalidation_t*)k_malloc(sizeof(config_store_revalidation_t) + strlen(request->_name) + 1);
+	if (revalidation == NULL)
+	{
+		LOG_ERR("Not enough memory to revalidate config %s", log_strdup(request->_name));
+		return;
+	}
+	revalidation->_type = request->_type;
+	revalidation->_streamed = request->_block_callback != NULL;
+	strcpy(revalidation->_name, request->_name);
+
+	if (atomic_cas(&config_store_revalidation_started, 0, 1))
+	{
+		k_thread_create(&config_store_revalidation_thread, config_store_revalidation_stack_area,
+						K_THREAD_STACK_SIZEOF(config_store_revalidation_stack_area),
+						_config_store_revalidation, NULL, NULL, NULL,
+						CONFIG_STORE_REVALIDATION_PRIORITY, 0, K_NO_WAIT);
+		k_thread_name_set(&config_store_revalidation_thread, "thread_config_revalidation");
+	}
+	atomic_inc(&config_store_revalidation_pending);
+	k_fifo_put(&config_store_revalidation_fifo, revalidation);
+}
+#endif
+
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+static void _config_store_notification(coap_client_observation_t* observation, const uint8_t* payload, size_t len, int content_format, void* user_data)
+{
+	config_store_observation_t* config_observation = (config_store_observation_t*)user_data;
+	const char* name = config_observation->_full_name + strlen(_config_store_base_path(config_observation->_type));
+
+	config_observation->_callback(config_observation->_type, name, payload, len, content_format, config_observation->_user_data);
+}
+#endif
 
 /************* PUBLIC **************/
 char* MPAI_Config_Store_Get_AIF(const char* aif_name)
@@ -19,7 +367,7 @@ char* MPAI_Config_Store_Get_AIF(const char* aif_name)
 #ifdef CONFIG_MPAI_CONFIG_STORE_USES_COAP
 	char* aif_full_name = append_strings(AIF_CONFIG[0], aif_name);
 	char * aif_config_path[] = { aif_full_name, NULL };/*TODO: UNION DEFAULT OPTIONS*/
-	return get_large_coap_msgs(aif_config_path);
+	return get_large_coap_msgs(get_coap_client(), aif_config_path);
 #else
 	return "{}";
 #endif
@@ -30,7 +378,7 @@ char* MPAI_Config_Store_Get_AIW(const char* aiw_name)
 #ifdef CONFIG_MPAI_CONFIG_STORE_USES_COAP
 	char* aiw_full_name = append_strings(AIW_CONFIG[0], aiw_name);
 	char * aiw_config_path[] = { aiw_full_name, NULL };/*TODO: UNION DEFAULT OPTIONS*/
-	return get_large_coap_msgs(aiw_config_path);
+	return get_large_coap_msgs(get_coap_client(), aiw_config_path);
 #else
 	return "{}";
 #endif
@@ -41,8 +389,152 @@ char* MPAI_Config_Store_Get_AIM(const char* aim_name)
 #ifdef CONFIG_MPAI_CONFIG_STORE_USES_COAP
 	char* aim_full_name = append_strings(AIM_CONFIG[0], aim_name);
 	char * aim_config_path[] = { aim_full_name, NULL };/*TODO: UNION DEFAULT OPTIONS*/
-	return get_large_coap_msgs(aim_config_path);
+	return get_large_coap_msgs(get_coap_client(), aim_config_path);
 #else
 	return "{}";
 #endif
-}
\ No newline at end of file
+}
+
+int MPAI_Config_Store_Get_Concurrent(const mpai_config_store_request_t* requests, size_t count, mpai_config_store_callback_t* callback, void* user_data)
+{
+#ifdef CONFIG_MPAI_CONFIG_STORE_USES_COAP
+	if (count > MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS)
+	{
+		return -EINVAL;
+	}
+
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+	return _config_store_get_cached(requests, count, true, callback, user_data);
+#else
+	char* full_names[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+	char* config_paths[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS][2];
+	large_coap_request_t large_requests[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+	for (size_t i = 0; i < count; i++)
+	{
+		full_names[i] = append_strings(_config_store_base_path(requests[i]._type), requests[i]._name);
+		config_paths[i][0] = full_names[i];/*TODO: UNION DEFAULT OPTIONS*/
+		config_paths[i][1] = NULL;
+		large_requests[i]._path = (const char* const*)config_paths[i];
+		large_requests[i]._block_callback = requests[i]._block_callback;
+		large_requests[i]._accept_format = _config_store_accept_format(&requests[i]);
+		large_requests[i]._etag = NULL;
+		large_requests[i]._etag_len = 0;
+		large_requests[i]._response = NULL;
+	}
+
+	int failed = get_large_coap_msgs_concurrent(get_coap_client(), large_requests, count, callback, user_data);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		k_free(full_names[i]);
+	}
+	return failed;
+#endif
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		if (requests[i]._block_callback != NULL)
+		{
+			requests[i]._block_callback(i, (const uint8_t*)"{}", 2, true, MPAI_CONFIG_STORE_CONTENT_FORMAT_JSON, user_data);
+			callback(i, NULL, user_data);
+		}
+		else
+		{
+			callback(i, append_strings("", "{}"), user_data);
+		}
+	}
+	return 0;
+#endif
+}
+
+bool MPAI_Config_Store_Wait_Revalidation(int32_t timeout_ms)
+{
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+	int64_t deadline = k_uptime_get() + timeout_ms;
+	while (atomic_get(&config_store_revalidation_pending) > 0)
+	{
+		if (k_uptime_get() >= deadline)
+		{
+			return false;
+		}
+		k_sleep(K_MSEC(100));
+	}
+#endif
+	return true;
+}
+
+int MPAI_Config_Store_Observe(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name, mpai_config_store_notification_callback_t* callback, void* user_data)
+{
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+	int r = -ENOMEM;
+
+	k_mutex_lock(&config_store_observations_lock, K_FOREVER);
+	if (config_store_observations_count < CONFIG_MPAI_CONFIG_STORE_OBSERVE_MAX)
+	{
+		config_store_observation_t* config_observation = &config_store_observations[config_store_observations_count];
+		config_observation->_type = type;
+		config_observation->_full_name = append_strings(_config_store_base_path(type), name);
+		config_observation->_path[0] = config_observation->_full_name;
+		config_observation->_path[1] = NULL;
+		config_observation->_callback = callback;
+		config_observation->_user_data = user_data;
+
+		uint16_t accept_format = 0;
+#ifdef CONFIG_MPAI_CONFIG_STORE_CBOR
+		accept_format = MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR;
+#endif
+		r = coap_client_observe(get_coap_client(), &config_observation->_observation, config_observation->_path, accept_format, _config_store_notification, config_observation);
+		// the client returns the bytes of the registration sent
+		if (r >= 0)
+		{
+			config_store_observations_count++;
+			r = 0;
+		}
+		else
+		{
+			k_free(config_observation->_full_name);
+		}
+	}
+	k_mutex_unlock(&config_store_observations_lock);
+
+	if (r < 0)
+	{
+		LOG_ERR("Cannot observe %s%s: %d", log_strdup(_config_store_base_path(type)), log_strdup(name), r);
+	}
+	return r;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int MPAI_Config_Store_Observe_Refresh()
+{
+	int refreshed = 0;
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+	k_mutex_lock(&config_store_observations_lock, K_FOREVER);
+	for (size_t i = 0; i < config_store_observations_count; i++)
+	{
+		coap_client_observation_t* observation = &config_store_observations[i]._observation;
+		if (!coap_client_observe_is_fresh(observation) && coap_client_observe_refresh(observation) >= 0)
+		{
+			refreshed++;
+		}
+	}
+	k_mutex_unlock(&config_store_observations_lock);
+#endif
+	return refreshed;
+}
+
+void MPAI_Config_Store_Observe_Cancel_All()
+{
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+	k_mutex_lock(&config_store_observations_lock, K_FOREVER);
+	for (size_t i = 0; i < config_store_observations_count; i++)
+	{
+		coap_client_observe_cancel(&config_store_observations[i]._observation);
+		k_free(config_store_observations[i]._full_name);
+	}
+	config_store_observations_count = 0;
+	k_mutex_unlock(&config_store_observations_lock);
+#endif
+}
@@ -22,8 +22,56 @@
     static const char * const AIF_CONFIG[] = { "config/aif/", NULL };
     static const char * const AIW_CONFIG[] = { "config/aiw/", NULL };
     static const char * const AIM_CONFIG[] = { "config/aim/", NULL };
+    static const char * const PARAMETERS_CONFIG[] = { "config/parameters/", NULL };
+
+    #define MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS MAX_COAP_CONCURRENT_TRANSFERS
+    #ifdef CONFIG_MPAI_CONFIG_CACHE
+        #include <config_cache.h>
+    #endif
+#else
+    #define MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS 8
 #endif
 
+/* Type of the resources stored in MPAI Config Store */
+typedef enum
+{
+    MPAI_CONFIG_STORE_AIF,
+    MPAI_CONFIG_STORE_AIW,
+    MPAI_CONFIG_STORE_AIM,
+    MPAI_CONFIG_STORE_PARAMETERS        // values of the parameters of an AIM, as an object of numbers
+} MPAI_CONFIG_STORE_RESOURCE_TYPE;
+
+/* Use of the copies in cache (with CONFIG_MPAI_CONFIG_CACHE) */
+typedef enum
+{
+    MPAI_CONFIG_STORE_CACHE_FIRST,      // the copy in cache is used at once and revalidated in background: changes are used from the next boot
+    MPAI_CONFIG_STORE_CACHE_REVALIDATE  // the copy in cache is used only if MPAI Config Store replies it's still valid, or if it's not reachable
+} MPAI_CONFIG_STORE_CACHE_POLICY;
+
+/* Encodings of the configurations, as CoAP Content-Format numbers */
+#define MPAI_CONFIG_STORE_CONTENT_FORMAT_JSON 50
+#define MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR 60
+
+/* Callback called for each chunk of a streamed configuration, in order (returns a negative value to abort).
+ * content_format is the encoding of the configuration (-1 if not declared by MPAI Config Store).
+ * A copy in cache can be delivered straight from the flash memory mapped: the flash memory can't be written until it returns */
+typedef int (mpai_config_store_block_callback_t)(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data);
+
+/* Resource to retrieve from MPAI Config Store */
+typedef struct _mpai_config_store_request_t {
+    MPAI_CONFIG_STORE_RESOURCE_TYPE _type;
+    const char* _name;
+    mpai_config_store_block_callback_t* _block_callback;   // NULL to retrieve the entire configuration
+    MPAI_CONFIG_STORE_CACHE_POLICY _cache_policy;
+} mpai_config_store_request_t;
+
+/* Callback called when a configuration is retrieved (result is NULL on error or if streamed, otherwise it has to be freed by the callee) */
+typedef void (mpai_config_store_callback_t)(size_t idx, char* result, void* user_data);
+
+/* Callback called when an observed resource changes (the first time with its current content).
+ * It's called by the thread receiving the notifications: it has to copy the document and return quickly */
+typedef void (mpai_config_store_notification_callback_t)(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name, const uint8_t* document, size_t len, int content_format, void* user_data);
+
 /**
  * @brief Retrieve AIF configuration in a JSON format
  * 
@@ -48,4 +96,57 @@ char* MPAI_Config_Store_Get_AIW(const char* aiw_name);
  */
 char* MPAI_Config_Store_Get_AIM(const char* aim_name);
 
+/**
+ * @brief Retrieve many configurations in a JSON format at the same time: the callback is called
+ * as soon as each configuration is retrieved, in the order they arrive.
+ * Requests with a block callback are streamed, so the configuration is never stored entirely
+ * (with CONFIG_MPAI_CONFIG_STORE_CBOR they are asked in CBOR, if MPAI Config Store supports it).
+ * With CONFIG_MPAI_CONFIG_CACHE, copies in cache are used according to the cache policy of each request,
+ * and configurations retrieved are stored in cache
+ * 
+ * @param requests resources to retrieve
+ * @param count number of resources
+ * @param callback called for each resource retrieved
+ * @param user_data data passed to the callback
+ * @return int number of resources not retrieved, or a negative value on error
+ */
+int MPAI_Config_Store_Get_Concurrent(const mpai_config_store_request_t* requests, size_t count, mpai_config_store_callback_t* callback, void* user_data);
+
+/**
+ * @brief Wait until the copies in cache used by MPAI_CONFIG_STORE_CACHE_FIRST requests are revalidated in background
+ * (i.e. before closing the CoAP client)
+ * 
+ * @param timeout_ms max time to wait
+ * @return true if there are no more revalidations pending
+ * @return false
+ */
+bool MPAI_Config_Store_Wait_Revalidation(int32_t timeout_ms);
+
+/**
+ * @brief Observe a resource of MPAI Config Store: the callback is called with its content
+ * and then each time it changes, until all the observations are cancelled.
+ * Only the first block of large resources is notified
+ * 
+ * @param type type of the resource
+ * @param name name of the resource
+ * @param callback called for each notification
+ * @param user_data data passed to the callback
+ * @return int 0 if the observation is registered, -ENOMEM if too many resources are observed, -ENOTSUP without CONFIG_MPAI_CONFIG_STORE_OBSERVE
+ */
+int MPAI_Config_Store_Observe(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name, mpai_config_store_notification_callback_t* callback, void* user_data);
+
+/**
+ * @brief Register again the observations not confirmed or not fresh anymore (i.e. MPAI Config Store restarted),
+ * to call periodically
+ * 
+ * @return int number of observations registered again
+ */
+int MPAI_Config_Store_Observe_Refresh();
+
+/**
+ * @brief Cancel all the observations
+ * 
+ */
+void MPAI_Config_Store_Observe_Cancel_All();
+
 #endif
\ No newline at end of file
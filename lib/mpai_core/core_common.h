@@ -29,7 +29,8 @@ typedef enum
     MPAI_AIF_OK,
     MPAI_AIM_ALIVE, 
     MPAI_AIM_DEAD,
-    MPAI_ERROR
+    MPAI_ERROR,
+    MPAI_AIW_ALREADY_STARTED
 } MPAI_RETURN_CODE;
 
 typedef enum
@@ -65,6 +66,7 @@ typedef void (topology_output_callback_t)(const char* aim_name, const char* port
     (MPAI_AIF_OK       == err ? "MPAI_AIF_OK"    :                \
      (MPAI_AIM_ALIVE     == err ? "MPAI_AIM_ALIVE"   :                \
       (MPAI_AIM_DEAD   == err ? "MPAI_AIM_DEAD"  :                \
-       (MPAI_ERROR == err ? "MPAI_ERROR" : "unknown"))))           
+       (MPAI_ERROR == err ? "MPAI_ERROR" :                \
+        (MPAI_AIW_ALREADY_STARTED == err ? "MPAI_AIW_ALREADY_STARTED" : "unknown")))))
 
 #endif
\ No newline at end of file
@@ -0,0 +1,473 @@
+/*
+ * @file
+ * @brief Implementation of a circular buffer of records in flash memory
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "flash_ring.h"
+
+LOG_MODULE_REGISTER(MPAI_FLASH_RING, LOG_LEVEL_INF);
+
+#ifdef CONFIG_MPAI_FLASH_RING
+
+BUILD_ASSERT(CONFIG_MPAI_FLASH_RING_SECTORS >= 2, "The flash ring needs at least 2 sectors");
+BUILD_ASSERT(FLASH_SECTOR_SIZE % MPAI_FLASH_RING_PAGE_SIZE == 0, "Sectors have to be made of pages");
+
+#define FLASH_RING_SEQUENCE_NONE 0xFFFFFFFF
+
+/* Sector in memory */
+typedef struct _flash_ring_sector_t {
+	uint32_t _sequence;							// FLASH_RING_SEQUENCE_NONE if not written
+	uint16_t _used;								// offset of the free space (records in memory included)
+	uint16_t _pending;							// records not forwarded
+} flash_ring_sector_t;
+
+static const struct device* flash_ring_flash_dev = NULL;
+static bool flash_ring_mounted = false;
+static flash_ring_sector_t flash_ring_sectors[CONFIG_MPAI_FLASH_RING_SECTORS];
+/* sector where records are appended, -1 if none is written */
+static int flash_ring_head = -1;
+static uint32_t flash_ring_sequence = 0;
+/* page of the head sector being filled: bytes before the flushed ones are already written */
+static uint8_t flash_ring_page[MPAI_FLASH_RING_PAGE_SIZE];
+static uint16_t flash_ring_page_offset = 0;
+static uint16_t flash_ring_page_flushed = 0;
+static uint32_t flash_ring_appended = 0;
+static uint32_t flash_ring_forwarded = 0;
+static uint32_t flash_ring_dropped = 0;
+K_MUTEX_DEFINE(flash_ring_lock);
+
+/************* PRIVATE HEADER *************/
+/* mount the ring, if it's not mounted */
+int _flash_ring_check_mounted();
+/* offset of a sector in flash */
+off_t _flash_ring_sector_offset(size_t sector);
+/* size of a record in flash, aligned */
+uint16_t _flash_ring_record_size(size_t len);
+/* scan the records of a sector, counting the ones not forwarded */
+void _flash_ring_scan(size_t sector);
+/* CRC32 of the data of a record in flash, continuing the CRC of its header */
+int _flash_ring_crc_flash(off_t offset, size_t len, uint32_t* crc);
+/* erase the next sector (the oldest one) and write its header, to append records to it */
+int _flash_ring_advance();
+/* set the page of the head sector being filled, from the free space of the sector */
+void _flash_ring_set_page();
+/* copy data to the page being filled, writing the page when it's full */
+int _flash_ring_buffer(const void* data, size_t len);
+/* write the bytes of the page not written yet */
+int _flash_ring_flush_page();
+
+/************* PUBLIC **************/
+int MPAI_Flash_Ring_Mount()
+{
+	mpai_flash_ring_sector_header_t header;
+	int r = 0;
+
+	k_mutex_lock(&flash_ring_lock, K_FOREVER);
+
+	if (flash_ring_flash_dev == NULL)
+	{
+		flash_ring_flash_dev = init_flash();
+	}
+	if (flash_ring_flash_dev == NULL)
+	{
+		k_mutex_unlock(&flash_ring_lock);
+		return -ENODEV;
+	}
+
+	flash_ring_mounted = false;
+	flash_ring_head = -1;
+	flash_ring_sequence = 0;
+	uint32_t pending = 0;
+
+	for (size_t sector = 0; sector < CONFIG_MPAI_FLASH_RING_SECTORS; sector++)
+	{
+		flash_ring_sectors[sector]._sequence = FLASH_RING_SEQUENCE_NONE;
+		flash_ring_sectors[sector]._used = FLASH_SECTOR_SIZE;
+		flash_ring_sectors[sector]._pending = 0;
+
+		r = read_flash_region(flash_ring_flash_dev, _flash_ring_sector_offset(sector), sizeof(header), &header);
+		if (r != 0)
+		{
+			k_mutex_unlock(&flash_ring_lock);
+			return r;
+		}
+		// sectors not written (or whose header was interrupted) are erased when the ring reaches them
+		if (header._magic != MPAI_FLASH_RING_MAGIC || header._sequence_check != ~header._sequence)
+		{
+			continue;
+		}
+
+		flash_ring_sectors[sector]._sequence = header._sequence;
+		_flash_ring_scan(sector);
+		pending += flash_ring_sectors[sector]._pending;
+		if (flash_ring_head < 0 || header._sequence > flash_ring_sequence)
+		{
+			flash_ring_head = sector;
+			flash_ring_sequence = header._sequence;
+		}
+	}
+
+	if (flash_ring_head >= 0)
+	{
+		_flash_ring_set_page();
+	}
+
+	flash_ring_mounted = true;
+	LOG_INF("Flash ring mounted: %u records not forwarded", pending);
+
+	k_mutex_unlock(&flash_ring_lock);
+	return 0;
+}
+
+int MPAI_Flash_Ring_Append(const void* data, size_t len)
+{
+	mpai_flash_ring_record_header_t header;
+	static const uint8_t padding[MPAI_FLASH_RING_ALIGN] = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+	if (len == 0 || len > MPAI_FLASH_RING_RECORD_MAX_LEN)
+	{
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&flash_ring_lock, K_FOREVER);
+	int r = _flash_ring_check_mounted();
+	uint16_t size = _flash_ring_record_size(len);
+	if (r == 0 && (flash_ring_head < 0 || flash_ring_sectors[flash_ring_head]._used + size > FLASH_SECTOR_SIZE))
+	{
+		r = _flash_ring_advance();
+	}
+	if (r != 0)
+	{
+		k_mutex_unlock(&flash_ring_lock);
+		return r;
+	}
+
+	header._len = len;
+	header._state = MPAI_FLASH_RING_RECORD_PENDING;
+	header._reserved = 0xFF;
+	header._crc = crc32_ieee((const uint8_t*)&header._len, sizeof(header._len));
+	header._crc = crc32_ieee_update(header._crc, data, len);
+
+	// the padding stays erased, so the next record can be written there
+	r = _flash_ring_buffer(&header, sizeof(header));
+	if (r == 0)
+	{
+		r = _flash_ring_buffer(data, len);
+	}
+	if (r == 0)
+	{
+		r = _flash_ring_buffer(padding, size - sizeof(header) - len);
+	}
+	if (r != 0)
+	{
+		// the space of the record can't be written again
+		flash_ring_sectors[flash_ring_head]._used = FLASH_SECTOR_SIZE;
+		k_mutex_unlock(&flash_ring_lock);
+		return r;
+	}
+
+	flash_ring_sectors[flash_ring_head]._pending++;
+	flash_ring_appended++;
+	k_mutex_unlock(&flash_ring_lock);
+	return 0;
+}
+
+int MPAI_Flash_Ring_Sync()
+{
+	k_mutex_lock(&flash_ring_lock, K_FOREVER);
+	int r = _flash_ring_check_mounted();
+	if (r == 0)
+	{
+		r = _flash_ring_flush_page();
+	}
+	k_mutex_unlock(&flash_ring_lock);
+	return r;
+}
+
+int MPAI_Flash_Ring_Forward(mpai_flash_ring_forward_t* callback, void* user_data, size_t max)
+{
+	mpai_flash_ring_record_header_t header;
+	static const uint8_t forwarded = MPAI_FLASH_RING_RECORD_FORWARDED;
+	size_t count = 0;
+
+	k_mutex_lock(&flash_ring_lock, K_FOREVER);
+	int r = _flash_ring_check_mounted();
+	// records are read from flash memory, so the page in memory is written first
+	if (r == 0 && flash_ring_head >= 0)
+	{
+		r = _flash_ring_flush_page();
+	}
+	if (r != 0 || flash_ring_head < 0)
+	{
+		k_mutex_unlock(&flash_ring_lock);
+		return r;
+	}
+
+	// from the sector after the head (the oldest one) to the head
+	for (size_t i = 1; r == 0 && count < max && i <= CONFIG_MPAI_FLASH_RING_SECTORS; i++)
+	{
+		size_t sector = (flash_ring_head + i) % CONFIG_MPAI_FLASH_RING_SECTORS;
+		off_t sector_offset = _flash_ring_sector_offset(sector);
+		size_t offset = sizeof(mpai_flash_ring_sector_header_t);
+
+		while (r == 0 && count < max && flash_ring_sectors[sector]._pending > 0 && offset < flash_ring_sectors[sector]._used)
+		{
+			r = read_flash_region(flash_ring_flash_dev, sector_offset + offset, sizeof(header), &header);
+			if (r != 0 || header._len == MPAI_FLASH_RING_FREE || header._len > MPAI_FLASH_RING_RECORD_MAX_LEN)
+			{
+				break;
+			}
+			if (header._state != MPAI_FLASH_RING_RECORD_PENDING)
+			{
+				offset += _flash_ring_record_size(header._len);
+				continue;
+			}
+
+			uint8_t* data = (uint8_t*)k_malloc(header._len);
+			if (data == NULL)
+			{
+				r = -ENOMEM;
+				break;
+			}
+			r = read_flash_region(flash_ring_flash_dev, sector_offset + offset + sizeof(header), header._len, data);
+			if (r == 0)
+			{
+				r = callback(data, header._len, user_data);
+			}
+			k_free(data);
+			if (r != 0)
+			{
+				break;
+			}
+
+			// only the state of the record is written: it's already erased
+			r = write_flash_region(flash_ring_flash_dev, sector_offset + offset + offsetof(mpai_flash_ring_record_header_t, _state), sizeof(forwarded), &forwarded);
+			if (r != 0)
+			{
+				break;
+			}
+			flash_ring_sectors[sector]._pending--;
+			flash_ring_forwarded++;
+			count++;
+			offset += _flash_ring_record_size(header._len);
+		}
+	}
+
+	k_mutex_unlock(&flash_ring_lock);
+	return count > 0 || r == 0 ? (int)count : r;
+}
+
+int MPAI_Flash_Ring_Stats(mpai_flash_ring_stats_t* stats)
+{
+	memset(stats, 0, sizeof(mpai_flash_ring_stats_t));
+
+	k_mutex_lock(&flash_ring_lock, K_FOREVER);
+	int r = _flash_ring_check_mounted();
+	if (r == 0)
+	{
+		stats->_sectors = CONFIG_MPAI_FLASH_RING_SECTORS;
+		for (size_t sector = 0; sector < CONFIG_MPAI_FLASH_RING_SECTORS; sector++)
+		{
+			if (flash_ring_sectors[sector]._sequence != FLASH_RING_SEQUENCE_NONE)
+			{
+				stats->_used_sectors++;
+			}
+			stats->_pending += flash_ring_sectors[sector]._pending;
+		}
+		stats->_appended = flash_ring_appended;
+		stats->_forwarded = flash_ring_forwarded;
+		stats->_dropped = flash_ring_dropped;
+	}
+	k_mutex_unlock(&flash_ring_lock);
+	return r;
+}
+
+/************* PRIVATE **************/
+int _flash_ring_check_mounted()
+{
+	return flash_ring_mounted ? 0 : MPAI_Flash_Ring_Mount();
+}
+
+off_t _flash_ring_sector_offset(size_t sector)
+{
+	return FLASH_RING_REGION_OFFSET + sector * FLASH_SECTOR_SIZE;
+}
+
+uint16_t _flash_ring_record_size(size_t len)
+{
+	return ROUND_UP(sizeof(mpai_flash_ring_record_header_t) + len, MPAI_FLASH_RING_ALIGN);
+}
+
+void _flash_ring_scan(size_t sector)
+{
+	off_t sector_offset = _flash_ring_sector_offset(sector);
+	mpai_flash_ring_record_header_t header;
+	size_t offset = sizeof(mpai_flash_ring_sector_header_t);
+	bool closed = false;
+
+	while (offset + sizeof(header) <= FLASH_SECTOR_SIZE)
+	{
+		if (read_flash_region(flash_ring_flash_dev, sector_offset + offset, sizeof(header), &header) != 0)
+		{
+			closed = true;
+			break;
+		}
+		// free space
+		if (header._len == MPAI_FLASH_RING_FREE)
+		{
+			break;
+		}
+
+		uint16_t size = _flash_ring_record_size(header._len);
+		uint32_t crc = crc32_ieee((const uint8_t*)&header._len, sizeof(header._len));
+		if (header._len == 0 || header._len > MPAI_FLASH_RING_RECORD_MAX_LEN || offset + size > FLASH_SECTOR_SIZE ||
+			_flash_ring_crc_flash(sector_offset + offset + sizeof(header), header._len, &crc) != 0 ||
+			crc != header._crc)
+		{
+			// a write was interrupted: nothing can be appended after it
+			LOG_WRN("Invalid record at %d of sector %d of the flash ring", (int)offset, (int)sector);
+			closed = true;
+			break;
+		}
+
+		if (header._state == MPAI_FLASH_RING_RECORD_PENDING)
+		{
+			flash_ring_sectors[sector]._pending++;
+		}
+		offset += size;
+	}
+
+	flash_ring_sectors[sector]._used = closed ? FLASH_SECTOR_SIZE : offset;
+}
+
+int _flash_ring_crc_flash(off_t offset, size_t len, uint32_t* crc)
+{
+	uint8_t chunk[MPAI_FLASH_RING_PAGE_SIZE / 2];
+
+	for (size_t read = 0; read < len; read += sizeof(chunk))
+	{
+		size_t chunk_len = MIN(len - read, sizeof(chunk));
+		int r = read_flash_region(flash_ring_flash_dev, offset + read, chunk_len, chunk);
+		if (r != 0)
+		{
+			return r;
+		}
+		*crc = crc32_ieee_update(*crc, chunk, chunk_len);
+	}
+	return 0;
+}
+
+int _flash_ring_advance()
+{
+	mpai_flash_ring_sector_header_t header;
+	size_t sector = flash_ring_head < 0 ? 0 : (flash_ring_head + 1) % CONFIG_MPAI_FLASH_RING_SECTORS;
+
+	if (flash_ring_head >= 0)
+	{
+		int r = _flash_ring_flush_page();
+		if (r != 0)
+		{
+			return r;
+		}
+	}
+
+	// the ring is full: the oldest records are lost
+	if (flash_ring_sectors[sector]._pending > 0)
+	{
+		LOG_WRN("Flash ring full: %u records not forwarded are dropped", flash_ring_sectors[sector]._pending);
+		flash_ring_dropped += flash_ring_sectors[sector]._pending;
+	}
+	flash_ring_sectors[sector]._sequence = FLASH_RING_SEQUENCE_NONE;
+	flash_ring_sectors[sector]._used = FLASH_SECTOR_SIZE;
+	flash_ring_sectors[sector]._pending = 0;
+
+	int r = erase_flash_region(flash_ring_flash_dev, _flash_ring_sector_offset(sector), FLASH_SECTOR_SIZE);
+	if (r != 0)
+	{
+		return r;
+	}
+
+	header._magic = MPAI_FLASH_RING_MAGIC;
+	header._sequence = flash_ring_sequence + 1;
+	header._sequence_check = ~header._sequence;
+	r = write_flash_region(flash_ring_flash_dev, _flash_ring_sector_offset(sector), sizeof(header), &header);
+	if (r != 0)
+	{
+		return r;
+	}
+
+	flash_ring_sequence = header._sequence;
+	flash_ring_sectors[sector]._sequence = header._sequence;
+	flash_ring_sectors[sector]._used = sizeof(header);
+	flash_ring_head = sector;
+	_flash_ring_set_page();
+	return 0;
+}
+
+void _flash_ring_set_page()
+{
+	uint16_t used = flash_ring_sectors[flash_ring_head]._used;
+
+	flash_ring_page_offset = ROUND_DOWN(used, MPAI_FLASH_RING_PAGE_SIZE);
+	flash_ring_page_flushed = used - flash_ring_page_offset;
+	memset(flash_ring_page, 0xFF, sizeof(flash_ring_page));
+}
+
+int _flash_ring_buffer(const void* data, size_t len)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	flash_ring_sector_t* head = &flash_ring_sectors[flash_ring_head];
+
+	while (len > 0)
+	{
+		uint16_t filled = head->_used - flash_ring_page_offset;
+		size_t chunk_len = MIN(len, MPAI_FLASH_RING_PAGE_SIZE - filled);
+		memcpy(&flash_ring_page[filled], bytes, chunk_len);
+		head->_used += chunk_len;
+		bytes += chunk_len;
+		len -= chunk_len;
+
+		// full page: written at once, the next one is filled
+		if (filled + chunk_len == MPAI_FLASH_RING_PAGE_SIZE)
+		{
+			int r = _flash_ring_flush_page();
+			if (r != 0)
+			{
+				return r;
+			}
+			flash_ring_page_offset += MPAI_FLASH_RING_PAGE_SIZE;
+			flash_ring_page_flushed = 0;
+			memset(flash_ring_page, 0xFF, sizeof(flash_ring_page));
+		}
+	}
+	return 0;
+}
+
+int _flash_ring_flush_page()
+{
+	if (flash_ring_head < 0)
+	{
+		return 0;
+	}
+
+	uint16_t filled = MIN(flash_ring_sectors[flash_ring_head]._used - flash_ring_page_offset, MPAI_FLASH_RING_PAGE_SIZE);
+	if (filled <= flash_ring_page_flushed)
+	{
+		return 0;
+	}
+
+	int r = write_flash_region(flash_ring_flash_dev, _flash_ring_sector_offset(flash_ring_head) + flash_ring_page_offset + flash_ring_page_flushed,
+							   filled - flash_ring_page_flushed, &flash_ring_page[flash_ring_page_flushed]);
+	if (r != 0)
+	{
+		return r;
+	}
+	flash_ring_page_flushed = filled;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * @file
+ * @brief Headers of a circular buffer of records in flash memory, to store data while it can't be forwarded (i.e. the network is down):
+ * records are written a page at a time from a buffer in memory, and marked when they are forwarded
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_FLASH_RING_H
+#define MPAI_FLASH_RING_H
+
+#include <core_common.h>
+#include <flash_store.h>
+#include <sys/crc.h>
+
+/* "MPRN" */
+#define MPAI_FLASH_RING_MAGIC 0x4D50524E
+/* Records start at offsets aligned to this size */
+#define MPAI_FLASH_RING_ALIGN 4
+/* Size of the writes to the flash memory (page of the NOR flash) */
+#define MPAI_FLASH_RING_PAGE_SIZE 256
+/* States of a record: the state is written again when the record is forwarded (bits are only cleared) */
+#define MPAI_FLASH_RING_RECORD_PENDING 0xFF
+#define MPAI_FLASH_RING_RECORD_FORWARDED 0x00
+#define MPAI_FLASH_RING_FREE 0xFFFF
+
+/* Header of a sector, written after erasing it: sectors are used in turn, the oldest one is erased when the ring is full */
+typedef struct _mpai_flash_ring_sector_header_t {
+	uint32_t _magic;
+	uint32_t _sequence;							// order of the sector in the ring
+	uint32_t _sequence_check;					// ~sequence: they differ if the writing of the header was interrupted
+} mpai_flash_ring_sector_header_t;
+
+/* Header of a record, followed by its data: a header not erased with a wrong CRC closes the sector (interrupted write) */
+typedef struct _mpai_flash_ring_record_header_t {
+	uint16_t _len;								// MPAI_FLASH_RING_FREE: free space of the sector
+	uint8_t _state;
+	uint8_t _reserved;
+	uint32_t _crc;								// CRC32 of length and data
+} mpai_flash_ring_record_header_t;
+
+/* Max size of the data of a record */
+#define MPAI_FLASH_RING_RECORD_MAX_LEN (FLASH_SECTOR_SIZE - sizeof(mpai_flash_ring_sector_header_t) - sizeof(mpai_flash_ring_record_header_t))
+
+typedef struct _mpai_flash_ring_stats_t {
+	size_t _sectors;
+	size_t _used_sectors;
+	uint32_t _pending;							// records not forwarded
+	uint32_t _appended;							// since the mount
+	uint32_t _forwarded;						// since the mount
+	uint32_t _dropped;							// records not forwarded, erased when the ring was full (since the mount)
+} mpai_flash_ring_stats_t;
+
+/**
+ * @brief Callback of MPAI_Flash_Ring_Forward
+ *
+ * @param data
+ * @param len
+ * @param user_data
+ * @return int 0 if the record is forwarded, negative errno to stop forwarding (the record is kept)
+ */
+typedef int (mpai_flash_ring_forward_t)(const uint8_t* data, size_t len, void* user_data);
+
+/**
+ * @brief Mount the ring, scanning its sectors to find the records not forwarded.
+ * The other functions mount it at first use
+ *
+ * @return int 0 on success, negative errno otherwise
+ */
+int MPAI_Flash_Ring_Mount();
+
+/**
+ * @brief Append a record: it's written in flash memory when its page is full, or with MPAI_Flash_Ring_Sync.
+ * If the ring is full, the records of its oldest sector are erased
+ *
+ * @param data
+ * @param len at most MPAI_FLASH_RING_RECORD_MAX_LEN bytes
+ * @return int 0 on success, negative errno otherwise
+ */
+int MPAI_Flash_Ring_Append(const void* data, size_t len);
+
+/**
+ * @brief Write the records still in memory: records not written are lost with the power
+ *
+ * @return int 0 on success, negative errno otherwise
+ */
+int MPAI_Flash_Ring_Sync();
+
+/**
+ * @brief Forward the records not forwarded yet, from the oldest one
+ *
+ * @param callback called with the ring locked, for each record
+ * @param user_data
+ * @param max max number of records forwarded
+ * @return int number of records forwarded, negative errno if none was forwarded because of an error
+ */
+int MPAI_Flash_Ring_Forward(mpai_flash_ring_forward_t* callback, void* user_data, size_t max);
+
+/**
+ * @brief Get the usage of the ring
+ *
+ * @param stats
+ * @return int 0 on success, negative errno otherwise
+ */
+int MPAI_Flash_Ring_Stats(mpai_flash_ring_stats_t* stats);
+
+#endif
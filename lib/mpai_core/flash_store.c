@@ -10,10 +10,81 @@
  */
 
 #include "flash_store.h"
+#ifdef FLASH_MEMORY_MAPPED
+#include <stm32l4xx_hal.h>
+#endif
 
 LOG_MODULE_REGISTER(MPAI_FLASH_STORE, LOG_LEVEL_INF);
 
+#ifdef FLASH_MEMORY_MAPPED
+/* Fast read (1-1-1, 8 dummy cycles), supported by every JEDEC NOR flash */
+#define FLASH_MEMORY_MAPPED_READ_INSTRUCTION 0x0B
+#define FLASH_MEMORY_MAPPED_DUMMY_CYCLES 8
+
+/* The QUADSPI is shared with the driver: it's switched to memory-mapped mode by the first mapping,
+ * and back to indirect mode by the first write or erase after the last unmapping */
+static bool flash_store_memory_mapped = false;
+static size_t flash_store_mappings = 0;
+K_MUTEX_DEFINE(flash_store_lock);
+K_CONDVAR_DEFINE(flash_store_unmapped);
+#endif
+
 /************* PRIVATE *************/
+#ifdef FLASH_MEMORY_MAPPED
+/* HAL handle of the QUADSPI initialized by the Zephyr driver (first field of the data of flash_stm32_qspi):
+ * the memory-mapped mode goes through the same handle, so the HAL state seen by the driver stays consistent */
+static QSPI_HandleTypeDef* _flash_store_qspi(const struct device* flash_dev)
+{
+	return (QSPI_HandleTypeDef*)flash_dev->data;
+}
+
+/* switch the QUADSPI to memory-mapped mode, with the lock taken */
+static int _flash_store_enter_memory_mapped(const struct device* flash_dev)
+{
+	QSPI_CommandTypeDef command = {
+		.Instruction = FLASH_MEMORY_MAPPED_READ_INSTRUCTION,
+		.InstructionMode = QSPI_INSTRUCTION_1_LINE,
+		.AddressSize = QSPI_ADDRESS_24_BITS,
+		.AddressMode = QSPI_ADDRESS_1_LINE,
+		.AlternateByteMode = QSPI_ALTERNATE_BYTES_NONE,
+		.DataMode = QSPI_DATA_1_LINE,
+		.DummyCycles = FLASH_MEMORY_MAPPED_DUMMY_CYCLES,
+		.DdrMode = QSPI_DDR_MODE_DISABLE,
+		.DdrHoldHalfCycle = QSPI_DDR_HHC_ANALOG_DELAY,
+		.SIOOMode = QSPI_SIOO_INST_EVERY_CMD
+	};
+	QSPI_MemoryMappedTypeDef memory_mapped = {
+		.TimeOutActivation = QSPI_TIMEOUT_COUNTER_DISABLE,
+		.TimeOutPeriod = 0
+	};
+
+	if (flash_store_memory_mapped) {
+		return 0;
+	}
+	if (HAL_QSPI_MemoryMapped(_flash_store_qspi(flash_dev), &command, &memory_mapped) != HAL_OK) {
+		LOG_ERR("Flash memory-mapped mode failed! %d\n", (int)HAL_QSPI_GetError(_flash_store_qspi(flash_dev)));
+		// the HAL leaves the handle ready for the driver, unless the QUADSPI is stuck
+		return -EIO;
+	}
+	flash_store_memory_mapped = true;
+	return 0;
+}
+
+/* wait for the regions mapped, then switch the QUADSPI back to indirect mode for the driver, with the lock taken */
+static void _flash_store_leave_memory_mapped(const struct device* flash_dev)
+{
+	while (flash_store_mappings > 0) {
+		k_condvar_wait(&flash_store_unmapped, &flash_store_lock, K_FOREVER);
+	}
+	if (flash_store_memory_mapped) {
+		// the abort clears the memory-mapped mode and sets the handle ready for the driver
+		if (HAL_QSPI_Abort(_flash_store_qspi(flash_dev)) != HAL_OK) {
+			LOG_ERR("Flash memory-mapped mode not aborted! %d\n", (int)HAL_QSPI_GetError(_flash_store_qspi(flash_dev)));
+		}
+		flash_store_memory_mapped = false;
+	}
+}
+#endif
 
 /************* PUBLIC **************/
 
@@ -35,20 +106,48 @@ struct device* init_flash()
 
 int erase_flash(const struct device* flash_dev)
 {
-	int rc = flash_erase(flash_dev, FLASH_TEST_REGION_OFFSET,
-			 FLASH_SECTOR_SIZE);
+	return erase_flash_region(flash_dev, FLASH_TEST_REGION_OFFSET, FLASH_SECTOR_SIZE);
+}
+
+int write_flash(const struct device* flash_dev, size_t len, void* data)
+{
+	return write_flash_region(flash_dev, FLASH_TEST_REGION_OFFSET, len, data);
+}
+
+int read_flash(const struct device* flash_dev, size_t len, void* buf)
+{
+	return read_flash_region(flash_dev, FLASH_TEST_REGION_OFFSET, len, buf);
+}
+
+int erase_flash_region(const struct device* flash_dev, off_t offset, size_t size)
+{
+#ifdef FLASH_MEMORY_MAPPED
+	k_mutex_lock(&flash_store_lock, K_FOREVER);
+	_flash_store_leave_memory_mapped(flash_dev);
+#endif
+	int rc = flash_erase(flash_dev, offset, size);
+#ifdef FLASH_MEMORY_MAPPED
+	k_mutex_unlock(&flash_store_lock);
+#endif
 	if (rc != 0) {
 		LOG_ERR("Flash erase failed! %d\n", rc);
 	} else {
-		LOG_INF("Flash erase succeeded!\n");
+		LOG_DBG("Flash erase succeeded!\n");
 	}
 	return rc;
 }
 
-int write_flash(const struct device* flash_dev, size_t len, void* data)
+int write_flash_region(const struct device* flash_dev, off_t offset, size_t len, const void* data)
 {
-	LOG_INF("Attempting to write %zu bytes\n", len);
-	int rc = flash_write(flash_dev, FLASH_TEST_REGION_OFFSET, data, len);
+	LOG_DBG("Attempting to write %zu bytes\n", len);
+#ifdef FLASH_MEMORY_MAPPED
+	k_mutex_lock(&flash_store_lock, K_FOREVER);
+	_flash_store_leave_memory_mapped(flash_dev);
+#endif
+	int rc = flash_write(flash_dev, offset, data, len);
+#ifdef FLASH_MEMORY_MAPPED
+	k_mutex_unlock(&flash_store_lock);
+#endif
 	if (rc != 0) {
 		LOG_ERR("Flash write failed! %d\n", rc);
 		return rc;
@@ -56,13 +155,72 @@ int write_flash(const struct device* flash_dev, size_t len, void* data)
 	return rc;
 }
 
-int read_flash(const struct device* flash_dev, size_t len, void* buf)
+int read_flash_region(const struct device* flash_dev, off_t offset, size_t len, void* buf)
 {
 	memset(buf, 0, len);
-	int rc = flash_read(flash_dev, FLASH_TEST_REGION_OFFSET, buf, len);
+#ifdef FLASH_MEMORY_MAPPED
+	// while it's mapped, the flash memory is read by the CPU
+	k_mutex_lock(&flash_store_lock, K_FOREVER);
+	if (flash_store_memory_mapped && offset + len <= FLASH_MEMORY_MAPPED_SIZE) {
+		memcpy(buf, (const void*)(FLASH_MEMORY_MAPPED_BASE + offset), len);
+		k_mutex_unlock(&flash_store_lock);
+		return 0;
+	}
+	_flash_store_leave_memory_mapped(flash_dev);
+#endif
+	int rc = flash_read(flash_dev, offset, buf, len);
+#ifdef FLASH_MEMORY_MAPPED
+	k_mutex_unlock(&flash_store_lock);
+#endif
 	if (rc != 0) {
 		LOG_ERR("Flash read failed! %d\n", rc);
 		return rc;
 	}
 	return rc;
+}
+
+const uint8_t* map_flash_region(const struct device* flash_dev, off_t offset, size_t len)
+{
+#ifdef FLASH_MEMORY_MAPPED
+	if (offset < 0 || offset + len > FLASH_MEMORY_MAPPED_SIZE) {
+		LOG_ERR("Flash region %ld not mapped: out of the flash memory\n", (long)offset);
+		return NULL;
+	}
+	k_mutex_lock(&flash_store_lock, K_FOREVER);
+	int rc = _flash_store_enter_memory_mapped(flash_dev);
+	if (rc == 0) {
+		flash_store_mappings++;
+	}
+	k_mutex_unlock(&flash_store_lock);
+	return rc == 0 ? (const uint8_t*)(FLASH_MEMORY_MAPPED_BASE + offset) : NULL;
+#else
+	// copied in memory, as the flash memory is not mapped
+	uint8_t* data = (uint8_t*)k_malloc(len > 0 ? len : 1);
+	if (data == NULL) {
+		LOG_ERR("Not enough memory to copy %zu bytes of flash\n", len);
+		return NULL;
+	}
+	if (read_flash_region(flash_dev, offset, len, data) != 0) {
+		k_free(data);
+		return NULL;
+	}
+	return data;
+#endif
+}
+
+void unmap_flash_region(const struct device* flash_dev, const uint8_t* data)
+{
+	if (data == NULL) {
+		return;
+	}
+#ifdef FLASH_MEMORY_MAPPED
+	// the memory-mapped mode is kept for the next mappings and reads, until a write or an erase
+	k_mutex_lock(&flash_store_lock, K_FOREVER);
+	if (flash_store_mappings > 0 && --flash_store_mappings == 0) {
+		k_condvar_broadcast(&flash_store_unmapped);
+	}
+	k_mutex_unlock(&flash_store_lock);
+#else
+	k_free((void*)data);
+#endif
 }
\ No newline at end of file
@@ -34,6 +34,14 @@
 #error Unsupported flash driver
 #endif
 
+/* The QUADSPI of STM32 can map the flash memory in the address space: regions are read in place, without copying them */
+#if defined(CONFIG_MPAI_FLASH_MEMORY_MAPPED) && DT_NODE_HAS_STATUS(DT_INST(0, st_stm32_qspi_nor), okay)
+#define FLASH_MEMORY_MAPPED
+#define FLASH_MEMORY_MAPPED_BASE 0x90000000
+/* size of the flash memory, in bits in the devicetree */
+#define FLASH_MEMORY_MAPPED_SIZE (DT_PROP(DT_INST(0, st_stm32_qspi_nor), size) / 8)
+#endif
+
 #if defined(CONFIG_BOARD_ADAFRUIT_FEATHER_STM32F405)
 #define FLASH_TEST_REGION_OFFSET 0xf000
 #elif defined(CONFIG_BOARD_ARTY_A7_ARM_DESIGNSTART_M1) || \
@@ -46,6 +54,38 @@
 #endif
 #define FLASH_SECTOR_SIZE        4096
 
+/* Region reserved to the boot image of the AIF, just below the test region */
+#define FLASH_BOOT_IMAGE_REGION_SIZE   FLASH_SECTOR_SIZE
+#define FLASH_BOOT_IMAGE_REGION_OFFSET (FLASH_TEST_REGION_OFFSET - FLASH_BOOT_IMAGE_REGION_SIZE)
+
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+/* Region reserved to the cache of MPAI Config Store, just below the boot image */
+#define FLASH_CONFIG_CACHE_REGION_SIZE   (CONFIG_MPAI_CONFIG_CACHE_SLOTS * CONFIG_MPAI_CONFIG_CACHE_SLOT_SIZE)
+#define FLASH_CONFIG_CACHE_REGION_OFFSET (FLASH_BOOT_IMAGE_REGION_OFFSET - FLASH_CONFIG_CACHE_REGION_SIZE)
+#endif
+
+#ifdef CONFIG_MPAI_KV_STORE
+/* Region reserved to the key/record store, just below the cache of MPAI Config Store (or the boot image) */
+#define FLASH_KV_STORE_REGION_SIZE   (CONFIG_MPAI_KV_STORE_SECTORS * FLASH_SECTOR_SIZE)
+#ifdef CONFIG_MPAI_CONFIG_CACHE
+#define FLASH_KV_STORE_REGION_OFFSET (FLASH_CONFIG_CACHE_REGION_OFFSET - FLASH_KV_STORE_REGION_SIZE)
+#else
+#define FLASH_KV_STORE_REGION_OFFSET (FLASH_BOOT_IMAGE_REGION_OFFSET - FLASH_KV_STORE_REGION_SIZE)
+#endif
+#endif
+
+#ifdef CONFIG_MPAI_FLASH_RING
+/* Region reserved to the flash ring, just below the key/record store (or the cache of MPAI Config Store, or the boot image) */
+#define FLASH_RING_REGION_SIZE   (CONFIG_MPAI_FLASH_RING_SECTORS * FLASH_SECTOR_SIZE)
+#if defined(CONFIG_MPAI_KV_STORE)
+#define FLASH_RING_REGION_OFFSET (FLASH_KV_STORE_REGION_OFFSET - FLASH_RING_REGION_SIZE)
+#elif defined(CONFIG_MPAI_CONFIG_CACHE)
+#define FLASH_RING_REGION_OFFSET (FLASH_CONFIG_CACHE_REGION_OFFSET - FLASH_RING_REGION_SIZE)
+#else
+#define FLASH_RING_REGION_OFFSET (FLASH_BOOT_IMAGE_REGION_OFFSET - FLASH_RING_REGION_SIZE)
+#endif
+#endif
+
 struct device* init_flash();
 
 int erase_flash(const struct device* dev);
@@ -54,4 +94,56 @@ int write_flash(const struct device* dev, size_t len, void* data);
 
 int read_flash(const struct device* dev, size_t len, void* buf);
 
+/**
+ * @brief Erase a region of the flash memory
+ * 
+ * @param dev flash device
+ * @param offset offset of the region (aligned to FLASH_SECTOR_SIZE)
+ * @param size size of the region (multiple of FLASH_SECTOR_SIZE)
+ * @return int 0 on success
+ */
+int erase_flash_region(const struct device* dev, off_t offset, size_t size);
+
+/**
+ * @brief Write data in the flash memory, starting from an offset (the region has to be erased before)
+ * 
+ * @param dev flash device
+ * @param offset 
+ * @param len 
+ * @param data 
+ * @return int 0 on success
+ */
+int write_flash_region(const struct device* dev, off_t offset, size_t len, const void* data);
+
+/**
+ * @brief Read data from the flash memory, starting from an offset
+ * 
+ * @param dev flash device
+ * @param offset 
+ * @param len 
+ * @param buf 
+ * @return int 0 on success
+ */
+int read_flash_region(const struct device* dev, off_t offset, size_t len, void* buf);
+
+/**
+ * @brief Map a region of the flash memory, to read it without copying it in memory (FLASH_MEMORY_MAPPED).
+ * Otherwise (other drivers, emulated flash) the region is copied in a buffer allocated.
+ * The flash memory is not written nor erased while a region is mapped: unmap it as soon as possible
+ * 
+ * @param dev flash device
+ * @param offset 
+ * @param len 
+ * @return const uint8_t* read-only data of the region, NULL on error
+ */
+const uint8_t* map_flash_region(const struct device* dev, off_t offset, size_t len);
+
+/**
+ * @brief Unmap a region mapped by map_flash_region
+ * 
+ * @param dev flash device
+ * @param data pointer returned by map_flash_region
+ */
+void unmap_flash_region(const struct device* dev, const uint8_t* data);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,188 @@
+/*
+ * @file
+ * @brief Implementation of an asynchronous writer of the flash ring
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "flash_writer.h"
+
+LOG_MODULE_REGISTER(MPAI_FLASH_WRITER, LOG_LEVEL_INF);
+
+#ifdef CONFIG_MPAI_FLASH_WRITER
+
+/* size of stack area used by the thread */
+#define FLASH_WRITER_STACKSIZE 1536
+
+/* records in the buffers are aligned to pointers, for their header */
+#define FLASH_WRITER_ALIGN sizeof(void*)
+
+/* Double buffer: the callers fill the active one, the thread writes the other one */
+static uint8_t flash_writer_buffers[2][CONFIG_MPAI_FLASH_WRITER_BUFFER_SIZE] __aligned(FLASH_WRITER_ALIGN);
+static size_t flash_writer_buffered[2] = { 0, 0 };
+static size_t flash_writer_active = 0;
+static mpai_flash_writer_stats_t flash_writer_stats;
+K_MUTEX_DEFINE(flash_writer_lock);
+
+/* The thread is woken by each record submitted: while it's busy, records are gathered in the active buffer */
+K_SEM_DEFINE(flash_writer_wakeup, 0, 1);
+/* A flush is served after the active buffer is written */
+K_MUTEX_DEFINE(flash_writer_flush_lock);
+K_SEM_DEFINE(flash_writer_flushed, 0, 1);
+static atomic_t flash_writer_flush_requested = ATOMIC_INIT(0);
+static int flash_writer_flush_result = 0;
+
+K_THREAD_STACK_DEFINE(flash_writer_stack_area, FLASH_WRITER_STACKSIZE);
+static struct k_thread flash_writer_thread;
+static atomic_t flash_writer_started = ATOMIC_INIT(0);
+
+/************* PRIVATE HEADER *************/
+/* start the thread, if it's not started */
+void _flash_writer_check_started();
+/* size of a record in the buffers, aligned */
+size_t _flash_writer_record_size(size_t len);
+/* append the records of a buffer to the flash ring, then empty it */
+void _flash_writer_write(size_t buffer);
+
+/**************** THREADS **********************/
+void th_flash_writer(void *dummy1, void *dummy2, void *dummy3)
+{
+	ARG_UNUSED(dummy1);
+	ARG_UNUSED(dummy2);
+	ARG_UNUSED(dummy3);
+
+	while (1)
+	{
+		k_sem_take(&flash_writer_wakeup, K_FOREVER);
+		// read before swapping: the records submitted before the flush are in the buffer swapped
+		bool flush = atomic_cas(&flash_writer_flush_requested, 1, 0);
+
+		// the callers fill the other buffer (already written) while this one is written
+		k_mutex_lock(&flash_writer_lock, K_FOREVER);
+		size_t filled = flash_writer_active;
+		flash_writer_active = 1 - filled;
+		k_mutex_unlock(&flash_writer_lock);
+
+		_flash_writer_write(filled);
+
+		if (flush)
+		{
+			flash_writer_flush_result = MPAI_Flash_Ring_Sync();
+			k_sem_give(&flash_writer_flushed);
+		}
+	}
+}
+
+/************* PUBLIC **************/
+int MPAI_Flash_Writer_Submit(const void* data, size_t len, mpai_flash_writer_callback_t* callback, void* user_data)
+{
+	size_t size = _flash_writer_record_size(len);
+
+	if (len == 0 || len > MPAI_FLASH_RING_RECORD_MAX_LEN || size > CONFIG_MPAI_FLASH_WRITER_BUFFER_SIZE)
+	{
+		return -EINVAL;
+	}
+	_flash_writer_check_started();
+
+	k_mutex_lock(&flash_writer_lock, K_FOREVER);
+	size_t active = flash_writer_active;
+	if (flash_writer_buffered[active] + size > CONFIG_MPAI_FLASH_WRITER_BUFFER_SIZE)
+	{
+		flash_writer_stats._rejected++;
+		k_mutex_unlock(&flash_writer_lock);
+		return -ENOBUFS;
+	}
+
+	mpai_flash_writer_record_t* record = (mpai_flash_writer_record_t*)&flash_writer_buffers[active][flash_writer_buffered[active]];
+	record->_callback = callback;
+	record->_user_data = user_data;
+	record->_len = len;
+	memcpy(record + 1, data, len);
+	flash_writer_buffered[active] += size;
+	flash_writer_stats._submitted++;
+	flash_writer_stats._max_buffered = MAX(flash_writer_stats._max_buffered, flash_writer_buffered[active]);
+	k_mutex_unlock(&flash_writer_lock);
+
+	k_sem_give(&flash_writer_wakeup);
+	return 0;
+}
+
+int MPAI_Flash_Writer_Flush(k_timeout_t timeout)
+{
+	_flash_writer_check_started();
+
+	// a flush at a time: a flush expired is not confused with the next one
+	k_mutex_lock(&flash_writer_flush_lock, K_FOREVER);
+	k_sem_reset(&flash_writer_flushed);
+	atomic_set(&flash_writer_flush_requested, 1);
+	k_sem_give(&flash_writer_wakeup);
+	int r = k_sem_take(&flash_writer_flushed, timeout);
+	if (r == 0)
+	{
+		r = flash_writer_flush_result;
+	}
+	k_mutex_unlock(&flash_writer_flush_lock);
+	return r;
+}
+
+void MPAI_Flash_Writer_Stats(mpai_flash_writer_stats_t* stats)
+{
+	k_mutex_lock(&flash_writer_lock, K_FOREVER);
+	*stats = flash_writer_stats;
+	k_mutex_unlock(&flash_writer_lock);
+}
+
+/************* PRIVATE **************/
+void _flash_writer_check_started()
+{
+	if (atomic_cas(&flash_writer_started, 0, 1))
+	{
+		k_thread_create(&flash_writer_thread, flash_writer_stack_area,
+						K_THREAD_STACK_SIZEOF(flash_writer_stack_area),
+						th_flash_writer, NULL, NULL, NULL,
+						CONFIG_MPAI_FLASH_WRITER_PRIORITY, 0, K_NO_WAIT);
+		k_thread_name_set(&flash_writer_thread, "thread_flash_writer");
+	}
+}
+
+size_t _flash_writer_record_size(size_t len)
+{
+	return ROUND_UP(sizeof(mpai_flash_writer_record_t) + len, FLASH_WRITER_ALIGN);
+}
+
+void _flash_writer_write(size_t buffer)
+{
+	uint32_t written = 0;
+	uint32_t failed = 0;
+
+	// only this thread accesses the buffer not active
+	for (size_t offset = 0; offset < flash_writer_buffered[buffer]; )
+	{
+		mpai_flash_writer_record_t* record = (mpai_flash_writer_record_t*)&flash_writer_buffers[buffer][offset];
+		int r = MPAI_Flash_Ring_Append(record + 1, record->_len);
+		if (r == 0)
+		{
+			written++;
+		}
+		else
+		{
+			failed++;
+			LOG_WRN("Record of %u bytes not written: %d", record->_len, r);
+		}
+		if (record->_callback != NULL)
+		{
+			record->_callback(r, record->_user_data);
+		}
+		offset += _flash_writer_record_size(record->_len);
+	}
+
+	k_mutex_lock(&flash_writer_lock, K_FOREVER);
+	flash_writer_buffered[buffer] = 0;
+	flash_writer_stats._written += written;
+	flash_writer_stats._failed += failed;
+	k_mutex_unlock(&flash_writer_lock);
+}
+
+#endif
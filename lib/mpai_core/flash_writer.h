@@ -0,0 +1,66 @@
+/*
+ * @file
+ * @brief Headers of an asynchronous writer of the flash ring: records are copied in a double buffer in memory,
+ * a thread with low priority appends them to the flash ring (erasing and programming its pages) while the other buffer is filled
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_FLASH_WRITER_H
+#define MPAI_FLASH_WRITER_H
+
+#include <core_common.h>
+#include <flash_ring.h>
+
+/**
+ * @brief Completion of a record submitted, called by the thread of the writer
+ *
+ * @param result 0 if the record is appended to the flash ring, negative errno otherwise
+ * @param user_data
+ */
+typedef void (mpai_flash_writer_callback_t)(int result, void* user_data);
+
+/* Header of a record in the buffers, followed by its data */
+typedef struct _mpai_flash_writer_record_t {
+	mpai_flash_writer_callback_t* _callback;
+	void* _user_data;
+	uint16_t _len;
+} mpai_flash_writer_record_t;
+
+typedef struct _mpai_flash_writer_stats_t {
+	uint32_t _submitted;
+	uint32_t _written;
+	uint32_t _failed;							// not appended to the flash ring
+	uint32_t _rejected;							// buffers full
+	size_t _max_buffered;						// max bytes in a buffer
+} mpai_flash_writer_stats_t;
+
+/**
+ * @brief Submit a record to append to the flash ring, without waiting: the data is copied (the writer thread is started at first use)
+ *
+ * @param data
+ * @param len at most MPAI_FLASH_RING_RECORD_MAX_LEN bytes
+ * @param callback called when the record is written (or not), NULL if not needed
+ * @param user_data
+ * @return int 0 on success, -ENOBUFS if the buffer is full (the other one is still being written), -EINVAL if the record is too large
+ */
+int MPAI_Flash_Writer_Submit(const void* data, size_t len, mpai_flash_writer_callback_t* callback, void* user_data);
+
+/**
+ * @brief Wait for the records submitted to be written, including the last page of the flash ring
+ *
+ * @param timeout
+ * @return int 0 on success, -EAGAIN if the timeout expired, negative errno of the flash ring otherwise
+ */
+int MPAI_Flash_Writer_Flush(k_timeout_t timeout);
+
+/**
+ * @brief Get the counters of the writer
+ *
+ * @param stats
+ */
+void MPAI_Flash_Writer_Stats(mpai_flash_writer_stats_t* stats);
+
+#endif
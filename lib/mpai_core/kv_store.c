@@ -0,0 +1,780 @@
+/*
+ * @file
+ * @brief Implementation of a log-structured key/record store in flash memory
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "kv_store.h"
+
+LOG_MODULE_REGISTER(MPAI_KV_STORE, LOG_LEVEL_INF);
+
+#ifdef CONFIG_MPAI_KV_STORE
+
+BUILD_ASSERT(CONFIG_MPAI_KV_STORE_SECTORS >= 3, "The key/record store needs at least 3 sectors");
+
+/* Size of the chunks read to check CRCs and to copy records */
+#define KV_STORE_CHUNK_SIZE 128
+/* Max bytes of live records: a sector is kept free for the compactions and one is lost to the records not fitting the end of the sectors */
+#define KV_STORE_CAPACITY ((CONFIG_MPAI_KV_STORE_SECTORS - 2) * (FLASH_SECTOR_SIZE - sizeof(mpai_kv_store_sector_header_t)))
+
+/* Sector in memory */
+typedef struct _kv_store_sector_t {
+	uint32_t _erase_count;
+	uint32_t _sequence;							// MPAI_KV_STORE_SEQUENCE_FREE if free
+	uint16_t _used;								// offset of the free space
+	uint16_t _live;								// bytes of the records in the index
+} kv_store_sector_t;
+
+/* Last record of a key */
+typedef struct _kv_store_entry_t {
+	uint32_t _hash;								// CRC32 of the key: the key in flash is compared only if it matches
+	uint16_t _sector;
+	uint16_t _offset;
+	uint16_t _len;
+	uint8_t _key_len;
+	uint8_t _flags;
+} kv_store_entry_t;
+
+static const struct device* kv_store_flash_dev = NULL;
+static bool kv_store_mounted = false;
+static kv_store_sector_t kv_store_sectors[CONFIG_MPAI_KV_STORE_SECTORS];
+static kv_store_entry_t kv_store_index[CONFIG_MPAI_KV_STORE_MAX_KEYS];
+static size_t kv_store_index_count = 0;
+/* sector where records are appended, -1 if none is opened */
+static int kv_store_head = -1;
+static uint32_t kv_store_sequence = 0;
+static uint32_t kv_store_erases = 0;
+static uint32_t kv_store_compactions = 0;
+K_MUTEX_DEFINE(kv_store_lock);
+
+/************* PRIVATE HEADER *************/
+/* mount the store, if it's not mounted */
+int _kv_store_check_mounted();
+/* offset of a sector in flash */
+off_t _kv_store_sector_offset(size_t sector);
+/* size of a record in flash, aligned */
+uint16_t _kv_store_record_size(size_t key_len, size_t len);
+/* erase a sector and write its header */
+int _kv_store_format(size_t sector, uint32_t erase_count);
+/* write the sequence of a free sector, to append records to it */
+int _kv_store_open(size_t sector);
+/* scan the records of a sector, adding them to the index */
+void _kv_store_scan(size_t sector);
+/* CRC32 of the key and data of a record in flash, continuing the CRC of its header */
+int _kv_store_crc_flash(off_t offset, size_t len, uint32_t* crc);
+/* find the index entry of a key, -1 if not found */
+int _kv_store_find(const char* key, size_t key_len, uint32_t hash);
+/* set the last record of a key, updating the live bytes of the sectors */
+int _kv_store_index_record(const char* key, size_t key_len, uint32_t hash, size_t sector, uint16_t offset, uint16_t len, uint8_t flags);
+/* remove an entry from the index */
+void _kv_store_index_remove(size_t idx);
+/* append a record to the head sector */
+int _kv_store_append(const char* key, uint8_t flags, const void* data, size_t len);
+/* make room in the head sector for a record: compactions can use the last free sector, writes can't */
+int _kv_store_reserve(uint16_t size, bool compacting);
+/* free sector with the lowest erase count, -1 if there are no free sectors */
+int _kv_store_free_sector(size_t* free_count);
+/* compact a sector: its live records are copied to the head sector, then it's erased */
+int _kv_store_compact(bool wear_leveling);
+/* choose the sector to compact, among the ones whose live records fit the room */
+int _kv_store_choose_victim(size_t room, bool wear_leveling, bool* oldest);
+/* copy a record to the head sector */
+int _kv_store_copy(size_t idx);
+
+/************* PUBLIC **************/
+int MPAI_KV_Store_Mount()
+{
+	mpai_kv_store_sector_header_t header;
+	int r = 0;
+
+	k_mutex_lock(&kv_store_lock, K_FOREVER);
+
+	if (kv_store_flash_dev == NULL)
+	{
+		kv_store_flash_dev = init_flash();
+	}
+	if (kv_store_flash_dev == NULL)
+	{
+		k_mutex_unlock(&kv_store_lock);
+		return -ENODEV;
+	}
+
+	kv_store_mounted = false;
+	kv_store_index_count = 0;
+	kv_store_head = -1;
+	kv_store_sequence = 0;
+
+	for (size_t sector = 0; sector < CONFIG_MPAI_KV_STORE_SECTORS; sector++)
+	{
+		r = read_flash_region(kv_store_flash_dev, _kv_store_sector_offset(sector), sizeof(header), &header);
+		if (r != 0)
+		{
+			k_mutex_unlock(&kv_store_lock);
+			return r;
+		}
+
+		if (header._magic != MPAI_KV_STORE_MAGIC || crc32_ieee((const uint8_t*)&header, offsetof(mpai_kv_store_sector_header_t, _crc)) != header._crc)
+		{
+			// never formatted, or its erase was interrupted: the erase count is lost
+			LOG_INF("Formatting sector %d of the key/record store", (int)sector);
+			r = _kv_store_format(sector, 0);
+			if (r != 0)
+			{
+				k_mutex_unlock(&kv_store_lock);
+				return r;
+			}
+			continue;
+		}
+
+		bool free = header._sequence == MPAI_KV_STORE_SEQUENCE_FREE && header._sequence_check == MPAI_KV_STORE_SEQUENCE_FREE;
+		if (!free && header._sequence_check != ~header._sequence)
+		{
+			// opened when the power was lost: no records were appended
+			LOG_WRN("Sector %d of the key/record store was not opened", (int)sector);
+			r = _kv_store_format(sector, header._erase_count + 1);
+			if (r != 0)
+			{
+				k_mutex_unlock(&kv_store_lock);
+				return r;
+			}
+			continue;
+		}
+
+		kv_store_sectors[sector]._erase_count = header._erase_count;
+		kv_store_sectors[sector]._sequence = header._sequence;
+		kv_store_sectors[sector]._used = sizeof(mpai_kv_store_sector_header_t);
+		kv_store_sectors[sector]._live = 0;
+	}
+
+	// records are scanned from the oldest sector, so the newest record of a key wins
+	uint32_t last_sequence = 0;
+	bool first = true;
+	while (true)
+	{
+		int next = -1;
+		for (size_t sector = 0; sector < CONFIG_MPAI_KV_STORE_SECTORS; sector++)
+		{
+			uint32_t sequence = kv_store_sectors[sector]._sequence;
+			if (sequence != MPAI_KV_STORE_SEQUENCE_FREE && (first || sequence > last_sequence) &&
+				(next < 0 || sequence < kv_store_sectors[next]._sequence))
+			{
+				next = sector;
+			}
+		}
+		if (next < 0)
+		{
+			break;
+		}
+
+		_kv_store_scan(next);
+		last_sequence = kv_store_sectors[next]._sequence;
+		first = false;
+		kv_store_head = next;
+		kv_store_sequence = last_sequence;
+	}
+
+	// writes never open the last free sector: without free sectors, a compaction was interrupted after opening it,
+	// so the head sector has only copies of the records still in the sector being compacted
+	size_t free_count;
+	if (kv_store_head >= 0 && _kv_store_free_sector(&free_count) < 0)
+	{
+		LOG_WRN("Compaction of the key/record store interrupted: sector %d is erased", kv_store_head);
+		r = _kv_store_format(kv_store_head, kv_store_sectors[kv_store_head]._erase_count + 1);
+		if (r == 0)
+		{
+			r = MPAI_KV_Store_Mount();
+		}
+		k_mutex_unlock(&kv_store_lock);
+		return r;
+	}
+
+	kv_store_mounted = true;
+	LOG_INF("Key/record store mounted: %d keys", (int)kv_store_index_count);
+
+	k_mutex_unlock(&kv_store_lock);
+	return 0;
+}
+
+int MPAI_KV_Store_Write(const char* key, const void* data, size_t len)
+{
+	size_t key_len = strlen(key);
+	if (key_len == 0 || key_len > MPAI_KV_STORE_KEY_MAX_LEN || len > MPAI_KV_STORE_DATA_MAX_LEN)
+	{
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&kv_store_lock, K_FOREVER);
+	int r = _kv_store_check_mounted();
+	if (r == 0)
+	{
+		r = _kv_store_append(key, 0, data, len);
+	}
+	k_mutex_unlock(&kv_store_lock);
+	return r;
+}
+
+int MPAI_KV_Store_Read(const char* key, void* buf, size_t size)
+{
+	size_t key_len = strlen(key);
+
+	k_mutex_lock(&kv_store_lock, K_FOREVER);
+	int r = _kv_store_check_mounted();
+	if (r == 0)
+	{
+		int idx = _kv_store_find(key, key_len, crc32_ieee((const uint8_t*)key, key_len));
+		if (idx < 0 || (kv_store_index[idx]._flags & MPAI_KV_STORE_RECORD_DELETED))
+		{
+			r = -ENOENT;
+		}
+		else if (kv_store_index[idx]._len > size)
+		{
+			r = -ENOBUFS;
+		}
+		else
+		{
+			kv_store_entry_t* entry = &kv_store_index[idx];
+			off_t offset = _kv_store_sector_offset(entry->_sector) + entry->_offset + sizeof(mpai_kv_store_record_header_t) + entry->_key_len;
+			r = entry->_len > 0 ? read_flash_region(kv_store_flash_dev, offset, entry->_len, buf) : 0;
+			if (r == 0)
+			{
+				r = entry->_len;
+			}
+		}
+	}
+	k_mutex_unlock(&kv_store_lock);
+	return r;
+}
+
+int MPAI_KV_Store_Delete(const char* key)
+{
+	size_t key_len = strlen(key);
+
+	k_mutex_lock(&kv_store_lock, K_FOREVER);
+	int r = _kv_store_check_mounted();
+	if (r == 0)
+	{
+		int idx = _kv_store_find(key, key_len, crc32_ieee((const uint8_t*)key, key_len));
+		if (idx < 0 || (kv_store_index[idx]._flags & MPAI_KV_STORE_RECORD_DELETED))
+		{
+			r = -ENOENT;
+		}
+		else
+		{
+			// the tombstone hides the records of the key in the older sectors
+			r = _kv_store_append(key, MPAI_KV_STORE_RECORD_DELETED, NULL, 0);
+		}
+	}
+	k_mutex_unlock(&kv_store_lock);
+	return r;
+}
+
+int MPAI_KV_Store_Foreach(const char* prefix, mpai_kv_store_foreach_t* callback, void* user_data)
+{
+	char key[MPAI_KV_STORE_KEY_MAX_LEN + 1];
+	size_t prefix_len = strlen(prefix);
+	int count = 0;
+
+	k_mutex_lock(&kv_store_lock, K_FOREVER);
+	int r = _kv_store_check_mounted();
+	for (size_t i = 0; r == 0 && i < kv_store_index_count; i++)
+	{
+		kv_store_entry_t* entry = &kv_store_index[i];
+		if ((entry->_flags & MPAI_KV_STORE_RECORD_DELETED) || entry->_key_len < prefix_len)
+		{
+			continue;
+		}
+
+		r = read_flash_region(kv_store_flash_dev, _kv_store_sector_offset(entry->_sector) + entry->_offset + sizeof(mpai_kv_store_record_header_t), entry->_key_len, key);
+		key[entry->_key_len] = '\0';
+		if (r == 0 && strncmp(key, prefix, prefix_len) == 0)
+		{
+			callback(key, entry->_len, user_data);
+			count++;
+		}
+	}
+	k_mutex_unlock(&kv_store_lock);
+	return r == 0 ? count : r;
+}
+
+int MPAI_KV_Store_Stats(mpai_kv_store_stats_t* stats)
+{
+	memset(stats, 0, sizeof(mpai_kv_store_stats_t));
+
+	k_mutex_lock(&kv_store_lock, K_FOREVER);
+	int r = _kv_store_check_mounted();
+	if (r == 0)
+	{
+		stats->_sectors = CONFIG_MPAI_KV_STORE_SECTORS;
+		stats->_min_erase_count = UINT32_MAX;
+		for (size_t sector = 0; sector < CONFIG_MPAI_KV_STORE_SECTORS; sector++)
+		{
+			kv_store_sector_t* s = &kv_store_sectors[sector];
+			if (s->_sequence == MPAI_KV_STORE_SEQUENCE_FREE)
+			{
+				stats->_free_sectors++;
+			}
+			else
+			{
+				stats->_used_bytes += s->_used - sizeof(mpai_kv_store_sector_header_t);
+			}
+			stats->_live_bytes += s->_live;
+			stats->_min_erase_count = MIN(stats->_min_erase_count, s->_erase_count);
+			stats->_max_erase_count = MAX(stats->_max_erase_count, s->_erase_count);
+		}
+		for (size_t i = 0; i < kv_store_index_count; i++)
+		{
+			if (!(kv_store_index[i]._flags & MPAI_KV_STORE_RECORD_DELETED))
+			{
+				stats->_keys++;
+			}
+		}
+		stats->_erases = kv_store_erases;
+		stats->_compactions = kv_store_compactions;
+	}
+	k_mutex_unlock(&kv_store_lock);
+	return r;
+}
+
+/************* PRIVATE **************/
+int _kv_store_check_mounted()
+{
+	return kv_store_mounted ? 0 : MPAI_KV_Store_Mount();
+}
+
+off_t _kv_store_sector_offset(size_t sector)
+{
+	return FLASH_KV_STORE_REGION_OFFSET + sector * FLASH_SECTOR_SIZE;
+}
+
+uint16_t _kv_store_record_size(size_t key_len, size_t len)
+{
+	return ROUND_UP(sizeof(mpai_kv_store_record_header_t) + key_len + len, MPAI_KV_STORE_ALIGN);
+}
+
+int _kv_store_format(size_t sector, uint32_t erase_count)
+{
+	mpai_kv_store_sector_header_t header;
+
+	int r = erase_flash_region(kv_store_flash_dev, _kv_store_sector_offset(sector), FLASH_SECTOR_SIZE);
+	if (r != 0)
+	{
+		return r;
+	}
+	kv_store_erases++;
+
+	// the sequence stays erased until the sector is opened
+	header._magic = MPAI_KV_STORE_MAGIC;
+	header._erase_count = erase_count;
+	header._crc = crc32_ieee((const uint8_t*)&header, offsetof(mpai_kv_store_sector_header_t, _crc));
+	r = write_flash_region(kv_store_flash_dev, _kv_store_sector_offset(sector), offsetof(mpai_kv_store_sector_header_t, _sequence), &header);
+	if (r != 0)
+	{
+		return r;
+	}
+
+	kv_store_sectors[sector]._erase_count = erase_count;
+	kv_store_sectors[sector]._sequence = MPAI_KV_STORE_SEQUENCE_FREE;
+	kv_store_sectors[sector]._used = sizeof(mpai_kv_store_sector_header_t);
+	kv_store_sectors[sector]._live = 0;
+	return 0;
+}
+
+int _kv_store_open(size_t sector)
+{
+	uint32_t sequence[2] = { kv_store_sequence + 1, ~(kv_store_sequence + 1) };
+
+	int r = write_flash_region(kv_store_flash_dev, _kv_store_sector_offset(sector) + offsetof(mpai_kv_store_sector_header_t, _sequence), sizeof(sequence), sequence);
+	if (r != 0)
+	{
+		return r;
+	}
+
+	kv_store_sequence = sequence[0];
+	kv_store_sectors[sector]._sequence = sequence[0];
+	kv_store_head = sector;
+	return 0;
+}
+
+void _kv_store_scan(size_t sector)
+{
+	off_t sector_offset = _kv_store_sector_offset(sector);
+	mpai_kv_store_record_header_t header;
+	char key[MPAI_KV_STORE_KEY_MAX_LEN];
+	size_t offset = sizeof(mpai_kv_store_sector_header_t);
+	bool closed = false;
+
+	while (offset + sizeof(header) <= FLASH_SECTOR_SIZE)
+	{
+		if (read_flash_region(kv_store_flash_dev, sector_offset + offset, sizeof(header), &header) != 0)
+		{
+			closed = true;
+			break;
+		}
+
+		// free space
+		const uint8_t* raw = (const uint8_t*)&header;
+		bool erased = true;
+		for (size_t i = 0; i < sizeof(header); i++)
+		{
+			erased = erased && raw[i] == 0xFF;
+		}
+		if (erased)
+		{
+			break;
+		}
+
+		uint16_t size = _kv_store_record_size(header._key_len, header._len);
+		uint32_t crc = crc32_ieee((const uint8_t*)&header, offsetof(mpai_kv_store_record_header_t, _crc));
+		if (header._key_len == 0 || header._key_len > MPAI_KV_STORE_KEY_MAX_LEN || offset + size > FLASH_SECTOR_SIZE ||
+			read_flash_region(kv_store_flash_dev, sector_offset + offset + sizeof(header), header._key_len, key) != 0 ||
+			_kv_store_crc_flash(sector_offset + offset + sizeof(header), header._key_len + header._len, &crc) != 0 ||
+			crc != header._crc)
+		{
+			// a write was interrupted: nothing can be appended after it
+			LOG_WRN("Invalid record at %d of sector %d of the key/record store", (int)offset, (int)sector);
+			closed = true;
+			break;
+		}
+
+		if (_kv_store_index_record(key, header._key_len, crc32_ieee((const uint8_t*)key, header._key_len), sector, offset, header._len, header._flags) != 0)
+		{
+			LOG_ERR("Too many keys in the key/record store: a record is ignored");
+		}
+		offset += size;
+	}
+
+	kv_store_sectors[sector]._used = closed ? FLASH_SECTOR_SIZE : offset;
+}
+
+int _kv_store_crc_flash(off_t offset, size_t len, uint32_t* crc)
+{
+	uint8_t chunk[KV_STORE_CHUNK_SIZE];
+
+	for (size_t read = 0; read < len; read += KV_STORE_CHUNK_SIZE)
+	{
+		size_t chunk_len = MIN(len - read, KV_STORE_CHUNK_SIZE);
+		int r = read_flash_region(kv_store_flash_dev, offset + read, chunk_len, chunk);
+		if (r != 0)
+		{
+			return r;
+		}
+		*crc = crc32_ieee_update(*crc, chunk, chunk_len);
+	}
+	return 0;
+}
+
+int _kv_store_find(const char* key, size_t key_len, uint32_t hash)
+{
+	char stored_key[MPAI_KV_STORE_KEY_MAX_LEN];
+
+	for (size_t i = 0; i < kv_store_index_count; i++)
+	{
+		kv_store_entry_t* entry = &kv_store_index[i];
+		if (entry->_hash != hash || entry->_key_len != key_len)
+		{
+			continue;
+		}
+		if (read_flash_region(kv_store_flash_dev, _kv_store_sector_offset(entry->_sector) + entry->_offset + sizeof(mpai_kv_store_record_header_t), key_len, stored_key) == 0 &&
+			memcmp(stored_key, key, key_len) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int _kv_store_index_record(const char* key, size_t key_len, uint32_t hash, size_t sector, uint16_t offset, uint16_t len, uint8_t flags)
+{
+	int idx = _kv_store_find(key, key_len, hash);
+	if (idx >= 0)
+	{
+		kv_store_entry_t* old = &kv_store_index[idx];
+		kv_store_sectors[old->_sector]._live -= _kv_store_record_size(old->_key_len, old->_len);
+	}
+	else if (kv_store_index_count < CONFIG_MPAI_KV_STORE_MAX_KEYS)
+	{
+		idx = kv_store_index_count++;
+	}
+	else
+	{
+		return -ENOMEM;
+	}
+
+	kv_store_entry_t* entry = &kv_store_index[idx];
+	entry->_hash = hash;
+	entry->_sector = sector;
+	entry->_offset = offset;
+	entry->_len = len;
+	entry->_key_len = key_len;
+	entry->_flags = flags;
+	kv_store_sectors[sector]._live += _kv_store_record_size(key_len, len);
+	return 0;
+}
+
+void _kv_store_index_remove(size_t idx)
+{
+	kv_store_entry_t* entry = &kv_store_index[idx];
+	kv_store_sectors[entry->_sector]._live -= _kv_store_record_size(entry->_key_len, entry->_len);
+	kv_store_index[idx] = kv_store_index[--kv_store_index_count];
+}
+
+int _kv_store_append(const char* key, uint8_t flags, const void* data, size_t len)
+{
+	uint8_t buf[sizeof(mpai_kv_store_record_header_t) + MPAI_KV_STORE_KEY_MAX_LEN];
+	mpai_kv_store_record_header_t header;
+	size_t key_len = strlen(key);
+	uint32_t hash = crc32_ieee((const uint8_t*)key, key_len);
+	uint16_t size = _kv_store_record_size(key_len, len);
+
+	// a new key needs a free entry, before writing it
+	int idx = _kv_store_find(key, key_len, hash);
+	if (idx < 0 && kv_store_index_count >= CONFIG_MPAI_KV_STORE_MAX_KEYS)
+	{
+		return -ENOMEM;
+	}
+
+	// compactions can't make room if the live records fill the sectors
+	size_t live = size;
+	for (size_t sector = 0; sector < CONFIG_MPAI_KV_STORE_SECTORS; sector++)
+	{
+		live += kv_store_sectors[sector]._live;
+	}
+	if (idx >= 0)
+	{
+		live -= _kv_store_record_size(kv_store_index[idx]._key_len, kv_store_index[idx]._len);
+	}
+	if (live > KV_STORE_CAPACITY)
+	{
+		return -ENOSPC;
+	}
+
+	int r = _kv_store_reserve(size, false);
+	if (r != 0)
+	{
+		return r;
+	}
+
+	header._key_len = key_len;
+	header._flags = flags;
+	header._len = len;
+	header._crc = crc32_ieee((const uint8_t*)&header, offsetof(mpai_kv_store_record_header_t, _crc));
+	header._crc = crc32_ieee_update(header._crc, (const uint8_t*)key, key_len);
+	if (len > 0)
+	{
+		header._crc = crc32_ieee_update(header._crc, data, len);
+	}
+
+	// header and key in a single write, the data in another one: an interrupted record has a wrong CRC
+	off_t offset = _kv_store_sector_offset(kv_store_head) + kv_store_sectors[kv_store_head]._used;
+	memcpy(buf, &header, sizeof(header));
+	memcpy(buf + sizeof(header), key, key_len);
+	r = write_flash_region(kv_store_flash_dev, offset, sizeof(header) + key_len, buf);
+	if (r == 0 && len > 0)
+	{
+		r = write_flash_region(kv_store_flash_dev, offset + sizeof(header) + key_len, len, data);
+	}
+	if (r != 0)
+	{
+		// the space of the record can't be written again
+		kv_store_sectors[kv_store_head]._used = FLASH_SECTOR_SIZE;
+		return r;
+	}
+
+	uint16_t record_offset = kv_store_sectors[kv_store_head]._used;
+	kv_store_sectors[kv_store_head]._used += size;
+	return _kv_store_index_record(key, key_len, hash, kv_store_head, record_offset, len, flags);
+}
+
+int _kv_store_reserve(uint16_t size, bool compacting)
+{
+	size_t free_count;
+
+	// each compaction erases a sector: if all the records are live, it can't make room.
+	// Only the first one can move cold records, the others free the most space to make progress
+	for (size_t attempts = 0; attempts <= CONFIG_MPAI_KV_STORE_SECTORS; attempts++)
+	{
+		if (kv_store_head >= 0 && kv_store_sectors[kv_store_head]._used + size <= FLASH_SECTOR_SIZE)
+		{
+			return 0;
+		}
+
+		// the last free sector is kept for the compactions
+		int sector = _kv_store_free_sector(&free_count);
+		if (!compacting && free_count <= 1)
+		{
+			int r = _kv_store_compact(attempts == 0);
+			if (r != 0)
+			{
+				return r;
+			}
+			continue;
+		}
+		if (sector < 0)
+		{
+			return -ENOSPC;
+		}
+
+		int r = _kv_store_open(sector);
+		if (r != 0)
+		{
+			return r;
+		}
+	}
+	return -ENOSPC;
+}
+
+int _kv_store_free_sector(size_t* free_count)
+{
+	int found = -1;
+
+	*free_count = 0;
+	for (size_t sector = 0; sector < CONFIG_MPAI_KV_STORE_SECTORS; sector++)
+	{
+		if (kv_store_sectors[sector]._sequence != MPAI_KV_STORE_SEQUENCE_FREE)
+		{
+			continue;
+		}
+		(*free_count)++;
+		// wear leveling: the sector erased fewer times
+		if (found < 0 || kv_store_sectors[sector]._erase_count < kv_store_sectors[found]._erase_count)
+		{
+			found = sector;
+		}
+	}
+	return found;
+}
+
+int _kv_store_compact(bool wear_leveling)
+{
+	size_t free_count;
+	bool oldest;
+
+	// the live records of the victim have to fit the head sector or the free one
+	size_t room = kv_store_head >= 0 ? FLASH_SECTOR_SIZE - kv_store_sectors[kv_store_head]._used : 0;
+	if (_kv_store_free_sector(&free_count) >= 0)
+	{
+		room = MAX(room, FLASH_SECTOR_SIZE - sizeof(mpai_kv_store_sector_header_t));
+	}
+
+	int victim = _kv_store_choose_victim(room, wear_leveling, &oldest);
+	if (victim < 0)
+	{
+		return -ENOSPC;
+	}
+
+	for (size_t i = 0; i < kv_store_index_count; )
+	{
+		kv_store_entry_t* entry = &kv_store_index[i];
+		if (entry->_sector != victim)
+		{
+			i++;
+			continue;
+		}
+
+		// a tombstone in the oldest sector has nothing left to hide
+		if (oldest && (entry->_flags & MPAI_KV_STORE_RECORD_DELETED))
+		{
+			_kv_store_index_remove(i);
+			continue;
+		}
+
+		int r = _kv_store_copy(i);
+		if (r != 0)
+		{
+			return r;
+		}
+		i++;
+	}
+
+	kv_store_compactions++;
+	LOG_DBG("Sector %d of the key/record store compacted", victim);
+	return _kv_store_format(victim, kv_store_sectors[victim]._erase_count + 1);
+}
+
+int _kv_store_choose_victim(size_t room, bool wear_leveling, bool* oldest)
+{
+	int victim = -1;
+	int oldest_sector = -1;
+	int coldest_sector = -1;
+	uint32_t max_erase_count = 0;
+
+	for (size_t sector = 0; sector < CONFIG_MPAI_KV_STORE_SECTORS; sector++)
+	{
+		kv_store_sector_t* s = &kv_store_sectors[sector];
+		max_erase_count = MAX(max_erase_count, s->_erase_count);
+		if (s->_sequence == MPAI_KV_STORE_SEQUENCE_FREE || sector == kv_store_head)
+		{
+			continue;
+		}
+		if (oldest_sector < 0 || s->_sequence < kv_store_sectors[oldest_sector]._sequence)
+		{
+			oldest_sector = sector;
+		}
+		if (s->_live > room)
+		{
+			continue;
+		}
+		if (coldest_sector < 0 || s->_erase_count < kv_store_sectors[coldest_sector]._erase_count)
+		{
+			coldest_sector = sector;
+		}
+		// the sector with less live records needs less copies (the oldest one, if they are equal)
+		if (victim < 0 || s->_live < kv_store_sectors[victim]._live ||
+			(s->_live == kv_store_sectors[victim]._live && s->_sequence < kv_store_sectors[victim]._sequence))
+		{
+			victim = sector;
+		}
+	}
+
+	// static wear leveling: records never replaced are moved, so their sector is erased too
+	if (wear_leveling && coldest_sector >= 0 && kv_store_sectors[coldest_sector]._erase_count + CONFIG_MPAI_KV_STORE_WEAR_DELTA < max_erase_count)
+	{
+		victim = coldest_sector;
+	}
+	*oldest = victim >= 0 && victim == oldest_sector;
+	return victim;
+}
+
+int _kv_store_copy(size_t idx)
+{
+	uint8_t chunk[KV_STORE_CHUNK_SIZE];
+	kv_store_entry_t* entry = &kv_store_index[idx];
+	uint16_t size = _kv_store_record_size(entry->_key_len, entry->_len);
+
+	int r = _kv_store_reserve(size, true);
+	if (r != 0)
+	{
+		return r;
+	}
+
+	// the record is copied as it is, with its CRC
+	off_t from = _kv_store_sector_offset(entry->_sector) + entry->_offset;
+	off_t to = _kv_store_sector_offset(kv_store_head) + kv_store_sectors[kv_store_head]._used;
+	size_t len = sizeof(mpai_kv_store_record_header_t) + entry->_key_len + entry->_len;
+	for (size_t copied = 0; copied < len; copied += KV_STORE_CHUNK_SIZE)
+	{
+		size_t chunk_len = MIN(len - copied, KV_STORE_CHUNK_SIZE);
+		r = read_flash_region(kv_store_flash_dev, from + copied, chunk_len, chunk);
+		if (r == 0)
+		{
+			r = write_flash_region(kv_store_flash_dev, to + copied, chunk_len, chunk);
+		}
+		if (r != 0)
+		{
+			kv_store_sectors[kv_store_head]._used = FLASH_SECTOR_SIZE;
+			return r;
+		}
+	}
+
+	kv_store_sectors[entry->_sector]._live -= size;
+	entry->_sector = kv_store_head;
+	entry->_offset = kv_store_sectors[kv_store_head]._used;
+	kv_store_sectors[kv_store_head]._used += size;
+	kv_store_sectors[kv_store_head]._live += size;
+	return 0;
+}
+
+#endif
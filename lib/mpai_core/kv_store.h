@@ -0,0 +1,121 @@
+/*
+ * @file
+ * @brief Headers of a log-structured key/record store in flash memory: records are appended to the sectors of its region,
+ * an index in memory is rebuilt at mount, sectors with records replaced are compacted and erased evenly
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_KV_STORE_H
+#define MPAI_KV_STORE_H
+
+#include <core_common.h>
+#include <flash_store.h>
+#include <sys/crc.h>
+
+/* "MPKV" */
+#define MPAI_KV_STORE_MAGIC 0x4D504B56
+#define MPAI_KV_STORE_KEY_MAX_LEN 48
+/* Records start at offsets aligned to this size */
+#define MPAI_KV_STORE_ALIGN 4
+#define MPAI_KV_STORE_RECORD_DELETED 0x01
+#define MPAI_KV_STORE_SEQUENCE_FREE 0xFFFFFFFF
+
+/* Header of a sector, written after erasing it: the sequence is written when the sector is opened to append records */
+typedef struct _mpai_kv_store_sector_header_t {
+	uint32_t _magic;
+	uint32_t _erase_count;
+	uint32_t _crc;								// CRC32 of magic and erase count
+	uint32_t _sequence;							// order of the sector in the log, MPAI_KV_STORE_SEQUENCE_FREE if not opened
+	uint32_t _sequence_check;					// ~sequence: they differ if the opening was interrupted
+} mpai_kv_store_sector_header_t;
+
+/* Header of a record, followed by its key and data: a header not erased with a wrong CRC closes the sector (interrupted write) */
+typedef struct _mpai_kv_store_record_header_t {
+	uint8_t _key_len;							// 0xFF: free space of the sector
+	uint8_t _flags;
+	uint16_t _len;
+	uint32_t _crc;								// CRC32 of key length, flags, length, key and data
+} mpai_kv_store_record_header_t;
+
+/* Max size of the data of a record */
+#define MPAI_KV_STORE_DATA_MAX_LEN (FLASH_SECTOR_SIZE - sizeof(mpai_kv_store_sector_header_t) - sizeof(mpai_kv_store_record_header_t) - MPAI_KV_STORE_KEY_MAX_LEN)
+
+typedef struct _mpai_kv_store_stats_t {
+	size_t _sectors;
+	size_t _free_sectors;
+	size_t _keys;
+	size_t _live_bytes;							// records not replaced nor deleted
+	size_t _used_bytes;							// records written in the sectors not free
+	uint32_t _min_erase_count;
+	uint32_t _max_erase_count;
+	uint32_t _erases;							// since the mount
+	uint32_t _compactions;						// since the mount
+} mpai_kv_store_stats_t;
+
+/**
+ * @brief Callback of MPAI_KV_Store_Foreach
+ *
+ * @param key
+ * @param len length of the data of the record
+ * @param user_data
+ */
+typedef void (mpai_kv_store_foreach_t)(const char* key, size_t len, void* user_data);
+
+/**
+ * @brief Mount the store, scanning its sectors to rebuild the index (sectors never formatted are erased).
+ * The other functions mount it at first use
+ *
+ * @return int 0 on success, negative errno otherwise
+ */
+int MPAI_KV_Store_Mount();
+
+/**
+ * @brief Write the data of a key, replacing the previous one
+ *
+ * @param key at most MPAI_KV_STORE_KEY_MAX_LEN chars
+ * @param data
+ * @param len at most MPAI_KV_STORE_DATA_MAX_LEN bytes
+ * @return int 0 on success, -ENOSPC if the store is full, -ENOMEM if there are too many keys
+ */
+int MPAI_KV_Store_Write(const char* key, const void* data, size_t len);
+
+/**
+ * @brief Read the data of a key
+ *
+ * @param key
+ * @param buf
+ * @param size size of the buffer
+ * @return int length of the data, -ENOENT if the key is not found, -ENOBUFS if the buffer is too small
+ */
+int MPAI_KV_Store_Read(const char* key, void* buf, size_t size);
+
+/**
+ * @brief Delete a key
+ *
+ * @param key
+ * @return int 0 on success, -ENOENT if the key is not found
+ */
+int MPAI_KV_Store_Delete(const char* key);
+
+/**
+ * @brief Call a function for each key starting with a prefix (i.e. the records of an event log)
+ *
+ * @param prefix "" for all the keys
+ * @param callback called with the store locked: it can read the keys, not write them
+ * @param user_data
+ * @return int number of keys found, negative errno otherwise
+ */
+int MPAI_KV_Store_Foreach(const char* prefix, mpai_kv_store_foreach_t* callback, void* user_data);
+
+/**
+ * @brief Get the usage of the store
+ *
+ * @param stats
+ * @return int 0 on success, negative errno otherwise
+ */
+int MPAI_KV_Store_Stats(mpai_kv_store_stats_t* stats);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * @file
+ * @brief Implementation of a memory arena
+ * 
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "mem_arena.h"
+
+/************* PUBLIC **************/
+void MPAI_Arena_Init(mpai_arena_t* arena, void* buffer, size_t size)
+{
+	arena->_buffer = (uint8_t *)buffer;
+	arena->_size = size;
+	MPAI_Arena_Reset(arena);
+}
+
+void* MPAI_Arena_Alloc(mpai_arena_t* arena, size_t size)
+{
+	size_t aligned_size = (size + MPAI_ARENA_ALIGN - 1) & ~(size_t)(MPAI_ARENA_ALIGN - 1);
+	if (size == 0 || aligned_size > arena->_size - arena->_used)
+	{
+		arena->_failures++;
+		return NULL;
+	}
+
+	void* ptr = arena->_buffer + arena->_used;
+	arena->_used += aligned_size;
+	arena->_allocations++;
+	if (arena->_used > arena->_peak)
+	{
+		arena->_peak = arena->_used;
+	}
+	return ptr;
+}
+
+void MPAI_Arena_Reset(mpai_arena_t* arena)
+{
+	arena->_used = 0;
+	arena->_peak = 0;
+	arena->_allocations = 0;
+	arena->_failures = 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * @file
+ * @brief Headers of a memory arena: a bump allocator over a fixed buffer, released all at once
+ * 
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_MEM_ARENA_H
+#define MPAI_MEM_ARENA_H
+
+#include <core_common.h>
+
+/* Alignment of each allocation */
+#define MPAI_ARENA_ALIGN 8
+
+/* Arena over a buffer owned by the caller */
+typedef struct _mpai_arena_t {
+	uint8_t* _buffer;
+	size_t _size;
+	size_t _used;
+	size_t _peak;				// max bytes used since the last reset
+	size_t _allocations;		// allocations since the last reset
+	size_t _failures;			// allocations failed since the last reset
+} mpai_arena_t;
+
+/**
+ * @brief Initialize an arena over a buffer
+ * 
+ * @param arena 
+ * @param buffer aligned to MPAI_ARENA_ALIGN
+ * @param size 
+ */
+void MPAI_Arena_Init(mpai_arena_t* arena, void* buffer, size_t size);
+
+/**
+ * @brief Allocate memory from the arena: it can't be released alone, but only resetting the arena
+ * 
+ * @param arena 
+ * @param size 
+ * @return void* NULL if the arena is exhausted
+ */
+void* MPAI_Arena_Alloc(mpai_arena_t* arena, size_t size);
+
+/**
+ * @brief Release all the memory allocated from the arena, resetting also its statistics
+ * 
+ * @param arena 
+ */
+void MPAI_Arena_Reset(mpai_arena_t* arena);
+
+#endif
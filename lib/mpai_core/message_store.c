@@ -13,6 +13,10 @@ LOG_MODULE_REGISTER(MPAI_MESSAGE_STORE, LOG_LEVEL_INF);
 
 K_SEM_DEFINE(subscriber_channel_sem, 0, 1);
 
+/* Counters of the messages by channel: AIMs publish and copy from many threads */
+static atomic_t message_store_published[MPAI_MESSAGE_STORE_CHANNEL_COUNTERS_MAX];
+static atomic_t message_store_copied[MPAI_MESSAGE_STORE_CHANNEL_COUNTERS_MAX];
+
 /************* PRIVATE HEADER *************/
 subscriber_item* _linear_search(subscriber_item *items, size_t size, module_t *subscriber_key, subscriber_channel_t channel);
 
@@ -81,6 +85,9 @@ mpai_error_t MPAI_MessageStore_publish(MPAI_AIM_MessageStore_t *me, mpai_message
 
 	// publish message to a specified topic and channel (using PubSub library)
 	pubsub_publish(me->_topic, channel, message);
+	if (channel < MPAI_MESSAGE_STORE_CHANNEL_COUNTERS_MAX) {
+		atomic_inc(&message_store_published[channel]);
+	}
 
 	// TODO: error management
 	MPAI_ERR_INIT(err, MPAI_AIF_OK);
@@ -127,6 +134,9 @@ mpai_error_t MPAI_MessageStore_copy(MPAI_AIM_MessageStore_t *me, module_t *subsc
 	subscriber_item *sub_found = _linear_search(me->message_store_subscribers, (size_t)subscriber_item_count, subscriber, channel);
 	if (sub_found != NULL) {
 		pubsub_copy(sub_found->value, message);
+		if (channel < MPAI_MESSAGE_STORE_CHANNEL_COUNTERS_MAX) {
+			atomic_inc(&message_store_copied[channel]);
+		}
 	}
 
 	// TODO: error management
@@ -134,6 +144,17 @@ mpai_error_t MPAI_MessageStore_copy(MPAI_AIM_MessageStore_t *me, module_t *subsc
 	return err;
 }
 
+void MPAI_MessageStore_counters(subscriber_channel_t channel, uint32_t* published, uint32_t* copied)
+{
+	if (channel >= MPAI_MESSAGE_STORE_CHANNEL_COUNTERS_MAX) {
+		*published = 0;
+		*copied = 0;
+		return;
+	}
+	*published = (uint32_t)atomic_get(&message_store_published[channel]);
+	*copied = (uint32_t)atomic_get(&message_store_copied[channel]);
+}
+
 MPAI_AIM_MessageStore_t *MPAI_MessageStore_Creator(int aiw_id, char *topic_name, size_t topic_size)
 {
 	MPAI_AIM_MessageStore_t *this = (MPAI_AIM_MessageStore_t *)k_malloc(sizeof(MPAI_AIM_MessageStore_t));
@@ -18,6 +18,8 @@
 
 #define PUB_SUB_MAX_SUBSCRIBERS 20
 #define PUB_SUB_DEFAULT_CHANNEL 0
+/* Channels with counters of messages (the ones created first) */
+#define MPAI_MESSAGE_STORE_CHANNEL_COUNTERS_MAX 16
 
 typedef uint16_t subscriber_channel_t;
 typedef struct _subscriber_item{
@@ -64,6 +66,15 @@ int MPAI_MessageStore_poll(MPAI_AIM_MessageStore_t* me, module_t* subscriber, k_
  */
 mpai_error_t MPAI_MessageStore_copy(MPAI_AIM_MessageStore_t* me, module_t* subscriber, subscriber_channel_t channel, mpai_message_t* message);
 
+/**
+ * @brief Get the counters of a channel, for all the message stores
+ * 
+ * @param channel 
+ * @param published messages published to the channel
+ * @param copied messages copied from the channel by its subscribers
+ */
+void MPAI_MessageStore_counters(subscriber_channel_t channel, uint32_t* published, uint32_t* copied);
+
 /**
  * @brief Create the message store
  */
@@ -0,0 +1,281 @@
+/*
+ * @file
+ * @brief Implementation of the parameters of the AIMs
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_aim_parameters.h"
+
+#include <config_store.h>
+
+LOG_MODULE_REGISTER(MPAI_LIBS_AIF_AIM_PARAMETERS, LOG_LEVEL_INF);
+
+/* New values read from a document: they are applied only if all of them are valid */
+typedef struct _aim_parameters_document_t {
+	const char* _aim_name;
+	mpai_aim_parameter_t* _parameters[MPAI_AIM_PARAMETERS_MAX];
+	float _values[MPAI_AIM_PARAMETERS_MAX];
+	size_t _count;
+	bool _valid;
+} aim_parameters_document_t;
+
+/* Parameters declared, never removed: AIMs keep a pointer to them */
+static mpai_aim_parameter_t aim_parameters[MPAI_AIM_PARAMETERS_MAX];
+static size_t aim_parameters_count = 0;
+K_MUTEX_DEFINE(aim_parameters_lock);
+
+/************* PRIVATE HEADER *************/
+/* find a parameter by AIM and name */
+mpai_aim_parameter_t* _aim_parameters_find(const char* aim_name, const char* name);
+/* find a parameter by AIM and CRC16 of the name */
+mpai_aim_parameter_t* _aim_parameters_find_hash(const char* aim_name, uint16_t hash);
+/* CRC16 of the name of a parameter */
+uint16_t _aim_parameters_hash(const char* name);
+/* check the range of a value */
+bool _aim_parameters_in_range(const mpai_aim_parameter_t* parameter, float value);
+/* change the value of a parameter, returning 1 if it changed */
+int _aim_parameters_update(mpai_aim_parameter_t* parameter, float value);
+/* collect the new values of a document */
+bool _aim_parameters_document_callback(const mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data);
+/* copy a name, truncating it if too long */
+void _aim_parameters_copy_name(char* dst, const char* src);
+
+/************* PUBLIC **************/
+mpai_aim_parameter_t* MPAI_AIM_Parameters_Declare(const char* aim_name, const char* name, float default_value, float min, float max)
+{
+	k_mutex_lock(&aim_parameters_lock, K_FOREVER);
+	mpai_aim_parameter_t* parameter = _aim_parameters_find(aim_name, name);
+	if (parameter == NULL && aim_parameters_count < MPAI_AIM_PARAMETERS_MAX)
+	{
+		parameter = &aim_parameters[aim_parameters_count++];
+		_aim_parameters_copy_name(parameter->_aim_name, aim_name);
+		_aim_parameters_copy_name(parameter->_name, name);
+		parameter->_hash = _aim_parameters_hash(parameter->_name);
+	}
+	if (parameter != NULL)
+	{
+		parameter->_default = default_value;
+		parameter->_min = min;
+		parameter->_max = max;
+		parameter->_value = default_value;
+	}
+	k_mutex_unlock(&aim_parameters_lock);
+
+	if (parameter == NULL)
+	{
+		LOG_ERR("Too many parameters: %s of AIM %s not declared", log_strdup(name), log_strdup(aim_name));
+	}
+	return parameter;
+}
+
+float MPAI_AIM_Parameters_Value(const mpai_aim_parameter_t* parameter, float default_value)
+{
+	return parameter != NULL ? parameter->_value : default_value;
+}
+
+int MPAI_AIM_Parameters_Set(const char* aim_name, const char* name, float value)
+{
+	int r;
+
+	k_mutex_lock(&aim_parameters_lock, K_FOREVER);
+	mpai_aim_parameter_t* parameter = _aim_parameters_find(aim_name, name);
+	if (parameter == NULL)
+	{
+		r = -ENOENT;
+	}
+	else if (!_aim_parameters_in_range(parameter, value))
+	{
+		r = -EINVAL;
+	}
+	else
+	{
+		r = _aim_parameters_update(parameter, value);
+	}
+	k_mutex_unlock(&aim_parameters_lock);
+
+	return r;
+}
+
+int MPAI_AIM_Parameters_Apply(const char* aim_name, const uint8_t* document, size_t len, int content_format)
+{
+	aim_parameters_document_t values = {._aim_name = aim_name, ._valid = true};
+	mpai_json_stream_t stream;
+	int changed = 0;
+
+	if (content_format == MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR)
+	{
+		MPAI_CBOR_Stream_Init(&stream, _aim_parameters_document_callback, &values);
+	}
+	else
+	{
+		MPAI_JSON_Stream_Init(&stream, _aim_parameters_document_callback, &values);
+	}
+
+	k_mutex_lock(&aim_parameters_lock, K_FOREVER);
+	bool parsed = MPAI_JSON_Stream_Feed(&stream, (const char *)document, len);
+	parsed = MPAI_JSON_Stream_End(&stream) && parsed;
+	if (parsed && values._valid)
+	{
+		for (size_t i = 0; i < values._count; i++)
+		{
+			changed += _aim_parameters_update(values._parameters[i], values._values[i]);
+		}
+	}
+	k_mutex_unlock(&aim_parameters_lock);
+
+	if (!parsed || !values._valid)
+	{
+		LOG_ERR("Parameters of AIM %s not valid: nothing changed", log_strdup(aim_name));
+		return -EINVAL;
+	}
+	return changed;
+}
+
+size_t MPAI_AIM_Parameters_Encode(const char* aim_name, uint8_t* buffer, size_t size)
+{
+	size_t len = 0;
+
+	k_mutex_lock(&aim_parameters_lock, K_FOREVER);
+	for (size_t i = 0; i < aim_parameters_count; i++)
+	{
+		mpai_aim_parameter_t* parameter = &aim_parameters[i];
+		if (strncmp(parameter->_aim_name, aim_name, MPAI_AIM_PARAMETER_NAME_LEN - 1) != 0)
+		{
+			continue;
+		}
+		if (len + MPAI_AIM_PARAMETER_ENCODED_LEN > size)
+		{
+			LOG_WRN("Parameter %s of AIM %s doesn't fit the boot image", log_strdup(parameter->_name), log_strdup(aim_name));
+			continue;
+		}
+		float value = parameter->_value;
+		memcpy(&buffer[len], &parameter->_hash, sizeof(uint16_t));
+		memcpy(&buffer[len + sizeof(uint16_t)], &value, sizeof(float));
+		len += MPAI_AIM_PARAMETER_ENCODED_LEN;
+	}
+	k_mutex_unlock(&aim_parameters_lock);
+
+	return len;
+}
+
+int MPAI_AIM_Parameters_Decode(const char* aim_name, const uint8_t* buffer, size_t len)
+{
+	int restored = 0;
+
+	k_mutex_lock(&aim_parameters_lock, K_FOREVER);
+	for (size_t offset = 0; offset + MPAI_AIM_PARAMETER_ENCODED_LEN <= len; offset += MPAI_AIM_PARAMETER_ENCODED_LEN)
+	{
+		uint16_t hash;
+		float value;
+		memcpy(&hash, &buffer[offset], sizeof(uint16_t));
+		memcpy(&value, &buffer[offset + sizeof(uint16_t)], sizeof(float));
+
+		mpai_aim_parameter_t* parameter = _aim_parameters_find_hash(aim_name, hash);
+		if (parameter == NULL || !_aim_parameters_in_range(parameter, value))
+		{
+			LOG_WRN("Parameter %04x of AIM %s in boot image ignored", hash, log_strdup(aim_name));
+			continue;
+		}
+		_aim_parameters_update(parameter, value);
+		restored++;
+	}
+	k_mutex_unlock(&aim_parameters_lock);
+
+	return restored;
+}
+
+/************* PRIVATE **************/
+mpai_aim_parameter_t* _aim_parameters_find(const char* aim_name, const char* name)
+{
+	for (size_t i = 0; i < aim_parameters_count; i++)
+	{
+		if (strncmp(aim_parameters[i]._aim_name, aim_name, MPAI_AIM_PARAMETER_NAME_LEN - 1) == 0 &&
+			strncmp(aim_parameters[i]._name, name, MPAI_AIM_PARAMETER_NAME_LEN - 1) == 0)
+		{
+			return &aim_parameters[i];
+		}
+	}
+	return NULL;
+}
+
+mpai_aim_parameter_t* _aim_parameters_find_hash(const char* aim_name, uint16_t hash)
+{
+	for (size_t i = 0; i < aim_parameters_count; i++)
+	{
+		if (aim_parameters[i]._hash == hash && strncmp(aim_parameters[i]._aim_name, aim_name, MPAI_AIM_PARAMETER_NAME_LEN - 1) == 0)
+		{
+			return &aim_parameters[i];
+		}
+	}
+	return NULL;
+}
+
+uint16_t _aim_parameters_hash(const char* name)
+{
+	return crc16_ccitt(0, (const uint8_t *)name, strlen(name));
+}
+
+bool _aim_parameters_in_range(const mpai_aim_parameter_t* parameter, float value)
+{
+	// NaN is never in range
+	return value >= parameter->_min && value <= parameter->_max;
+}
+
+int _aim_parameters_update(mpai_aim_parameter_t* parameter, float value)
+{
+	if (parameter->_value == value)
+	{
+		return 0;
+	}
+	LOG_INF("Parameter %s of AIM %s: %f -> %f", log_strdup(parameter->_name), log_strdup(parameter->_aim_name), parameter->_value, value);
+	parameter->_value = value;
+	return 1;
+}
+
+bool _aim_parameters_document_callback(const mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data)
+{
+	aim_parameters_document_t* values = (aim_parameters_document_t *)user_data;
+
+	if (event == MPAI_JSON_STREAM_OBJECT_BEGIN || event == MPAI_JSON_STREAM_OBJECT_END)
+	{
+		// nested objects are rejected by their members
+		return true;
+	}
+
+	const char* key = MPAI_JSON_Stream_Key(stream);
+	if (event != MPAI_JSON_STREAM_NUMBER || stream->_depth != 1 || key == NULL)
+	{
+		LOG_WRN("Parameters of AIM %s have to be an object of numbers", log_strdup(values->_aim_name));
+		values->_valid = false;
+		return false;
+	}
+
+	mpai_aim_parameter_t* parameter = _aim_parameters_find(values->_aim_name, key);
+	char* end;
+	float number = strtof(value, &end);
+	if (parameter == NULL)
+	{
+		LOG_WRN("Parameter %s of AIM %s unknown", log_strdup(key), log_strdup(values->_aim_name));
+		values->_valid = false;
+	}
+	else if (*end != '\0' || !_aim_parameters_in_range(parameter, number))
+	{
+		LOG_WRN("Parameter %s of AIM %s out of range: %s", log_strdup(key), log_strdup(values->_aim_name), log_strdup(value));
+		values->_valid = false;
+	}
+	else if (values->_count < MPAI_AIM_PARAMETERS_MAX)
+	{
+		values->_parameters[values->_count] = parameter;
+		values->_values[values->_count++] = number;
+	}
+	return values->_valid;
+}
+
+void _aim_parameters_copy_name(char* dst, const char* src)
+{
+	strncpy(dst, src, MPAI_AIM_PARAMETER_NAME_LEN - 1);
+	dst[MPAI_AIM_PARAMETER_NAME_LEN - 1] = '\0';
+}
@@ -0,0 +1,101 @@
+/*
+ * @file
+ * @brief Headers of the parameters of the AIMs: thresholds and rates declared by the AIW with their defaults,
+ * that can be changed while the AIMs are running (i.e. by MPAI Store notifications) and are saved in the boot image
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_AIF_AIM_PARAMETERS_H
+#define MPAI_LIBS_AIF_AIM_PARAMETERS_H
+
+#include <core_common.h>
+#include <sys/crc.h>
+
+#include <aif_metadata_stream.h>
+
+/* Max parameters of all the AIMs */
+#define MPAI_AIM_PARAMETERS_MAX 24
+#define MPAI_AIM_PARAMETER_NAME_LEN 32
+/* Bytes of a parameter encoded in the boot image: CRC16 of its name and its value */
+#define MPAI_AIM_PARAMETER_ENCODED_LEN (sizeof(uint16_t) + sizeof(float))
+
+/* Parameter of an AIM: the AIM reads _value at each use, so a new value is applied without restarting it */
+typedef struct _mpai_aim_parameter_t {
+	char _aim_name[MPAI_AIM_PARAMETER_NAME_LEN];
+	char _name[MPAI_AIM_PARAMETER_NAME_LEN];
+	uint16_t _hash;						// CRC16 of the name, identifies the parameter in the boot image
+	volatile float _value;				// written at once, read by the AIM thread without locks
+	float _default;
+	float _min;
+	float _max;
+} mpai_aim_parameter_t;
+
+/**
+ * @brief Declare a parameter of an AIM, with its default value and the range of the values accepted
+ *
+ * @param aim_name
+ * @param name
+ * @param default_value
+ * @param min
+ * @param max
+ * @return mpai_aim_parameter_t* parameter to read with MPAI_AIM_Parameters_Value (NULL if there is no more space)
+ */
+mpai_aim_parameter_t* MPAI_AIM_Parameters_Declare(const char* aim_name, const char* name, float default_value, float min, float max);
+
+/**
+ * @brief Current value of a parameter
+ *
+ * @param parameter parameter declared (NULL if not declared by the AIW)
+ * @param default_value value returned when the parameter is not declared
+ * @return float
+ */
+float MPAI_AIM_Parameters_Value(const mpai_aim_parameter_t* parameter, float default_value);
+
+/**
+ * @brief Change the value of a parameter of an AIM
+ *
+ * @param aim_name
+ * @param name
+ * @param value
+ * @return int 1 if the value changed, 0 if it's the same, -ENOENT if not declared, -EINVAL if out of range
+ */
+int MPAI_AIM_Parameters_Set(const char* aim_name, const char* name, float value);
+
+/**
+ * @brief Apply a document with new values of the parameters of an AIM, as an object of numbers
+ * (i.e. {"AccelTotThresholdMin": 9.4}). Parameters not in the document are not changed, and nothing
+ * is changed if any of them is unknown or out of range
+ *
+ * @param aim_name
+ * @param document
+ * @param len
+ * @param content_format Content-Format of the document (CBOR or JSON)
+ * @return int number of parameters changed, or a negative value if the document is not valid
+ */
+int MPAI_AIM_Parameters_Apply(const char* aim_name, const uint8_t* document, size_t len, int content_format);
+
+/**
+ * @brief Encode the values of the parameters of an AIM, to save them in the boot image
+ *
+ * @param aim_name
+ * @param buffer
+ * @param size size of the buffer (parameters that don't fit are not saved)
+ * @return size_t bytes written
+ */
+size_t MPAI_AIM_Parameters_Encode(const char* aim_name, uint8_t* buffer, size_t size);
+
+/**
+ * @brief Restore the values of the parameters of an AIM saved in the boot image: values of parameters
+ * not declared anymore, or out of range, are ignored
+ *
+ * @param aim_name
+ * @param buffer
+ * @param len
+ * @return int number of parameters restored
+ */
+int MPAI_AIM_Parameters_Decode(const char* aim_name, const uint8_t* buffer, size_t len);
+
+#endif
@@ -0,0 +1,608 @@
+/*
+ * @file
+ * @brief Implementation of a COAP Server that exposes the AIF APIs and the metrics of the device
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_api_server.h"
+#include <logging/log.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+LOG_MODULE_REGISTER(MPAI_LIBS_AIF_API_SERVER, LOG_LEVEL_INF);
+
+/*************** DEFINE ***************/
+
+/* timeout of the poll of the socket, to check if the server is stopped */
+#define API_SERVER_POLL_MS 500
+
+/* the requests carry only the path and a short payload */
+#define API_SERVER_REQUEST_MAX_LEN 128
+
+/*************** STATIC ***************/
+/* Reply sent to a confirmable request, identified by the peer and the message ID */
+typedef struct _api_server_reply_t {
+	struct sockaddr_in _addr;
+	uint16_t _id;
+	uint16_t _len;								// 0 if the slot is empty
+	uint8_t _data[MPAI_API_SERVER_REPLY_CACHED_LEN];
+} api_server_reply_t;
+
+/* Context of the metrics of the threads */
+typedef struct _api_server_threads_t {
+	size_t* _offset;
+	size_t _count;
+	uint64_t _total_cycles;
+} api_server_threads_t;
+
+static int api_server_sock = -1;
+static volatile bool api_server_running = false;
+
+K_THREAD_STACK_DEFINE(api_server_stack_area, CONFIG_MPAI_API_SERVER_STACK_SIZE);
+static struct k_thread api_server_thread;
+
+/* Buffers used only by the thread of the server */
+static uint8_t api_server_request[API_SERVER_REQUEST_MAX_LEN];
+static uint8_t api_server_response[MAX_COAP_MSG_LEN];
+static char api_server_payload[CONFIG_COAP_BLOCK_SIZE];
+static api_server_reply_t api_server_replies[MPAI_API_SERVER_REPLIES_CACHED];
+static size_t api_server_reply_next = 0;
+/* IPv4 addresses of the peers allowed to send requests: any peer if there are none */
+static struct in_addr api_server_allowed_peers[MPAI_API_SERVER_ALLOWED_PEERS_MAX];
+static size_t api_server_allowed_peers_count = 0;
+/* coap_handle_request doesn't reply to a method not implemented by the resource */
+static bool api_server_replied = false;
+
+#ifdef CONFIG_SYS_HEAP_RUNTIME_STATS
+extern struct k_heap _system_heap;
+#endif
+
+/************* PRIVATE HEADER *************/
+void th_api_server(void *dummy1, void *dummy2, void *dummy3);
+/* parse CONFIG_MPAI_API_SERVER_ALLOWED_PEERS */
+int _api_server_parse_allowed_peers();
+/* check if the peer is allowed to send requests */
+bool _api_server_peer_allowed(const struct sockaddr *addr);
+/* dispatch a request to its resource */
+void _api_server_process(uint8_t *data, size_t len, struct sockaddr *addr, socklen_t addr_len);
+/* send again the reply of a retransmitted request, if it's cached */
+bool _api_server_resend(const struct coap_packet *request, const struct sockaddr *addr, socklen_t addr_len);
+/* keep the reply of a confirmable request */
+void _api_server_cache(const struct sockaddr *addr, uint16_t id, const uint8_t *data, uint16_t len);
+/* reply to a request: ACK if it's confirmable, NON otherwise */
+int _api_server_reply(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, uint8_t code, const char *payload, uint16_t content_format);
+/* reply to a request with the error of an API */
+int _api_server_reply_error(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, mpai_error_t err);
+/* copy the payload of a request in a string, false if it's empty or too long */
+bool _api_server_get_payload(const struct coap_packet *request, char *value, size_t size);
+/* append to api_server_payload: offset is set beyond its size when it's truncated */
+void _api_server_append(size_t *offset, const char *format, ...);
+/* AIW commands, with the AIW ID in the payload */
+int _api_server_aiw_command(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, mpai_error_t (*command)(int AIW_ID));
+/* AIM commands, with the AIM name in the payload */
+int _api_server_aim_command(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, mpai_error_t (*command)(const char *name));
+#if defined(CONFIG_THREAD_RUNTIME_STATS) && defined(CONFIG_THREAD_MONITOR)
+void _api_server_append_thread(const struct k_thread *thread, void *user_data);
+#endif
+
+/* Resources */
+int _api_server_aiw_start(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aiw_pause(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aiw_resume(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aiw_stop(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aim_start(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aim_stop(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aim_pause(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aim_resume(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_aim_status(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+int _api_server_metrics(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len);
+
+static const char * const api_server_aiw_start_path[] = { "aiw", "start", NULL };
+static const char * const api_server_aiw_pause_path[] = { "aiw", "pause", NULL };
+static const char * const api_server_aiw_resume_path[] = { "aiw", "resume", NULL };
+static const char * const api_server_aiw_stop_path[] = { "aiw", "stop", NULL };
+static const char * const api_server_aim_start_path[] = { "aim", "start", NULL };
+static const char * const api_server_aim_stop_path[] = { "aim", "stop", NULL };
+static const char * const api_server_aim_pause_path[] = { "aim", "pause", NULL };
+static const char * const api_server_aim_resume_path[] = { "aim", "resume", NULL };
+static const char * const api_server_aim_status_path[] = { "aim", "status", NULL };
+static const char * const api_server_metrics_path[] = { "metrics", NULL };
+
+static struct coap_resource api_server_resources[] = {
+	{ .path = api_server_aiw_start_path, .post = _api_server_aiw_start },
+	{ .path = api_server_aiw_pause_path, .post = _api_server_aiw_pause },
+	{ .path = api_server_aiw_resume_path, .post = _api_server_aiw_resume },
+	{ .path = api_server_aiw_stop_path, .post = _api_server_aiw_stop },
+	{ .path = api_server_aim_start_path, .post = _api_server_aim_start },
+	{ .path = api_server_aim_stop_path, .post = _api_server_aim_stop },
+	{ .path = api_server_aim_pause_path, .post = _api_server_aim_pause },
+	{ .path = api_server_aim_resume_path, .post = _api_server_aim_resume },
+	{ .path = api_server_aim_status_path, .get = _api_server_aim_status },
+	{ .path = api_server_metrics_path, .get = _api_server_metrics },
+	{ },
+};
+
+/**************** PUBLIC ****************/
+int MPAI_API_Server_Start()
+{
+	struct sockaddr_in addr;
+	int r;
+
+	if (api_server_running) {
+		return 0;
+	}
+
+	r = _api_server_parse_allowed_peers();
+	if (r < 0) {
+		return r;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(CONFIG_MPAI_API_SERVER_PORT);
+
+	api_server_sock = socket(addr.sin_family, SOCK_DGRAM, IPPROTO_UDP);
+	if (api_server_sock < 0) {
+		LOG_ERR("Failed to create UDP socket %d", errno);
+		return -errno;
+	}
+
+	r = bind(api_server_sock, (struct sockaddr *)&addr, sizeof(addr));
+	if (r < 0) {
+		LOG_ERR("Cannot bind UDP socket to port %d: %d", CONFIG_MPAI_API_SERVER_PORT, errno);
+		r = -errno;
+		(void)close(api_server_sock);
+		return r;
+	}
+
+	memset(api_server_replies, 0, sizeof(api_server_replies));
+	api_server_reply_next = 0;
+	api_server_running = true;
+
+	k_thread_create(&api_server_thread, api_server_stack_area, K_THREAD_STACK_SIZEOF(api_server_stack_area),
+			th_api_server, NULL, NULL, NULL,
+			CONFIG_MPAI_API_SERVER_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&api_server_thread, "aif_api_server");
+
+	LOG_INF("AIF API server listening on port %d (%s)", CONFIG_MPAI_API_SERVER_PORT,
+		api_server_allowed_peers_count > 0 ? "allowed peers only" : "any peer");
+	return 0;
+}
+
+void MPAI_API_Server_Stop()
+{
+	if (!api_server_running) {
+		return;
+	}
+
+	// the thread checks the flag at least every API_SERVER_POLL_MS
+	api_server_running = false;
+	k_thread_join(&api_server_thread, K_FOREVER);
+	(void)close(api_server_sock);
+	api_server_sock = -1;
+}
+
+/**************** PRIVATE ****************/
+void th_api_server(void *dummy1, void *dummy2, void *dummy3)
+{
+	ARG_UNUSED(dummy1);
+	ARG_UNUSED(dummy2);
+	ARG_UNUSED(dummy3);
+
+	struct pollfd fds[1] = { { .fd = api_server_sock, .events = POLLIN } };
+	struct sockaddr addr;
+	socklen_t addr_len;
+	int rcvd;
+	int r;
+
+	while (api_server_running) {
+		r = poll(fds, 1, API_SERVER_POLL_MS);
+		if (r < 0) {
+			LOG_ERR("Error in poll:%d", errno);
+			break;
+		}
+		if (r == 0) {
+			continue;
+		}
+
+		addr_len = sizeof(addr);
+		rcvd = recvfrom(api_server_sock, api_server_request, sizeof(api_server_request), MSG_DONTWAIT, &addr, &addr_len);
+		if (rcvd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			continue;
+		}
+		if (rcvd <= 0) {
+			LOG_ERR("Error receiving CoAP requests: %d", errno);
+			break;
+		}
+
+		if (!_api_server_peer_allowed(&addr)) {
+			LOG_WRN("Request from a peer not allowed, dropped");
+			continue;
+		}
+
+		_api_server_process(api_server_request, rcvd, &addr, addr_len);
+	}
+
+	LOG_DBG("AIF API server stopped");
+}
+
+int _api_server_parse_allowed_peers()
+{
+	char peers[] = CONFIG_MPAI_API_SERVER_ALLOWED_PEERS;
+	char *next;
+	char *peer;
+
+	api_server_allowed_peers_count = 0;
+	for (peer = strtok_r(peers, ", ", &next); peer != NULL; peer = strtok_r(NULL, ", ", &next)) {
+		if (api_server_allowed_peers_count == MPAI_API_SERVER_ALLOWED_PEERS_MAX) {
+			LOG_ERR("More than %d allowed peers", MPAI_API_SERVER_ALLOWED_PEERS_MAX);
+			return -EINVAL;
+		}
+		if (net_addr_pton(AF_INET, peer, &api_server_allowed_peers[api_server_allowed_peers_count]) < 0) {
+			LOG_ERR("Invalid allowed peer: %s", log_strdup(peer));
+			return -EINVAL;
+		}
+		api_server_allowed_peers_count++;
+	}
+	return 0;
+}
+
+bool _api_server_peer_allowed(const struct sockaddr *addr)
+{
+	const struct sockaddr_in *peer = (const struct sockaddr_in *)addr;
+
+	if (api_server_allowed_peers_count == 0) {
+		return true;
+	}
+	if (addr->sa_family != AF_INET) {
+		return false;
+	}
+	for (size_t i = 0; i < api_server_allowed_peers_count; i++) {
+		if (api_server_allowed_peers[i].s_addr == peer->sin_addr.s_addr) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void _api_server_process(uint8_t *data, size_t len, struct sockaddr *addr, socklen_t addr_len)
+{
+	struct coap_packet request;
+	struct coap_option options[MPAI_API_SERVER_MAX_OPTIONS];
+	uint8_t code;
+	int r;
+
+	r = coap_packet_parse(&request, data, len, options, MPAI_API_SERVER_MAX_OPTIONS);
+	if (r < 0) {
+		LOG_ERR("Invalid request received: %d", r);
+		return;
+	}
+
+	// only requests are served (pings, ACKs and resets are ignored)
+	code = coap_header_get_code(&request);
+	if (code == COAP_CODE_EMPTY || code >= COAP_RESPONSE_CODE_OK) {
+		return;
+	}
+
+	if (coap_header_get_type(&request) == COAP_TYPE_CON && _api_server_resend(&request, addr, addr_len)) {
+		return;
+	}
+
+	api_server_replied = false;
+	r = coap_handle_request(&request, api_server_resources, options, MPAI_API_SERVER_MAX_OPTIONS, addr, addr_len);
+	if (r == -ENOENT) {
+		_api_server_reply(&request, addr, addr_len, COAP_RESPONSE_CODE_NOT_FOUND, NULL, 0);
+	} else if (!api_server_replied) {
+		_api_server_reply(&request, addr, addr_len, COAP_RESPONSE_CODE_NOT_ALLOWED, NULL, 0);
+	}
+}
+
+bool _api_server_resend(const struct coap_packet *request, const struct sockaddr *addr, socklen_t addr_len)
+{
+	const struct sockaddr_in *peer = (const struct sockaddr_in *)addr;
+	uint16_t id = coap_header_get_id(request);
+
+	for (size_t i = 0; i < MPAI_API_SERVER_REPLIES_CACHED; i++) {
+		api_server_reply_t *reply = &api_server_replies[i];
+		if (reply->_len > 0 && reply->_id == id && reply->_addr.sin_port == peer->sin_port &&
+			reply->_addr.sin_addr.s_addr == peer->sin_addr.s_addr) {
+			LOG_DBG("Request %d retransmitted, sending the same reply", id);
+			(void)sendto(api_server_sock, reply->_data, reply->_len, 0, addr, addr_len);
+			return true;
+		}
+	}
+	return false;
+}
+
+void _api_server_cache(const struct sockaddr *addr, uint16_t id, const uint8_t *data, uint16_t len)
+{
+	// the replies with metrics are bigger, but they can be generated again
+	if (len > MPAI_API_SERVER_REPLY_CACHED_LEN) {
+		return;
+	}
+
+	api_server_reply_t *reply = &api_server_replies[api_server_reply_next];
+	memcpy(&reply->_addr, addr, sizeof(reply->_addr));
+	reply->_id = id;
+	reply->_len = len;
+	memcpy(reply->_data, data, len);
+	api_server_reply_next = (api_server_reply_next + 1) % MPAI_API_SERVER_REPLIES_CACHED;
+}
+
+int _api_server_reply(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, uint8_t code, const char *payload, uint16_t content_format)
+{
+	struct coap_packet response;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t tkl = coap_header_get_token(request, token);
+	uint16_t id = coap_header_get_id(request);
+	bool confirmable = coap_header_get_type(request) == COAP_TYPE_CON;
+	int r;
+
+	api_server_replied = true;
+
+	// piggybacked response for CON requests, NON response with a new ID otherwise
+	r = coap_packet_init(&response, api_server_response, sizeof(api_server_response),
+			     COAP_VERSION_1, confirmable ? COAP_TYPE_ACK : COAP_TYPE_NON_CON,
+			     tkl, token, code, confirmable ? id : coap_next_id());
+	if (r < 0) {
+		LOG_ERR("Failed to init CoAP message");
+		return r;
+	}
+
+	if (payload != NULL) {
+		r = coap_append_option_int(&response, COAP_OPTION_CONTENT_FORMAT, content_format);
+		if (r < 0) {
+			LOG_ERR("Unable add option to response");
+			return r;
+		}
+
+		r = coap_packet_append_payload_marker(&response);
+		if (r < 0) {
+			LOG_ERR("Unable to append payload marker");
+			return r;
+		}
+
+		r = coap_packet_append_payload(&response, (const uint8_t *)payload, strlen(payload));
+		if (r < 0) {
+			LOG_ERR("Not able to append payload");
+			return r;
+		}
+	}
+
+	r = sendto(api_server_sock, response.data, response.offset, 0, addr, addr_len);
+	if (r < 0) {
+		LOG_ERR("Failed to send CoAP reply: %d", errno);
+		return -errno;
+	}
+
+	if (confirmable) {
+		_api_server_cache(addr, id, response.data, response.offset);
+	}
+	return 0;
+}
+
+int _api_server_reply_error(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, mpai_error_t err)
+{
+	/* a request not allowed in the current state isn't an error of the server */
+	uint8_t code = err.code == MPAI_AIW_ALREADY_STARTED ? COAP_RESPONSE_CODE_FORBIDDEN : COAP_RESPONSE_CODE_INTERNAL_ERROR;
+
+	return _api_server_reply(request, addr, addr_len, code,
+				 MPAI_ERR_STR(err.code), COAP_CONTENT_FORMAT_TEXT_PLAIN);
+}
+
+bool _api_server_get_payload(const struct coap_packet *request, char *value, size_t size)
+{
+	uint16_t len;
+	const uint8_t *payload = coap_packet_get_payload(request, &len);
+
+	if (payload == NULL || len == 0 || len >= size) {
+		return false;
+	}
+	memcpy(value, payload, len);
+	value[len] = '\0';
+	return true;
+}
+
+void _api_server_append(size_t *offset, const char *format, ...)
+{
+	va_list args;
+	int r;
+
+	if (*offset >= sizeof(api_server_payload)) {
+		return;
+	}
+
+	va_start(args, format);
+	r = vsnprintf(api_server_payload + *offset, sizeof(api_server_payload) - *offset, format, args);
+	va_end(args);
+
+	*offset = r < 0 ? sizeof(api_server_payload) : *offset + r;
+}
+
+int _api_server_aiw_command(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, mpai_error_t (*command)(int AIW_ID))
+{
+	char value[MPAI_API_SERVER_PAYLOAD_MAX + 1];
+	char *end;
+
+	if (!_api_server_get_payload(request, value, sizeof(value))) {
+		return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_BAD_REQUEST, NULL, 0);
+	}
+	long aiw_id = strtol(value, &end, 10);
+	if (end == value || *end != '\0') {
+		return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_BAD_REQUEST, NULL, 0);
+	}
+
+	mpai_error_t err = command((int)aiw_id);
+	if (err.code != MPAI_AIF_OK) {
+		return _api_server_reply_error(request, addr, addr_len, err);
+	}
+	return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_CHANGED, NULL, 0);
+}
+
+int _api_server_aim_command(const struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len, mpai_error_t (*command)(const char *name))
+{
+	char name[MPAI_API_SERVER_PAYLOAD_MAX + 1];
+
+	if (!_api_server_get_payload(request, name, sizeof(name))) {
+		return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_BAD_REQUEST, NULL, 0);
+	}
+
+	LOG_INF("Remote command for AIM %s", log_strdup(name));
+	mpai_error_t err = command(name);
+	if (err.code != MPAI_AIF_OK) {
+		return _api_server_reply_error(request, addr, addr_len, err);
+	}
+	return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_CHANGED, NULL, 0);
+}
+
+int _api_server_aiw_start(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	char name[MPAI_API_SERVER_PAYLOAD_MAX + 1];
+	int aiw_id;
+
+	if (!_api_server_get_payload(request, name, sizeof(name))) {
+		return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_BAD_REQUEST, NULL, 0);
+	}
+
+	mpai_error_t err = MPAI_AIFU_AIW_Start(name, &aiw_id);
+	if (err.code != MPAI_AIF_OK) {
+		return _api_server_reply_error(request, addr, addr_len, err);
+	}
+
+	snprintf(api_server_payload, sizeof(api_server_payload), "%d", aiw_id);
+	return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_CHANGED, api_server_payload, COAP_CONTENT_FORMAT_TEXT_PLAIN);
+}
+
+int _api_server_aiw_pause(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aiw_command(request, addr, addr_len, MPAI_AIFU_AIW_Pause);
+}
+
+int _api_server_aiw_resume(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aiw_command(request, addr, addr_len, MPAI_AIFU_AIW_Resume);
+}
+
+int _api_server_aiw_stop(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aiw_command(request, addr, addr_len, MPAI_AIFU_AIW_Stop);
+}
+
+int _api_server_aim_start(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aim_command(request, addr, addr_len, MPAI_AIFM_AIM_Start);
+}
+
+int _api_server_aim_stop(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aim_command(request, addr, addr_len, MPAI_AIFM_AIM_Stop);
+}
+
+int _api_server_aim_pause(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aim_command(request, addr, addr_len, MPAI_AIFM_AIM_Pause);
+}
+
+int _api_server_aim_resume(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	return _api_server_aim_command(request, addr, addr_len, MPAI_AIFM_AIM_Resume);
+}
+
+int _api_server_aim_status(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	size_t offset = 0;
+	bool first = true;
+	int status;
+
+	_api_server_append(&offset, "{");
+	for (int i = 0; i < mpai_controller_aim_count; i++) {
+		// the list is cleared when an AIW is stopped
+		if (MPAI_AIM_List[i] == NULL) {
+			continue;
+		}
+		mpai_error_t err = MPAI_AIFU_AIM_GetStatus(AIW_IOT_REV, MPAI_AIM_List[i]->_aim_name, &status);
+		if (err.code != MPAI_AIF_OK) {
+			continue;
+		}
+		_api_server_append(&offset, "%s\"%s\":\"%s\"", first ? "" : ",", MPAI_AIM_List[i]->_aim_name, MPAI_ERR_STR(status));
+		first = false;
+	}
+	_api_server_append(&offset, "}");
+
+	if (offset >= sizeof(api_server_payload)) {
+		return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_INTERNAL_ERROR, "status too large", COAP_CONTENT_FORMAT_TEXT_PLAIN);
+	}
+	return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_CONTENT, api_server_payload, COAP_CONTENT_FORMAT_APP_JSON);
+}
+
+#if defined(CONFIG_THREAD_RUNTIME_STATS) && defined(CONFIG_THREAD_MONITOR)
+void _api_server_append_thread(const struct k_thread *thread, void *user_data)
+{
+	api_server_threads_t *threads = (api_server_threads_t *)user_data;
+	k_thread_runtime_stats_t stats;
+	const char *name = NULL;
+
+	if (k_thread_runtime_stats_get((k_tid_t)thread, &stats) != 0) {
+		return;
+	}
+#ifdef CONFIG_THREAD_NAME
+	name = k_thread_name_get((k_tid_t)thread);
+#endif
+
+	// share of the CPU since boot, in thousandths
+	uint32_t share = threads->_total_cycles > 0 ? (uint32_t)(stats.execution_cycles * 1000 / threads->_total_cycles) : 0;
+	if (name != NULL && name[0] != '\0') {
+		_api_server_append(threads->_offset, "%s[\"%s\",%llu,%u]", threads->_count > 0 ? "," : "",
+				   name, (unsigned long long)stats.execution_cycles, share);
+	} else {
+		_api_server_append(threads->_offset, "%s[\"%p\",%llu,%u]", threads->_count > 0 ? "," : "",
+				   (void *)thread, (unsigned long long)stats.execution_cycles, share);
+	}
+	threads->_count++;
+}
+#endif
+
+int _api_server_metrics(struct coap_resource *resource, struct coap_packet *request, struct sockaddr *addr, socklen_t addr_len)
+{
+	size_t offset = 0;
+	uint32_t published;
+	uint32_t copied;
+
+	_api_server_append(&offset, "{\"uptime_ms\":%lld", (long long)k_uptime_get());
+
+#ifdef CONFIG_SYS_HEAP_RUNTIME_STATS
+	struct sys_heap_runtime_stats heap_stats;
+	if (sys_heap_runtime_stats_get(&_system_heap.heap, &heap_stats) == 0) {
+		_api_server_append(&offset, ",\"heap\":{\"free\":%u,\"allocated\":%u}",
+				   (unsigned int)heap_stats.free_bytes, (unsigned int)heap_stats.allocated_bytes);
+	}
+#endif
+
+#if defined(CONFIG_THREAD_RUNTIME_STATS) && defined(CONFIG_THREAD_MONITOR)
+	// cycles since boot: the gateway computes the load from the difference between two scrapes
+	k_thread_runtime_stats_t all_stats;
+	api_server_threads_t threads = { ._offset = &offset, ._count = 0, ._total_cycles = 0 };
+	if (k_thread_runtime_stats_all_get(&all_stats) == 0) {
+		threads._total_cycles = all_stats.execution_cycles;
+	}
+	_api_server_append(&offset, ",\"cycles\":%llu,\"threads\":[", (unsigned long long)threads._total_cycles);
+	k_thread_foreach_unlocked(_api_server_append_thread, &threads);
+	_api_server_append(&offset, "]");
+#endif
+
+	_api_server_append(&offset, ",\"channels\":{");
+	for (int i = 0; i < mpai_message_store_channel_count; i++) {
+		MPAI_MessageStore_counters(message_store_channel_list[i]._channel, &published, &copied);
+		_api_server_append(&offset, "%s\"%s\":[%u,%u]", i > 0 ? "," : "",
+				   message_store_channel_list[i]._channel_name, published, copied);
+	}
+	_api_server_append(&offset, "}}");
+
+	if (offset >= sizeof(api_server_payload)) {
+		return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_INTERNAL_ERROR, "metrics too large", COAP_CONTENT_FORMAT_TEXT_PLAIN);
+	}
+	return _api_server_reply(request, addr, addr_len, COAP_RESPONSE_CODE_CONTENT, api_server_payload, COAP_CONTENT_FORMAT_APP_JSON);
+}
@@ -0,0 +1,48 @@
+/*
+ * @file
+ * @brief Headers of a COAP Server that exposes the AIF APIs and the metrics of the device
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_AIF_API_SERVER_H
+#define MPAI_LIBS_AIF_API_SERVER_H
+
+#include <core_common.h>
+#include <aif_controller.h>
+#include <net/socket.h>
+#include <net/coap.h>
+
+/* Resources (payload of the requests in text, replies in text or JSON):
+ * - POST aiw/start <AIW name>: 2.04 with the AIW ID, 4.03 if it's already started
+ * - POST aiw/pause, aiw/resume, aiw/stop <AIW ID>: 2.04
+ * - POST aim/start, aim/stop, aim/pause, aim/resume <AIM name>: 2.04
+ * - GET aim/status: 2.05 with {"<AIM name>":"MPAI_AIM_ALIVE"|"MPAI_AIM_DEAD",...}
+ * - GET metrics: 2.05 with uptime, heap, cycles of the threads and counters of the channels
+ * Errors of the APIs are replied with 5.00 and the error string, invalid payloads with 4.00
+ */
+#define MPAI_API_SERVER_PAYLOAD_MAX 32
+#define MPAI_API_SERVER_MAX_OPTIONS 16
+/* Replies kept to answer the retransmissions of confirmable requests, without executing them again */
+#define MPAI_API_SERVER_REPLIES_CACHED 4
+#define MPAI_API_SERVER_REPLY_CACHED_LEN 96
+/* Peers accepted from CONFIG_MPAI_API_SERVER_ALLOWED_PEERS */
+#define MPAI_API_SERVER_ALLOWED_PEERS_MAX 4
+
+/**
+ * @brief Start the COAP Server of the AIF APIs, on CONFIG_MPAI_API_SERVER_PORT.
+ * Only the peers of CONFIG_MPAI_API_SERVER_ALLOWED_PEERS are served (any peer if it's empty)
+ *
+ * @return int 0 on success, -EINVAL if CONFIG_MPAI_API_SERVER_ALLOWED_PEERS is invalid, negative errno otherwise
+ */
+int MPAI_API_Server_Start();
+
+/**
+ * @brief Stop the COAP Server of the AIF APIs
+ *
+ */
+void MPAI_API_Server_Stop();
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * @file
+ * @brief Implementation of the boot image of the AIF
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_boot_image.h"
+
+LOG_MODULE_REGISTER(MPAI_LIBS_AIF_BOOT_IMAGE, LOG_LEVEL_INF);
+
+BUILD_ASSERT(sizeof(mpai_boot_image_t) <= FLASH_BOOT_IMAGE_REGION_SIZE, "Boot image doesn't fit the flash region");
+
+/************* PRIVATE HEADER *************/
+/* CRC32 of the image, excluding the CRC itself */
+uint32_t _boot_image_crc(const mpai_boot_image_t* image);
+/* copy a name, truncating it if too long */
+void _boot_image_copy_name(char* dst, const char* src);
+
+/************* PUBLIC **************/
+void MPAI_Boot_Image_Init(mpai_boot_image_t* image, const char* aif_name, const char* aiw_name, uint32_t store_version)
+{
+	memset(image, 0, sizeof(mpai_boot_image_t));
+	image->_magic = MPAI_BOOT_IMAGE_MAGIC;
+	image->_format_version = MPAI_BOOT_IMAGE_FORMAT_VERSION;
+	image->_size = sizeof(mpai_boot_image_t);
+	image->_store_version = store_version;
+	if (aif_name != NULL)
+	{
+		_boot_image_copy_name(image->_aif_name, aif_name);
+	}
+	_boot_image_copy_name(image->_aiw_name, aiw_name);
+}
+
+int MPAI_Boot_Image_Add_Channel(mpai_boot_image_t* image, const char* channel_name, subscriber_channel_t channel)
+{
+	for (size_t i = 0; i < image->_channel_count; i++)
+	{
+		if (strncmp(image->_channels[i]._channel_name, channel_name, MPAI_BOOT_IMAGE_NAME_LEN) == 0)
+		{
+			return i;
+		}
+	}
+	if (image->_channel_count >= MPAI_AIF_CHANNEL_MAX)
+	{
+		return -1;
+	}
+	mpai_boot_image_channel_t* channel_el = &image->_channels[image->_channel_count];
+	_boot_image_copy_name(channel_el->_channel_name, channel_name);
+	channel_el->_channel = channel;
+	return image->_channel_count++;
+}
+
+mpai_boot_image_aim_t* MPAI_Boot_Image_Add_AIM(mpai_boot_image_t* image, const char* aim_name)
+{
+	if (image->_aim_count >= MPAI_AIF_AIM_MAX)
+	{
+		return NULL;
+	}
+	mpai_boot_image_aim_t* aim_el = &image->_aims[image->_aim_count++];
+	_boot_image_copy_name(aim_el->_aim_name, aim_name);
+	return aim_el;
+}
+
+bool MPAI_Boot_Image_Save(mpai_boot_image_t* image)
+{
+	const struct device *flash_dev = init_flash();
+	if (flash_dev == NULL)
+	{
+		return false;
+	}
+
+	image->_crc = _boot_image_crc(image);
+
+	if (erase_flash_region(flash_dev, FLASH_BOOT_IMAGE_REGION_OFFSET, FLASH_BOOT_IMAGE_REGION_SIZE) != 0)
+	{
+		return false;
+	}
+	if (write_flash_region(flash_dev, FLASH_BOOT_IMAGE_REGION_OFFSET, sizeof(mpai_boot_image_t), image) != 0)
+	{
+		return false;
+	}
+	LOG_INF("Boot image of AIW %s saved: %d AIMs, %d channels", log_strdup(image->_aiw_name), image->_aim_count, image->_channel_count);
+	return true;
+}
+
+bool MPAI_Boot_Image_Load(mpai_boot_image_t* image, const char* aif_name, const char* aiw_name)
+{
+	const struct device *flash_dev = init_flash();
+	if (flash_dev == NULL)
+	{
+		return false;
+	}
+
+	if (read_flash_region(flash_dev, FLASH_BOOT_IMAGE_REGION_OFFSET, sizeof(mpai_boot_image_t), image) != 0)
+	{
+		return false;
+	}
+
+	if (image->_magic != MPAI_BOOT_IMAGE_MAGIC)
+	{
+		LOG_INF("Boot image not found");
+		return false;
+	}
+	if (image->_format_version != MPAI_BOOT_IMAGE_FORMAT_VERSION || image->_size != sizeof(mpai_boot_image_t))
+	{
+		LOG_WRN("Boot image written by another firmware (format %d, size %d)", image->_format_version, image->_size);
+		return false;
+	}
+	if (image->_crc != _boot_image_crc(image))
+	{
+		LOG_WRN("Boot image corrupted: CRC mismatch");
+		return false;
+	}
+	if (image->_channel_count > MPAI_AIF_CHANNEL_MAX || image->_aim_count > MPAI_AIF_AIM_MAX)
+	{
+		LOG_WRN("Boot image not valid: too many AIMs or channels");
+		return false;
+	}
+	if (strncmp(image->_aiw_name, aiw_name, MPAI_BOOT_IMAGE_NAME_LEN) != 0 ||
+		strncmp(image->_aif_name, aif_name != NULL ? aif_name : "", MPAI_BOOT_IMAGE_NAME_LEN) != 0)
+	{
+		LOG_INF("Boot image refers to another AIF/AIW");
+		return false;
+	}
+	return true;
+}
+
+bool MPAI_Boot_Image_Invalidate()
+{
+	const struct device *flash_dev = init_flash();
+	if (flash_dev == NULL)
+	{
+		return false;
+	}
+	return erase_flash_region(flash_dev, FLASH_BOOT_IMAGE_REGION_OFFSET, FLASH_BOOT_IMAGE_REGION_SIZE) == 0;
+}
+
+uint32_t MPAI_Boot_Image_Config_Version(const char* config)
+{
+	if (config == NULL)
+	{
+		return 0;
+	}
+	return MPAI_Boot_Image_Update_Config_Version(0, (const uint8_t *)config, strlen(config));
+}
+
+uint32_t MPAI_Boot_Image_Update_Config_Version(uint32_t config_version, const uint8_t* chunk, size_t len)
+{
+	return crc32_ieee_update(config_version, chunk, len);
+}
+
+uint32_t MPAI_Boot_Image_Update_Store_Version(uint32_t store_version, uint32_t config_version)
+{
+	return crc32_ieee_update(store_version, (const uint8_t *)&config_version, sizeof(config_version));
+}
+
+/************* PRIVATE **************/
+uint32_t _boot_image_crc(const mpai_boot_image_t* image)
+{
+	return crc32_ieee((const uint8_t *)image, offsetof(mpai_boot_image_t, _crc));
+}
+
+void _boot_image_copy_name(char* dst, const char* src)
+{
+	strncpy(dst, src, MPAI_BOOT_IMAGE_NAME_LEN - 1);
+	dst[MPAI_BOOT_IMAGE_NAME_LEN - 1] = '\0';
+}
@@ -0,0 +1,142 @@
+/*
+ * @file
+ * @brief Headers of the boot image of the AIF: a compact binary copy, stored in flash, of the state resolved
+ * by parsing AIF/AIW/AIM configurations, used to start the AIW without network and JSON parser
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_AIF_BOOT_IMAGE_H
+#define MPAI_LIBS_AIF_BOOT_IMAGE_H
+
+#include <core_common.h>
+#include <flash_store.h>
+#include <sys/crc.h>
+
+#include <aif_controller.h>
+
+/* "MPBI" */
+#define MPAI_BOOT_IMAGE_MAGIC 0x4D504249
+/* Increment when the layout of mpai_boot_image_t changes */
+#define MPAI_BOOT_IMAGE_FORMAT_VERSION 1
+#define MPAI_BOOT_IMAGE_NAME_LEN 32
+#define MPAI_BOOT_IMAGE_PARAMETERS_LEN 64
+
+/* Element of the channel map */
+typedef struct _mpai_boot_image_channel_t {
+	char _channel_name[MPAI_BOOT_IMAGE_NAME_LEN];
+	subscriber_channel_t _channel;
+} mpai_boot_image_channel_t;
+
+/* AIM initialization record: routing is stored as indexes of the channel map */
+typedef struct _mpai_boot_image_aim_t {
+	char _aim_name[MPAI_BOOT_IMAGE_NAME_LEN];
+	uint8_t _count_channels;
+	uint8_t _input_channels[MPAI_AIF_CHANNEL_MAX];
+	uint16_t _parameters_len;
+	uint8_t _parameters[MPAI_BOOT_IMAGE_PARAMETERS_LEN];
+} mpai_boot_image_aim_t;
+
+/* Boot image, stored as it is in FLASH_BOOT_IMAGE_REGION_OFFSET */
+typedef struct _mpai_boot_image_t {
+	uint32_t _magic;
+	uint16_t _format_version;
+	uint16_t _size;										// sizeof(mpai_boot_image_t) of the firmware that wrote it
+	uint32_t _store_version;							// CRC32 of the configurations retrieved from MPAI Store
+	char _aif_name[MPAI_BOOT_IMAGE_NAME_LEN];			// empty if the AIF was not validated
+	char _aiw_name[MPAI_BOOT_IMAGE_NAME_LEN];
+	uint8_t _channel_count;
+	uint8_t _aim_count;
+	mpai_boot_image_channel_t _channels[MPAI_AIF_CHANNEL_MAX];
+	mpai_boot_image_aim_t _aims[MPAI_AIF_AIM_MAX];		// in the order the AIMs have to be started
+	uint32_t _crc;										// CRC32 of all the previous fields
+} mpai_boot_image_t;
+
+/**
+ * @brief Initialize an empty boot image
+ *
+ * @param image
+ * @param aif_name name of the AIF validated (NULL if not used)
+ * @param aiw_name name of the AIW
+ * @param store_version version of the configurations retrieved from MPAI Store
+ */
+void MPAI_Boot_Image_Init(mpai_boot_image_t* image, const char* aif_name, const char* aiw_name, uint32_t store_version);
+
+/**
+ * @brief Add a channel to the channel map of the image
+ *
+ * @param image
+ * @param channel_name
+ * @param channel
+ * @return int index of the channel in the map (-1 if there is no more space)
+ */
+int MPAI_Boot_Image_Add_Channel(mpai_boot_image_t* image, const char* channel_name, subscriber_channel_t channel);
+
+/**
+ * @brief Add an AIM record to the image
+ *
+ * @param image
+ * @param aim_name
+ * @return mpai_boot_image_aim_t* record to fill with routing and parameters (NULL if there is no more space)
+ */
+mpai_boot_image_aim_t* MPAI_Boot_Image_Add_AIM(mpai_boot_image_t* image, const char* aim_name);
+
+/**
+ * @brief Write the image in flash, replacing the previous one
+ *
+ * @param image
+ * @return true
+ * @return false
+ */
+bool MPAI_Boot_Image_Save(mpai_boot_image_t* image);
+
+/**
+ * @brief Read the image from flash, checking magic, format, CRC and names
+ *
+ * @param image buffer where the image is read
+ * @param aif_name name of the AIF expected (NULL if not used)
+ * @param aiw_name name of the AIW expected
+ * @return true if the image is valid
+ * @return false
+ */
+bool MPAI_Boot_Image_Load(mpai_boot_image_t* image, const char* aif_name, const char* aiw_name);
+
+/**
+ * @brief Erase the image from flash, so the next boot parses configurations again
+ *
+ * @return true
+ * @return false
+ */
+bool MPAI_Boot_Image_Invalidate();
+
+/**
+ * @brief Compute the version of a configuration retrieved from MPAI Store
+ *
+ * @param config configuration in a JSON format (NULL if not retrieved)
+ * @return uint32_t CRC32 of the configuration (0 if not retrieved)
+ */
+uint32_t MPAI_Boot_Image_Config_Version(const char* config);
+
+/**
+ * @brief Compute the version of a configuration retrieved from MPAI Store in chunks
+ *
+ * @param config_version version computed until now (0 for the first chunk)
+ * @param chunk
+ * @param len
+ * @return uint32_t
+ */
+uint32_t MPAI_Boot_Image_Update_Config_Version(uint32_t config_version, const uint8_t* chunk, size_t len);
+
+/**
+ * @brief Add the version of a configuration to the version of the whole MPAI Store
+ * (configurations have to be added always in the same order)
+ *
+ * @param store_version version computed until now (0 for the first configuration)
+ * @param config_version version returned by MPAI_Boot_Image_Config_Version
+ * @return uint32_t
+ */
+uint32_t MPAI_Boot_Image_Update_Store_Version(uint32_t store_version, uint32_t config_version);
+
+#endif
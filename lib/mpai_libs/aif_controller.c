@@ -13,15 +13,138 @@ LOG_MODULE_REGISTER(MPAI_LIBS_AIF_CONTROLLER, LOG_LEVEL_INF);
 
 #include <wifi_connect.h>
 #include <net_private.h>
+#include <boot_trace.h>
+#include <aif_boot_image.h>
+#include <aif_aim_parameters.h>
+#ifdef CONFIG_MPAI_API_SERVER
+	#include <aif_api_server.h>
+#endif
 
 /************* STATIC HEADER *************/
 static int aiw_id;
 
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+/* size of stack area used by the config observer thread */
+#define CONFIG_OBSERVER_STACKSIZE 2048
+
+/* scheduling priority used by the config observer thread */
+#define CONFIG_OBSERVER_PRIORITY 7
+
+/* Resource observed on MPAI Store, owned by the config observer thread */
+typedef struct _config_observer_resource_t {
+	MPAI_CONFIG_STORE_RESOURCE_TYPE _type;
+	const char* _name;
+	bool _notified;
+	uint32_t _version;							// CRC32 of the last notification (only its first block for large configurations)
+} config_observer_resource_t;
+
+/* Notification copied by the CoAP client to the config observer thread */
+typedef struct _config_observer_notification_t {
+	void* _fifo_reserved;						// first word reserved for use by k_fifo
+	config_observer_resource_t* _resource;
+	int _content_format;
+	size_t _len;
+	uint8_t _document[];
+} config_observer_notification_t;
+
+static config_observer_resource_t config_observer_resources[CONFIG_MPAI_CONFIG_STORE_OBSERVE_MAX];
+static size_t config_observer_resource_count = 0;
+K_FIFO_DEFINE(config_observer_fifo);
+K_THREAD_STACK_DEFINE(config_observer_stack_area, CONFIG_OBSERVER_STACKSIZE);
+static struct k_thread config_observer_thread;
+#endif
+
+#if defined(CONFIG_MPAI_CONFIG_STORE)
+/* Slots of the boot pipeline not related to an AIM */
+#define BOOT_PIPELINE_SLOT_AIF -2
+#define BOOT_PIPELINE_SLOT_AIW -1
+
+/* State of the boot pipeline: AIF/AIW/AIM configurations are retrieved concurrently from MPAI Store
+ * and every AIM is started as soon as its configuration and the AIW topology are available */
+typedef struct _boot_pipeline_t {
+	int _aiw_id;
+	const char* _aif_name;						// AIF to validate before starting AIMs (NULL to skip it)
+	const char* _aiw_name;
+	bool _aif_requested;
+	bool _aif_received;
+	bool _aif_ok;
+	char* _aif_result;
+	uint32_t _aif_version;						// version of each configuration, used by the boot image
+	bool _aiw_requested;
+	bool _aiw_received;
+	bool _aiw_parsed;
+	mpai_metadata_aiw_stream_t _aiw_stream;		// AIW is parsed while it's received
+	bool _aiw_stream_ok;
+	size_t _aiw_len;								// bytes of AIW received
+	uint32_t _aiw_version;
+	bool _aim_requested[MPAI_AIF_AIM_MAX];		// AIM configurations, indexed as MPAI_AIM_List
+	bool _aim_received[MPAI_AIF_AIM_MAX];
+	bool _aim_required[MPAI_AIF_AIM_MAX];		// AIM listed in "SubAIMs" of the AIW
+	bool _aim_started[MPAI_AIF_AIM_MAX];
+	char* _aim_results[MPAI_AIF_AIM_MAX];
+	uint32_t _aim_versions[MPAI_AIF_AIM_MAX];
+	int _request_slots[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];	// slot of each request of the current round
+	int _request_traces[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];	// boot trace of each request of the current round
+	bool _failed;
+} boot_pipeline_t;
+
+static boot_pipeline_t boot_pipeline;
+#endif
+
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+/* Boot image: loaded at warm boots, saved after a successful cold boot */
+static mpai_boot_image_t boot_image;
+/* the boot image in flash is the one in memory (it has to be saved again when parameters change) */
+static bool boot_image_valid = false;
+#endif
+
 /************* PRIVATE HEADER *************/
 /* search channel by name*/
 channel_map_element_t _linear_search_channel(const char *name);
-/* init and start aim after parsing from MPAI Store Config*/
-bool _start_aim_after_parsing_callback(const char * aim_name); 
+/* search aim index in MPAI_AIM_List by name */
+int _linear_search_aim_index(const char *name);
+/* init the AIW by name, returning the AIW_ID (-1 if not handled) */
+int _aiw_init(const char *name);
+#if defined(CONFIG_MPAI_CONFIG_STORE)
+/* mark an aim as required by the AIW after parsing from MPAI Store Config*/
+bool _require_aim_after_parsing_callback(const char * aim_name); 
+/* prepare next concurrent requests of the boot pipeline, returning the count */
+size_t _boot_pipeline_next_requests(boot_pipeline_t *pipeline, mpai_config_store_request_t *requests);
+/* store a configuration retrieved by the boot pipeline */
+void _boot_pipeline_config_callback(size_t idx, char* result, void* user_data);
+/* parse a chunk of the AIW retrieved by the boot pipeline */
+int _boot_pipeline_aiw_block_callback(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data);
+/* parse configurations available and start AIMs whose dependencies are satisfied */
+void _boot_pipeline_advance(boot_pipeline_t *pipeline);
+#endif
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+/* save the state resolved by the boot pipeline as boot image */
+bool _boot_image_save(boot_pipeline_t *pipeline);
+/* check that AIMs and channels of the boot image are known by the AIW implementation */
+bool _boot_image_validate(const mpai_boot_image_t *image);
+/* start the AIMs of the boot image, without parsing configurations */
+mpai_error_t _boot_image_start(const mpai_boot_image_t *image, int aiw_id);
+/* compare the version of the boot image with the configurations on MPAI Store, invalidating it if they changed */
+void _boot_image_verify(const mpai_boot_image_t *image);
+/* store the version of a configuration retrieved to verify the boot image */
+void _boot_image_verify_callback(size_t idx, char* result, void* user_data);
+/* callback computing the version of the AIW streamed, in the same encoding used saving the image */
+int _boot_image_verify_block_callback(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data);
+/* save in the boot image the current parameters of an AIM */
+void _boot_image_update_parameters(const char* aim_name);
+#endif
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+/* observe on MPAI Store the AIW and the configurations and parameters of the AIMs started, starting the config observer thread */
+void _config_observer_start(const char* aiw_name);
+/* add a resource to observe */
+void _config_observer_add(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name);
+/* copy a notification to the config observer thread */
+void _config_observer_notification_callback(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name, const uint8_t* document, size_t len, int content_format, void* user_data);
+/* apply a notification received */
+void _config_observer_process(config_observer_notification_t* notification);
+/* thread applying notifications and registering again the observations lost */
+void th_config_observer(void *dummy1, void *dummy2, void *dummy3);
+#endif
 /* update input channels in MPAI_AIM_List */
 void _update_input_channels_after_parsing_callback(const char * aim_name, const char* port_name); 
 /* search message store by aiw_id*/
@@ -37,15 +160,6 @@ int mpai_controller_aim_count = 0;
 int mpai_message_store_channel_count = 0;
 int mpai_message_store_count = 0;
 
-/*** START COAP ***/
-#ifdef CONFIG_COAP_SERVER
-const char *const test_path[] = {"test", NULL};
-
-const char *const large_path[] = {"large", NULL};
-
-const char *const obs_path[] = {"obs", NULL};
-#endif
-
 mpai_error_t MPAI_AIFU_Controller_Initialize()
 {
 
@@ -96,57 +210,104 @@ mpai_error_t MPAI_AIFU_Controller_Initialize()
 	/*** END SPI FLASH ***/
 #endif
 
+#if defined(CONFIG_MPAI_CONFIG_STORE) && defined(CONFIG_MPAI_CONFIG_STORE_USES_COAP)
+	LOG_INF("Starting AIW %s...", log_strdup(MPAI_LIBS_IOT_REV_AIW_NAME));
+	aiw_id = _aiw_init(MPAI_LIBS_IOT_REV_AIW_NAME);
+#endif
+
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+	// warm boot: AIMs are started from the boot image in flash, before connecting to the network
+	int trace_boot_image = MPAI_BOOT_TRACE_BEGIN("Load boot image", NULL);
+	bool warm_boot = MPAI_Boot_Image_Load(&boot_image, MPAI_LIBS_AIF_NAME, MPAI_LIBS_IOT_REV_AIW_NAME) && _boot_image_validate(&boot_image);
+	if (warm_boot)
+	{
+		mpai_error_t err_image = _boot_image_start(&boot_image, aiw_id);
+		MPAI_BOOT_TRACE_END(trace_boot_image);
+		if (err_image.code != MPAI_AIF_OK)
+		{
+			LOG_ERR("Error starting AIW %s from boot image: %s", MPAI_LIBS_IOT_REV_AIW_NAME, log_strdup(MPAI_ERR_STR(err_image.code)));
+			return err_image;
+		}
+		LOG_INF("MPAI_AIF initialized correctly from boot image");
+		boot_image_valid = true;
+	}
+	else
+	{
+		MPAI_BOOT_TRACE_END(trace_boot_image);
+	}
+#endif
+
+	int trace_wifi = MPAI_BOOT_TRACE_BEGIN("Wi-Fi connect", NULL);
 	wifi_connect();
+	MPAI_BOOT_TRACE_END(trace_wifi);
 
 #ifdef CONFIG_COAP_SERVER
 	/*** START COAP ***/
 	int r;
 
 	LOG_DBG("Start CoAP-client sample");
+	int trace_coap = MPAI_BOOT_TRACE_BEGIN("CoAP client start", NULL);
 	r = start_coap_client();
 	if (r < 0)
 	{
-		(void)close(get_coap_sock());
+		LOG_ERR("Error starting CoAP client: %d", r);
 	}
+	MPAI_BOOT_TRACE_END(trace_coap);
+#endif
 
-	// // /* GET, PUT, POST, DELETE */
-	// uint8_t* data_result = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN * sizeof(uint8_t));
-	// r = send_simple_coap_msgs_and_wait_for_reply(data_result, test_path);
-	// k_free(data_result);
-
-	// /* Block-wise transfer */
-	// char* data_large_result = get_large_coap_msgs(large_path);
-	// k_free(data_large_result);
-
-	/* Register observer, get notifications and unregister */
-	// r = register_observer();
-	// if (r < 0) {
-	// 	(void)close(get_coap_sock());
-	// }
+#ifdef CONFIG_MPAI_API_SERVER
+	// started before the AIW, so a gateway can start it again if loading fails
+	int r_api = MPAI_API_Server_Start();
+	if (r_api < 0)
+	{
+		LOG_ERR("Error starting AIF API server: %d", r_api);
+	}
 #endif
 
-	bool aif_ok = false;
 #if defined(CONFIG_MPAI_CONFIG_STORE) && defined(CONFIG_MPAI_CONFIG_STORE_USES_COAP)
-	char *aif_result = MPAI_Config_Store_Get_AIF(MPAI_LIBS_AIF_NAME);
-	aif_ok = MPAI_Metadata_Parser_Parse_AIF_JSON(aif_result);
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+	if (warm_boot)
+	{
+		// configurations could be changed on MPAI Store after saving the boot image
+		int trace_verify = MPAI_BOOT_TRACE_BEGIN("Verify boot image", NULL);
+		_boot_image_verify(&boot_image);
+		MPAI_BOOT_TRACE_END(trace_verify);
+	}
+	else
 #endif
-
-	if (aif_ok)
 	{
-		mpai_error_t err_aiw = MPAI_AIFU_AIW_Start(MPAI_LIBS_IOT_REV_AIW_NAME, &aiw_id);
+		// AIF and AIW configurations are retrieved together, by the boot pipeline
+		mpai_error_t err_aiw = MPAI_Controller_Start_Loading_AIF_AIW_From_MPAI_Store(MPAI_LIBS_AIF_NAME, MPAI_LIBS_IOT_REV_AIW_NAME, aiw_id);
 		if (err_aiw.code != MPAI_AIF_OK)
 		{
 			LOG_ERR("Error starting AIW %s: %s", MPAI_LIBS_IOT_REV_AIW_NAME, log_strdup(MPAI_ERR_STR(err_aiw.code)));
-			return;
+			return err_aiw;
 		}
 
 		LOG_INF("MPAI_AIF initialized correctly");
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+		boot_image_valid = _boot_image_save(&boot_pipeline);
+#endif
 	}
+#endif
 
-
-#if defined(CONFIG_MPAI_CONFIG_STORE) && defined(CONFIG_MPAI_CONFIG_STORE_USES_COAP)
-	/* Close the socket when it's no longer usefull*/
-	(void)close(get_coap_sock());
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+	// the socket is kept open: changes on MPAI Store are notified while the AIMs are running
+	_config_observer_start(MPAI_LIBS_IOT_REV_AIW_NAME);
+#elif defined(CONFIG_MPAI_CONFIG_STORE) && defined(CONFIG_MPAI_CONFIG_STORE_USES_COAP)
+	/* Close the socket when it's no longer usefull (copies in cache revalidated in background and telemetry still need it)*/
+#ifdef CONFIG_MPAI_AIM_TELEMETRY
+	LOG_INF("CoAP client kept open: telemetry is sent to the COAP Server");
+#else
+	if (MPAI_Config_Store_Wait_Revalidation(0))
+	{
+		stop_coap_client();
+	}
+	else
+	{
+		LOG_INF("CoAP client kept open: copies in cache are revalidated in background");
+	}
+#endif
 #endif
 
 	// k_sleep(K_SECONDS(5));
@@ -159,6 +320,9 @@ mpai_error_t MPAI_AIFU_Controller_Initialize()
 
 mpai_error_t MPAI_AIFU_Controller_Destroy()
 {
+#ifdef CONFIG_MPAI_API_SERVER
+	MPAI_API_Server_Stop();
+#endif
 	MPAI_AIW_IOT_REV_Destroy();
 
 	memset(MPAI_AIM_List, 0, MPAI_AIF_AIM_MAX * sizeof(aim_initialization_cb_t *));
@@ -171,10 +335,9 @@ mpai_error_t MPAI_AIFU_AIW_Start(const char *name, int *AIW_ID)
 {
 	LOG_INF("Starting AIW %s...", log_strdup(name));
 
-	// At the moment, we handle only AIW IOT-REV
-	if (strcmp(name, MPAI_LIBS_IOT_REV_AIW_NAME) == 0)
+	int aiw_id = _aiw_init(name);
+	if (aiw_id >= 0)
 	{
-		int aiw_id = MPAI_AIW_IOT_REV_Init();
 		*AIW_ID = aiw_id;
 
 #if defined(CONFIG_MPAI_CONFIG_STORE)
@@ -182,6 +345,12 @@ mpai_error_t MPAI_AIFU_AIW_Start(const char *name, int *AIW_ID)
 		return err_aiw;
 #endif
 	}
+	else if (aiw_id == -EALREADY)
+	{
+		// its lists and parameters can't be set up again while it's running
+		MPAI_ERR_INIT(err_started, MPAI_AIW_ALREADY_STARTED);
+		return err_started;
+	}
 
 	MPAI_ERR_INIT(err, MPAI_ERROR);
 	return err;
@@ -242,10 +411,11 @@ mpai_error_t MPAI_AIFU_AIW_Stop(int AIW_ID)
 
 mpai_error_t MPAI_AIFU_AIM_GetStatus(int AIW_ID, const char *name, int *status)
 {
-	aim_initialization_cb_t* aim_init = MPAI_AIFU_AIM_Find_AIM(name);
+	aim_initialization_cb_t* aim_init = MPAI_Controller_Find_AIM_Init_Config(name);
 	if (aim_init != NULL)
 	{
-		if (MPAI_AIM_Is_Alive(aim_init->_aim))
+		// an AIM not required by the AIW is never created
+		if (aim_init->_aim != NULL && MPAI_AIM_Is_Alive(aim_init->_aim))
 		{
 			*status = MPAI_AIM_ALIVE;
 		}
@@ -308,26 +478,55 @@ mpai_error_t MPAI_AIFM_AIM_Resume(const char *name)
 #if defined(CONFIG_MPAI_CONFIG_STORE)
 mpai_error_t MPAI_Controller_Start_Loading_AIW_From_MPAI_Store(const char *name, int aiw_id)
 {
-	char *aiw_result = MPAI_Config_Store_Get_AIW(name);
-	// printk("AIW RESULT: \n");
-	// for ( size_t i = 0; i < strlen(aiw_result); i++ )
-	// {
-	// 	printk("%c", (char)aiw_result[i]);
-	// 	k_sleep(K_MSEC(5));
-	// }
-	// printk("\n");
+	return MPAI_Controller_Start_Loading_AIF_AIW_From_MPAI_Store(NULL, name, aiw_id);
+}
 
-	bool aiw_ok = MPAI_Metadata_Parser_Parse_AIW_JSON(aiw_result, aiw_id, _start_aim_after_parsing_callback, _update_input_channels_after_parsing_callback);
-	if (aiw_ok)
+mpai_error_t MPAI_Controller_Start_Loading_AIF_AIW_From_MPAI_Store(const char *aif_name, const char *aiw_name, int aiw_id)
+{
+	mpai_config_store_request_t requests[MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS];
+	size_t count;
+
+	memset(&boot_pipeline, 0, sizeof(boot_pipeline_t));
+	boot_pipeline._aiw_id = aiw_id;
+	boot_pipeline._aif_name = aif_name;
+	boot_pipeline._aiw_name = aiw_name;
+	boot_pipeline._aif_ok = aif_name == NULL;
+	MPAI_Metadata_Parser_AIW_Stream_Init(&boot_pipeline._aiw_stream, aiw_id, _require_aim_after_parsing_callback, _update_input_channels_after_parsing_callback);
+
+	// every round retrieves concurrently all the configurations not requested yet
+	while (!boot_pipeline._failed && (count = _boot_pipeline_next_requests(&boot_pipeline, requests)) > 0)
 	{
-		MPAI_ERR_INIT(err, MPAI_AIF_OK);
-		return err;
+		for (size_t i = 0; i < count; i++)
+		{
+			boot_pipeline._request_traces[i] = MPAI_BOOT_TRACE_BEGIN_CONCURRENT("Fetch config", requests[i]._name);
+		}
+		int r = MPAI_Config_Store_Get_Concurrent(requests, count, _boot_pipeline_config_callback, &boot_pipeline);
+		if (r < 0)
+		{
+			LOG_ERR("Error retrieving configurations from MPAI Store: %d", r);
+			boot_pipeline._failed = true;
+		}
 	}
-	else
+
+	// free configurations not consumed (AIMs not used by the AIW or pipeline failed)
+	k_free(boot_pipeline._aif_result);
+	for (size_t i = 0; i < mpai_controller_aim_count; i++)
+	{
+		k_free(boot_pipeline._aim_results[i]);
+		if (!boot_pipeline._failed && boot_pipeline._aim_required[i] && !boot_pipeline._aim_started[i])
+		{
+			LOG_ERR("AIM %s not started: configuration not found", log_strdup(MPAI_AIM_List[i]->_aim_name));
+			boot_pipeline._failed = true;
+		}
+	}
+
+	if (boot_pipeline._failed || !boot_pipeline._aiw_parsed)
 	{
 		MPAI_ERR_INIT(err, MPAI_ERROR);
 		return err;
 	}
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return err;
 }
 #endif
 
@@ -367,8 +566,8 @@ aim_initialization_cb_t *MPAI_Controller_Find_AIM_Init_Config(const char *name)
 {
 	for (size_t i = 0; i < mpai_controller_aim_count; i++)
 	{
-		// verify aim name
-		if (strcmp(MPAI_AIM_Get_Component(MPAI_AIM_List[i]->_aim)->name, name) == 0 || strcmp(MPAI_AIM_List[i]->_aim_name, name) == 0)
+		// verify aim name (the AIM could be not created yet)
+		if (strcmp(MPAI_AIM_List[i]->_aim_name, name) == 0 || (MPAI_AIM_List[i]->_aim != NULL && strcmp(MPAI_AIM_Get_Component(MPAI_AIM_List[i]->_aim)->name, name) == 0))
 		{
 			return MPAI_AIM_List[i];
 		}
@@ -376,6 +575,28 @@ aim_initialization_cb_t *MPAI_Controller_Find_AIM_Init_Config(const char *name)
 	return NULL;
 }
 
+int _linear_search_aim_index(const char *name)
+{
+	for (size_t i = 0; i < mpai_controller_aim_count; i++)
+	{
+		if (strcmp(MPAI_AIM_List[i]->_aim_name, name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int _aiw_init(const char *name)
+{
+	// At the moment, we handle only AIW IOT-REV
+	if (strcmp(name, MPAI_LIBS_IOT_REV_AIW_NAME) == 0)
+	{
+		return MPAI_AIW_IOT_REV_Init();
+	}
+	return -1;
+}
+
 channel_map_element_t _linear_search_channel(const char *name)
 {
 	for (size_t i = 0; i < mpai_message_store_channel_count; i++)
@@ -403,40 +624,538 @@ message_store_map_element_t _linear_search_message_store(int aiw_id)
 	return empty;
 }
 
-bool _start_aim_after_parsing_callback(const char * aim_name)
+#if defined(CONFIG_MPAI_CONFIG_STORE)
+bool _require_aim_after_parsing_callback(const char * aim_name)
 {
-	aim_initialization_cb_t *aim_init_cb = MPAI_Controller_Find_AIM_Init_Config(aim_name);
-	if (aim_init_cb != NULL)
+	int aim_idx = _linear_search_aim_index(aim_name);
+	if (aim_idx < 0)
 	{
-		LOG_INF("AIM %s found, now initializing...", log_strdup(aim_name));
-		char *aim_result = MPAI_Config_Store_Get_AIM(aim_name);
-		bool aim_parse_ok = MPAI_Metadata_Parser_Parse_AIM_JSON(aim_result);
-		if (aim_parse_ok)
+		LOG_ERR("AIM %s not found", log_strdup(aim_name));
+		return false;
+	}
+	boot_pipeline._aim_required[aim_idx] = true;
+	return true;
+}
+
+size_t _boot_pipeline_next_requests(boot_pipeline_t *pipeline, mpai_config_store_request_t *requests)
+{
+	size_t count = 0;
+
+	if (pipeline->_aif_name != NULL && !pipeline->_aif_requested)
+	{
+		pipeline->_aif_requested = true;
+		pipeline->_request_slots[count] = BOOT_PIPELINE_SLOT_AIF;
+		requests[count++] = (mpai_config_store_request_t){._type = MPAI_CONFIG_STORE_AIF, ._name = pipeline->_aif_name};
+	}
+	if (!pipeline->_aiw_requested)
+	{
+		pipeline->_aiw_requested = true;
+		pipeline->_request_slots[count] = BOOT_PIPELINE_SLOT_AIW;
+		requests[count++] = (mpai_config_store_request_t){._type = MPAI_CONFIG_STORE_AIW, ._name = pipeline->_aiw_name, ._block_callback = _boot_pipeline_aiw_block_callback};
+	}
+	// AIMs known by the AIW implementation are requested before parsing the AIW, if there are free slots:
+	// the others are requested in the next rounds, only if required by the AIW
+	for (size_t i = 0; i < mpai_controller_aim_count && count < MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS; i++)
+	{
+		if (!pipeline->_aim_requested[i] && (!pipeline->_aiw_parsed || pipeline->_aim_required[i]))
 		{
-			LOG_DBG("Calling AIM %s: success", log_strdup(aim_name));
+			pipeline->_aim_requested[i] = true;
+			pipeline->_request_slots[count] = i;
+			requests[count++] = (mpai_config_store_request_t){._type = MPAI_CONFIG_STORE_AIM, ._name = MPAI_AIM_List[i]->_aim_name};
+		}
+	}
+	return count;
+}
+
+void _boot_pipeline_config_callback(size_t idx, char* result, void* user_data)
+{
+	boot_pipeline_t *pipeline = (boot_pipeline_t *)user_data;
+	int slot = pipeline->_request_slots[idx];
+
+	MPAI_BOOT_TRACE_END(pipeline->_request_traces[idx]);
 
-			// start AIM according with the aim_init configuration
-			mpai_error_t err_aim = MPAI_Controller_Start_Loading_AIM_From_Init_Config(aiw_id, aim_init_cb);
-			if (err_aim.code == MPAI_AIF_OK)
+	if (slot == BOOT_PIPELINE_SLOT_AIF)
+	{
+		pipeline->_aif_received = true;
+		pipeline->_aif_result = result;
+		pipeline->_aif_version = MPAI_Boot_Image_Config_Version(result);
+	}
+	else if (slot == BOOT_PIPELINE_SLOT_AIW)
+	{
+		// AIW is streamed, so the result is always NULL
+		pipeline->_aiw_received = true;
+	}
+	else
+	{
+		pipeline->_aim_received[slot] = true;
+		pipeline->_aim_results[slot] = result;
+		pipeline->_aim_versions[slot] = MPAI_Boot_Image_Config_Version(result);
+	}
+
+	_boot_pipeline_advance(pipeline);
+}
+
+int _boot_pipeline_aiw_block_callback(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data)
+{
+	boot_pipeline_t *pipeline = (boot_pipeline_t *)user_data;
+
+	// MPAI Config Store could ignore the Accept option: the encoding is the one declared in the reply
+	if (pipeline->_aiw_len == 0 && content_format == MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR)
+	{
+		MPAI_Metadata_Parser_AIW_Stream_Set_Format(&pipeline->_aiw_stream, MPAI_METADATA_FORMAT_CBOR);
+	}
+	pipeline->_aiw_len += len;
+	if (last)
+	{
+		LOG_INF("AIW %s received: %zu bytes of %s", log_strdup(pipeline->_aiw_name), pipeline->_aiw_len,
+			content_format == MPAI_CONFIG_STORE_CONTENT_FORMAT_CBOR ? "CBOR" : "JSON");
+	}
+
+	pipeline->_aiw_version = MPAI_Boot_Image_Update_Config_Version(pipeline->_aiw_version, block, len);
+	if (!MPAI_Metadata_Parser_AIW_Stream_Feed(&pipeline->_aiw_stream, (const char *)block, len))
+	{
+		return -EINVAL;
+	}
+	if (last)
+	{
+		pipeline->_aiw_stream_ok = MPAI_Metadata_Parser_AIW_Stream_End(&pipeline->_aiw_stream);
+		if (!pipeline->_aiw_stream_ok)
+		{
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+void _boot_pipeline_advance(boot_pipeline_t *pipeline)
+{
+	if (pipeline->_failed)
+	{
+		return;
+	}
+
+	// 1. AIF has to be valid before starting anything
+	if (!pipeline->_aif_ok)
+	{
+		if (!pipeline->_aif_received)
+		{
+			return;
+		}
+		int trace_aif = MPAI_BOOT_TRACE_BEGIN("Parse AIF", pipeline->_aif_name);
+		pipeline->_aif_ok = MPAI_Metadata_Parser_Parse_AIF_JSON(pipeline->_aif_result);
+		MPAI_BOOT_TRACE_END(trace_aif);
+		k_free(pipeline->_aif_result);
+		pipeline->_aif_result = NULL;
+		if (!pipeline->_aif_ok)
+		{
+			LOG_ERR("Error parsing AIF %s", log_strdup(pipeline->_aif_name));
+			pipeline->_failed = true;
+			return;
+		}
+	}
+
+	// 2. AIW topology is needed to know the AIMs required and their input channels
+	if (!pipeline->_aiw_parsed)
+	{
+		if (!pipeline->_aiw_received)
+		{
+			return;
+		}
+		// AIW has been already parsed while it was received
+		pipeline->_aiw_parsed = true;
+		if (!pipeline->_aiw_stream_ok)
+		{
+			LOG_ERR("Error parsing AIW %s", log_strdup(pipeline->_aiw_name));
+			pipeline->_failed = true;
+			return;
+		}
+	}
+
+	// 3. start every AIM required whose configuration is arrived
+	for (size_t i = 0; i < mpai_controller_aim_count; i++)
+	{
+		if (!pipeline->_aim_required[i] || !pipeline->_aim_received[i] || pipeline->_aim_started[i])
+		{
+			continue;
+		}
+		pipeline->_aim_started[i] = true;
+
+		aim_initialization_cb_t *aim_init_cb = MPAI_AIM_List[i];
+		LOG_INF("AIM %s found, now initializing...", log_strdup(aim_init_cb->_aim_name));
+		int trace_aim = MPAI_BOOT_TRACE_BEGIN("Start AIM", aim_init_cb->_aim_name);
+		bool aim_parse_ok = MPAI_Metadata_Parser_Parse_AIM_JSON(pipeline->_aim_results[i]);
+		k_free(pipeline->_aim_results[i]);
+		pipeline->_aim_results[i] = NULL;
+		if (!aim_parse_ok)
+		{
+			MPAI_BOOT_TRACE_END(trace_aim);
+			LOG_ERR("Error parsing AIM %s", log_strdup(aim_init_cb->_aim_name));
+			pipeline->_failed = true;
+			return;
+		}
+
+		LOG_DBG("Calling AIM %s: success", log_strdup(aim_init_cb->_aim_name));
+
+		// start AIM according with the aim_init configuration
+		mpai_error_t err_aim = MPAI_Controller_Start_Loading_AIM_From_Init_Config(pipeline->_aiw_id, aim_init_cb);
+		MPAI_BOOT_TRACE_END(trace_aim);
+		if (err_aim.code != MPAI_AIF_OK)
+		{
+			LOG_ERR("Stop initialization");
+			pipeline->_failed = true;
+			return;
+		}
+	}
+}
+#endif
+
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+bool _boot_image_save(boot_pipeline_t *pipeline)
+{
+	// configurations are added to the version always in the same order, whatever the order they arrived
+	uint32_t store_version = 0;
+	if (pipeline->_aif_name != NULL)
+	{
+		store_version = MPAI_Boot_Image_Update_Store_Version(store_version, pipeline->_aif_version);
+	}
+	store_version = MPAI_Boot_Image_Update_Store_Version(store_version, pipeline->_aiw_version);
+
+	MPAI_Boot_Image_Init(&boot_image, pipeline->_aif_name, pipeline->_aiw_name, store_version);
+
+	// channel map
+	for (size_t i = 0; i < mpai_message_store_channel_count; i++)
+	{
+		MPAI_Boot_Image_Add_Channel(&boot_image, message_store_channel_list[i]._channel_name, message_store_channel_list[i]._channel);
+	}
+
+	// AIM records, with routing
+	for (size_t i = 0; i < mpai_controller_aim_count; i++)
+	{
+		if (!pipeline->_aim_started[i])
+		{
+			continue;
+		}
+		boot_image._store_version = MPAI_Boot_Image_Update_Store_Version(boot_image._store_version, pipeline->_aim_versions[i]);
+
+		aim_initialization_cb_t *aim_init_cb = MPAI_AIM_List[i];
+		mpai_boot_image_aim_t *aim_el = MPAI_Boot_Image_Add_AIM(&boot_image, aim_init_cb->_aim_name);
+		if (aim_el == NULL)
+		{
+			LOG_ERR("Boot image not saved: too many AIMs");
+			return false;
+		}
+		for (size_t c = 0; c < aim_init_cb->_count_channels; c++)
+		{
+			int channel_idx = -1;
+			for (size_t m = 0; m < boot_image._channel_count; m++)
 			{
-				return true;
+				if (boot_image._channels[m]._channel == aim_init_cb->_input_channels[c])
+				{
+					channel_idx = m;
+					break;
+				}
 			}
-			else
+			if (channel_idx < 0 || aim_el->_count_channels >= MPAI_AIF_CHANNEL_MAX)
 			{
-				LOG_ERR("Stop initialization");
-				while (1)
-				{
-				};
+				LOG_ERR("Boot image not saved: channel %d of AIM %s not in the channel map", aim_init_cb->_input_channels[c], log_strdup(aim_init_cb->_aim_name));
+				return false;
 			}
+			aim_el->_input_channels[aim_el->_count_channels++] = channel_idx;
 		}
-		k_free(aim_result);
+		aim_el->_parameters_len = MPAI_AIM_Parameters_Encode(aim_init_cb->_aim_name, aim_el->_parameters, MPAI_BOOT_IMAGE_PARAMETERS_LEN);
+	}
+
+	return MPAI_Boot_Image_Save(&boot_image);
+}
+
+bool _boot_image_validate(const mpai_boot_image_t *image)
+{
+	// channels are created by the AIW implementation: they have to be the same of the image
+	for (size_t i = 0; i < image->_channel_count; i++)
+	{
+		channel_map_element_t channel_map_element = _linear_search_channel(image->_channels[i]._channel_name);
+		if (channel_map_element._channel_name == NULL || channel_map_element._channel != image->_channels[i]._channel)
+		{
+			LOG_WRN("Boot image not valid: channel %s changed", log_strdup(image->_channels[i]._channel_name));
+			return false;
+		}
+	}
+	for (size_t i = 0; i < image->_aim_count; i++)
+	{
+		const mpai_boot_image_aim_t *aim_el = &image->_aims[i];
+		if (_linear_search_aim_index(aim_el->_aim_name) < 0)
+		{
+			LOG_WRN("Boot image not valid: AIM %s not found", log_strdup(aim_el->_aim_name));
+			return false;
+		}
+		if (aim_el->_count_channels > MPAI_AIF_CHANNEL_MAX)
+		{
+			LOG_WRN("Boot image not valid: too many channels for AIM %s", log_strdup(aim_el->_aim_name));
+			return false;
+		}
+		for (size_t c = 0; c < aim_el->_count_channels; c++)
+		{
+			if (aim_el->_input_channels[c] >= image->_channel_count)
+			{
+				LOG_WRN("Boot image not valid: unknown channel for AIM %s", log_strdup(aim_el->_aim_name));
+				return false;
+			}
+		}
+		if (aim_el->_parameters_len > MPAI_BOOT_IMAGE_PARAMETERS_LEN)
+		{
+			LOG_WRN("Boot image not valid: too many parameters for AIM %s", log_strdup(aim_el->_aim_name));
+			return false;
+		}
+	}
+	return true;
+}
+
+mpai_error_t _boot_image_start(const mpai_boot_image_t *image, int aiw_id)
+{
+	for (size_t i = 0; i < image->_aim_count; i++)
+	{
+		const mpai_boot_image_aim_t *aim_el = &image->_aims[i];
+		aim_initialization_cb_t *aim_init_cb = MPAI_AIM_List[_linear_search_aim_index(aim_el->_aim_name)];
+
+		LOG_INF("AIM %s found in boot image, now initializing...", log_strdup(aim_init_cb->_aim_name));
+		int trace_aim = MPAI_BOOT_TRACE_BEGIN("Start AIM", aim_init_cb->_aim_name);
+
+		// routing
+		if (aim_el->_count_channels > 0)
+		{
+			k_free(aim_init_cb->_input_channels);
+			aim_init_cb->_input_channels = (subscriber_channel_t *)k_malloc(aim_el->_count_channels * sizeof(subscriber_channel_t));
+			for (size_t c = 0; c < aim_el->_count_channels; c++)
+			{
+				aim_init_cb->_input_channels[c] = image->_channels[aim_el->_input_channels[c]]._channel;
+			}
+			aim_init_cb->_count_channels = aim_el->_count_channels;
+		}
+
+		// parameters changed by MPAI Store before saving the image
+		MPAI_AIM_Parameters_Decode(aim_init_cb->_aim_name, aim_el->_parameters, aim_el->_parameters_len);
+
+		mpai_error_t err_aim = MPAI_Controller_Start_Loading_AIM_From_Init_Config(aiw_id, aim_init_cb);
+		MPAI_BOOT_TRACE_END(trace_aim);
+		if (err_aim.code != MPAI_AIF_OK)
+		{
+			LOG_ERR("Stop initialization");
+			return err_aim;
+		}
+	}
+
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return err;
+}
+
+void _boot_image_verify(const mpai_boot_image_t *image)
+{
+	mpai_config_store_request_t requests[2 + MPAI_AIF_AIM_MAX];
+	uint32_t versions[2 + MPAI_AIF_AIM_MAX] = {};
+	size_t count = 0;
+
+	// same order used to compute the version saving the image: copies in cache are used only if still valid
+	if (image->_aif_name[0] != '\0')
+	{
+		requests[count++] = (mpai_config_store_request_t){._type = MPAI_CONFIG_STORE_AIF, ._name = image->_aif_name, ._cache_policy = MPAI_CONFIG_STORE_CACHE_REVALIDATE};
+	}
+	requests[count++] = (mpai_config_store_request_t){._type = MPAI_CONFIG_STORE_AIW, ._name = image->_aiw_name, ._block_callback = _boot_image_verify_block_callback, ._cache_policy = MPAI_CONFIG_STORE_CACHE_REVALIDATE};
+	for (size_t i = 0; i < image->_aim_count; i++)
+	{
+		requests[count++] = (mpai_config_store_request_t){._type = MPAI_CONFIG_STORE_AIM, ._name = image->_aims[i]._aim_name, ._cache_policy = MPAI_CONFIG_STORE_CACHE_REVALIDATE};
+	}
+
+	for (size_t base = 0; base < count; base += MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS)
+	{
+		size_t round_count = MIN(count - base, MPAI_CONFIG_STORE_MAX_CONCURRENT_REQUESTS);
+		int r = MPAI_Config_Store_Get_Concurrent(&requests[base], round_count, _boot_image_verify_callback, &versions[base]);
+		if (r != 0)
+		{
+			// MPAI Store not reachable: the image is kept
+			LOG_WRN("Unable to verify boot image with MPAI Store: %d", r);
+			return;
+		}
+	}
+
+	uint32_t store_version = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		store_version = MPAI_Boot_Image_Update_Store_Version(store_version, versions[i]);
+	}
+	if (store_version != image->_store_version)
+	{
+		LOG_WRN("Configurations changed on MPAI Store: boot image invalidated, it will be rebuilt at next boot");
+		MPAI_Boot_Image_Invalidate();
+		boot_image_valid = false;
 	}
 	else
 	{
-		LOG_ERR("AIM %s not found", log_strdup(aim_name));
+		LOG_INF("Boot image is up to date with MPAI Store");
+	}
+}
+
+void _boot_image_verify_callback(size_t idx, char* result, void* user_data)
+{
+	uint32_t *versions = (uint32_t *)user_data;
+	// streamed configurations have their version computed block by block
+	if (result != NULL)
+	{
+		versions[idx] = MPAI_Boot_Image_Config_Version(result);
+		k_free(result);
+	}
+}
+
+int _boot_image_verify_block_callback(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data)
+{
+	uint32_t *versions = (uint32_t *)user_data;
+	versions[idx] = MPAI_Boot_Image_Update_Config_Version(versions[idx], block, len);
+	return 0;
+}
+
+void _boot_image_update_parameters(const char* aim_name)
+{
+	if (!boot_image_valid)
+	{
+		return;
+	}
+	for (size_t i = 0; i < boot_image._aim_count; i++)
+	{
+		mpai_boot_image_aim_t *aim_el = &boot_image._aims[i];
+		if (strncmp(aim_el->_aim_name, aim_name, MPAI_BOOT_IMAGE_NAME_LEN - 1) == 0)
+		{
+			aim_el->_parameters_len = MPAI_AIM_Parameters_Encode(aim_name, aim_el->_parameters, MPAI_BOOT_IMAGE_PARAMETERS_LEN);
+			boot_image_valid = MPAI_Boot_Image_Save(&boot_image);
+			return;
+		}
+	}
+}
+#endif
+
+#ifdef CONFIG_MPAI_CONFIG_STORE_OBSERVE
+void _config_observer_start(const char* aiw_name)
+{
+	// started once: the resources observed are the same until the reboot
+	if (config_observer_resource_count > 0)
+	{
+		return;
 	}
+
+	_config_observer_add(MPAI_CONFIG_STORE_AIW, aiw_name);
+	for (size_t i = 0; i < mpai_controller_aim_count; i++)
+	{
+		if (MPAI_AIM_List[i]->_aim == NULL)
+		{
+			continue;
+		}
+		_config_observer_add(MPAI_CONFIG_STORE_PARAMETERS, MPAI_AIM_List[i]->_aim_name);
+		_config_observer_add(MPAI_CONFIG_STORE_AIM, MPAI_AIM_List[i]->_aim_name);
+	}
+
+	k_thread_create(&config_observer_thread, config_observer_stack_area,
+										 K_THREAD_STACK_SIZEOF(config_observer_stack_area),
+										 th_config_observer, NULL, NULL, NULL,
+										 CONFIG_OBSERVER_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&config_observer_thread, "thread_config_observer");
 }
 
+void _config_observer_add(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name)
+{
+	if (config_observer_resource_count >= CONFIG_MPAI_CONFIG_STORE_OBSERVE_MAX)
+	{
+		LOG_WRN("Too many resources observed: %s ignored", log_strdup(name));
+		return;
+	}
+	config_observer_resource_t *resource = &config_observer_resources[config_observer_resource_count];
+	resource->_type = type;
+	resource->_name = name;
+	resource->_notified = false;
+	resource->_version = 0;
+	// if the registration is lost, it's sent again by the config observer thread
+	if (MPAI_Config_Store_Observe(type, name, _config_observer_notification_callback, resource) >= 0)
+	{
+		config_observer_resource_count++;
+	}
+}
+
+void _config_observer_notification_callback(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* name, const uint8_t* document, size_t len, int content_format, void* user_data)
+{
+	config_observer_notification_t *notification = (config_observer_notification_t *)k_malloc(sizeof(config_observer_notification_t) + len);
+	if (notification == NULL)
+	{
+		LOG_ERR("Not enough memory for the notification of %s", log_strdup(name));
+		return;
+	}
+	notification->_resource = (config_observer_resource_t *)user_data;
+	notification->_content_format = content_format;
+	notification->_len = len;
+	memcpy(notification->_document, document, len);
+	k_fifo_put(&config_observer_fifo, notification);
+}
+
+void _config_observer_process(config_observer_notification_t* notification)
+{
+	config_observer_resource_t *resource = notification->_resource;
+
+	if (resource->_type == MPAI_CONFIG_STORE_PARAMETERS)
+	{
+		// every notification has all the values: the ones not changed are ignored
+		int changed = MPAI_AIM_Parameters_Apply(resource->_name, notification->_document, notification->_len, notification->_content_format);
+		if (changed > 0)
+		{
+			LOG_INF("%d parameters of AIM %s changed by MPAI Store", changed, log_strdup(resource->_name));
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+			_boot_image_update_parameters(resource->_name);
+#endif
+		}
+		return;
+	}
+
+	// AIW/AIM configurations: the first notification (and the ones after a new registration) is the content already known
+	uint32_t version = crc32_ieee(notification->_document, notification->_len);
+	if (resource->_notified && version != resource->_version)
+	{
+		LOG_WRN("Configuration of %s changed on MPAI Store: it will be applied at next start of the AIW", log_strdup(resource->_name));
+#ifdef CONFIG_MPAI_BOOT_IMAGE
+		if (boot_image_valid)
+		{
+			MPAI_Boot_Image_Invalidate();
+			boot_image_valid = false;
+		}
+#endif
+	}
+	resource->_notified = true;
+	resource->_version = version;
+}
+
+void th_config_observer(void *dummy1, void *dummy2, void *dummy3)
+{
+	ARG_UNUSED(dummy1);
+	ARG_UNUSED(dummy2);
+	ARG_UNUSED(dummy3);
+
+	int64_t next_refresh = k_uptime_get() + CONFIG_MPAI_CONFIG_STORE_OBSERVE_REFRESH_MS;
+	while (1)
+	{
+		config_observer_notification_t *notification = k_fifo_get(&config_observer_fifo, K_MSEC(MAX(next_refresh - k_uptime_get(), 0)));
+		if (notification != NULL)
+		{
+			_config_observer_process(notification);
+			k_free(notification);
+		}
+		if (k_uptime_get() >= next_refresh)
+		{
+			// observations not confirmed or not fresh: MPAI Store could have restarted, forgetting them
+			int refreshed = MPAI_Config_Store_Observe_Refresh();
+			if (refreshed > 0)
+			{
+				LOG_INF("%d observations registered again on MPAI Store", refreshed);
+			}
+			next_refresh = k_uptime_get() + CONFIG_MPAI_CONFIG_STORE_OBSERVE_REFRESH_MS;
+		}
+	}
+}
+#endif
+
 void _update_input_channels_after_parsing_callback(const char * aim_name, const char* output_port_name)
 {
 	// search channel in config
@@ -445,16 +1164,32 @@ void _update_input_channels_after_parsing_callback(const char * aim_name, const
 	{
 		// search aim_init to add the input ports
 		aim_initialization_cb_t *aim_init_cb = MPAI_Controller_Find_AIM_Init_Config(aim_name);
-		if (aim_init_cb->_input_channels == NULL || sizeof(aim_init_cb->_input_channels) == 0)
+		if (aim_init_cb == NULL)
+		{
+			// AIM not implemented: it can't be required by the AIW, so its inputs are not needed
+			LOG_WRN("AIM %s of topology not found: output %s ignored", log_strdup(aim_name), log_strdup(output_port_name));
+			return;
+		}
+		if (aim_init_cb->_input_channels == NULL || aim_init_cb->_count_channels == 0)
 		{
 			aim_init_cb->_input_channels = (subscriber_channel_t *)k_malloc(sizeof(subscriber_channel_t));
+			if (aim_init_cb->_input_channels == NULL)
+			{
+				LOG_ERR("Not enough memory for input channels of AIM %s", log_strdup(aim_name));
+				return;
+			}
 			aim_init_cb->_input_channels[0] = channel_map_element._channel;
-			aim_init_cb->_count_channels++;
+			aim_init_cb->_count_channels = 1;
 		}
 		else
 		{
 			int8_t old_size = aim_init_cb->_count_channels;
 			subscriber_channel_t *channel_list_tmp = (subscriber_channel_t *)k_malloc((old_size + 1) * sizeof(subscriber_channel_t));
+			if (channel_list_tmp == NULL)
+			{
+				LOG_ERR("Not enough memory for input channels of AIM %s", log_strdup(aim_name));
+				return;
+			}
 			memcpy(channel_list_tmp, aim_init_cb->_input_channels, old_size * sizeof(subscriber_channel_t));
 			channel_list_tmp[old_size] = channel_map_element._channel;
 			k_free(aim_init_cb->_input_channels);
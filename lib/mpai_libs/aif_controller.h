@@ -104,7 +104,7 @@ mpai_error_t MPAI_AIFU_Controller_Destroy();
  * 
  * @param name name of the AIW
  * @param AIW_ID AIW_ID generated
- * @return error_t 
+ * @return error_t MPAI_AIW_ALREADY_STARTED if the AIW is already initialized
  */
 mpai_error_t MPAI_AIFU_AIW_Start(const char* name, int* AIW_ID);
 
@@ -192,6 +192,18 @@ mpai_error_t MPAI_Controller_Start_Loading_AIM_From_Init_Config(int aiw_id, aim_
  * @return mpai_error_t 
  */
 mpai_error_t MPAI_Controller_Start_Loading_AIW_From_MPAI_Store(const char *name, int aiw_id);
+
+/**
+ * @brief Start an AIW, loading AIF, AIW and AIM configurations concurrently from MPAI Store:
+ * each configuration is parsed as soon as it arrives and each AIM is started when the AIF is valid,
+ * the AIW topology is known and its own configuration is arrived
+ * 
+ * @param aif_name name of the AIF to validate before starting the AIMs (NULL to skip it)
+ * @param aiw_name name of the AIW
+ * @param aiw_id 
+ * @return mpai_error_t 
+ */
+mpai_error_t MPAI_Controller_Start_Loading_AIF_AIW_From_MPAI_Store(const char *aif_name, const char *aiw_name, int aiw_id);
 #endif
 
 /**
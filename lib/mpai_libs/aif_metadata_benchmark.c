@@ -0,0 +1,304 @@
+/*
+ * @file
+ * @brief Implementation of the benchmark of the metadata parser
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_metadata_benchmark.h"
+
+#ifdef CONFIG_MPAI_METADATA_PARSER_BENCHMARK
+
+LOG_MODULE_REGISTER(MPAI_LIBS_AIF_METADATA_BENCHMARK, LOG_LEVEL_INF);
+
+/* Size of the chunks of the synthetic AIW, as CoAP blocks */
+#define BENCHMARK_CHUNK_LEN 64
+
+/* Results of a parsing */
+typedef struct _benchmark_result_t {
+	bool _ok;
+	uint64_t _cycles;
+	mpai_metadata_parser_stats_t _stats;
+} benchmark_result_t;
+
+/* Elements extracted from an AIW by the callbacks */
+static size_t benchmark_aims_found;
+static size_t benchmark_topology_found;
+/* State of the pseudo-random generator of mutations */
+static uint32_t benchmark_random_state;
+/* Synthetic AIW is too big to be parsed in the arena */
+static mpai_metadata_aiw_stream_t benchmark_aiw_stream;
+
+/************* PRIVATE HEADER *************/
+/* parse a document of the corpus with the related parser */
+benchmark_result_t _benchmark_parse(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* document);
+/* measure the parsing of a document of the corpus */
+bool _benchmark_document(const mpai_metadata_corpus_document_t* document);
+/* measure the parsing of an AIW with many AIMs and ports, generated while it's parsed: it has to be rejected
+   if its topology has more outputs than MPAI_METADATA_AIW_TOPOLOGY_MAX */
+bool _benchmark_synthetic_aiw(size_t aim_count, size_t topology_count);
+/* parse mutations of a document of the corpus, returning false if any of them exhausted the arena */
+bool _benchmark_mutations(const mpai_metadata_corpus_document_t* document, size_t count);
+/* apply a random mutation to a document, returning its new length */
+size_t _benchmark_mutate(char* document, size_t len);
+/* feed a formatted chunk to the synthetic AIW, counting the bytes */
+bool _benchmark_feed(size_t* bytes, const char* fmt, ...);
+/* AIM callback counting the AIMs */
+bool _benchmark_aim_callback(const char* aim_name);
+/* topology callback counting the outputs */
+void _benchmark_topology_callback(const char* aim_name, const char* port_name);
+/* xorshift32 */
+uint32_t _benchmark_random();
+
+/************* PUBLIC **************/
+bool MPAI_Metadata_Parser_Benchmark()
+{
+	bool ok = true;
+
+	LOG_INF("Metadata parser benchmark: %zu documents, %d iterations, %d mutations each",
+		MPAI_METADATA_CORPUS_COUNT, CONFIG_MPAI_METADATA_PARSER_BENCHMARK_ITERATIONS, CONFIG_MPAI_METADATA_PARSER_BENCHMARK_MUTATIONS);
+
+	for (size_t i = 0; i < MPAI_METADATA_CORPUS_COUNT; i++)
+	{
+		ok = _benchmark_document(&MPAI_METADATA_CORPUS[i]) && ok;
+	}
+
+	ok = _benchmark_synthetic_aiw(CONFIG_MPAI_METADATA_PARSER_BENCHMARK_AIMS,
+		MIN(CONFIG_MPAI_METADATA_PARSER_BENCHMARK_AIMS, MPAI_METADATA_AIW_TOPOLOGY_MAX)) && ok;
+	ok = _benchmark_synthetic_aiw(CONFIG_MPAI_METADATA_PARSER_BENCHMARK_AIMS, CONFIG_MPAI_METADATA_PARSER_BENCHMARK_AIMS) && ok;
+
+	benchmark_random_state = CONFIG_MPAI_METADATA_PARSER_BENCHMARK_SEED;
+	for (size_t i = 0; i < MPAI_METADATA_CORPUS_COUNT; i++)
+	{
+		ok = _benchmark_mutations(&MPAI_METADATA_CORPUS[i], CONFIG_MPAI_METADATA_PARSER_BENCHMARK_MUTATIONS) && ok;
+	}
+
+#ifdef CONFIG_THREAD_STACK_INFO
+	size_t unused_stack = 0;
+	if (k_thread_stack_space_get(k_current_get(), &unused_stack) == 0)
+	{
+		LOG_INF("Metadata parser benchmark: %zu bytes of stack never used", unused_stack);
+	}
+#endif
+
+	LOG_INF("Metadata parser benchmark %s", ok ? "passed" : "FAILED");
+	return ok;
+}
+
+/************* PRIVATE **************/
+benchmark_result_t _benchmark_parse(MPAI_CONFIG_STORE_RESOURCE_TYPE type, const char* document)
+{
+	benchmark_result_t result = {};
+	uint32_t start = k_cycle_get_32();
+
+	switch (type)
+	{
+	case MPAI_CONFIG_STORE_AIF:
+		result._ok = MPAI_Metadata_Parser_Parse_AIF_JSON(document);
+		break;
+	case MPAI_CONFIG_STORE_AIW:
+		result._ok = MPAI_Metadata_Parser_Parse_AIW_JSON(document, -1, _benchmark_aim_callback, _benchmark_topology_callback);
+		break;
+	case MPAI_CONFIG_STORE_AIM:
+		result._ok = MPAI_Metadata_Parser_Parse_AIM_JSON(document);
+		break;
+	default:
+		break;
+	}
+
+	result._cycles = k_cycle_get_32() - start;
+	MPAI_Metadata_Parser_Get_Last_Stats(&result._stats);
+	return result;
+}
+
+bool _benchmark_document(const mpai_metadata_corpus_document_t* document)
+{
+	uint64_t cycles = 0;
+	benchmark_result_t result = {};
+
+	for (size_t i = 0; i < CONFIG_MPAI_METADATA_PARSER_BENCHMARK_ITERATIONS; i++)
+	{
+		result = _benchmark_parse(document->_type, document->_document);
+		cycles += result._cycles;
+		if (!result._ok)
+		{
+			break;
+		}
+	}
+
+	LOG_INF("%s: %s, %zu bytes, %u us, peak %zu bytes, %zu allocations", document->_name, result._ok ? "ok" : "FAILED",
+		strlen(document->_document), (uint32_t)k_cyc_to_us_floor64(cycles / CONFIG_MPAI_METADATA_PARSER_BENCHMARK_ITERATIONS),
+		result._stats._peak_bytes, result._stats._allocations);
+	return result._ok;
+}
+
+bool _benchmark_synthetic_aiw(size_t aim_count, size_t topology_count)
+{
+	mpai_metadata_aiw_stream_t* stream = &benchmark_aiw_stream;
+	bool expected = topology_count <= MPAI_METADATA_AIW_TOPOLOGY_MAX;
+	size_t bytes = 0;
+	bool parsed = true;
+
+	benchmark_aims_found = 0;
+	benchmark_topology_found = 0;
+	uint32_t start = k_cycle_get_32();
+
+	MPAI_Metadata_Parser_AIW_Stream_Init(stream, -1, _benchmark_aim_callback, _benchmark_topology_callback);
+	parsed = parsed && _benchmark_feed(&bytes, "{\"title\":\"Synthetic AIW\",\"Identifier\":{\"ImplementerID\":1,\"Specification\":"
+		"{\"Standard\":\"MPAI-IOT\",\"AIW\":\"SYN\",\"AIM\":\"SYN\",\"Version\":\"1\"}},\"APIProfile\":\"Main\",\"Ports\":[");
+	for (size_t i = 0; parsed && i < aim_count; i++)
+	{
+		parsed = _benchmark_feed(&bytes, "%s{\"Name\":\"Port%03zu\",\"Direction\":\"InputOutput\",\"RecordType\":\"Data_t\","
+			"\"Technology\":\"Software\",\"Protocol\":\"\",\"IsRemote\":false}", i > 0 ? "," : "", i);
+	}
+	// AIMs come before the topology, so they are all parsed also when the topology is rejected
+	parsed = parsed && _benchmark_feed(&bytes, "],\"SubAIMs\":[");
+	for (size_t i = 0; parsed && i < aim_count; i++)
+	{
+		parsed = _benchmark_feed(&bytes, "%s{\"Name\":\"AIM%03zu\",\"Identifier\":{\"ImplementerID\":1,\"Specification\":"
+			"{\"Standard\":\"MPAI-IOT\",\"AIW\":\"SYN\",\"AIM\":\"AIM%03zu\",\"Version\":\"1\"}}}", i > 0 ? "," : "", i, i);
+	}
+	parsed = parsed && _benchmark_feed(&bytes, "],\"Topology\":[");
+	for (size_t i = 0; parsed && i < topology_count; i++)
+	{
+		parsed = _benchmark_feed(&bytes, "%s{\"Output\":{\"AIMName\":\"AIM%03zu\",\"PortName\":\"Port%03zu\"},"
+			"\"Input\":{\"AIMName\":\"AIM%03zu\",\"PortName\":\"Port%03zu\"}}", i > 0 ? "," : "", i, i, (i + 1) % aim_count, i);
+	}
+	parsed = parsed && _benchmark_feed(&bytes, "]}");
+	parsed = MPAI_Metadata_Parser_AIW_Stream_End(stream) && parsed;
+
+	uint32_t cycles = k_cycle_get_32() - start;
+	// the topology is notified only when the whole AIW is valid
+	bool ok = parsed == expected && benchmark_aims_found == aim_count && benchmark_topology_found == (parsed ? topology_count : 0);
+
+	LOG_INF("Synthetic AIW (%zu AIMs and ports, %zu topology outputs, max %d): %s %s, %zu bytes, %u us, %zu bytes of parser state",
+		aim_count, topology_count, MPAI_METADATA_AIW_TOPOLOGY_MAX, parsed ? "accepted" : "rejected", ok ? "as expected" : "FAILED",
+		bytes, (uint32_t)k_cyc_to_us_floor64(cycles), sizeof(mpai_metadata_aiw_stream_t));
+	return ok;
+}
+
+bool _benchmark_mutations(const mpai_metadata_corpus_document_t* document, size_t count)
+{
+	size_t len = strlen(document->_document);
+	size_t accepted = 0;
+	size_t exhausted = 0;
+
+	char* mutated = (char *)k_malloc(len + MPAI_METADATA_BENCHMARK_MUTATION_SPAN + 1);
+	if (mutated == NULL)
+	{
+		LOG_ERR("%s: not enough memory to mutate", document->_name);
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		memcpy(mutated, document->_document, len + 1);
+		size_t mutated_len = _benchmark_mutate(mutated, len);
+		mutated[mutated_len] = '\0';
+
+		benchmark_result_t result = _benchmark_parse(document->_type, mutated);
+		accepted += result._ok ? 1 : 0;
+		exhausted += result._stats._exhausted ? 1 : 0;
+	}
+	k_free(mutated);
+
+	// a mutation could be still valid (i.e. a changed char in a description), but it must never crash
+	LOG_INF("%s: %zu mutations, %zu accepted, %zu rejected, %zu exhausted the arena", document->_name, count, accepted, count - accepted, exhausted);
+	return exhausted == 0;
+}
+
+size_t _benchmark_mutate(char* document, size_t len)
+{
+	static const char tokens[] = "{}[]:,\"\\-.0123456789eEtfnul \t";
+	size_t pos = _benchmark_random() % len;
+	size_t span = 1 + _benchmark_random() % MPAI_METADATA_BENCHMARK_MUTATION_SPAN;
+
+	switch (_benchmark_random() % 6)
+	{
+	case 0:
+		// flip a bit
+		document[pos] ^= 1 << (_benchmark_random() % 8);
+		return len;
+	case 1:
+		// replace a char with a JSON token
+		document[pos] = tokens[_benchmark_random() % (sizeof(tokens) - 1)];
+		return len;
+	case 2:
+		// truncate
+		return pos;
+	case 3:
+		// remove a span
+		span = MIN(span, len - pos);
+		memmove(&document[pos], &document[pos + span], len - pos - span);
+		return len - span;
+	case 4:
+		// duplicate a span
+		span = MIN(span, len - pos);
+		memmove(&document[pos + span], &document[pos], len - pos);
+		return len + span;
+	default:
+		// remove a quote or a bracket, breaking the structure
+		for (size_t i = pos; i < len; i++)
+		{
+			if (strchr("\"{}[]", document[i]) != NULL)
+			{
+				memmove(&document[i], &document[i + 1], len - i - 1);
+				return len - 1;
+			}
+		}
+		return len;
+	}
+}
+
+bool _benchmark_feed(size_t* bytes, const char* fmt, ...)
+{
+	char chunk[256];
+	va_list args;
+
+	va_start(args, fmt);
+	int len = vsnprintf(chunk, sizeof(chunk), fmt, args);
+	va_end(args);
+	if (len < 0 || len >= sizeof(chunk))
+	{
+		return false;
+	}
+
+	// fed in blocks, as received by CoAP
+	for (size_t i = 0; i < len; i += BENCHMARK_CHUNK_LEN)
+	{
+		if (!MPAI_Metadata_Parser_AIW_Stream_Feed(&benchmark_aiw_stream, &chunk[i], MIN(BENCHMARK_CHUNK_LEN, len - i)))
+		{
+			return false;
+		}
+	}
+	*bytes += len;
+	return true;
+}
+
+bool _benchmark_aim_callback(const char* aim_name)
+{
+	ARG_UNUSED(aim_name);
+	benchmark_aims_found++;
+	return true;
+}
+
+void _benchmark_topology_callback(const char* aim_name, const char* port_name)
+{
+	ARG_UNUSED(aim_name);
+	ARG_UNUSED(port_name);
+	benchmark_topology_found++;
+}
+
+uint32_t _benchmark_random()
+{
+	uint32_t x = benchmark_random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	benchmark_random_state = x;
+	return x;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * @file
+ * @brief Headers of the benchmark of the metadata parser: it measures time and memory parsing the documents
+ * in docs and synthetic AIWs with hundreds of AIMs and ports, then it checks that the parser rejects
+ * (without crashing) thousands of mutations of the same documents
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_AIF_METADATA_BENCHMARK_H
+#define MPAI_LIBS_AIF_METADATA_BENCHMARK_H
+
+#include <core_common.h>
+#include <config_store.h>
+#include <aif_metadata_parser.h>
+#include <stdarg.h>
+
+/* Max bytes added by a mutation of a document */
+#define MPAI_METADATA_BENCHMARK_MUTATION_SPAN 16
+
+/* Document of the corpus */
+typedef struct _mpai_metadata_corpus_document_t {
+	const char* _name;
+	MPAI_CONFIG_STORE_RESOURCE_TYPE _type;
+	const char* _document;
+} mpai_metadata_corpus_document_t;
+
+/* Documents in docs, generated by tools/gen_metadata_corpus.py */
+extern const mpai_metadata_corpus_document_t MPAI_METADATA_CORPUS[];
+extern const size_t MPAI_METADATA_CORPUS_COUNT;
+
+/**
+ * @brief Run the benchmark, printing the results to the log. It has to be called before
+ * initializing the AIF: AIW callbacks don't change AIMs and channels
+ *
+ * @return true if all the documents of the corpus are parsed and no mutation exhausted the parser arena
+ * @return false
+ */
+bool MPAI_Metadata_Parser_Benchmark();
+
+#endif
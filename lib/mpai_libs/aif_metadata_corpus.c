@@ -0,0 +1,367 @@
+/*
+ * @file
+ * @brief Corpus of the metadata parser benchmark: the documents in docs
+ *
+ * Generated by tools/gen_metadata_corpus.py: do not edit
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_metadata_benchmark.h"
+
+#ifdef CONFIG_MPAI_METADATA_PARSER_BENCHMARK
+const mpai_metadata_corpus_document_t MPAI_METADATA_CORPUS[] = {
+	{
+		._name = "mpai_aif.json",
+		._type = MPAI_CONFIG_STORE_AIF,
+		._document =
+		"{\n"
+		"  \"$schema\": \"https://json-schema.org/draft/2020-12/schema\",\n"
+		"  \"$id\": \"https://mpai.community/standards/resources/MPAI-AIF/V1/AIF-metadata.schema.json\",\n"
+		"  \"title\": \"MPAI-AIF V1 AIF metadata\",\n"
+		"  \"ImplementerID\": 1,\n"
+		"  \"Version\": \"v1.0\",\n"
+		"  \"APIProfile\": \"Main\",\n"
+		"  \"ResourcePolicies\": [\n"
+		"    {\n"
+		"      \"Name\": \"Memory\",\n"
+		"      \"Minimum\": \"50000\",\n"
+		"      \"Maximum\": \"120000\",\n"
+		"      \"Request\": \"80000\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"CPUNumber\",\n"
+		"      \"Minimum\": \"1\",\n"
+		"      \"Maximum\": \"2\",\n"
+		"      \"Request\": \"1\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"CPU:Class\",\n"
+		"      \"Minimum\": \"Low\",\n"
+		"      \"Maximum\": \"High\",\n"
+		"      \"Request\": \"Low\"\n"
+		"    }\n"
+		"  ],\n"
+		"  \"Authentication\": \"admin\",\n"
+		"  \"TimeBase\": \"NTP\"\n"
+		"}\n"
+	},
+	{
+		._name = "mpai_aim_ControlUnitSensorsReading.json",
+		._type = MPAI_CONFIG_STORE_AIM,
+		._document =
+		"{\n"
+		"  \"Identifier\": {\n"
+		"    \"ImplementerID\": 1,\n"
+		"    \"Specification\": {\n"
+		"      \"Name\": \"IOT\",\n"
+		"      \"AIW\": \"REV\",\n"
+		"      \"AIM\": \"ControlUnitSensorsReading\",\n"
+		"      \"Version\": \"1\"\n"
+		"    }\n"
+		"  },\n"
+		"  \"Description\": \"This AIM implements sensor readings from control unit.\",\n"
+		"  \"Ports\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"SubAIMs\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"Implementations\": [],\n"
+		"  \"Documentation\": [\n"
+		"    {\n"
+		"      \"Type\": \"Tutorial\",\n"
+		"      \"URI\": \"https://mpai.community/standards/mpai-iot/\"\n"
+		"    }\n"
+		"  ]\n"
+		"}\n"
+	},
+	{
+		._name = "mpai_aim_MotionRecognitionAnalysis.json",
+		._type = MPAI_CONFIG_STORE_AIM,
+		._document =
+		"{\n"
+		"  \"Identifier\": {\n"
+		"    \"ImplementerID\": 1,\n"
+		"    \"Specification\": {\n"
+		"      \"Name\": \"IOT\",\n"
+		"      \"AIW\": \"REV\",\n"
+		"      \"AIM\": \"MotionRecognitionAnalysis\",\n"
+		"      \"Version\": \"1\"\n"
+		"    }\n"
+		"  },\n"
+		"  \"Description\": \"This AIM implements motion recognition analysing data from inertial unit.\",\n"
+		"  \"Ports\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"SubAIMs\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"Implementations\": [],\n"
+		"  \"Documentation\": [\n"
+		"    {\n"
+		"      \"Type\": \"Tutorial\",\n"
+		"      \"URI\": \"https://mpai.community/standards/mpai-iot/\"\n"
+		"    }\n"
+		"  ]\n"
+		"}\n"
+	},
+	{
+		._name = "mpai_aim_MovementsWithAudioValidation.json",
+		._type = MPAI_CONFIG_STORE_AIM,
+		._document =
+		"{\n"
+		"  \"Identifier\": {\n"
+		"    \"ImplementerID\": 1,\n"
+		"    \"Specification\": {\n"
+		"      \"Name\": \"IOT\",\n"
+		"      \"AIW\": \"REV\",\n"
+		"      \"AIM\": \"MovementsWithAudioValidation\",\n"
+		"      \"Version\": \"1\"\n"
+		"    }\n"
+		"  },\n"
+		"  \"Description\": \"This AIM implements a validation of limbs movements during rehabilitation exercises, according to music rhythm\",\n"
+		"  \"Ports\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"SubAIMs\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"Implementations\": [],\n"
+		"  \"Documentation\": [\n"
+		"    {\n"
+		"      \"Type\": \"Tutorial\",\n"
+		"      \"URI\": \"https://mpai.community/standards/mpai-iot/\"\n"
+		"    }\n"
+		"  ]\n"
+		"}\n"
+	},
+	{
+		._name = "mpai_aim_VolumePeaksAnalysis.json",
+		._type = MPAI_CONFIG_STORE_AIM,
+		._document =
+		"{\n"
+		"  \"Identifier\": {\n"
+		"    \"ImplementerID\": 1,\n"
+		"    \"Specification\": {\n"
+		"      \"Name\": \"IOT\",\n"
+		"      \"AIW\": \"REV\",\n"
+		"      \"AIM\": \"VolumePeaksAnalysis\",\n"
+		"      \"Version\": \"1\"\n"
+		"    }\n"
+		"  },\n"
+		"  \"Description\": \"This AIM implements analysis transform function for IOT-REV that recognizes volume peaks from microphone array audio.\",\n"
+		"  \"Ports\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"SubAIMs\": [],\n"
+		"  \"Topology\": [],\n"
+		"  \"Implementations\": [],\n"
+		"  \"Documentation\": [\n"
+		"    {\n"
+		"      \"Type\": \"Tutorial\",\n"
+		"      \"URI\": \"https://mpai.community/standards/mpai-iot/\"\n"
+		"    }\n"
+		"  ]\n"
+		"}\n"
+	},
+	{
+		._name = "mpai_aiw_iot_rev.json",
+		._type = MPAI_CONFIG_STORE_AIW,
+		._document =
+		"{\n"
+		"  \"$schema\": \"https://json-schema.org/draft/2020-12/schema\",\n"
+		"  \"$id\": \"https://mpai.community/standards/resources/MPAI-AIF/V1/AIW-AIM-metadata.schema.json\",\n"
+		"  \"title\": \"IOT AIF v1 AIW/AIM metadata\",\n"
+		"  \"Identifier\": {\n"
+		"    \"ImplementerID\": 1,\n"
+		"    \"Specification\": {\n"
+		"      \"Standard\": \"MPAI-IOT\",\n"
+		"      \"AIW\": \"IOT-REV\",\n"
+		"      \"AIM\": \"IOT-REV\",\n"
+		"      \"Version\": \"1\"\n"
+		"    }\n"
+		"  },\n"
+		"  \"APIProfile\": \"Main\",\n"
+		"  \"Description\": \"AIW that implements Use-Case IOT-REV (Rehabilitation Exercises Validation)\",\n"
+		"  \"Types\": [\n"
+		"    {\n"
+		"      \"Name\": \"Sensors_Data_t\",\n"
+		"      \"Type\": \"mpai_message_t\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"Mic_Buffer_Data_t\",\n"
+		"      \"Type\": \"mpai_message_t\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"Mic_Peak_Data_t\",\n"
+		"      \"Type\": \"mpai_message_t\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"Motion_Data_t\",\n"
+		"      \"Type\": \"mpai_message_t\"\n"
+		"    }\n"
+		"  ],\n"
+		"  \"Ports\": [\n"
+		"    {\n"
+		"      \"Name\": \"SensorsDataChannel\",\n"
+		"      \"Direction\": \"InputOutput\",\n"
+		"      \"RecordType\": \"Sensors_Data_t\",\n"
+		"      \"Technology\": \"Software\",\n"
+		"      \"Protocol\": \"\",\n"
+		"      \"IsRemote\": false\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"MicBufferDataChannel\",\n"
+		"      \"Direction\": \"InputOutput\",\n"
+		"      \"RecordType\": \"Mic_Buffer_Data_t\",\n"
+		"      \"Technology\": \"Software\",\n"
+		"      \"Protocol\": \"\",\n"
+		"      \"IsRemote\": false\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"MicPeakDataChannel\",\n"
+		"      \"Direction\": \"InputOutput\",\n"
+		"      \"RecordType\": \"Mic_Peak_Data_t\",\n"
+		"      \"Technology\": \"Software\",\n"
+		"      \"Protocol\": \"\",\n"
+		"      \"IsRemote\": false\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"MotionDataChannel\",\n"
+		"      \"Direction\": \"InputOutput\",\n"
+		"      \"RecordType\": \"Motion_Data_t\",\n"
+		"      \"Technology\": \"Software\",\n"
+		"      \"Protocol\": \"\",\n"
+		"      \"IsRemote\": false\n"
+		"    }\n"
+		"  ],\n"
+		"  \"Topology\": [\n"
+		"    {\n"
+		"      \"Output\": {\n"
+		"        \"AIMName\": \"MotionRecognitionAnalysis\",\n"
+		"        \"PortName\": \"SensorsDataChannel\"\n"
+		"      },\n"
+		"      \"Input\": {\n"
+		"        \"AIMName\": \"ControlUnitSensorsReading\",\n"
+		"        \"PortName\": \"SensorsDataChannel\"\n"
+		"      }\n"
+		"    },\n"
+		"    {\n"
+		"      \"Output\": {\n"
+		"        \"AIMName\": \"MovementsWithAudioValidation\",\n"
+		"        \"PortName\": \"MicPeakDataChannel\"\n"
+		"      },\n"
+		"      \"Input\": {\n"
+		"        \"AIMName\": \"VolumePeaksAnalysis\",\n"
+		"        \"PortName\": \"MicPeakDataChannel\"\n"
+		"      }\n"
+		"    },\n"
+		"    {\n"
+		"      \"Output\": {\n"
+		"        \"AIMName\": \"\",\n"
+		"        \"PortName\": \"MicBufferDataChannel\"\n"
+		"      },\n"
+		"      \"Input\": {\n"
+		"        \"AIMName\": \"VolumePeaksAnalysis\",\n"
+		"        \"PortName\": \"\"\n"
+		"      }\n"
+		"    },\n"
+		"    {\n"
+		"      \"Output\": {\n"
+		"        \"AIMName\": \"MovementsWithAudioValidation\",\n"
+		"        \"PortName\": \"MotionDataChannel\"\n"
+		"      },\n"
+		"      \"Input\": {\n"
+		"        \"AIMName\": \"MotionRecognitionAnalysis\",\n"
+		"        \"PortName\": \"MotionDataChannel\"\n"
+		"      }\n"
+		"    }\n"
+		"  ],\n"
+		"  \"SubAIMs\": [\n"
+		"    {\n"
+		"      \"Name\": \"VolumePeaksAnalysis\",\n"
+		"      \"Identifier\": {\n"
+		"        \"ImplementerID\": 1,\n"
+		"        \"Specification\": {\n"
+		"          \"Standard\": \"MPAI-IOT\",\n"
+		"          \"AIW\": \"IOT-REV\",\n"
+		"          \"AIM\": \"VolumePeaksAnalysis\",\n"
+		"          \"Version\": \"1\"\n"
+		"        }\n"
+		"      }\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"ControlUnitSensorsReading\",\n"
+		"      \"Identifier\": {\n"
+		"        \"ImplementerID\": 1,\n"
+		"        \"Specification\": {\n"
+		"          \"Standard\": \"MPAI-IOT\",\n"
+		"          \"AIW\": \"IOT-REV\",\n"
+		"          \"AIM\": \"ControlUnitSensorsReading\",\n"
+		"          \"Version\": \"1\"\n"
+		"        }\n"
+		"      }\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"MotionRecognitionAnalysis\",\n"
+		"      \"Identifier\": {\n"
+		"        \"ImplementerID\": 1,\n"
+		"        \"Specification\": {\n"
+		"          \"Standard\": \"MPAI-IOT\",\n"
+		"          \"AIW\": \"IOT-REV\",\n"
+		"          \"AIM\": \"MotionRecognitionAnalysis\",\n"
+		"          \"Version\": \"1\"\n"
+		"        }\n"
+		"      }\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"MovementsWithAudioValidation\",\n"
+		"      \"Identifier\": {\n"
+		"        \"ImplementerID\": 1,\n"
+		"        \"Specification\": {\n"
+		"          \"Standard\": \"MPAI-IOT\",\n"
+		"          \"AIW\": \"IOT-REV\",\n"
+		"          \"AIM\": \"MovementsWithAudioValidation\",\n"
+		"          \"Version\": \"1\"\n"
+		"        }\n"
+		"      }\n"
+		"    }\n"
+		"  ],\n"
+		"  \"Implementations\": [\n"
+		"    {\n"
+		"      \"BinaryName\": \"firmware.bin\",\n"
+		"      \"Architecture\": \"arm\",\n"
+		"      \"OperatingSystem\": \"Zephyr RTOS\",\n"
+		"      \"Version\": \"v0.1\",\n"
+		"      \"Source\": \"AIMStorage\",\n"
+		"      \"Destination\": \"\"\n"
+		"    }\n"
+		"  ],\n"
+		"  \"ResourcePolicies\": [\n"
+		"    {\n"
+		"      \"Name\": \"Memory\",\n"
+		"      \"Minimum\": \"50000\",\n"
+		"      \"Maximum\": \"120000\",\n"
+		"      \"Request\": \"80000\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"CPUNumber\",\n"
+		"      \"Minimum\": \"1\",\n"
+		"      \"Maximum\": \"2\",\n"
+		"      \"Request\": \"1\"\n"
+		"    },\n"
+		"    {\n"
+		"      \"Name\": \"CPU:Class\",\n"
+		"      \"Minimum\": \"Low\",\n"
+		"      \"Maximum\": \"High\",\n"
+		"      \"Request\": \"Low\"\n"
+		"    }\n"
+		"  ],\n"
+		"  \"Documentation\": [\n"
+		"    {\n"
+		"      \"Type\": \"Tutorial\",\n"
+		"      \"URI\": \"https://mpai.community/standards/mpai-iot/\"\n"
+		"    }\n"
+		"  ]\n"
+		"}\n"
+	},
+};
+
+const size_t MPAI_METADATA_CORPUS_COUNT = ARRAY_SIZE(MPAI_METADATA_CORPUS);
+#endif
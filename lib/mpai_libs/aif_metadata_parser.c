@@ -12,146 +12,262 @@
 
 LOG_MODULE_REGISTER(MPAI_LIBS_AIF_METADATA_PARSER, LOG_LEVEL_INF);
 
+/* Arena used by each parsing: all the memory of a document is released at once when the parsing ends */
+static uint8_t metadata_arena_buffer[CONFIG_MPAI_METADATA_PARSER_ARENA_SIZE] __aligned(MPAI_ARENA_ALIGN);
+static mpai_arena_t metadata_arena;
+/* Usage of the arena by the last document parsed */
+static mpai_metadata_parser_stats_t metadata_last_stats;
+/* Held from the begin to the end of each parsing: the arena is shared (i.e. boot and API server threads) */
+K_MUTEX_DEFINE(metadata_parse_lock);
+
+/* Validation of an entire document, with its "title" */
+typedef struct _metadata_validation_t {
+	mpai_json_stream_t _json;
+	mpai_schema_validator_t _validator;
+	char _title[MPAI_METADATA_NAME_LEN];
+} metadata_validation_t;
+
+/************* PRIVATE HEADER *************/
+/* lock the parser and reset the arena */
+void _metadata_parse_begin();
+/* store the usage of the arena, release all its memory and unlock the parser */
+void _metadata_parse_end(const char* document);
+/* handle the events of the AIW JSON, calling AIM callbacks and storing the topology */
+bool _aiw_stream_event_callback(const mpai_json_stream_t* json, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data);
+/* validate an entire JSON document against a schema, without building its tree, copying its "title" (NULL if not needed) */
+bool _metadata_validate(const mpai_schema_t* schema, const char* document, char* title);
+/* handle the events of a JSON document validated by _metadata_validate */
+bool _metadata_validate_event_callback(const mpai_json_stream_t* json, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data);
+
+/************* PUBLIC **************/
+
 bool MPAI_Metadata_Parser_Parse_AIF_JSON(const char *aif_result)
 {
-	if (aif_result != NULL)
+	if (aif_result == NULL)
 	{
-		// TODO: validate according with JSON schema
+		return false;
+	}
 
-		// Parse AIF Json Metadata
-		cJSON *root_aif = cJSON_Parse(aif_result);
-		if (root_aif != NULL)
-		{
-			// read aif
-			cJSON *aif_name_cjson = cJSON_GetObjectItem(root_aif, "title");
-			if (aif_name_cjson != NULL)
-			{
-				char *aif_name = aif_name_cjson->valuestring;
-				LOG_INF("Initializing AIF with title \"%s\"...", log_strdup(aif_name));
-			} 
-			else 
-			{
-				return false;
-			}
-			free(aif_name_cjson);
-		} 
-		else 
-		{
-			return false;
-		}
-		free(root_aif);
-		k_free(aif_result);
+	bool aif_ok = false;
+	_metadata_parse_begin();
 
-		return true;
+	// "title" is read while validating: it's a string required by the schema
+	char aif_name[MPAI_METADATA_NAME_LEN];
+	if (_metadata_validate(&MPAI_SCHEMA_AIF, aif_result, aif_name))
+	{
+		LOG_INF("Initializing AIF with title \"%s\"...", log_strdup(aif_name));
+		aif_ok = true;
 	}
-	else 
+
+	_metadata_parse_end("AIF");
+	return aif_ok;
+}
+
+bool MPAI_Metadata_Parser_Parse_AIW_JSON(const char *aiw_result, int aiw_id, aim_callback_t aim_callback, topology_output_callback_t topology_output_callback)
+{
+	if (aiw_result == NULL)
 	{
 		return false;
 	}
+
+	_metadata_parse_begin();
+
+	bool aiw_ok = false;
+	mpai_metadata_aiw_stream_t *stream = (mpai_metadata_aiw_stream_t *)MPAI_Arena_Alloc(&metadata_arena, sizeof(mpai_metadata_aiw_stream_t));
+	if (stream != NULL)
+	{
+		MPAI_Metadata_Parser_AIW_Stream_Init(stream, aiw_id, aim_callback, topology_output_callback);
+		aiw_ok = MPAI_Metadata_Parser_AIW_Stream_Feed(stream, aiw_result, strlen(aiw_result));
+		aiw_ok = MPAI_Metadata_Parser_AIW_Stream_End(stream) && aiw_ok;
+	}
+
+	_metadata_parse_end("AIW");
+	return aiw_ok;
 }
 
-bool MPAI_Metadata_Parser_Parse_AIW_JSON(const char *aiw_result, int aiw_id, aim_callback_t aim_callback, topology_output_callback_t topology_output_callback)
+void MPAI_Metadata_Parser_AIW_Stream_Init(mpai_metadata_aiw_stream_t* stream, int aiw_id, aim_callback_t aim_callback, topology_output_callback_t topology_output_callback)
 {
-	bool aiw_ok = true;
-	cJSON *root = cJSON_Parse(aiw_result);
-	if (root != NULL)
+	memset(stream, 0, sizeof(mpai_metadata_aiw_stream_t));
+	stream->_aiw_id = aiw_id;
+	stream->_aim_callback = aim_callback;
+	stream->_topology_output_callback = topology_output_callback;
+	stream->_aims_ok = true;
+	MPAI_Schema_Validator_Init(&stream->_validator, &MPAI_SCHEMA_AIW);
+	MPAI_JSON_Stream_Init(&stream->_json, _aiw_stream_event_callback, stream);
+}
+
+void MPAI_Metadata_Parser_AIW_Stream_Set_Format(mpai_metadata_aiw_stream_t* stream, MPAI_METADATA_FORMAT format)
+{
+	if (format == MPAI_METADATA_FORMAT_CBOR)
 	{
-		// TODO: validate according with JSON schema
+		MPAI_CBOR_Stream_Init(&stream->_json, _aiw_stream_event_callback, stream);
+	}
+	else
+	{
+		MPAI_JSON_Stream_Init(&stream->_json, _aiw_stream_event_callback, stream);
+	}
+}
 
-		// read aiw
-		cJSON *aiw_name_cjson = cJSON_GetObjectItem(root, "title");
-		if (aiw_name_cjson != NULL)
-		{
-			bool aiw_init_ok = true;
-			char *aiw_name = aiw_name_cjson->valuestring;
-			LOG_INF("Initializing AIW with title \"%s\"...", log_strdup(aiw_name));
+bool MPAI_Metadata_Parser_AIW_Stream_Feed(mpai_metadata_aiw_stream_t* stream, const char* data, size_t len)
+{
+	return MPAI_JSON_Stream_Feed(&stream->_json, data, len);
+}
 
-			// read aiw topology
-			cJSON *aiw_topology_cjson = cJSON_GetObjectItem(root, "Topology");
-			if (aiw_topology_cjson != NULL)
-			{
-				if (cJSON_Array == aiw_topology_cjson->type)
-				{
-					int aiw_topology_el_count = cJSON_GetArraySize(aiw_topology_cjson);
-					// read each topology element topology
-					for (int idx = 0; idx < aiw_topology_el_count; idx++)
-					{
-						cJSON *aiw_topology_el_cjson = cJSON_GetArrayItem(aiw_topology_cjson, idx);
-						// read input channel by aim (the json describe input channel match to output channel)
-						cJSON *aiw_topology_output_cjson = cJSON_GetObjectItem(aiw_topology_el_cjson, "Output");
-						if (aiw_topology_output_cjson != NULL)
-						{
-
-							cJSON *aiw_output_aim_name_cjson = cJSON_GetObjectItem(aiw_topology_output_cjson, "AIMName");
-							cJSON *aiw_output_channel_cjson = cJSON_GetObjectItem(aiw_topology_output_cjson, "PortName");
-
-							const char* aim_name = aiw_output_aim_name_cjson->valuestring;
-							const char* output_port_name = aiw_output_channel_cjson->valuestring;
-
-							topology_output_callback(aim_name, output_port_name);
-
-							free(aiw_output_aim_name_cjson);
-							free(aiw_output_channel_cjson);
-						}
-						free(aiw_topology_output_cjson);
-						free(aiw_topology_el_cjson);
-					}
-				}
-			}
+bool MPAI_Metadata_Parser_AIW_Stream_End(mpai_metadata_aiw_stream_t* stream)
+{
+	// required properties ("title", "Topology", "SubAIMs") are checked by the validator, closing the root object
+	if (!MPAI_JSON_Stream_End(&stream->_json) || !stream->_aims_ok)
+	{
+		return false;
+	}
+
+	// the AIW is valid: topology can be applied
+	for (size_t i = 0; stream->_topology_output_callback != NULL && i < stream->_topology_count; i++)
+	{
+		stream->_topology_output_callback(stream->_topology[i]._aim_name, stream->_topology[i]._port_name);
+	}
+	return true;
+}
+
+bool MPAI_Metadata_Parser_Parse_AIM_JSON(const char *aim_result)
+{
+	if (aim_result == NULL)
+	{
+		return false;
+	}
 
-			// read AIMs of AIW
-			cJSON *aiw_subaims_cjson = cJSON_GetObjectItem(root, "SubAIMs");
-			if (cJSON_Array == aiw_subaims_cjson->type)
+	_metadata_parse_begin();
+	bool aim_ok = _metadata_validate(&MPAI_SCHEMA_AIM, aim_result, NULL);
+	_metadata_parse_end("AIM");
+	return aim_ok;
+}
+
+void MPAI_Metadata_Parser_Get_Last_Stats(mpai_metadata_parser_stats_t* stats)
+{
+	*stats = metadata_last_stats;
+}
+
+/************* PRIVATE **************/
+void _metadata_parse_begin()
+{
+	k_mutex_lock(&metadata_parse_lock, K_FOREVER);
+	if (metadata_arena._buffer == NULL)
+	{
+		MPAI_Arena_Init(&metadata_arena, metadata_arena_buffer, sizeof(metadata_arena_buffer));
+	}
+	MPAI_Arena_Reset(&metadata_arena);
+}
+
+void _metadata_parse_end(const char* document)
+{
+	metadata_last_stats._peak_bytes = metadata_arena._peak;
+	metadata_last_stats._allocations = metadata_arena._allocations;
+	metadata_last_stats._exhausted = metadata_arena._failures > 0;
+
+	if (metadata_last_stats._exhausted)
+	{
+		LOG_ERR("Parsing %s: arena of %zu bytes exhausted (increase CONFIG_MPAI_METADATA_PARSER_ARENA_SIZE)", document, sizeof(metadata_arena_buffer));
+	}
+	LOG_INF("Parsing %s: peak %zu bytes, %zu allocations", document, metadata_last_stats._peak_bytes, metadata_last_stats._allocations);
+
+	MPAI_Arena_Reset(&metadata_arena);
+	k_mutex_unlock(&metadata_parse_lock);
+}
+
+bool _aiw_stream_event_callback(const mpai_json_stream_t* json, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data)
+{
+	mpai_metadata_aiw_stream_t *stream = (mpai_metadata_aiw_stream_t *)user_data;
+
+	// values are handled only after they are validated, so they have the type and the length of the schema
+	if (!MPAI_Schema_Validator_Event(&stream->_validator, json, event, value))
+	{
+		return false;
+	}
+
+	switch (event)
+	{
+	case MPAI_JSON_STREAM_STRING:
+		if (MPAI_JSON_Stream_Path_Is(json, "title"))
+		{
+			LOG_INF("Initializing AIW with title \"%s\"...", log_strdup(value));
+		}
+		// read input channel by aim (the json describe input channel match to output channel)
+		else if (MPAI_JSON_Stream_Path_Is(json, "Topology.*.Output.AIMName"))
+		{
+			strncpy(stream->_topology[stream->_topology_count]._aim_name, value, MPAI_METADATA_NAME_LEN - 1);
+		}
+		else if (MPAI_JSON_Stream_Path_Is(json, "Topology.*.Output.PortName"))
+		{
+			strncpy(stream->_topology[stream->_topology_count]._port_name, value, MPAI_METADATA_NAME_LEN - 1);
+		}
+		// read AIMs of AIW
+		else if (MPAI_JSON_Stream_Path_Is(json, "SubAIMs.*.Identifier.Specification.AIM"))
+		{
+			if (stream->_aim_callback != NULL)
 			{
-				int aims_count = cJSON_GetArraySize(aiw_subaims_cjson);
-				// loop on AIMs
-				for (int idx = 0; idx < aims_count; idx++)
-				{
-					bool aim_init_ok = false;
-					cJSON *aim_cjson = cJSON_GetArrayItem(aiw_subaims_cjson, idx);
-					cJSON *aim_identifier_cjson = cJSON_GetObjectItem(aim_cjson, "Identifier");
-					if (aim_identifier_cjson != NULL)
-					{
-						cJSON *aim_specification_cjson = cJSON_GetObjectItem(aim_identifier_cjson, "Specification");
-						if (aim_identifier_cjson != NULL)
-						{
-							cJSON *aim_name_cjson = cJSON_GetObjectItem(aim_specification_cjson, "AIM");
-							char *aim_name = aim_name_cjson->valuestring;
-
-							aim_init_ok = aim_callback(aim_name);
-							free(aim_name_cjson);
-						}
-						free(aim_specification_cjson);
-					}
-					free(aim_identifier_cjson);
-					aiw_init_ok = aiw_init_ok & aim_init_ok;
-				}
+				stream->_aims_ok = stream->_aim_callback(value) && stream->_aims_ok;
 			}
-			else
+		}
+		break;
+	case MPAI_JSON_STREAM_OBJECT_BEGIN:
+		if (MPAI_JSON_Stream_Path_Is(json, "Topology.*.Output"))
+		{
+			if (stream->_topology_count >= MPAI_METADATA_AIW_TOPOLOGY_MAX)
 			{
-				aiw_init_ok = false;
+				LOG_ERR("Too many elements in AIW \"Topology\" (max %d)", MPAI_METADATA_AIW_TOPOLOGY_MAX);
+				return false;
 			}
-
-			free(aiw_name_cjson);
-			free(aiw_topology_cjson);
-			free(root);
-			aiw_ok = aiw_ok && aiw_init_ok;
+			memset(&stream->_topology[stream->_topology_count], 0, sizeof(mpai_metadata_topology_output_t));
 		}
-		else 
+		break;
+	case MPAI_JSON_STREAM_OBJECT_END:
+		// "AIMName" and "PortName" are required by the schema, so the output is complete
+		if (MPAI_JSON_Stream_Path_Is(json, "Topology.*.Output"))
 		{
-			aiw_ok = false;
+			stream->_topology_count++;
 		}
+		break;
+	default:
+		break;
 	}
-	else
+	return true;
+}
+
+bool _metadata_validate(const mpai_schema_t* schema, const char* document, char* title)
+{
+	metadata_validation_t *validation = (metadata_validation_t *)MPAI_Arena_Alloc(&metadata_arena, sizeof(metadata_validation_t));
+	if (validation == NULL)
+	{
+		return false;
+	}
+	MPAI_Schema_Validator_Init(&validation->_validator, schema);
+	validation->_title[0] = '\0';
+	MPAI_JSON_Stream_Init(&validation->_json, _metadata_validate_event_callback, validation);
+	bool valid = MPAI_JSON_Stream_Feed(&validation->_json, document, strlen(document));
+	valid = MPAI_JSON_Stream_End(&validation->_json) && valid;
+	if (!valid)
 	{
-		aiw_ok = false;
+		LOG_ERR("%s not valid according with its schema", schema->_name);
 	}
-	return aiw_ok;
+	else if (title != NULL)
+	{
+		strcpy(title, validation->_title);
+	}
+	return valid;
 }
 
-// TODO: at the moment, we only check the AIM exists
-bool MPAI_Metadata_Parser_Parse_AIM_JSON(const char *aim_result)
+bool _metadata_validate_event_callback(const mpai_json_stream_t* json, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data)
 {
-	// TODO: validate according with JSON schema
-	return aim_result != NULL;
-}
\ No newline at end of file
+	metadata_validation_t *validation = (metadata_validation_t *)user_data;
+
+	if (!MPAI_Schema_Validator_Event(&validation->_validator, json, event, value))
+	{
+		return false;
+	}
+	if (event == MPAI_JSON_STREAM_STRING && MPAI_JSON_Stream_Path_Is(json, "title"))
+	{
+		strncpy(validation->_title, value, MPAI_METADATA_NAME_LEN - 1);
+		validation->_title[MPAI_METADATA_NAME_LEN - 1] = '\0';
+	}
+	return true;
+}
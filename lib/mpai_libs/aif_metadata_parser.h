@@ -12,10 +12,45 @@
 #define MPAI_AIF_METADATA_PARSER_H
 
 #include <core_common.h>
-#include <cJSON.h>
+#include <aif_metadata_stream.h>
+#include <aif_metadata_schema.h>
+#include <mem_arena.h>
+
+/* Max "Output" elements of "Topology" of an AIW */
+#define MPAI_METADATA_AIW_TOPOLOGY_MAX 16
+/* Max length of AIM and port names in the topology (including the terminator, as limited by the AIW schema) */
+#define MPAI_METADATA_NAME_LEN 32
+
+/* Memory used parsing a document */
+typedef struct _mpai_metadata_parser_stats_t {
+	size_t _peak_bytes;			// peak usage of the parser arena
+	size_t _allocations;
+	bool _exhausted;			// the arena was too small for the document
+} mpai_metadata_parser_stats_t;
+
+/* "Output" element of "Topology" */
+typedef struct _mpai_metadata_topology_output_t {
+	char _aim_name[MPAI_METADATA_NAME_LEN];
+	char _port_name[MPAI_METADATA_NAME_LEN];
+} mpai_metadata_topology_output_t;
+
+/* State of an AIW parsed while its JSON is streamed */
+typedef struct _mpai_metadata_aiw_stream_t {
+	mpai_json_stream_t _json;
+	mpai_schema_validator_t _validator;
+	int _aiw_id;
+	aim_callback_t* _aim_callback;
+	topology_output_callback_t* _topology_output_callback;
+	mpai_metadata_topology_output_t _topology[MPAI_METADATA_AIW_TOPOLOGY_MAX];	// notified only when the whole AIW is valid
+	uint8_t _topology_count;
+	bool _aims_ok;
+} mpai_metadata_aiw_stream_t;
+
+/* Documents are parsed one at a time, in the arena of the parser: callers in other threads wait for the parsing in progress */
 
 /**
- * @brief Parse JSON coming from MPAI Store Config according with AIF specs
+ * @brief Parse JSON coming from MPAI Store Config according with AIF specs: the document is validated
+ * against the AIF schema in one pass, reading its title
  * 
  * @param aif_result JSON string
  * @return true 
@@ -36,7 +71,47 @@ bool MPAI_Metadata_Parser_Parse_AIF_JSON(const char *aif_result);
 bool MPAI_Metadata_Parser_Parse_AIW_JSON(const char *aiw_result, int aiw_id, aim_callback_t aim_callback, topology_output_callback_t topology_output_callback);
 
 /**
- * @brief Parse JSON coming from MPAI Store Config according with AIW specs
+ * @brief Start parsing an AIW whose JSON is received in chunks: the document is validated against the AIW schema
+ * while it's parsed. AIM callbacks are called as soon as the related elements are received, so the whole document
+ * is never stored, while topology callbacks are called only when the document is complete and valid
+ * 
+ * @param stream state of the parsing
+ * @param aiw_id ID of AIW
+ * @param aim_callback callback called after extracting each AIM (NULL if not used)
+ * @param topology_output_callback callback called after extracting the "Output" property of "Topology" (NULL if not used)
+ */
+void MPAI_Metadata_Parser_AIW_Stream_Init(mpai_metadata_aiw_stream_t* stream, int aiw_id, aim_callback_t aim_callback, topology_output_callback_t topology_output_callback);
+
+/**
+ * @brief Set the encoding of the AIW (JSON by default): it has to be called before parsing the first chunk
+ * 
+ * @param stream 
+ * @param format 
+ */
+void MPAI_Metadata_Parser_AIW_Stream_Set_Format(mpai_metadata_aiw_stream_t* stream, MPAI_METADATA_FORMAT format);
+
+/**
+ * @brief Parse a chunk of AIW (JSON or CBOR)
+ * 
+ * @param stream 
+ * @param data 
+ * @param len 
+ * @return true 
+ * @return false on syntax error or if an AIM callback fails
+ */
+bool MPAI_Metadata_Parser_AIW_Stream_Feed(mpai_metadata_aiw_stream_t* stream, const char* data, size_t len);
+
+/**
+ * @brief End parsing an AIW, checking that the document is complete and valid
+ * 
+ * @param stream 
+ * @return true 
+ * @return false 
+ */
+bool MPAI_Metadata_Parser_AIW_Stream_End(mpai_metadata_aiw_stream_t* stream);
+
+/**
+ * @brief Parse JSON coming from MPAI Store Config according with AIM specs, validating it against the AIM schema
  * 
  * @param aim_result 
  * @return true 
@@ -44,4 +119,12 @@ bool MPAI_Metadata_Parser_Parse_AIW_JSON(const char *aiw_result, int aiw_id, aim
  */
 bool MPAI_Metadata_Parser_Parse_AIM_JSON(const char *aim_result);
 
+/**
+ * @brief Get the memory used parsing the last document: each document is parsed in an arena of
+ * CONFIG_MPAI_METADATA_PARSER_ARENA_SIZE bytes, released all at once when the parsing ends
+ * 
+ * @param stats 
+ */
+void MPAI_Metadata_Parser_Get_Last_Stats(mpai_metadata_parser_stats_t* stats);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*
+ * @file
+ * @brief Implementation of the validation of AIF/AIW/AIM metadata against the MPAI-AIF JSON schemas
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_metadata_schema.h"
+
+LOG_MODULE_REGISTER(MPAI_LIBS_AIF_METADATA_SCHEMA, LOG_LEVEL_INF);
+
+/************* PRIVATE HEADER *************/
+/* find the node describing the value of the current event (MPAI_SCHEMA_NO_NODE if not described) */
+uint16_t _schema_value_node(mpai_schema_validator_t* validator, const mpai_json_stream_t* stream);
+/* JSON type of the value of an event */
+uint8_t _schema_event_type(MPAI_JSON_STREAM_EVENT event, const char* value);
+/* check a string against length and enum of its node */
+bool _schema_check_string(const mpai_schema_node_t* node, const char* value);
+/* name of the value of the current event, used in error messages */
+const char* _schema_value_name(const mpai_json_stream_t* stream);
+
+/************* PUBLIC **************/
+void MPAI_Schema_Validator_Init(mpai_schema_validator_t* validator, const mpai_schema_t* schema)
+{
+	memset(validator, 0, sizeof(mpai_schema_validator_t));
+	validator->_schema = schema;
+}
+
+bool MPAI_Schema_Validator_Event(mpai_schema_validator_t* validator, const mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value)
+{
+	if (validator->_error)
+	{
+		return false;
+	}
+
+	// a container is closed: all its required properties have to be found
+	if (event == MPAI_JSON_STREAM_OBJECT_END || event == MPAI_JSON_STREAM_ARRAY_END)
+	{
+		uint16_t closed = validator->_nodes[stream->_depth];
+		if (event == MPAI_JSON_STREAM_ARRAY_END || closed == MPAI_SCHEMA_NO_NODE)
+		{
+			return true;
+		}
+		const mpai_schema_node_t* node = &validator->_schema->_nodes[closed];
+		uint32_t missing = node->_required & ~validator->_found[stream->_depth];
+		if (missing != 0)
+		{
+			size_t i = 0;
+			while ((missing & (1U << i)) == 0)
+			{
+				i++;
+			}
+			LOG_ERR("%s: required property \"%s\" not found", validator->_schema->_name,
+				log_strdup(validator->_schema->_nodes[node->_first_child + i]._key));
+			validator->_error = true;
+			return false;
+		}
+		return true;
+	}
+
+	uint16_t node_idx = _schema_value_node(validator, stream);
+	if (event == MPAI_JSON_STREAM_OBJECT_BEGIN || event == MPAI_JSON_STREAM_ARRAY_BEGIN)
+	{
+		// the container will be at the current depth, after the push
+		validator->_nodes[stream->_depth] = node_idx;
+		validator->_found[stream->_depth] = 0;
+	}
+	if (node_idx == MPAI_SCHEMA_NO_NODE)
+	{
+		// additional properties are allowed, and not validated
+		return true;
+	}
+
+	const mpai_schema_node_t* node = &validator->_schema->_nodes[node_idx];
+	if ((node->_types & _schema_event_type(event, value)) == 0)
+	{
+		LOG_ERR("%s: \"%s\" has a wrong type", validator->_schema->_name, log_strdup(_schema_value_name(stream)));
+		validator->_error = true;
+		return false;
+	}
+	if (event == MPAI_JSON_STREAM_STRING && !_schema_check_string(node, value))
+	{
+		LOG_ERR("%s: \"%s\" has a wrong value \"%s\"", validator->_schema->_name, log_strdup(_schema_value_name(stream)), log_strdup(value));
+		validator->_error = true;
+		return false;
+	}
+	return true;
+}
+
+/************* PRIVATE **************/
+uint16_t _schema_value_node(mpai_schema_validator_t* validator, const mpai_json_stream_t* stream)
+{
+	if (stream->_depth == 0)
+	{
+		return 0;
+	}
+
+	uint16_t parent_idx = validator->_nodes[stream->_depth - 1];
+	if (parent_idx == MPAI_SCHEMA_NO_NODE)
+	{
+		return MPAI_SCHEMA_NO_NODE;
+	}
+	const mpai_schema_node_t* parent = &validator->_schema->_nodes[parent_idx];
+	const mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth - 1];
+
+	if (frame->_is_array)
+	{
+		return parent->_child_count > 0 && (parent->_types & MPAI_SCHEMA_TYPE_ARRAY) ? parent->_first_child : MPAI_SCHEMA_NO_NODE;
+	}
+	if ((parent->_types & MPAI_SCHEMA_TYPE_OBJECT) == 0)
+	{
+		return MPAI_SCHEMA_NO_NODE;
+	}
+	for (size_t i = 0; i < parent->_child_count; i++)
+	{
+		const mpai_schema_node_t* child = &validator->_schema->_nodes[parent->_first_child + i];
+		if (strcmp(child->_key, frame->_key) == 0)
+		{
+			validator->_found[stream->_depth - 1] |= 1U << i;
+			return parent->_first_child + i;
+		}
+	}
+	return MPAI_SCHEMA_NO_NODE;
+}
+
+uint8_t _schema_event_type(MPAI_JSON_STREAM_EVENT event, const char* value)
+{
+	switch (event)
+	{
+	case MPAI_JSON_STREAM_OBJECT_BEGIN:
+		return MPAI_SCHEMA_TYPE_OBJECT;
+	case MPAI_JSON_STREAM_ARRAY_BEGIN:
+		return MPAI_SCHEMA_TYPE_ARRAY;
+	case MPAI_JSON_STREAM_STRING:
+		return MPAI_SCHEMA_TYPE_STRING;
+	case MPAI_JSON_STREAM_NUMBER:
+		// an integer is also a number
+		return strpbrk(value, ".eE") == NULL ? MPAI_SCHEMA_TYPE_INTEGER | MPAI_SCHEMA_TYPE_NUMBER : MPAI_SCHEMA_TYPE_NUMBER;
+	case MPAI_JSON_STREAM_TRUE:
+	case MPAI_JSON_STREAM_FALSE:
+		return MPAI_SCHEMA_TYPE_BOOLEAN;
+	case MPAI_JSON_STREAM_NULL:
+		return MPAI_SCHEMA_TYPE_NULL;
+	default:
+		return 0;
+	}
+}
+
+bool _schema_check_string(const mpai_schema_node_t* node, const char* value)
+{
+	size_t len = strlen(value);
+	if (len < node->_min_length || (node->_max_length > 0 && len > node->_max_length))
+	{
+		return false;
+	}
+	if (node->_enum != NULL)
+	{
+		for (const char* const* allowed = node->_enum; *allowed != NULL; allowed++)
+		{
+			if (strcmp(*allowed, value) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	return true;
+}
+
+const char* _schema_value_name(const mpai_json_stream_t* stream)
+{
+	if (stream->_depth == 0)
+	{
+		return "(root)";
+	}
+	const mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth - 1];
+	if (frame->_is_array)
+	{
+		// items of an array are named by the array
+		return stream->_depth > 1 ? stream->_frames[stream->_depth - 2]._key : "(root)";
+	}
+	return frame->_key;
+}
@@ -0,0 +1,87 @@
+/*
+ * @file
+ * @brief Headers of the validation of AIF/AIW/AIM metadata against the MPAI-AIF JSON schemas.
+ * Schemas in docs/schemas are compiled by tools/gen_metadata_schema.py into tables of nodes
+ * (aif_metadata_schema_tables.c), checked while the document is parsed by the streaming parser:
+ * no schema is interpreted at runtime and no memory is allocated
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_AIF_METADATA_SCHEMA_H
+#define MPAI_LIBS_AIF_METADATA_SCHEMA_H
+
+#include <core_common.h>
+#include <aif_metadata_stream.h>
+
+/* JSON types allowed for a node (bitmask) */
+#define MPAI_SCHEMA_TYPE_OBJECT 0x01
+#define MPAI_SCHEMA_TYPE_ARRAY 0x02
+#define MPAI_SCHEMA_TYPE_STRING 0x04
+#define MPAI_SCHEMA_TYPE_INTEGER 0x08
+#define MPAI_SCHEMA_TYPE_NUMBER 0x10
+#define MPAI_SCHEMA_TYPE_BOOLEAN 0x20
+#define MPAI_SCHEMA_TYPE_NULL 0x40
+#define MPAI_SCHEMA_TYPE_ANY 0x7F
+
+/* No node: the value is not described by the schema, so it's not validated */
+#define MPAI_SCHEMA_NO_NODE 0xFFFF
+/* Max properties of an object described by a schema (required properties are a bitmask) */
+#define MPAI_SCHEMA_MAX_PROPERTIES 32
+
+/* Node of a compiled schema: properties of an object and items of an array are its children */
+typedef struct _mpai_schema_node_t {
+	const char* _key;							// name of the property (NULL for the root and for items of arrays)
+	uint8_t _types;								// MPAI_SCHEMA_TYPE_* allowed
+	uint8_t _child_count;						// properties of an object, 1 for the items of an array
+	uint16_t _first_child;						// index of the first child (MPAI_SCHEMA_NO_NODE if none)
+	uint32_t _required;							// bit i set if the child i is a required property
+	uint8_t _min_length;						// strings only
+	uint8_t _max_length;						// strings only (0 if not limited)
+	const char* const* _enum;					// strings allowed, NULL terminated (NULL if any)
+} mpai_schema_node_t;
+
+/* Schema compiled in a table of nodes, whose first one is the root */
+typedef struct _mpai_schema_t {
+	const char* _name;
+	const mpai_schema_node_t* _nodes;
+	uint16_t _node_count;
+} mpai_schema_t;
+
+/* Schemas of MPAI-AIF metadata, generated from docs/schemas */
+extern const mpai_schema_t MPAI_SCHEMA_AIF;
+extern const mpai_schema_t MPAI_SCHEMA_AIW;
+extern const mpai_schema_t MPAI_SCHEMA_AIM;
+
+/* State of the validation of a document */
+typedef struct _mpai_schema_validator_t {
+	const mpai_schema_t* _schema;
+	uint16_t _nodes[MPAI_JSON_STREAM_MAX_DEPTH];	// node of each container opened
+	uint32_t _found[MPAI_JSON_STREAM_MAX_DEPTH];	// properties found in each object opened
+	bool _error;
+} mpai_schema_validator_t;
+
+/**
+ * @brief Initialize the validation of a document
+ *
+ * @param validator
+ * @param schema
+ */
+void MPAI_Schema_Validator_Init(mpai_schema_validator_t* validator, const mpai_schema_t* schema);
+
+/**
+ * @brief Validate an event emitted by the streaming parser: it has to be called for each event,
+ * from the callback of the stream
+ *
+ * @param validator
+ * @param stream stream that emitted the event
+ * @param event
+ * @param value
+ * @return true
+ * @return false if the document doesn't match the schema (the error is logged)
+ */
+bool MPAI_Schema_Validator_Event(mpai_schema_validator_t* validator, const mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * @file
+ * @brief Validation tables of the MPAI-AIF metadata schemas
+ *
+ * Generated by tools/gen_metadata_schema.py from docs/schemas: do not edit
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_metadata_schema.h"
+
+static const char* const schema_aif_enum_4[] = {"Basic", "Main", "Secure", NULL};
+
+static const mpai_schema_node_t schema_aif_nodes[] = {
+	/* 0 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 7, ._first_child = 1, ._required = 0x00000001, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 1 */ {._key = "title", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 1, ._max_length = 63, ._enum = NULL},
+	/* 2 */ {._key = "ImplementerID", ._types = MPAI_SCHEMA_TYPE_INTEGER, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 3 */ {._key = "Version", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 4 */ {._key = "APIProfile", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = schema_aif_enum_4},
+	/* 5 */ {._key = "ResourcePolicies", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 8, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 6 */ {._key = "Authentication", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 7 */ {._key = "TimeBase", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 8 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 4, ._first_child = 9, ._required = 0x00000001, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 9 */ {._key = "Name", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 10 */ {._key = "Minimum", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 11 */ {._key = "Maximum", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 12 */ {._key = "Request", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+};
+
+const mpai_schema_t MPAI_SCHEMA_AIF = {._name = "AIF", ._nodes = schema_aif_nodes, ._node_count = 13};
+
+static const char* const schema_aiw_enum_3[] = {"Basic", "Main", "Secure", NULL};
+static const char* const schema_aiw_enum_28[] = {"Input", "Output", "InputOutput", NULL};
+static const char* const schema_aiw_enum_30[] = {"Hardware", "Software", NULL};
+
+static const mpai_schema_node_t schema_aiw_nodes[] = {
+	/* 0 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 11, ._first_child = 1, ._required = 0x000000C1, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 1 */ {._key = "title", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 1, ._max_length = 63, ._enum = NULL},
+	/* 2 */ {._key = "Identifier", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 12, ._required = 0x00000002, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 3 */ {._key = "APIProfile", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = schema_aiw_enum_3},
+	/* 4 */ {._key = "Description", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 5 */ {._key = "Types", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 14, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 6 */ {._key = "Ports", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 15, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 7 */ {._key = "Topology", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 16, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 8 */ {._key = "SubAIMs", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 17, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 9 */ {._key = "Implementations", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 18, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 10 */ {._key = "ResourcePolicies", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 19, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 11 */ {._key = "Documentation", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 20, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 12 */ {._key = "ImplementerID", ._types = MPAI_SCHEMA_TYPE_INTEGER, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 13 */ {._key = "Specification", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 4, ._first_child = 21, ._required = 0x00000004, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 14 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 25, ._required = 0x00000003, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 15 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 6, ._first_child = 27, ._required = 0x00000003, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 16 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 33, ._required = 0x00000003, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 17 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 35, ._required = 0x00000002, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 18 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 6, ._first_child = 37, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 19 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 4, ._first_child = 43, ._required = 0x00000001, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 20 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 47, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 21 */ {._key = "Standard", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 22 */ {._key = "AIW", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 23 */ {._key = "AIM", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 1, ._max_length = 31, ._enum = NULL},
+	/* 24 */ {._key = "Version", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 25 */ {._key = "Name", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 26 */ {._key = "Type", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 27 */ {._key = "Name", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 1, ._max_length = 0, ._enum = NULL},
+	/* 28 */ {._key = "Direction", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = schema_aiw_enum_28},
+	/* 29 */ {._key = "RecordType", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 30 */ {._key = "Technology", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = schema_aiw_enum_30},
+	/* 31 */ {._key = "Protocol", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 32 */ {._key = "IsRemote", ._types = MPAI_SCHEMA_TYPE_BOOLEAN, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 33 */ {._key = "Output", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 49, ._required = 0x00000003, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 34 */ {._key = "Input", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 51, ._required = 0x00000003, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 35 */ {._key = "Name", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 36 */ {._key = "Identifier", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 53, ._required = 0x00000002, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 37 */ {._key = "BinaryName", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 38 */ {._key = "Architecture", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 39 */ {._key = "OperatingSystem", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 40 */ {._key = "Version", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 41 */ {._key = "Source", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 42 */ {._key = "Destination", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 43 */ {._key = "Name", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 44 */ {._key = "Minimum", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 45 */ {._key = "Maximum", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 46 */ {._key = "Request", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 47 */ {._key = "Type", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 48 */ {._key = "URI", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 49 */ {._key = "AIMName", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 31, ._enum = NULL},
+	/* 50 */ {._key = "PortName", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 31, ._enum = NULL},
+	/* 51 */ {._key = "AIMName", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 31, ._enum = NULL},
+	/* 52 */ {._key = "PortName", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 31, ._enum = NULL},
+	/* 53 */ {._key = "ImplementerID", ._types = MPAI_SCHEMA_TYPE_INTEGER, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 54 */ {._key = "Specification", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 4, ._first_child = 55, ._required = 0x00000004, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 55 */ {._key = "Standard", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 56 */ {._key = "AIW", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 57 */ {._key = "AIM", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 1, ._max_length = 31, ._enum = NULL},
+	/* 58 */ {._key = "Version", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+};
+
+const mpai_schema_t MPAI_SCHEMA_AIW = {._name = "AIW", ._nodes = schema_aiw_nodes, ._node_count = 59};
+
+
+static const mpai_schema_node_t schema_aim_nodes[] = {
+	/* 0 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 7, ._first_child = 1, ._required = 0x00000001, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 1 */ {._key = "Identifier", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 8, ._required = 0x00000002, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 2 */ {._key = "Description", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 3 */ {._key = "Ports", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 4 */ {._key = "Topology", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 5 */ {._key = "SubAIMs", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 6 */ {._key = "Implementations", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 7 */ {._key = "Documentation", ._types = MPAI_SCHEMA_TYPE_ARRAY, ._child_count = 1, ._first_child = 10, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 8 */ {._key = "ImplementerID", ._types = MPAI_SCHEMA_TYPE_INTEGER, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 9 */ {._key = "Specification", ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 4, ._first_child = 11, ._required = 0x00000004, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 10 */ {._key = NULL, ._types = MPAI_SCHEMA_TYPE_OBJECT, ._child_count = 2, ._first_child = 15, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 11 */ {._key = "Name", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 12 */ {._key = "AIW", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 13 */ {._key = "AIM", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 1, ._max_length = 31, ._enum = NULL},
+	/* 14 */ {._key = "Version", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 15 */ {._key = "Type", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+	/* 16 */ {._key = "URI", ._types = MPAI_SCHEMA_TYPE_STRING, ._child_count = 0, ._first_child = MPAI_SCHEMA_NO_NODE, ._required = 0x00000000, ._min_length = 0, ._max_length = 0, ._enum = NULL},
+};
+
+const mpai_schema_t MPAI_SCHEMA_AIM = {._name = "AIM", ._nodes = schema_aim_nodes, ._node_count = 17};
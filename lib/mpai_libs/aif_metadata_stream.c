@@ -0,0 +1,826 @@
+/*
+ * @file
+ * @brief Implementation of a streaming (SAX-style) JSON parser
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "aif_metadata_stream.h"
+
+LOG_MODULE_REGISTER(MPAI_LIBS_AIF_METADATA_STREAM, LOG_LEVEL_INF);
+
+/* States of the parser */
+enum
+{
+	JSON_STREAM_VALUE,				// expecting a value
+	JSON_STREAM_VALUE_OR_END,		// after '['
+	JSON_STREAM_KEY_OR_END,			// after '{'
+	JSON_STREAM_KEY,				// after ',' in an object
+	JSON_STREAM_COLON,
+	JSON_STREAM_NEXT,				// after a value, expecting ',' or the end of the container
+	JSON_STREAM_STRING,
+	JSON_STREAM_ESCAPE,
+	JSON_STREAM_UNICODE,
+	JSON_STREAM_LITERAL,			// number, true, false or null
+	JSON_STREAM_DONE,				// root value completed
+	CBOR_STREAM_HEADER,				// expecting the initial byte of an item
+	CBOR_STREAM_ARGUMENT,			// reading the argument that follows the initial byte
+	CBOR_STREAM_TEXT				// reading a text string
+};
+
+/* CBOR major types */
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_NEGINT 1
+#define CBOR_MAJOR_BYTES 2
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+#define CBOR_MAJOR_SIMPLE 7
+/* CBOR additional information */
+#define CBOR_INFO_UINT8 24
+#define CBOR_INFO_UINT64 27
+#define CBOR_INFO_INDEFINITE 31
+#define CBOR_SIMPLE_FALSE 20
+#define CBOR_SIMPLE_TRUE 21
+#define CBOR_SIMPLE_NULL 22
+#define CBOR_SIMPLE_UNDEFINED 23
+#define CBOR_FLOAT_HALF 25
+#define CBOR_FLOAT_SINGLE 26
+#define CBOR_FLOAT_DOUBLE 27
+
+/************* PRIVATE HEADER *************/
+/* process a single char, returning false on error */
+bool _json_stream_process(mpai_json_stream_t* stream, char c, bool* reprocess);
+/* emit an event to the callback */
+bool _json_stream_emit(mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value);
+/* open a container */
+bool _json_stream_push(mpai_json_stream_t* stream, bool is_array);
+/* close a container */
+bool _json_stream_pop(mpai_json_stream_t* stream, bool is_array);
+/* move to the next state after a value */
+void _json_stream_value_done(mpai_json_stream_t* stream);
+/* emit the literal read */
+bool _json_stream_literal_done(mpai_json_stream_t* stream);
+/* append a char to the current token, truncating it if too long */
+void _json_stream_append(mpai_json_stream_t* stream, char c);
+/* append a code point of a \uXXXX escape, as UTF-8 */
+void _json_stream_append_unicode(mpai_json_stream_t* stream, uint16_t code_point);
+/* validate a number according with JSON grammar */
+bool _json_stream_is_number(const char* token);
+/* check if the char is a whitespace */
+bool _json_stream_is_space(char c);
+/* process a single byte of a CBOR document, returning false on error */
+bool _cbor_stream_process(mpai_json_stream_t* stream, uint8_t b);
+/* handle an item whose initial byte and argument have been read */
+bool _cbor_stream_item(mpai_json_stream_t* stream, uint8_t major, uint8_t info, uint64_t argument);
+/* handle a text string read (key or value) */
+bool _cbor_stream_text_done(mpai_json_stream_t* stream);
+/* open a container of a known number of items (or indefinite) */
+bool _cbor_stream_push(mpai_json_stream_t* stream, bool is_array, uint64_t items, bool indefinite);
+/* count a value read in its container, closing the containers completed */
+bool _cbor_stream_value_done(mpai_json_stream_t* stream);
+/* emit a number as text, as it would appear in a JSON document */
+bool _cbor_stream_emit_number(mpai_json_stream_t* stream, bool negative, uint64_t magnitude);
+/* emit a floating point number */
+bool _cbor_stream_emit_float(mpai_json_stream_t* stream, double value);
+
+/************* PUBLIC **************/
+void MPAI_JSON_Stream_Init(mpai_json_stream_t* stream, mpai_json_stream_callback_t* callback, void* user_data)
+{
+	memset(stream, 0, sizeof(mpai_json_stream_t));
+	stream->_callback = callback;
+	stream->_user_data = user_data;
+	stream->_state = JSON_STREAM_VALUE;
+}
+
+void MPAI_CBOR_Stream_Init(mpai_json_stream_t* stream, mpai_json_stream_callback_t* callback, void* user_data)
+{
+	MPAI_JSON_Stream_Init(stream, callback, user_data);
+	stream->_format = MPAI_METADATA_FORMAT_CBOR;
+	stream->_state = CBOR_STREAM_HEADER;
+}
+
+bool MPAI_JSON_Stream_Feed(mpai_json_stream_t* stream, const char* data, size_t len)
+{
+	if (stream->_format == MPAI_METADATA_FORMAT_CBOR)
+	{
+		for (size_t i = 0; !stream->_error && i < len; i++)
+		{
+			stream->_error = !_cbor_stream_process(stream, (uint8_t)data[i]);
+		}
+		return !stream->_error;
+	}
+
+	size_t i = 0;
+	while (!stream->_error && i < len)
+	{
+		bool reprocess = false;
+		if (!_json_stream_process(stream, data[i], &reprocess))
+		{
+			stream->_error = true;
+			break;
+		}
+		// a literal is terminated by the first char not belonging to it, that has to be processed again
+		if (!reprocess)
+		{
+			i++;
+		}
+	}
+	return !stream->_error;
+}
+
+bool MPAI_JSON_Stream_End(mpai_json_stream_t* stream)
+{
+	if (!stream->_error && stream->_format == MPAI_METADATA_FORMAT_JSON && stream->_state == JSON_STREAM_LITERAL && stream->_depth == 0)
+	{
+		stream->_error = !_json_stream_literal_done(stream);
+	}
+	if (!stream->_error && stream->_state != JSON_STREAM_DONE)
+	{
+		LOG_ERR("Metadata document truncated");
+		stream->_error = true;
+	}
+	return !stream->_error;
+}
+
+bool MPAI_JSON_Stream_Path_Is(const mpai_json_stream_t* stream, const char* path)
+{
+	const char* p = path;
+	for (size_t d = 0; d < stream->_depth; d++)
+	{
+		const char* end = strchr(p, '.');
+		size_t len = end != NULL ? (size_t)(end - p) : strlen(p);
+		const mpai_json_stream_frame_t* frame = &stream->_frames[d];
+
+		if (len == 0)
+		{
+			return false;
+		}
+		if (frame->_is_array)
+		{
+			if (len != 1 || *p != '*')
+			{
+				return false;
+			}
+		}
+		else if (strlen(frame->_key) != len || strncmp(frame->_key, p, len) != 0)
+		{
+			return false;
+		}
+
+		if (end == NULL)
+		{
+			// path is shorter than the current depth, unless this is the last level
+			return d == stream->_depth - 1;
+		}
+		p = end + 1;
+	}
+	// empty path matches the root value
+	return stream->_depth == 0 && *path == '\0';
+}
+
+const char* MPAI_JSON_Stream_Key(const mpai_json_stream_t* stream)
+{
+	if (stream->_depth == 0 || stream->_frames[stream->_depth - 1]._is_array)
+	{
+		return NULL;
+	}
+	return stream->_frames[stream->_depth - 1]._key;
+}
+
+/************* PRIVATE **************/
+bool _json_stream_process(mpai_json_stream_t* stream, char c, bool* reprocess)
+{
+	switch (stream->_state)
+	{
+	case JSON_STREAM_STRING:
+		if (c == '"')
+		{
+			if (stream->_in_key)
+			{
+				mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth - 1];
+				strncpy(frame->_key, stream->_token, MPAI_JSON_STREAM_KEY_LEN - 1);
+				frame->_key[MPAI_JSON_STREAM_KEY_LEN - 1] = '\0';
+				stream->_state = JSON_STREAM_COLON;
+				return true;
+			}
+			if (!_json_stream_emit(stream, MPAI_JSON_STREAM_STRING, stream->_token))
+			{
+				return false;
+			}
+			_json_stream_value_done(stream);
+			return true;
+		}
+		if (c == '\\')
+		{
+			stream->_state = JSON_STREAM_ESCAPE;
+			return true;
+		}
+		if ((unsigned char)c < 0x20)
+		{
+			LOG_ERR("Control char not escaped in JSON string");
+			return false;
+		}
+		_json_stream_append(stream, c);
+		return true;
+
+	case JSON_STREAM_ESCAPE:
+		stream->_state = JSON_STREAM_STRING;
+		switch (c)
+		{
+		case '"': case '\\': case '/':
+			_json_stream_append(stream, c);
+			return true;
+		case 'b':
+			_json_stream_append(stream, '\b');
+			return true;
+		case 'f':
+			_json_stream_append(stream, '\f');
+			return true;
+		case 'n':
+			_json_stream_append(stream, '\n');
+			return true;
+		case 'r':
+			_json_stream_append(stream, '\r');
+			return true;
+		case 't':
+			_json_stream_append(stream, '\t');
+			return true;
+		case 'u':
+			stream->_state = JSON_STREAM_UNICODE;
+			stream->_unicode_digits = 0;
+			stream->_unicode = 0;
+			return true;
+		default:
+			LOG_ERR("Invalid escape in JSON string");
+			return false;
+		}
+
+	case JSON_STREAM_UNICODE:
+		if (!isxdigit((unsigned char)c))
+		{
+			LOG_ERR("Invalid unicode escape in JSON string");
+			return false;
+		}
+		stream->_unicode = (stream->_unicode << 4) | (isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+		if (++stream->_unicode_digits == 4)
+		{
+			_json_stream_append_unicode(stream, stream->_unicode);
+			stream->_state = JSON_STREAM_STRING;
+		}
+		return true;
+
+	case JSON_STREAM_LITERAL:
+		if (isalnum((unsigned char)c) || c == '-' || c == '+' || c == '.')
+		{
+			_json_stream_append(stream, c);
+			return true;
+		}
+		*reprocess = true;
+		return _json_stream_literal_done(stream);
+
+	default:
+		break;
+	}
+
+	if (_json_stream_is_space(c))
+	{
+		return true;
+	}
+
+	switch (stream->_state)
+	{
+	case JSON_STREAM_VALUE_OR_END:
+		if (c == ']')
+		{
+			return _json_stream_pop(stream, true);
+		}
+		// fall through
+	case JSON_STREAM_VALUE:
+		stream->_token_len = 0;
+		stream->_token[0] = '\0';
+		if (c == '{')
+		{
+			return _json_stream_push(stream, false);
+		}
+		if (c == '[')
+		{
+			return _json_stream_push(stream, true);
+		}
+		if (c == '"')
+		{
+			stream->_in_key = false;
+			stream->_state = JSON_STREAM_STRING;
+			return true;
+		}
+		if (c == '-' || isdigit((unsigned char)c) || c == 't' || c == 'f' || c == 'n')
+		{
+			_json_stream_append(stream, c);
+			stream->_state = JSON_STREAM_LITERAL;
+			return true;
+		}
+		break;
+
+	case JSON_STREAM_KEY_OR_END:
+		if (c == '}')
+		{
+			return _json_stream_pop(stream, false);
+		}
+		// fall through
+	case JSON_STREAM_KEY:
+		if (c == '"')
+		{
+			stream->_token_len = 0;
+			stream->_token[0] = '\0';
+			stream->_in_key = true;
+			stream->_state = JSON_STREAM_STRING;
+			return true;
+		}
+		break;
+
+	case JSON_STREAM_COLON:
+		if (c == ':')
+		{
+			stream->_state = JSON_STREAM_VALUE;
+			return true;
+		}
+		break;
+
+	case JSON_STREAM_NEXT:
+		if (c == ',')
+		{
+			mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth - 1];
+			if (frame->_is_array)
+			{
+				frame->_index++;
+				stream->_state = JSON_STREAM_VALUE;
+			}
+			else
+			{
+				stream->_state = JSON_STREAM_KEY;
+			}
+			return true;
+		}
+		if (c == '}' || c == ']')
+		{
+			return _json_stream_pop(stream, c == ']');
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	LOG_ERR("Unexpected char '%c' in JSON document", c);
+	return false;
+}
+
+bool _json_stream_emit(mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value)
+{
+	if (stream->_callback == NULL)
+	{
+		return true;
+	}
+	return stream->_callback(stream, event, value, stream->_user_data);
+}
+
+bool _json_stream_push(mpai_json_stream_t* stream, bool is_array)
+{
+	if (stream->_depth >= MPAI_JSON_STREAM_MAX_DEPTH)
+	{
+		LOG_ERR("JSON document too deep");
+		return false;
+	}
+	// the event is emitted with the path of the container
+	if (!_json_stream_emit(stream, is_array ? MPAI_JSON_STREAM_ARRAY_BEGIN : MPAI_JSON_STREAM_OBJECT_BEGIN, NULL))
+	{
+		return false;
+	}
+	mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth++];
+	memset(frame, 0, sizeof(mpai_json_stream_frame_t));
+	frame->_is_array = is_array;
+	stream->_state = is_array ? JSON_STREAM_VALUE_OR_END : JSON_STREAM_KEY_OR_END;
+	return true;
+}
+
+bool _json_stream_pop(mpai_json_stream_t* stream, bool is_array)
+{
+	if (stream->_depth == 0 || stream->_frames[stream->_depth - 1]._is_array != is_array)
+	{
+		LOG_ERR("Unbalanced container in JSON document");
+		return false;
+	}
+	stream->_depth--;
+	if (!_json_stream_emit(stream, is_array ? MPAI_JSON_STREAM_ARRAY_END : MPAI_JSON_STREAM_OBJECT_END, NULL))
+	{
+		return false;
+	}
+	_json_stream_value_done(stream);
+	return true;
+}
+
+void _json_stream_value_done(mpai_json_stream_t* stream)
+{
+	stream->_state = stream->_depth == 0 ? JSON_STREAM_DONE : JSON_STREAM_NEXT;
+}
+
+bool _json_stream_literal_done(mpai_json_stream_t* stream)
+{
+	MPAI_JSON_STREAM_EVENT event;
+	const char* value = NULL;
+
+	if (strcmp(stream->_token, "true") == 0)
+	{
+		event = MPAI_JSON_STREAM_TRUE;
+	}
+	else if (strcmp(stream->_token, "false") == 0)
+	{
+		event = MPAI_JSON_STREAM_FALSE;
+	}
+	else if (strcmp(stream->_token, "null") == 0)
+	{
+		event = MPAI_JSON_STREAM_NULL;
+	}
+	else if (_json_stream_is_number(stream->_token))
+	{
+		event = MPAI_JSON_STREAM_NUMBER;
+		value = stream->_token;
+	}
+	else
+	{
+		LOG_ERR("Invalid literal in JSON document");
+		return false;
+	}
+
+	if (!_json_stream_emit(stream, event, value))
+	{
+		return false;
+	}
+	_json_stream_value_done(stream);
+	return true;
+}
+
+void _json_stream_append(mpai_json_stream_t* stream, char c)
+{
+	if (stream->_token_len < MPAI_JSON_STREAM_VALUE_LEN - 1)
+	{
+		stream->_token[stream->_token_len++] = c;
+		stream->_token[stream->_token_len] = '\0';
+	}
+}
+
+void _json_stream_append_unicode(mpai_json_stream_t* stream, uint16_t code_point)
+{
+	if (code_point < 0x80)
+	{
+		_json_stream_append(stream, (char)code_point);
+	}
+	else if (code_point < 0x800)
+	{
+		_json_stream_append(stream, (char)(0xC0 | (code_point >> 6)));
+		_json_stream_append(stream, (char)(0x80 | (code_point & 0x3F)));
+	}
+	else
+	{
+		// surrogate pairs are not combined: metadata names are expected to be in the BMP
+		_json_stream_append(stream, (char)(0xE0 | (code_point >> 12)));
+		_json_stream_append(stream, (char)(0x80 | ((code_point >> 6) & 0x3F)));
+		_json_stream_append(stream, (char)(0x80 | (code_point & 0x3F)));
+	}
+}
+
+bool _json_stream_is_number(const char* token)
+{
+	const char* p = token;
+	if (*p == '-')
+	{
+		p++;
+	}
+	if (!isdigit((unsigned char)*p))
+	{
+		return false;
+	}
+	if (*p == '0')
+	{
+		p++;
+	}
+	else
+	{
+		while (isdigit((unsigned char)*p))
+		{
+			p++;
+		}
+	}
+	if (*p == '.')
+	{
+		p++;
+		if (!isdigit((unsigned char)*p))
+		{
+			return false;
+		}
+		while (isdigit((unsigned char)*p))
+		{
+			p++;
+		}
+	}
+	if (*p == 'e' || *p == 'E')
+	{
+		p++;
+		if (*p == '+' || *p == '-')
+		{
+			p++;
+		}
+		if (!isdigit((unsigned char)*p))
+		{
+			return false;
+		}
+		while (isdigit((unsigned char)*p))
+		{
+			p++;
+		}
+	}
+	return *p == '\0';
+}
+
+bool _json_stream_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool _cbor_stream_process(mpai_json_stream_t* stream, uint8_t b)
+{
+	switch (stream->_state)
+	{
+	case CBOR_STREAM_TEXT:
+		_json_stream_append(stream, (char)b);
+		if (--stream->_cbor_text_len == 0)
+		{
+			return _cbor_stream_text_done(stream);
+		}
+		return true;
+
+	case CBOR_STREAM_ARGUMENT:
+		stream->_cbor_argument = (stream->_cbor_argument << 8) | b;
+		if (--stream->_cbor_argument_len == 0)
+		{
+			return _cbor_stream_item(stream, stream->_cbor_major, stream->_cbor_info, stream->_cbor_argument);
+		}
+		return true;
+
+	case CBOR_STREAM_HEADER:
+		stream->_cbor_major = b >> 5;
+		stream->_cbor_info = b & 0x1F;
+		if (stream->_cbor_info < CBOR_INFO_UINT8)
+		{
+			return _cbor_stream_item(stream, stream->_cbor_major, stream->_cbor_info, stream->_cbor_info);
+		}
+		if (stream->_cbor_info <= CBOR_INFO_UINT64)
+		{
+			// argument of 1, 2, 4 or 8 bytes, in network byte order
+			stream->_cbor_argument_len = 1 << (stream->_cbor_info - CBOR_INFO_UINT8);
+			stream->_cbor_argument = 0;
+			stream->_state = CBOR_STREAM_ARGUMENT;
+			return true;
+		}
+		if (stream->_cbor_info == CBOR_INFO_INDEFINITE)
+		{
+			return _cbor_stream_item(stream, stream->_cbor_major, stream->_cbor_info, 0);
+		}
+		LOG_ERR("Reserved additional information in CBOR document");
+		return false;
+
+	default:
+		LOG_ERR("Unexpected data after the end of CBOR document");
+		return false;
+	}
+}
+
+bool _cbor_stream_item(mpai_json_stream_t* stream, uint8_t major, uint8_t info, uint64_t argument)
+{
+	mpai_json_stream_frame_t* frame = stream->_depth > 0 ? &stream->_frames[stream->_depth - 1] : NULL;
+	bool expect_key = frame != NULL && !frame->_is_array && frame->_expect_key;
+	bool indefinite = info == CBOR_INFO_INDEFINITE;
+
+	stream->_state = CBOR_STREAM_HEADER;
+
+	// break closes the current indefinite container
+	if (major == CBOR_MAJOR_SIMPLE && indefinite)
+	{
+		if (frame == NULL || !frame->_indefinite || (!frame->_is_array && !frame->_expect_key))
+		{
+			LOG_ERR("Unexpected break in CBOR document");
+			return false;
+		}
+		stream->_depth--;
+		if (!_json_stream_emit(stream, frame->_is_array ? MPAI_JSON_STREAM_ARRAY_END : MPAI_JSON_STREAM_OBJECT_END, NULL))
+		{
+			return false;
+		}
+		return _cbor_stream_value_done(stream);
+	}
+	// tags are ignored: the tagged item follows
+	if (major == CBOR_MAJOR_TAG && !indefinite)
+	{
+		return true;
+	}
+	if (expect_key && major != CBOR_MAJOR_TEXT)
+	{
+		LOG_ERR("Only text keys are supported in CBOR maps");
+		return false;
+	}
+	if (indefinite && major != CBOR_MAJOR_ARRAY && major != CBOR_MAJOR_MAP)
+	{
+		LOG_ERR("Indefinite length item not supported in CBOR document");
+		return false;
+	}
+
+	switch (major)
+	{
+	case CBOR_MAJOR_UINT:
+		return _cbor_stream_emit_number(stream, false, argument);
+	case CBOR_MAJOR_NEGINT:
+		// value is -1 - argument
+		if (argument == UINT64_MAX)
+		{
+			LOG_ERR("Negative integer out of range in CBOR document");
+			return false;
+		}
+		return _cbor_stream_emit_number(stream, true, argument + 1);
+	case CBOR_MAJOR_TEXT:
+		stream->_in_key = expect_key;
+		stream->_token_len = 0;
+		stream->_token[0] = '\0';
+		if (argument == 0)
+		{
+			return _cbor_stream_text_done(stream);
+		}
+		stream->_cbor_text_len = argument;
+		stream->_state = CBOR_STREAM_TEXT;
+		return true;
+	case CBOR_MAJOR_ARRAY:
+		return _cbor_stream_push(stream, true, argument, indefinite);
+	case CBOR_MAJOR_MAP:
+		if (!indefinite && argument > UINT32_MAX / 2)
+		{
+			LOG_ERR("CBOR map too big");
+			return false;
+		}
+		return _cbor_stream_push(stream, false, argument * 2, indefinite);
+	case CBOR_MAJOR_SIMPLE:
+		switch (info)
+		{
+		case CBOR_SIMPLE_FALSE:
+			return _json_stream_emit(stream, MPAI_JSON_STREAM_FALSE, NULL) && _cbor_stream_value_done(stream);
+		case CBOR_SIMPLE_TRUE:
+			return _json_stream_emit(stream, MPAI_JSON_STREAM_TRUE, NULL) && _cbor_stream_value_done(stream);
+		case CBOR_SIMPLE_NULL:
+		case CBOR_SIMPLE_UNDEFINED:
+			return _json_stream_emit(stream, MPAI_JSON_STREAM_NULL, NULL) && _cbor_stream_value_done(stream);
+		case CBOR_FLOAT_HALF:
+		{
+			uint16_t half = (uint16_t)argument;
+			int exponent = (half >> 10) & 0x1F;
+			int mantissa = half & 0x3FF;
+			double value = exponent == 0 ? ldexp(mantissa, -24) : (exponent != 31 ? ldexp(mantissa + 1024, exponent - 25) : NAN);
+			return _cbor_stream_emit_float(stream, (half & 0x8000) ? -value : value);
+		}
+		case CBOR_FLOAT_SINGLE:
+		{
+			uint32_t bits = (uint32_t)argument;
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			return _cbor_stream_emit_float(stream, value);
+		}
+		case CBOR_FLOAT_DOUBLE:
+		{
+			double value;
+			memcpy(&value, &argument, sizeof(value));
+			return _cbor_stream_emit_float(stream, value);
+		}
+		default:
+			break;
+		}
+		// fall through
+	default:
+		// byte strings and other simple values are not in the JSON data model
+		LOG_ERR("Unsupported item (major type %d) in CBOR document", major);
+		return false;
+	}
+}
+
+bool _cbor_stream_text_done(mpai_json_stream_t* stream)
+{
+	stream->_state = CBOR_STREAM_HEADER;
+	if (stream->_in_key)
+	{
+		mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth - 1];
+		strncpy(frame->_key, stream->_token, MPAI_JSON_STREAM_KEY_LEN - 1);
+		frame->_key[MPAI_JSON_STREAM_KEY_LEN - 1] = '\0';
+		frame->_expect_key = false;
+		if (!frame->_indefinite)
+		{
+			frame->_remaining--;
+		}
+		return true;
+	}
+	return _json_stream_emit(stream, MPAI_JSON_STREAM_STRING, stream->_token) && _cbor_stream_value_done(stream);
+}
+
+bool _cbor_stream_push(mpai_json_stream_t* stream, bool is_array, uint64_t items, bool indefinite)
+{
+	if (stream->_depth >= MPAI_JSON_STREAM_MAX_DEPTH)
+	{
+		LOG_ERR("CBOR document too deep");
+		return false;
+	}
+	if (items > UINT32_MAX)
+	{
+		LOG_ERR("CBOR array too big");
+		return false;
+	}
+	// the event is emitted with the path of the container
+	if (!_json_stream_emit(stream, is_array ? MPAI_JSON_STREAM_ARRAY_BEGIN : MPAI_JSON_STREAM_OBJECT_BEGIN, NULL))
+	{
+		return false;
+	}
+	mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth++];
+	memset(frame, 0, sizeof(mpai_json_stream_frame_t));
+	frame->_is_array = is_array;
+	frame->_remaining = (uint32_t)items;
+	frame->_indefinite = indefinite;
+	frame->_expect_key = !is_array;
+
+	// empty container is closed immediately
+	if (!indefinite && items == 0)
+	{
+		stream->_depth--;
+		if (!_json_stream_emit(stream, is_array ? MPAI_JSON_STREAM_ARRAY_END : MPAI_JSON_STREAM_OBJECT_END, NULL))
+		{
+			return false;
+		}
+		return _cbor_stream_value_done(stream);
+	}
+	return true;
+}
+
+bool _cbor_stream_value_done(mpai_json_stream_t* stream)
+{
+	while (stream->_depth > 0)
+	{
+		mpai_json_stream_frame_t* frame = &stream->_frames[stream->_depth - 1];
+		frame->_expect_key = !frame->_is_array;
+		frame->_index++;
+		if (frame->_indefinite || --frame->_remaining > 0)
+		{
+			stream->_state = CBOR_STREAM_HEADER;
+			return true;
+		}
+		// last item of the container: the container itself is a value of its parent
+		stream->_depth--;
+		if (!_json_stream_emit(stream, frame->_is_array ? MPAI_JSON_STREAM_ARRAY_END : MPAI_JSON_STREAM_OBJECT_END, NULL))
+		{
+			return false;
+		}
+	}
+	stream->_state = JSON_STREAM_DONE;
+	return true;
+}
+
+bool _cbor_stream_emit_number(mpai_json_stream_t* stream, bool negative, uint64_t magnitude)
+{
+	char digits[21];
+	size_t count = 0;
+	do
+	{
+		digits[count++] = '0' + (magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	stream->_token_len = 0;
+	if (negative)
+	{
+		stream->_token[stream->_token_len++] = '-';
+	}
+	while (count > 0)
+	{
+		stream->_token[stream->_token_len++] = digits[--count];
+	}
+	stream->_token[stream->_token_len] = '\0';
+
+	return _json_stream_emit(stream, MPAI_JSON_STREAM_NUMBER, stream->_token) && _cbor_stream_value_done(stream);
+}
+
+bool _cbor_stream_emit_float(mpai_json_stream_t* stream, double value)
+{
+	if (isnan(value) || isinf(value))
+	{
+		// not representable in JSON
+		return _json_stream_emit(stream, MPAI_JSON_STREAM_NULL, NULL) && _cbor_stream_value_done(stream);
+	}
+	snprintf(stream->_token, MPAI_JSON_STREAM_VALUE_LEN, "%.17g", value);
+	stream->_token_len = strlen(stream->_token);
+	return _json_stream_emit(stream, MPAI_JSON_STREAM_NUMBER, stream->_token) && _cbor_stream_value_done(stream);
+}
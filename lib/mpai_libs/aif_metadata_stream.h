@@ -0,0 +1,150 @@
+/*
+ * @file
+ * @brief Headers of a streaming (SAX-style) JSON parser: the document is fed in chunks of any size
+ * (i.e. CoAP blocks) and an event is emitted for each value, without building a tree.
+ * Documents encoded in CBOR (RFC 8949) are decoded by the same parser, emitting the same events
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_AIF_METADATA_STREAM_H
+#define MPAI_LIBS_AIF_METADATA_STREAM_H
+
+#include <core_common.h>
+#include <ctype.h>
+#include <math.h>
+
+/* Max nesting of objects and arrays */
+#define MPAI_JSON_STREAM_MAX_DEPTH 10
+/* Max length of a key (longer keys are truncated) */
+#define MPAI_JSON_STREAM_KEY_LEN 32
+/* Max length of a string or number value (longer values are truncated) */
+#define MPAI_JSON_STREAM_VALUE_LEN 64
+
+/* Encoding of the document */
+typedef enum
+{
+	MPAI_METADATA_FORMAT_JSON,
+	MPAI_METADATA_FORMAT_CBOR
+} MPAI_METADATA_FORMAT;
+
+/* Events emitted by the parser */
+typedef enum
+{
+	MPAI_JSON_STREAM_OBJECT_BEGIN,
+	MPAI_JSON_STREAM_OBJECT_END,
+	MPAI_JSON_STREAM_ARRAY_BEGIN,
+	MPAI_JSON_STREAM_ARRAY_END,
+	MPAI_JSON_STREAM_STRING,
+	MPAI_JSON_STREAM_NUMBER,
+	MPAI_JSON_STREAM_TRUE,
+	MPAI_JSON_STREAM_FALSE,
+	MPAI_JSON_STREAM_NULL
+} MPAI_JSON_STREAM_EVENT;
+
+typedef struct _mpai_json_stream_t mpai_json_stream_t;
+
+/**
+ * @brief Callback called for each event: the path of the value is available with MPAI_JSON_Stream_Path_Is
+ *
+ * @param stream
+ * @param event
+ * @param value value of strings and numbers, NULL otherwise
+ * @param user_data
+ * @return true to go on
+ * @return false to stop parsing with an error
+ */
+typedef bool (mpai_json_stream_callback_t)(const mpai_json_stream_t* stream, MPAI_JSON_STREAM_EVENT event, const char* value, void* user_data);
+
+/* Container (object or array) opened and not closed yet */
+typedef struct _mpai_json_stream_frame_t {
+	bool _is_array;
+	int _index;										// index of the current element of the array
+	char _key[MPAI_JSON_STREAM_KEY_LEN];			// key of the current member of the object
+	uint32_t _remaining;							// CBOR: items (keys and values) not read yet
+	bool _indefinite;								// CBOR: container terminated by a break
+	bool _expect_key;								// CBOR: next item of the map is a key
+} mpai_json_stream_frame_t;
+
+struct _mpai_json_stream_t {
+	MPAI_METADATA_FORMAT _format;
+	mpai_json_stream_callback_t* _callback;
+	void* _user_data;
+	mpai_json_stream_frame_t _frames[MPAI_JSON_STREAM_MAX_DEPTH];
+	uint8_t _depth;
+	uint8_t _state;
+	bool _in_key;									// string read is a key
+	uint8_t _unicode_digits;						// hex digits of \uXXXX read until now
+	uint16_t _unicode;
+	char _token[MPAI_JSON_STREAM_VALUE_LEN];		// string, number or literal read until now
+	size_t _token_len;
+	uint8_t _cbor_major;							// CBOR: major type of the item read
+	uint8_t _cbor_info;								// CBOR: additional information of the item read
+	uint8_t _cbor_argument_len;						// CBOR: bytes of the argument not read yet
+	uint64_t _cbor_argument;
+	uint64_t _cbor_text_len;						// CBOR: bytes of the text string not read yet
+	bool _error;
+};
+
+/**
+ * @brief Initialize a stream parser
+ *
+ * @param stream
+ * @param callback called for each event
+ * @param user_data data passed to the callback
+ */
+void MPAI_JSON_Stream_Init(mpai_json_stream_t* stream, mpai_json_stream_callback_t* callback, void* user_data);
+
+/**
+ * @brief Initialize a stream parser for a document encoded in CBOR: it's fed and ended
+ * with the same functions of JSON, and emits the same events
+ * (text keys only, no byte strings and no indefinite-length strings)
+ *
+ * @param stream
+ * @param callback called for each event
+ * @param user_data data passed to the callback
+ */
+void MPAI_CBOR_Stream_Init(mpai_json_stream_t* stream, mpai_json_stream_callback_t* callback, void* user_data);
+
+/**
+ * @brief Feed a chunk of the document: it could split tokens at any point
+ *
+ * @param stream
+ * @param data
+ * @param len
+ * @return true
+ * @return false on syntax error or if the callback stopped the parsing
+ */
+bool MPAI_JSON_Stream_Feed(mpai_json_stream_t* stream, const char* data, size_t len);
+
+/**
+ * @brief Notify the end of the document
+ *
+ * @param stream
+ * @return true if the document was complete and valid
+ * @return false
+ */
+bool MPAI_JSON_Stream_End(mpai_json_stream_t* stream);
+
+/**
+ * @brief Check the path of the current value, as a list of keys separated by '.' where "*" matches any element of an array
+ * (i.e. "Topology.*.Output.AIMName")
+ *
+ * @param stream
+ * @param path
+ * @return true
+ * @return false
+ */
+bool MPAI_JSON_Stream_Path_Is(const mpai_json_stream_t* stream, const char* path);
+
+/**
+ * @brief Key of the current value, when it's a member of an object
+ *
+ * @param stream
+ * @return const char* NULL for the root value and for the elements of an array
+ */
+const char* MPAI_JSON_Stream_Key(const mpai_json_stream_t* stream);
+
+#endif
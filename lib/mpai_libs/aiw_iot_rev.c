@@ -21,6 +21,74 @@ subscriber_channel_t MIC_BUFFER_DATA_CHANNEL;
 subscriber_channel_t MIC_PEAK_DATA_CHANNEL;
 subscriber_channel_t MOTION_DATA_CHANNEL;
 
+/* AIW global parameters of the AIMs, that can be changed while they are running */
+mpai_aim_parameter_t* motion_accel_tot_threshold_min;
+mpai_aim_parameter_t* motion_accel_tot_threshold_max;
+mpai_aim_parameter_t* motion_min_stop_delay_ms;
+mpai_aim_parameter_t* volume_peak_threshold_min;
+mpai_aim_parameter_t* volume_peak_threshold_max;
+mpai_aim_parameter_t* volume_median_peak_ratio_max;
+mpai_aim_parameter_t* sensors_rate_ms;
+
+/* The lists of the controller are filled only once: the AIW isn't initialized again */
+static bool aiw_iot_rev_initialized = false;
+
+#ifdef CONFIG_MPAI_AIM_TELEMETRY
+/* AIM outside the topology of the AIW: it's started with the AIW, subscribing to the channels configured */
+MPAI_Component_AIM_t* aim_telemetry;
+
+/******** START TELEMETRY ***********/
+telemetry_encoder_t* telemetry_encoder(const char* channel_name)
+{
+	if (strcmp(channel_name, MPAI_LIBS_IOT_REV_SENSORS_DATA_CHANNEL_NAME) == 0)
+	{
+		return telemetry_encode_sensors;
+	}
+	if (strcmp(channel_name, MPAI_LIBS_IOT_REV_MOTION_DATA_CHANNEL_NAME) == 0)
+	{
+		return telemetry_encode_motion;
+	}
+	if (strcmp(channel_name, MPAI_LIBS_IOT_REV_MIC_PEAK_DATA_CHANNEL_NAME) == 0)
+	{
+		return telemetry_encode_mic_peak;
+	}
+	// raw buffers (like the mic one) are too large to be sent
+	return NULL;
+}
+
+void telemetry_start()
+{
+	char channel_names[] = CONFIG_MPAI_AIM_TELEMETRY_CHANNELS;
+	char* saveptr;
+
+	for (char* name = strtok_r(channel_names, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr))
+	{
+		channel_map_element_t* channel_map_el = NULL;
+		for (size_t i = 0; i < mpai_message_store_channel_count; i++)
+		{
+			if (strcmp(message_store_channel_list[i]._channel_name, name) == 0)
+			{
+				channel_map_el = &message_store_channel_list[i];
+			}
+		}
+		telemetry_encoder_t* encoder = telemetry_encoder(name);
+		if (channel_map_el == NULL || encoder == NULL)
+		{
+			LOG_WRN("Channel %s can't be sent as telemetry", log_strdup(name));
+			continue;
+		}
+		if (telemetry_aim_add_channel(name, channel_map_el->_channel, encoder) == 0)
+		{
+			MPAI_MessageStore_register(message_store_telemetry_aim, telemetry_aim_subscriber, channel_map_el->_channel);
+		}
+	}
+
+	aim_telemetry = MPAI_AIM_Creator(MPAI_LIBS_IOT_REV_AIM_TELEMETRY_NAME, AIW_IOT_REV, telemetry_aim_subscriber, telemetry_aim_start, telemetry_aim_stop, telemetry_aim_resume, telemetry_aim_pause);
+	MPAI_AIM_Start(aim_telemetry);
+}
+/******** END TELEMETRY ***********/
+#endif
+
 #ifdef CONFIG_MPAI_AIM_CONTROL_UNIT_SENSORS_PERIODIC
 
 /******** START PERIODIC MODE ***********/
@@ -56,6 +124,13 @@ K_TIMER_DEFINE(aim_timer, aim_timer_handler, NULL);
 /************* PUBLIC HEADER *************/
 int MPAI_AIW_IOT_REV_Init() 
 {
+	if (aiw_iot_rev_initialized)
+	{
+		LOG_WRN("AIW %s already initialized", MPAI_LIBS_IOT_REV_AIW_NAME);
+		return -EALREADY;
+	}
+	aiw_iot_rev_initialized = true;
+
     // create message store for the AIW
     message_store_test_case_aiw = MPAI_MessageStore_Creator(AIW_IOT_REV, MPAI_LIBS_IOT_REV_AIW_NAME, sizeof(mpai_message_t));
 	message_store_map_element_t message_store_map_el_test_case_aiw = {._aiw_id = AIW_IOT_REV, ._message_store = message_store_test_case_aiw};
@@ -66,6 +141,9 @@ int MPAI_AIW_IOT_REV_Init()
     message_store_temp_limit_aim = message_store_test_case_aiw;
     message_store_motion_aim = message_store_test_case_aiw;
     message_store_rehabilitation_aim = message_store_test_case_aiw;
+#ifdef CONFIG_MPAI_AIM_TELEMETRY
+    message_store_telemetry_aim = message_store_test_case_aiw;
+#endif
 
     // create channels
     SENSORS_DATA_CHANNEL = MPAI_MessageStore_new_channel();
@@ -81,6 +159,15 @@ int MPAI_AIW_IOT_REV_Init()
 	channel_map_element_t motion_data_channel = {._channel_name = MPAI_LIBS_IOT_REV_MOTION_DATA_CHANNEL_NAME, ._channel = MOTION_DATA_CHANNEL};
 	message_store_channel_list[mpai_message_store_channel_count++] = motion_data_channel;
 
+	// declare parameters of the AIMs, with defaults and the range accepted from MPAI Store
+	motion_accel_tot_threshold_min = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_MOTION_NAME, "AccelTotThresholdMin", MOTION_ACCEL_TOT_THRESHOLD_MIN, 0, 20);
+	motion_accel_tot_threshold_max = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_MOTION_NAME, "AccelTotThresholdMax", MOTION_ACCEL_TOT_THRESHOLD_MAX, 0, 20);
+	motion_min_stop_delay_ms = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_MOTION_NAME, "MinStopDelayMs", MOTION_MIN_STOP_DELAY_MS, 0, 10000);
+	volume_peak_threshold_min = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_DATA_MIC_NAME, "PeakThresholdMin", VOLUME_PEAK_THRESHOLD_MIN, AUDIO_DSP_DBFS_MIN, 0);
+	volume_peak_threshold_max = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_DATA_MIC_NAME, "PeakThresholdMax", VOLUME_PEAK_THRESHOLD_MAX, AUDIO_DSP_DBFS_MIN, 0);
+	volume_median_peak_ratio_max = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_DATA_MIC_NAME, "MedianPeakRatioMax", VOLUME_MEDIAN_PEAK_RATIO_MAX, 0, 1);
+	sensors_rate_ms = MPAI_AIM_Parameters_Declare(MPAI_LIBS_IOT_REV_AIM_SENSORS_NAME, "RateMs", SENSORS_RATE_MS, 10, 60000);
+
 	// add aims to list with related callback
 	aim_initialization_cb_t* aim_data_mic_init_cb = (aim_initialization_cb_t *) k_malloc(sizeof(aim_initialization_cb_t));
 	aim_data_mic_init_cb->_aim_name = MPAI_LIBS_IOT_REV_AIM_DATA_MIC_NAME;
@@ -142,6 +229,11 @@ int MPAI_AIW_IOT_REV_Init()
 			k_timer_start(&aim_timer, K_SECONDS(5), K_SECONDS(5));
 	#endif
 
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY
+		/* messages published before the AIMs are started are not expected, so it can start before them */
+		telemetry_start();
+	#endif
+
 	return AIW_IOT_REV;
 }
 
@@ -162,10 +254,17 @@ void MPAI_AIW_IOT_REV_Stop()
 	#ifdef CONFIG_MPAI_AIM_VOLUME_PEAKS_ANALYSIS
 		MPAI_AIFM_AIM_Stop(MPAI_LIBS_IOT_REV_AIM_DATA_MIC_NAME);
 	#endif
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY
+		/* stopped last, sending the records of the other AIMs still in the batch */
+		MPAI_AIM_Stop(aim_telemetry);
+	#endif
 }
 
 void MPAI_AIW_IOT_REV_Resume()
 {
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY
+		MPAI_AIM_Resume(aim_telemetry);
+	#endif
 	#ifdef CONFIG_MPAI_AIM_CONTROL_UNIT_SENSORS
 		MPAI_AIFM_AIM_Resume(MPAI_LIBS_IOT_REV_AIM_SENSORS_NAME);
 	#endif
@@ -185,6 +284,9 @@ void MPAI_AIW_IOT_REV_Resume()
 
 void MPAI_AIW_IOT_REV_Pause()
 {
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY
+		MPAI_AIM_Pause(aim_telemetry);
+	#endif
 	#ifdef CONFIG_MPAI_AIM_VALIDATION_MOVEMENT_WITH_AUDIO
 		MPAI_AIFM_AIM_Pause(MPAI_LIBS_IOT_REV_AIM_REHABILITATION_NAME);
 	#endif
@@ -240,4 +342,7 @@ void MPAI_AIW_IOT_REV_Destroy()
 			MPAI_AIM_Destructor(aim_init->_aim);
 		}
 	#endif
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY
+		MPAI_AIM_Destructor(aim_telemetry);
+	#endif
 }
\ No newline at end of file
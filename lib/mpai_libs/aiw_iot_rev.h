@@ -17,6 +17,9 @@
 #include <data_mic_aim.h>
 #include <motion_aim.h>
 #include <rehabilitation_aim.h>
+#ifdef CONFIG_MPAI_AIM_TELEMETRY
+    #include <telemetry_aim.h>
+#endif
 #include <message_store.h>
 #include <aif_controller.h>
 #if defined(CONFIG_MPAI_CONFIG_STORE)
@@ -33,6 +36,7 @@ static int AIW_IOT_REV = 1;
 #define MPAI_LIBS_IOT_REV_AIM_TEMP_LIMIT_NAME "AIM_TEMP_LIMIT"
 #define MPAI_LIBS_IOT_REV_AIM_MOTION_NAME "MotionRecognitionAnalysis"
 #define MPAI_LIBS_IOT_REV_AIM_REHABILITATION_NAME "MovementsWithAudioValidation"
+#define MPAI_LIBS_IOT_REV_AIM_TELEMETRY_NAME "Telemetry"
 #define MPAI_LIBS_IOT_REV_SENSORS_DATA_CHANNEL_NAME "SensorsDataChannel"
 #define MPAI_LIBS_IOT_REV_MIC_BUFFER_DATA_CHANNEL_NAME "MicBufferDataChannel"
 #define MPAI_LIBS_IOT_REV_MIC_PEAK_DATA_CHANNEL_NAME "MicPeakDataChannel"
@@ -46,6 +50,9 @@ extern MPAI_AIM_MessageStore_t* message_store_sensors_aim;
 extern MPAI_AIM_MessageStore_t* message_store_temp_limit_aim;
 extern MPAI_AIM_MessageStore_t* message_store_motion_aim;
 extern MPAI_AIM_MessageStore_t* message_store_rehabilitation_aim;
+#ifdef CONFIG_MPAI_AIM_TELEMETRY
+extern MPAI_AIM_MessageStore_t* message_store_telemetry_aim;
+#endif
 
 /* AIW global channels used by message store */
 extern subscriber_channel_t SENSORS_DATA_CHANNEL;
@@ -54,8 +61,10 @@ extern subscriber_channel_t MIC_PEAK_DATA_CHANNEL;
 extern subscriber_channel_t MOTION_DATA_CHANNEL;
 
 /**
- * @brief Initialize AIW Test Case (IOT-REV)
+ * @brief Initialize AIW Test Case (IOT-REV): its message store, channels, parameters and AIMs.
+ * It's initialized only once
  * 
+ * @return int AIW ID, -EALREADY if it's already initialized
  */
 int MPAI_AIW_IOT_REV_Init();
 
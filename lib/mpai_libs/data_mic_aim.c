@@ -16,21 +16,23 @@ LOG_MODULE_REGISTER(MPAI_LIBS_DATA_MIC_AIM, LOG_LEVEL_INF);
 /*************** DEFINE ***************/
 
 /* size of stack area used by each thread */
-#define STACKSIZE 1024
+#define STACKSIZE 1536
 
-/* scheduling priority used by each thread */
-#define PRIORITY 7
+/* scheduling priority of the thread: higher than the other AIMs (7), so each half of PCM_Buffer is processed before the DMA fills it again */
+#define PRIORITY 2
 
 /* Define The transmission interval [mSec] for Microphones dB Values */
 #define MICS_DB_UPDATE_MS 50
 
-/* Parameters to identify correct volume peaks: at the moment, we have find them doing some tests */
-#define VOLUME_PEAK_THRESHOLD_MIN 10000000
-#define VOLUME_PEAK_THRESHOLD_MAX 15000000
-#define VOLUME_MEDIAN_PEAK_RATIO_MAX 0.00006
+BUILD_ASSERT(PCM_BLOCK_MS <= MICS_DB_UPDATE_MS, "Audio blocks longer than the interval of the dB values");
+BUILD_ASSERT(AUDIO_CHANNELS == 1, "The volume is analysed on a single mic");
 
-/* Function to remove high and low values */
-#define SaturaLH(N, L, H) (((N)<(L))?(L):(((N)>(H))?(H):(N)))    
+/* Window of the RMS level, whatever the size of the audio blocks: the median filter spans MEDIAN_FILTER_SIZE windows */
+#define VOLUME_WINDOW_MS 1
+#define VOLUME_WINDOW_SAMPLES (VOLUME_WINDOW_MS * PCM_AUDIO_IN_SAMPLES)
+
+/* Audio skipped at the start, to not record the button click */
+#define SKIP_FIRST_MS 100
 
 /* Configuration to enable printing bytes representation of the captured .wav in console*/
 #define PRINT_WAV_ENABLED false
@@ -40,6 +42,7 @@ LOG_MODULE_REGISTER(MPAI_LIBS_DATA_MIC_AIM, LOG_LEVEL_INF);
 /*************** PRIVATE ***************/
 void publish_buffer_to_message_store();
 void publish_peak_to_message_store(int32_t peak_value);
+void process_pcm_half(size_t half);
 
 /*************** STATIC ***************/
 #if PUBLISH_BUFFER_ENABLED == true || PRINT_WAV_ENABLED == true
@@ -47,25 +50,33 @@ void publish_peak_to_message_store(int32_t peak_value);
     static int16_t *TARGET_AUDIO_BUFFER;
 #endif
 static size_t TARGET_AUDIO_BUFFER_IX = 0;
-typedef struct {
-  int32_t Z;
-  int32_t oldOut;
-  int32_t oldIn;
-} HP_FilterState_TypeDef;
-static HP_FilterState_TypeDef HP_Filter;
+static audio_dsp_hp_state_t HP_Filter;
+/* Block filtered by the thread, out of its stack (aligned for the loads of two samples) */
+static int16_t PCM_Block[PCM_BUFFER_LEN / 4] __aligned(4);
 
 static uint16_t PCM_Buffer[PCM_BUFFER_LEN / 2];
 static BSP_AUDIO_Init_t MicParams;
 
-// we skip the first 50 events (100 ms.) to not record the button click
-static size_t SKIP_FIRST_EVENTS = 50;
+// we skip the events of the first 100 ms (50 events with blocks of 1 ms) to not record the button click
+static size_t SKIP_FIRST_EVENTS = SKIP_FIRST_MS / (2 * PCM_BLOCK_MS) + 1;
 static size_t half_transfer_events = 0;
 static size_t transfer_complete_events = 0;
 
+/* Halves of PCM_Buffer filled by the DMA and not processed yet: the DMA callbacks only mark them and wake the thread */
+static atomic_t pcm_halves_ready = ATOMIC_INIT(0);
+static atomic_t pcm_overruns = ATOMIC_INIT(0);
+static size_t pcm_next_half = 0;
+K_SEM_DEFINE(pcm_half_ready, 0, 1);
+
 /* Volume peak recognized? At the start is false, obviously */
 static bool flag_peak_recognized = false;
 /* Data structure of a volume peak to send to the message store */
-static mic_peak_t mic_peak = {};
+static int32_t mic_peak_value = 0;
+static mic_peak_t mic_peak = { .data = &mic_peak_value };
+
+/* Energy of the current window, integrated across the audio blocks */
+static uint64_t window_energy = 0;
+static uint32_t window_samples = 0;
 
 /**
  * @brief Start recording audio using stm32 drivers
@@ -90,6 +101,10 @@ void static start_recording() {
     TARGET_AUDIO_BUFFER_IX = 0;
     transfer_complete_events = 0;
     half_transfer_events = 0;
+    atomic_clear(&pcm_halves_ready);
+    pcm_next_half = 0;
+    window_energy = 0;
+    window_samples = 0;
 
     ret = BSP_AUDIO_IN_Record(AUDIO_INSTANCE, (uint8_t *) PCM_Buffer, PCM_BUFFER_LEN);
     if (ret != BSP_ERROR_NONE) {
@@ -164,10 +179,6 @@ static k_tid_t producer_mic_thread_id;
 K_THREAD_STACK_DEFINE(thread_prod_mic_stack_area, STACKSIZE);
 static struct k_thread thread_prod_mic_data;
 
-volatile float RMS_Ch[AUDIO_CHANNELS];
-float DBNOISE_Value_Old_Ch[AUDIO_CHANNELS];
-uint16_t       DBNOISE_Value_Ch[AUDIO_CHANNELS];
-
 // callback that gets invoked when TARGET_AUDIO_BUFFER is full
 void target_audio_buffer_full() {
     // pause audio stream
@@ -183,96 +194,105 @@ void target_audio_buffer_full() {
 }
 
 /**
-  * @brief  Send Audio Level Data (Ch1) to BLE
-  * @param  None
+  * @brief  Look for a volume peak, at the end of each window
+  * @param  mean_square mean square of the samples of the window (q15 units)
   * @retval None
   */
-static void Detect_DB_Noise(void)
+static void Detect_DB_Noise(uint32_t mean_square)
 {
-  int32_t NumberMic;
-  int32_t DBNOISE_Value_Ch[AUDIO_CHANNELS];
-
-  for(NumberMic=0;NumberMic<(AUDIO_CHANNELS);NumberMic++) {
-    DBNOISE_Value_Ch[NumberMic] = 0;
-
-    RMS_Ch[NumberMic] /= (16.0f*MICS_DB_UPDATE_MS);
-
-    int32_t calc_median = 0;
-    int32_t calc_peak = 0;
-    median_filter((int32_t) RMS_Ch[NumberMic], &calc_median, &calc_peak);
-
-    // This is a custom algorithm to detect real volume peaks:
-    // 1. compare computed volume peak from sliding window and check if it's included in threshold
-    // 2. compare (median vs volume peak) ratio to detect highest volume peaks as much as possible
-    if (calc_peak >= VOLUME_PEAK_THRESHOLD_MIN && calc_peak < VOLUME_PEAK_THRESHOLD_MAX && VOLUME_MEDIAN_PEAK_RATIO_MAX >= (float)calc_median/calc_peak) {
-
-        // int64_t now = k_uptime_get();
-        // printk("AUDIO PEAK RECOGNIZED %lld\n", now);  
-
-        if (flag_peak_recognized == true)
-        {
-        } else 
-        {
-            int64_t now = k_uptime_get();
-            LOG_DBG("AUDIO PEAK RECOGNIZED %d: %lld\n", calc_peak, now);  
-            flag_peak_recognized = true;
-
-            publish_peak_to_message_store(calc_peak);
-        }
-
-    } else {
-        flag_peak_recognized = false;
-    }
-
-    // DBNoise management used in STM32 SENSING1: at the moment, it doesn't work because the data read are different from SENSING1 (probably cause by clock config)
-    // DBNOISE_Value_Ch[NumberMic] = (uint16_t)((120.0f - 20 * log10f(32768 * (1 + 0.25f * (AUDIO_VOLUME_VALUE /*AudioInVolume*/ - 4))) + 10.0f * log10f(RMS_Ch[NumberMic])) * 0.3f + DBNOISE_Value_Old_Ch[NumberMic] * 0.7f);
-    // DBNOISE_Value_Old_Ch[NumberMic] = DBNOISE_Value_Ch[NumberMic];
-    RMS_Ch[NumberMic] = 0.0f;
-    // printk("Volume at %lld: %d\n",k_uptime_get(), DBNOISE_Value_Ch[NumberMic]&0xFF);
+  // parameters are read at each update, so they can be changed while the AIM is running
+  float peak_threshold_min = MPAI_AIM_Parameters_Value(volume_peak_threshold_min, VOLUME_PEAK_THRESHOLD_MIN);
+  float peak_threshold_max = MPAI_AIM_Parameters_Value(volume_peak_threshold_max, VOLUME_PEAK_THRESHOLD_MAX);
+  float median_peak_ratio_max = MPAI_AIM_Parameters_Value(volume_median_peak_ratio_max, VOLUME_MEDIAN_PEAK_RATIO_MAX);
+
+  int32_t calc_median = 0;
+  int32_t calc_peak = 0;
+  median_filter((int32_t) mean_square, &calc_median, &calc_peak);
+  if (calc_peak <= 0) {
+    flag_peak_recognized = false;
+    return;
+  }
+  float peak_dbfs = audio_dsp_dbfs((uint32_t) calc_peak);
+
+  // This is a custom algorithm to detect real volume peaks:
+  // 1. compare the level (dBFS) of the volume peak from sliding window and check if it's included in threshold
+  // 2. compare (median vs volume peak) ratio of the mean squares to detect highest volume peaks as much as possible
+  if (peak_dbfs >= peak_threshold_min && peak_dbfs < peak_threshold_max && median_peak_ratio_max >= (float)calc_median/calc_peak) {
+
+      if (flag_peak_recognized == true)
+      {
+      } else 
+      {
+          int64_t now = k_uptime_get();
+          int32_t peak_rms = audio_dsp_rms((uint32_t) calc_peak);
+          LOG_DBG("AUDIO PEAK RECOGNIZED %d (%d dBFS): %lld\n", peak_rms, (int)peak_dbfs, now);  
+          flag_peak_recognized = true;
+
+          publish_peak_to_message_store(peak_rms);
+      }
+
+  } else {
+      flag_peak_recognized = false;
   }
-  
 }
 
 /**
  * 
-* @brief  User function that is called when 1s ms of PDM data is available.
-* @param  none
+* @brief  User function that is called with the filtered samples of each audio block: the energy of all of them
+*         is integrated in fixed point, for windows of VOLUME_WINDOW_MS whatever the size of the blocks.
+* @param  samples samples filtered
+* @param  n number of samples
 * @retval None
 */
-void AudioProcess_DB_Noise(void)
+void AudioProcess_DB_Noise(const int16_t* samples, size_t n)
 {
-  int32_t i;
-  int32_t NumberMic;
-
-  uint32_t buffer_size = PCM_BUFFER_LEN / 2; /* Half Transfer */
-  uint32_t nb_samples = buffer_size / sizeof(int16_t); /* Bytes to Length */
-
-  for(i = 0; i < 16; i++){
-    for(NumberMic=0;NumberMic<AUDIO_CHANNELS;NumberMic++) {
-      RMS_Ch[NumberMic] += (float)((int16_t)PCM_Buffer[i*AUDIO_CHANNELS+NumberMic] * ((int16_t)PCM_Buffer[i*AUDIO_CHANNELS+NumberMic]));
+  while (n > 0) {
+    size_t len = MIN(n, VOLUME_WINDOW_SAMPLES - window_samples);
+    window_energy += audio_dsp_energy(samples, len);
+    window_samples += len;
+    samples += len;
+    n -= len;
+
+    if (window_samples == VOLUME_WINDOW_SAMPLES) {
+      // at most 2^30, full scale
+      Detect_DB_Noise((uint32_t) (window_energy / VOLUME_WINDOW_SAMPLES));
+      window_energy = 0;
+      window_samples = 0;
     }
   }
-  Detect_DB_Noise();
 }
 
 /**
-* @brief  Half Transfer user callback, called by BSP functions.
-* @param  None
+* @brief  Mark a half of PCM_Buffer as filled and wake the thread, called by the DMA callbacks (in interrupt context).
+* @param  half 0 for the first half, 1 for the second one
 * @retval None
 */
-void BSP_AUDIO_IN_HalfTransfer_CallBack(uint32_t Instance) {
-    half_transfer_events++;
-    if (half_transfer_events < SKIP_FIRST_EVENTS) return;
+static void signal_pcm_half(size_t half)
+{
+    if (atomic_test_and_set_bit(&pcm_halves_ready, half)) {
+        // the thread didn't process it before the DMA filled it again
+        atomic_inc(&pcm_overruns);
+    }
+    k_sem_give(&pcm_half_ready);
+}
 
+/**
+* @brief  Filter a half of PCM_Buffer (PCM_BLOCK_MS of audio) and look for volume peaks in each ms, called by the thread.
+* @param  half 0 for the first half, 1 for the second one
+* @retval None
+*/
+void process_pcm_half(size_t half)
+{
     uint32_t buffer_size = PCM_BUFFER_LEN / 2; /* Half Transfer */
     uint32_t nb_samples = buffer_size / sizeof(int16_t); /* Bytes to Length */
+    const uint16_t* samples = PCM_Buffer + half * nb_samples;
 
 #if PUBLISH_BUFFER_ENABLED == true || PRINT_WAV_ENABLED == true
     if ((TARGET_AUDIO_BUFFER_IX + nb_samples) > TARGET_AUDIO_BUFFER_NB_SAMPLES) {
         return;
     }
-    /* Copy first half of PCM_Buffer from Microphones onto Fill_Buffer */
-    memcpy(((uint8_t*)TARGET_AUDIO_BUFFER) + (TARGET_AUDIO_BUFFER_IX * 2), PCM_Buffer, buffer_size);
+    /* Copy the half of PCM_Buffer from Microphones onto Fill_Buffer */
+    memcpy(((uint8_t*)TARGET_AUDIO_BUFFER) + (TARGET_AUDIO_BUFFER_IX * 2), samples, buffer_size);
     TARGET_AUDIO_BUFFER_IX += nb_samples;
 
     if (TARGET_AUDIO_BUFFER_IX >= TARGET_AUDIO_BUFFER_NB_SAMPLES) {
@@ -281,16 +301,22 @@ void BSP_AUDIO_IN_HalfTransfer_CallBack(uint32_t Instance) {
     }
 #endif
 
-    /* High-Pass filter to remove DC component and/or low frequency noise */
-    for (uint32_t i = 0; i < nb_samples; i++)
-    {
-        HP_Filter.Z = (int32_t) PCM_Buffer[i];
-        HP_Filter.oldOut = (0xFC * (HP_Filter.oldOut + HP_Filter.Z - HP_Filter.oldIn)) / 256;
-        HP_Filter.oldIn = HP_Filter.Z;
-        PCM_Buffer[i] = (uint16_t) SaturaLH(HP_Filter.oldOut, -32768, 32767);
-    }
+    /* High-Pass filter to remove DC component and/or low frequency noise: PCM_Buffer is left to the DMA */
+    audio_dsp_hp_filter(&HP_Filter, samples, PCM_Block, nb_samples);
 
-    AudioProcess_DB_Noise();
+    AudioProcess_DB_Noise(PCM_Block, nb_samples);
+}
+
+/**
+* @brief  Half Transfer user callback, called by BSP functions.
+* @param  None
+* @retval None
+*/
+void BSP_AUDIO_IN_HalfTransfer_CallBack(uint32_t Instance) {
+    half_transfer_events++;
+    if (half_transfer_events < SKIP_FIRST_EVENTS) return;
+
+    signal_pcm_half(0);
 }
 
 /**
@@ -302,35 +328,7 @@ void BSP_AUDIO_IN_TransferComplete_CallBack(uint32_t Instance) {
     transfer_complete_events++;
     if (transfer_complete_events < SKIP_FIRST_EVENTS) return;
 
-    uint32_t buffer_size = PCM_BUFFER_LEN / 2; /* Half Transfer */
-    uint32_t nb_samples = buffer_size / sizeof(int16_t); /* Bytes to Length */
-
-#if PUBLISH_BUFFER_ENABLED == true || PRINT_WAV_ENABLED == true
-    if ((TARGET_AUDIO_BUFFER_IX + nb_samples) > TARGET_AUDIO_BUFFER_NB_SAMPLES) {
-        return;
-    }
-
-    /* Copy second half of PCM_Buffer from Microphones onto Fill_Buffer */
-    memcpy((uint8_t*)TARGET_AUDIO_BUFFER + (TARGET_AUDIO_BUFFER_IX * 2),
-       ((uint8_t*)PCM_Buffer) + (nb_samples * 2), buffer_size);
-    TARGET_AUDIO_BUFFER_IX += nb_samples;
-
-    if (TARGET_AUDIO_BUFFER_IX >= TARGET_AUDIO_BUFFER_NB_SAMPLES) {
-		target_audio_buffer_full();
-        return;
-    }
-#endif
-
-    /* High-Pass filter to remove DC component and/or low frequency noise */
-    for (uint32_t i = 0; i < nb_samples; i++)
-    {
-        HP_Filter.Z = (int32_t) PCM_Buffer[i + nb_samples];
-        HP_Filter.oldOut = (0xFC * (HP_Filter.oldOut + HP_Filter.Z - HP_Filter.oldIn)) / 256;
-        HP_Filter.oldIn = HP_Filter.Z;
-        PCM_Buffer[i + nb_samples] = (uint16_t) SaturaLH(HP_Filter.oldOut, -32768, 32767);
-    }
-
-    AudioProcess_DB_Noise();
+    signal_pcm_half(1);
 }
 
 /**
@@ -392,6 +390,10 @@ void th_produce_data_mic_data(void *dummy1, void *dummy2, void *dummy3)
 	ARG_UNUSED(dummy2);
 	ARG_UNUSED(dummy3);
 
+    #ifdef CONFIG_MPAI_AUDIO_DSP_SELF_CHECK
+        audio_dsp_self_check();
+    #endif
+
     #if PUBLISH_BUFFER_ENABLED == true || PRINT_WAV_ENABLED == true
         TARGET_AUDIO_BUFFER = (int16_t*)k_calloc(TARGET_AUDIO_BUFFER_NB_SAMPLES, sizeof(int16_t));
         if (!TARGET_AUDIO_BUFFER) {
@@ -424,6 +426,29 @@ void th_produce_data_mic_data(void *dummy1, void *dummy2, void *dummy3)
 	    print_wav();
     #endif
 
+    // process the halves of PCM_Buffer in the order they are filled by the DMA
+    while (1)
+    {
+        k_sem_take(&pcm_half_ready, K_FOREVER);
+
+        while (1)
+        {
+            size_t half = pcm_next_half;
+            if (!atomic_test_and_clear_bit(&pcm_halves_ready, half)) {
+                half = 1 - half;
+                if (!atomic_test_and_clear_bit(&pcm_halves_ready, half)) {
+                    break;
+                }
+            }
+            process_pcm_half(half);
+            pcm_next_half = 1 - half;
+        }
+
+        atomic_val_t overruns = atomic_clear(&pcm_overruns);
+        if (overruns > 0) {
+            LOG_WRN("%ld audio blocks overwritten before being processed", (long)overruns);
+        }
+    }
 }
 
 /************** EXECUTIONS ***************/
@@ -18,11 +18,22 @@
 #include <stm32l475e_iot01_audio.h>
 #include <drivers/gpio.h>
 #include <misc_utils.h>
+#include <audio_dsp.h>
+#include <aif_aim_parameters.h>
+
+/* Default parameters to identify correct volume peaks: at the moment, we have find them doing some tests.
+ * Thresholds are levels of the RMS of a window (dBFS), the ratio is between the mean squares of median and peak */
+#define VOLUME_PEAK_THRESHOLD_MIN (-3.32f)
+#define VOLUME_PEAK_THRESHOLD_MAX (-1.56f)
+#define VOLUME_MEDIAN_PEAK_RATIO_MAX 0.00006
 
 // The implementation will be added in AIW configuration
 __weak MPAI_AIM_MessageStore_t* message_store_data_mic_aim;
 __weak subscriber_channel_t MIC_BUFFER_DATA_CHANNEL;
 __weak subscriber_channel_t MIC_PEAK_DATA_CHANNEL;
+__weak mpai_aim_parameter_t* volume_peak_threshold_min;
+__weak mpai_aim_parameter_t* volume_peak_threshold_max;
+__weak mpai_aim_parameter_t* volume_median_peak_ratio_max;
 
 // AIM subscriber
 mpai_error_t* data_mic_aim_subscriber();
@@ -20,18 +20,9 @@ LOG_MODULE_REGISTER(MPAI_LIBS_MOTION_AIM, LOG_LEVEL_INF);
 /* scheduling priority used by each thread */
 #define PRIORITY 7
 
-/* min delay used to detect when mcu is stopped */
-#define MCU_MIN_DETECTED_STOP_DELAY_MS 100
-
 /* delay in polling from sensors*/
 #define SENSORS_DATA_POLLING_MS 1000
 
-/* parameters to identify correct motion events, like start and stop: at the moment, we have find them doing some tests 
- * because the total acceleration is not "9.81" perfectly in our test device
- */
-#define ACCEL_TOT_THRESHOLD_MIN 9.5
-#define ACCEL_TOT_THRESHOLD_MAX 10.5
-
 /*************** STATIC ***************/
 /* last time (in ms) that mcu has stopped */
 static int64_t mcu_has_stopped_ts = 0.0;
@@ -95,11 +86,16 @@ void th_subscribe_motion_data(void *dummy1, void *dummy2, void *dummy3)
 				// compute vectorial product to get the total acceleration
 				float accel_tot = sqrt(accel_x*accel_x + accel_y*accel_y + accel_z*accel_z);
 
+				// parameters are read at each message, so they can be changed while the AIM is running
+				float accel_tot_threshold_min = MPAI_AIM_Parameters_Value(motion_accel_tot_threshold_min, MOTION_ACCEL_TOT_THRESHOLD_MIN);
+				float accel_tot_threshold_max = MPAI_AIM_Parameters_Value(motion_accel_tot_threshold_max, MOTION_ACCEL_TOT_THRESHOLD_MAX);
+				int64_t min_stop_delay_ms = (int64_t)MPAI_AIM_Parameters_Value(motion_min_stop_delay_ms, MOTION_MIN_STOP_DELAY_MS);
+
 				// algorithm to check if mcu is stopped or not
 				// 1. check if the total acceleration is between the MIN and the MAX threshold
-				if (accel_tot >= ACCEL_TOT_THRESHOLD_MIN && accel_tot <= ACCEL_TOT_THRESHOLD_MAX)
+				if (accel_tot >= accel_tot_threshold_min && accel_tot <= accel_tot_threshold_max)
 				{
-					if (mcu_has_stopped_ts != 0 && aim_message.timestamp - mcu_has_stopped_ts >=  MCU_MIN_DETECTED_STOP_DELAY_MS)
+					if (mcu_has_stopped_ts != 0 && aim_message.timestamp - mcu_has_stopped_ts >= min_stop_delay_ms)
 					{
 						// MCU is stopped but it doesn't publish event, because it was already stopped
 					}
@@ -16,12 +16,24 @@
 #include <sensors_common.h>
 #include <core_aim.h>
 #include <motion_common.h>
+#include <aif_aim_parameters.h>
 #include <math.h>
 
+/* Default parameters to identify correct motion events, like start and stop: at the moment, we have find them doing some tests 
+ * because the total acceleration is not "9.81" perfectly in our test device
+ */
+#define MOTION_ACCEL_TOT_THRESHOLD_MIN 9.5
+#define MOTION_ACCEL_TOT_THRESHOLD_MAX 10.5
+/* Default min delay used to detect when mcu is stopped */
+#define MOTION_MIN_STOP_DELAY_MS 100
+
 // The implementation will be added in AIW configuration
 __weak MPAI_AIM_MessageStore_t* message_store_motion_aim;
 __weak subscriber_channel_t MOTION_DATA_CHANNEL;
 __weak subscriber_channel_t SENSORS_DATA_CHANNEL;
+__weak mpai_aim_parameter_t* motion_accel_tot_threshold_min;
+__weak mpai_aim_parameter_t* motion_accel_tot_threshold_max;
+__weak mpai_aim_parameter_t* motion_min_stop_delay_ms;
 
 // AIM subscriber
 mpai_error_t* motion_aim_subscriber();
@@ -21,9 +21,6 @@ LOG_MODULE_REGISTER(MPAI_LIBS_SENSORS_AIM, LOG_LEVEL_INF);
 /* scheduling priority used by each thread */
 #define PRIORITY 7
 
-/* delay between reads from sensors (in ms) */
-#define CONFIG_SENSORS_RATE_MS 100
-
 /*************** STATIC ***************/
 // INITIALIZE STRUCT
 #ifdef CONFIG_HTS221
@@ -669,7 +666,8 @@ void th_produce_sensors_data(void *arg1, void *dummy2, void *dummy3)
 	while(1) {
 
 		produce_sensors_data((void*) sensor_result_ptr, (void*) sensor_devices_ptr);
-		k_sleep(K_MSEC(CONFIG_SENSORS_RATE_MS));
+		// read at each iteration, so the rate can be changed while the AIM is running
+		k_sleep(K_MSEC((int32_t)MPAI_AIM_Parameters_Value(sensors_rate_ms, SENSORS_RATE_MS)));
 		
 	}
 }
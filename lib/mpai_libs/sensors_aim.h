@@ -19,10 +19,15 @@
 #include <usb/usb_device.h>
 #include <drivers/uart.h>
 #include <message_store.h>
+#include <aif_aim_parameters.h>
+
+/* Default delay between reads from sensors (in ms) */
+#define SENSORS_RATE_MS 100
 
 // The implementation will be added in AIW configuration
 __weak MPAI_AIM_MessageStore_t* message_store_sensors_aim;
 __weak subscriber_channel_t SENSORS_DATA_CHANNEL;
+__weak mpai_aim_parameter_t* sensors_rate_ms;
 
 // AIM subscriber
 mpai_error_t* sensors_aim_subscriber();
@@ -0,0 +1,467 @@
+/*
+ * @file
+ * @brief Implementation of an AIM that sends the messages of some channels to the COAP Server, packed in batches
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "telemetry_aim.h"
+#include <logging/log.h>
+#include <math.h>
+
+LOG_MODULE_REGISTER(MPAI_LIBS_TELEMETRY_AIM, LOG_LEVEL_INF);
+
+/*************** DEFINE ***************/
+
+/* size of stack area used by each thread */
+#define STACKSIZE 1536
+
+/* scheduling priority used by each thread: lower than the AIMs, that don't have to wait for the uplink */
+#define PRIORITY 8
+
+/*************** STATIC ***************/
+/* Channel sent, with the index used by its records */
+typedef struct _telemetry_channel_t {
+	subscriber_channel_t _channel;
+	uint16_t _hash;								// CRC16 of the name, in the header of the batches
+	telemetry_encoder_t* _encoder;
+} telemetry_channel_t;
+
+static telemetry_channel_t telemetry_channels[MPAI_TELEMETRY_CHANNELS_MAX];
+static size_t telemetry_channel_count = 0;
+
+/* Batch being packed: the header is written when it's sent, records follow it */
+static uint8_t telemetry_batch[CONFIG_MPAI_AIM_TELEMETRY_BATCH_SIZE];
+static size_t telemetry_batch_len = 0;
+static uint16_t telemetry_batch_records = 0;
+static uint16_t telemetry_batch_sequence = 0;
+/* Batches stored in flash memory are sent again later, so the server tells them apart by boot and sequence */
+static uint32_t telemetry_boot_id = 0;
+static int64_t telemetry_batch_first_timestamp = 0;
+static int64_t telemetry_batch_last_timestamp = 0;
+static int64_t telemetry_batch_opened_ms = 0;
+/* Batches not sent: their sequence is skipped, so the server counts them as lost */
+static uint32_t telemetry_batches_dropped = 0;
+#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+static uint32_t telemetry_batches_stored = 0;
+static int64_t telemetry_forward_next_ms = 0;
+#endif
+
+static const char * const telemetry_path[] = { CONFIG_MPAI_AIM_TELEMETRY_PATH, CONFIG_MPAI_AIM_TELEMETRY_DEVICE, NULL };
+
+/* The batch is shared between the thread and the commands */
+K_MUTEX_DEFINE(telemetry_lock);
+
+/************* PRIVATE HEADER *************/
+/* length of the header with the channels added */
+size_t _telemetry_header_len();
+/* append the record of a message to the batch, sending the batch first if the record doesn't fit */
+void _telemetry_append(size_t channel_idx, const mpai_message_t* message);
+/* send the batch, if it has records */
+void _telemetry_flush();
+/* send a batch (or a batch stored in flash memory) to the COAP Server */
+int _telemetry_send(const uint8_t* data, size_t len, void* user_data);
+#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+/* send again some batches stored in flash memory, if the network is up */
+void _telemetry_forward();
+#endif
+/* write the header of the batch */
+void _telemetry_write_header();
+/* write a signed integer as a zigzag varint, returning its length */
+size_t _telemetry_put_varint(uint8_t* buffer, int64_t value);
+/* write an unsigned integer in little endian */
+void _telemetry_put_le(uint8_t* buffer, uint64_t value, size_t len);
+/* append sensor values in fixed-point */
+size_t _telemetry_put_sensor_values(int64_t* values, size_t count, size_t max, const struct sensor_value* sensor_values, size_t len);
+/* convert a float in fixed-point */
+int64_t _telemetry_fixed_point(float value);
+
+/**************** THREADS **********************/
+
+static k_tid_t telemetry_thread_id;
+
+K_THREAD_STACK_DEFINE(thread_telemetry_stack_area, STACKSIZE);
+static struct k_thread thread_telemetry;
+
+/* SUBSCRIBER */
+
+void th_telemetry(void *dummy1, void *dummy2, void *dummy3)
+{
+	ARG_UNUSED(dummy1);
+	ARG_UNUSED(dummy2);
+	ARG_UNUSED(dummy3);
+
+	mpai_message_t aim_message;
+
+	LOG_DBG("START SUBSCRIBER");
+
+	while (1)
+	{
+		bool received = false;
+
+		// channels are polled without waiting: a message of a channel doesn't have to wait for the others
+		for (size_t i = 0; i < telemetry_channel_count; i++)
+		{
+			int ret = MPAI_MessageStore_poll(message_store_telemetry_aim, telemetry_aim_subscriber, K_NO_WAIT, telemetry_channels[i]._channel);
+			if (ret > 0)
+			{
+				MPAI_MessageStore_copy(message_store_telemetry_aim, telemetry_aim_subscriber, telemetry_channels[i]._channel, &aim_message);
+				_telemetry_append(i, &aim_message);
+				received = true;
+			}
+		}
+
+		k_mutex_lock(&telemetry_lock, K_FOREVER);
+		if (telemetry_batch_records > 0 && k_uptime_get() - telemetry_batch_opened_ms >= CONFIG_MPAI_AIM_TELEMETRY_FLUSH_MS)
+		{
+			_telemetry_flush();
+		}
+		k_mutex_unlock(&telemetry_lock);
+
+		#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+			_telemetry_forward();
+		#endif
+
+		if (!received)
+		{
+			k_sleep(K_MSEC(CONFIG_MPAI_AIM_TELEMETRY_POLL_MS));
+		}
+	}
+}
+
+/************** EXECUTIONS ***************/
+int telemetry_aim_add_channel(const char* channel_name, subscriber_channel_t channel, telemetry_encoder_t* encoder)
+{
+	if (telemetry_channel_count >= MPAI_TELEMETRY_CHANNELS_MAX)
+	{
+		LOG_ERR("Too many channels: %s not sent", log_strdup(channel_name));
+		return -ENOMEM;
+	}
+	telemetry_channels[telemetry_channel_count++] = (telemetry_channel_t){
+		._channel = channel,
+		._hash = crc16_ccitt(0, (const uint8_t *)channel_name, strlen(channel_name)),
+		._encoder = encoder
+	};
+	LOG_INF("Channel %s sent to %s/%s", log_strdup(channel_name), CONFIG_MPAI_AIM_TELEMETRY_PATH, CONFIG_MPAI_AIM_TELEMETRY_DEVICE);
+	return 0;
+}
+
+size_t telemetry_encode_sensors(const mpai_message_t* message, int64_t* values, size_t max)
+{
+	const sensor_result_t *sensor_data = (const sensor_result_t *)message->data;
+	size_t count = 0;
+
+	// same order of the fields: the server knows it from the sensors of the board
+	#ifdef CONFIG_HTS221
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->hts221_temp, 1);
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->hts221_hum, 1);
+	#endif
+	#ifdef CONFIG_LPS22HH
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lps22hh_temp, 1);
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lps22hh_press, 1);
+	#endif
+	#ifdef CONFIG_LPS22HB
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lps22hb_temp, 1);
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lps22hb_press, 1);
+	#endif
+	#ifdef CONFIG_LIS2DW12
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lis2dw12_accel, 3);
+	#endif
+	#ifdef CONFIG_IIS3DHHC
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->iis3dhhc_accel, 3);
+	#endif
+	#ifdef CONFIG_LSM6DSO
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lsm6dso_accel, 3);
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lsm6dso_gyro, 3);
+	#endif
+	#ifdef CONFIG_LSM6DSL
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lsm6dsl_accel, 3);
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lsm6dsl_gyro, 3);
+	#endif
+	#ifdef CONFIG_STTS751
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->stts751_temp, 1);
+	#endif
+	#ifdef CONFIG_LIS2MDL
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lis2mdl_magn, 3);
+	#endif
+	#ifdef CONFIG_LIS3MDL
+		count = _telemetry_put_sensor_values(values, count, max, sensor_data->lis3mdl_magn, 3);
+	#endif
+
+	return count;
+}
+
+size_t telemetry_encode_motion(const mpai_message_t* message, int64_t* values, size_t max)
+{
+	const motion_data_t *motion_data = (const motion_data_t *)message->data;
+
+	if (max < 2)
+	{
+		return 0;
+	}
+	values[0] = (int64_t)motion_data->motion_type * MPAI_TELEMETRY_VALUE_SCALE;
+	values[1] = _telemetry_fixed_point(motion_data->accel_total);
+	return 2;
+}
+
+size_t telemetry_encode_mic_peak(const mpai_message_t* message, int64_t* values, size_t max)
+{
+	const mic_peak_t *mic_peak = (const mic_peak_t *)message->data;
+
+	if (max < 1)
+	{
+		return 0;
+	}
+	values[0] = (int64_t)*mic_peak->data * MPAI_TELEMETRY_VALUE_SCALE;
+	return 1;
+}
+
+mpai_error_t* telemetry_aim_subscriber()
+{
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return &err;
+}
+
+mpai_error_t *telemetry_aim_start()
+{
+	if (telemetry_boot_id == 0)
+	{
+		telemetry_boot_id = sys_rand32_get();
+	}
+
+	// CREATE SUBSCRIBER
+	telemetry_thread_id = k_thread_create(&thread_telemetry, thread_telemetry_stack_area,
+										 K_THREAD_STACK_SIZEOF(thread_telemetry_stack_area),
+										 th_telemetry, NULL, NULL, NULL,
+										 PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&thread_telemetry, "thread_telemetry");
+
+	// START THREAD
+	k_thread_start(telemetry_thread_id);
+
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return &err;
+}
+
+mpai_error_t *telemetry_aim_stop()
+{
+	// the lock is taken first, so the thread is not aborted while it's packing a record
+	k_mutex_lock(&telemetry_lock, K_FOREVER);
+	k_thread_abort(telemetry_thread_id);
+	_telemetry_flush();
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+		// batches stored could be still in memory
+		MPAI_Flash_Writer_Flush(K_SECONDS(MPAI_TELEMETRY_FLUSH_TIMEOUT_S));
+		LOG_INF("%u batches stored in flash memory", telemetry_batches_stored);
+	#endif
+	// channels are added again when the AIW is started again
+	telemetry_channel_count = 0;
+	k_mutex_unlock(&telemetry_lock);
+	LOG_INF("Execution stopped: %u batches not sent", telemetry_batches_dropped);
+
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return &err;
+}
+
+mpai_error_t *telemetry_aim_resume()
+{
+	k_thread_resume(telemetry_thread_id);
+	LOG_INF("Execution resumed");
+
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return &err;
+}
+
+mpai_error_t *telemetry_aim_pause()
+{
+	// records already packed are sent when the execution is resumed
+	k_thread_suspend(telemetry_thread_id);
+	LOG_INF("Execution paused");
+
+	MPAI_ERR_INIT(err, MPAI_AIF_OK);
+	return &err;
+}
+
+/************* PRIVATE **************/
+size_t _telemetry_header_len()
+{
+	return 20 + 2 * telemetry_channel_count;
+}
+
+void _telemetry_append(size_t channel_idx, const mpai_message_t* message)
+{
+	int64_t values[MPAI_TELEMETRY_VALUES_MAX];
+	uint8_t encoded[MPAI_TELEMETRY_RECORD_MAX_LEN];
+	size_t count = telemetry_channels[channel_idx]._encoder(message, values, MPAI_TELEMETRY_VALUES_MAX);
+	size_t encoded_len = 0;
+
+	// values are encoded first, so the batch is sent only when the record doesn't fit really
+	for (size_t i = 0; i < count; i++)
+	{
+		encoded_len += _telemetry_put_varint(&encoded[encoded_len], values[i]);
+	}
+
+	k_mutex_lock(&telemetry_lock, K_FOREVER);
+	// channel index, delta of timestamp (10 bytes at most) and count of values
+	if (telemetry_batch_records > 0 && telemetry_batch_len + 12 + encoded_len > sizeof(telemetry_batch))
+	{
+		_telemetry_flush();
+	}
+	if (telemetry_batch_records == 0)
+	{
+		telemetry_batch_len = _telemetry_header_len();
+		telemetry_batch_first_timestamp = message->timestamp;
+		telemetry_batch_last_timestamp = message->timestamp;
+		telemetry_batch_opened_ms = k_uptime_get();
+	}
+
+	// channels are polled in turn, so timestamps could go back a bit: deltas are signed
+	telemetry_batch[telemetry_batch_len++] = (uint8_t)channel_idx;
+	telemetry_batch_len += _telemetry_put_varint(&telemetry_batch[telemetry_batch_len], message->timestamp - telemetry_batch_last_timestamp);
+	telemetry_batch[telemetry_batch_len++] = (uint8_t)count;
+	memcpy(&telemetry_batch[telemetry_batch_len], encoded, encoded_len);
+	telemetry_batch_len += encoded_len;
+	telemetry_batch_last_timestamp = message->timestamp;
+	telemetry_batch_records++;
+	k_mutex_unlock(&telemetry_lock);
+}
+
+void _telemetry_flush()
+{
+	if (telemetry_batch_records == 0)
+	{
+		return;
+	}
+
+	_telemetry_write_header();
+	int r = _telemetry_send(telemetry_batch, telemetry_batch_len, NULL);
+	#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+		if (r < 0)
+		{
+			// sent again when the network is up, as it is: the writer copies it, so it doesn't wait for the flash memory
+			r = MPAI_Flash_Writer_Submit(telemetry_batch, telemetry_batch_len, NULL, NULL);
+			if (r == 0)
+			{
+				telemetry_batches_stored++;
+				LOG_DBG("Batch %u stored in flash memory", telemetry_batch_sequence);
+			}
+		}
+	#endif
+	if (r < 0)
+	{
+		telemetry_batches_dropped++;
+		LOG_WRN("Batch %u not sent (%u records): %d", telemetry_batch_sequence, telemetry_batch_records, r);
+	}
+	else
+	{
+		LOG_DBG("Batch %u: %u records in %zu bytes", telemetry_batch_sequence, telemetry_batch_records, telemetry_batch_len);
+	}
+
+	telemetry_batch_sequence++;
+	telemetry_batch_records = 0;
+	telemetry_batch_len = 0;
+}
+
+int _telemetry_send(const uint8_t* data, size_t len, void* user_data)
+{
+	ARG_UNUSED(user_data);
+
+	// without the network, the socket would drop it
+	if (!wifi_is_connected())
+	{
+		return -ENOTCONN;
+	}
+	int r = coap_client_post_non(get_coap_client(), telemetry_path, COAP_CONTENT_FORMAT_APP_OCTET_STREAM, data, len);
+	return r < 0 ? r : 0;
+}
+
+#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+void _telemetry_forward()
+{
+	mpai_flash_ring_stats_t stats;
+	int64_t now = k_uptime_get();
+
+	if (now < telemetry_forward_next_ms || !wifi_is_connected())
+	{
+		return;
+	}
+	telemetry_forward_next_ms = now + CONFIG_MPAI_AIM_TELEMETRY_FORWARD_PERIOD_MS;
+	if (MPAI_Flash_Ring_Stats(&stats) != 0 || stats._pending == 0)
+	{
+		return;
+	}
+
+	// a few batches at a time, so the uplink is not flooded and new records are packed meanwhile
+	int r = MPAI_Flash_Ring_Forward(_telemetry_send, NULL, CONFIG_MPAI_AIM_TELEMETRY_FORWARD_BATCHES);
+	if (r < 0)
+	{
+		LOG_WRN("Batches stored not sent: %d", r);
+	}
+	else
+	{
+		LOG_INF("%d batches stored sent, %u left", r, stats._pending - r);
+	}
+}
+#endif
+
+void _telemetry_write_header()
+{
+	size_t len = 0;
+
+	memcpy(&telemetry_batch[len], MPAI_TELEMETRY_MAGIC, 2);
+	len += 2;
+	telemetry_batch[len++] = MPAI_TELEMETRY_VERSION;
+	telemetry_batch[len++] = (uint8_t)telemetry_channel_count;
+	for (size_t i = 0; i < telemetry_channel_count; i++)
+	{
+		_telemetry_put_le(&telemetry_batch[len], telemetry_channels[i]._hash, 2);
+		len += 2;
+	}
+	_telemetry_put_le(&telemetry_batch[len], telemetry_boot_id, 4);
+	len += 4;
+	_telemetry_put_le(&telemetry_batch[len], telemetry_batch_sequence, 2);
+	len += 2;
+	_telemetry_put_le(&telemetry_batch[len], telemetry_batch_records, 2);
+	len += 2;
+	_telemetry_put_le(&telemetry_batch[len], (uint64_t)telemetry_batch_first_timestamp, 8);
+}
+
+size_t _telemetry_put_varint(uint8_t* buffer, int64_t value)
+{
+	// zigzag: small values, positive or negative, take few bytes
+	uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+	size_t len = 0;
+
+	while (zigzag >= 0x80)
+	{
+		buffer[len++] = (uint8_t)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	buffer[len++] = (uint8_t)zigzag;
+	return len;
+}
+
+void _telemetry_put_le(uint8_t* buffer, uint64_t value, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		buffer[i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+size_t _telemetry_put_sensor_values(int64_t* values, size_t count, size_t max, const struct sensor_value* sensor_values, size_t len)
+{
+	for (size_t i = 0; i < len && count < max; i++)
+	{
+		// val2 is in millionths
+		values[count++] = (int64_t)sensor_values[i].val1 * MPAI_TELEMETRY_VALUE_SCALE + sensor_values[i].val2 / (1000000 / MPAI_TELEMETRY_VALUE_SCALE);
+	}
+	return count;
+}
+
+int64_t _telemetry_fixed_point(float value)
+{
+	return (int64_t)llroundf(value * MPAI_TELEMETRY_VALUE_SCALE);
+}
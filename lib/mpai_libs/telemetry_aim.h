@@ -0,0 +1,86 @@
+/*
+ * @file
+ * @brief Headers of an AIM that sends the messages of some channels to the COAP Server, packed in batches
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MPAI_LIBS_TELEMETRY_AIM_H
+#define MPAI_LIBS_TELEMETRY_AIM_H
+
+#include <core_common.h>
+#include <core_aim.h>
+#include <message_store.h>
+#include <sensors_common.h>
+#include <motion_common.h>
+#include <mic_common.h>
+#include <coap_connect.h>
+#include <wifi_connect.h>
+#include <sys/crc.h>
+#include <random/rand32.h>
+#ifdef CONFIG_MPAI_AIM_TELEMETRY_STORE_AND_FORWARD
+#include <flash_ring.h>
+#include <flash_writer.h>
+#endif
+
+/* Batch sent with a non-confirmable POST (all the integers are little endian):
+ * - header: magic "MT", version, count of channels, CRC16 of the name of each channel (uint16), random ID of the boot (uint32),
+ *   sequence of the batch in the boot (uint16), count of records (uint16), timestamp of the first record (int64, ms)
+ * - each record: index of the channel in the header, delta from the timestamp of the previous record (zigzag varint, ms),
+ *   count of values, each value in fixed-point (zigzag varint, MPAI_TELEMETRY_VALUE_SCALE units)
+ */
+#define MPAI_TELEMETRY_MAGIC "MT"
+#define MPAI_TELEMETRY_VERSION 2
+#define MPAI_TELEMETRY_VALUE_SCALE 1000
+#define MPAI_TELEMETRY_CHANNELS_MAX 8
+#define MPAI_TELEMETRY_VALUES_MAX 16
+/* Max wait for the batches stored, when the AIM is stopped */
+#define MPAI_TELEMETRY_FLUSH_TIMEOUT_S 5
+/* Channel index, delta of timestamp, count of values and values, each varint with 10 bytes at most */
+#define MPAI_TELEMETRY_RECORD_MAX_LEN (12 + 10 * MPAI_TELEMETRY_VALUES_MAX)
+
+/**
+ * @brief Convert the data of a message in fixed-point values
+ *
+ * @param message message copied from the channel
+ * @param values where the values are written, in MPAI_TELEMETRY_VALUE_SCALE units
+ * @param max max number of values
+ * @return size_t number of values written
+ */
+typedef size_t (telemetry_encoder_t)(const mpai_message_t* message, int64_t* values, size_t max);
+
+// The implementation will be added in AIW configuration
+__weak MPAI_AIM_MessageStore_t* message_store_telemetry_aim;
+
+/**
+ * @brief Add a channel to the ones sent (before starting the AIM): the AIM has to be registered to it in the message store
+ *
+ * @param channel_name name of the channel, identified in the batches by its CRC16
+ * @param channel
+ * @param encoder conversion of the data of its messages
+ * @return int 0 on success, -ENOMEM if there are too many channels
+ */
+int telemetry_aim_add_channel(const char* channel_name, subscriber_channel_t channel, telemetry_encoder_t* encoder);
+
+/* Encoders of the data published by the AIMs */
+size_t telemetry_encode_sensors(const mpai_message_t* message, int64_t* values, size_t max);
+
+size_t telemetry_encode_motion(const mpai_message_t* message, int64_t* values, size_t max);
+
+size_t telemetry_encode_mic_peak(const mpai_message_t* message, int64_t* values, size_t max);
+
+// AIM subscriber
+mpai_error_t* telemetry_aim_subscriber();
+
+// AIM high priorities commands
+mpai_error_t* telemetry_aim_start();
+
+mpai_error_t* telemetry_aim_stop();
+
+mpai_error_t* telemetry_aim_resume();
+
+mpai_error_t* telemetry_aim_pause();
+
+#endif
@@ -38,8 +38,15 @@ extern "C" {
 #define AUDIO_SAMPLING_FREQUENCY            16000
 // ATTENTION: to overwrite the handler, we have to disable IRQ and renable with the new IRQ Handler in the code
 // #define AUDIO_DFSDM_DMAx_MIC1_IRQHandler    DMA1_Channel4_IRQHandler
-#define PCM_BUFFER_LEN                      64U
 #define PCM_AUDIO_IN_SAMPLES                (AUDIO_SAMPLING_FREQUENCY / 1000)
+/* Duration of each half of the ping-pong buffer of the DMA: an interrupt every block */
+#ifdef CONFIG_MPAI_AIM_VOLUME_PEAKS_BLOCK_MS
+#define PCM_BLOCK_MS                        CONFIG_MPAI_AIM_VOLUME_PEAKS_BLOCK_MS
+#else
+#define PCM_BLOCK_MS                        1U
+#endif
+/* Ping-pong buffer in bytes: two blocks of 16-bit samples (64 bytes for blocks of 1 ms) */
+#define PCM_BUFFER_LEN                      (2U * PCM_BLOCK_MS * PCM_AUDIO_IN_SAMPLES * AUDIO_CHANNELS * 2U)
 
 /* COM define */
 #define USE_BSP_COM_FEATURE                  1U
@@ -67,9 +74,8 @@ extern "C" {
 /* SPI3 Baud rate in bps  */
 #define BUS_SPI3_BAUDRATE                    16000000U /* baud rate of SPIn = 16 Mbps */
 
-/* AUDIO IN internal buffer size in 32-bit words per micro */
-#define BSP_AUDIO_IN_DEFAULT_BUFFER_SIZE    2048U /* 2048*4 = 8Kbytes */
-// #define BSP_AUDIO_IN_DEFAULT_BUFFER_SIZE     PCM_BUFFER_LEN
+/* AUDIO IN internal buffer size in 32-bit words per micro: one word per sample of the ping-pong buffer */
+#define BSP_AUDIO_IN_DEFAULT_BUFFER_SIZE    (PCM_BUFFER_LEN / 2U) /* 320 words (1280 bytes) for blocks of 10 ms */
 
 #define CFG_HW_UART1_BAUDRATE                115200
 #define CFG_HW_UART1_WORDLENGTH              UART_WORDLENGTH_8B
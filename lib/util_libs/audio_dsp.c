@@ -0,0 +1,227 @@
+/*
+ * @file
+ * @brief Implementation of the fixed-point kernels of the audio front end
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "audio_dsp.h"
+
+#include <zephyr.h>
+#include <kernel.h>
+#include <math.h>
+#include <string.h>
+#include <logging/log.h>
+#ifdef AUDIO_DSP_SIMD
+#include <arch/arm/aarch32/cortex_m/cmsis.h>
+#endif
+
+LOG_MODULE_REGISTER(AUDIO_DSP, LOG_LEVEL_INF);
+
+/* Samples of the self check: 50 ms at 16 kHz, the longest audio block */
+#define AUDIO_DSP_SELF_CHECK_SAMPLES 800
+#define AUDIO_DSP_SELF_CHECK_SEED 0x4D504149
+
+/* x / 256 rounded toward zero, like the C division, with a shift */
+static inline int32_t audio_dsp_div256(int32_t x)
+{
+	return (x + ((x >> 31) & 0xFF)) >> 8;
+}
+
+/* next output of the high-pass filter, not saturated */
+static inline int32_t audio_dsp_hp_step(int32_t old_out, int32_t in, int32_t old_in)
+{
+	return audio_dsp_div256(0xFC * (old_out + in - old_in));
+}
+
+static inline int16_t audio_dsp_saturate_q15(int32_t x)
+{
+#ifdef AUDIO_DSP_SIMD
+	return (int16_t) __SSAT(x, 16);
+#else
+	return (int16_t) (x < -32768 ? -32768 : (x > 32767 ? 32767 : x));
+#endif
+}
+
+/************* PUBLIC **************/
+void audio_dsp_hp_filter(audio_dsp_hp_state_t* state, const uint16_t* in, int16_t* out, size_t n)
+{
+	int32_t old_out = state->old_out;
+	int32_t old_in = state->old_in;
+	size_t i = 0;
+
+#ifdef AUDIO_DSP_SIMD
+	// two samples for each load and store of 32 bits: the filter is recursive, so the samples are filtered in turn
+	for (; i + 1 < n; i += 2)
+	{
+		uint32_t in_pair;
+		memcpy(&in_pair, &in[i], sizeof(in_pair));
+		int32_t in_0 = (int32_t) (in_pair & 0xFFFF);
+		int32_t in_1 = (int32_t) (in_pair >> 16);
+
+		old_out = audio_dsp_hp_step(old_out, in_0, old_in);
+		int32_t out_0 = __SSAT(old_out, 16);
+		old_out = audio_dsp_hp_step(old_out, in_1, in_0);
+		int32_t out_1 = __SSAT(old_out, 16);
+		old_in = in_1;
+
+		uint32_t out_pair = __PKHBT(out_0, out_1, 16);
+		memcpy(&out[i], &out_pair, sizeof(out_pair));
+	}
+#endif
+	for (; i < n; i++)
+	{
+		int32_t in_0 = (int32_t) in[i];
+		old_out = audio_dsp_hp_step(old_out, in_0, old_in);
+		old_in = in_0;
+		out[i] = audio_dsp_saturate_q15(old_out);
+	}
+
+	// the state isn't saturated, like the output
+	state->old_out = old_out;
+	state->old_in = old_in;
+}
+
+uint64_t audio_dsp_energy(const int16_t* samples, size_t n)
+{
+	uint64_t energy = 0;
+	size_t i = 0;
+
+#ifdef AUDIO_DSP_SIMD
+	// the squares of two samples are added at once, in 64 bits: a pair of squares overflows 32 bits
+	for (; i + 3 < n; i += 4)
+	{
+		uint32_t pairs[2];
+		memcpy(pairs, &samples[i], sizeof(pairs));
+		energy = __SMLALD(pairs[0], pairs[0], energy);
+		energy = __SMLALD(pairs[1], pairs[1], energy);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		energy += (uint32_t) ((int32_t) samples[i] * samples[i]);
+	}
+	return energy;
+}
+
+int32_t audio_dsp_rms(uint32_t mean_square)
+{
+	// square root a bit at a time, in integers
+	uint32_t rms = 0;
+	for (uint32_t bit = 1u << 15; bit > 0; bit >>= 1)
+	{
+		uint32_t candidate = rms | bit;
+		if (candidate * candidate <= mean_square)
+		{
+			rms = candidate;
+		}
+	}
+	return (int32_t) rms;
+}
+
+float audio_dsp_dbfs(uint32_t mean_square)
+{
+	if (mean_square == 0)
+	{
+		return AUDIO_DSP_DBFS_MIN;
+	}
+	return MAX(10.0f * log10f((float) mean_square / AUDIO_DSP_FULL_SCALE_MEAN_SQUARE), AUDIO_DSP_DBFS_MIN);
+}
+
+/************* SELF CHECK **************/
+/* high-pass filter of the mic AIM, before the kernels */
+static void audio_dsp_hp_filter_reference(audio_dsp_hp_state_t* state, const uint16_t* in, int16_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		int32_t z = (int32_t) in[i];
+		state->old_out = (0xFC * (state->old_out + z - state->old_in)) / 256;
+		state->old_in = z;
+		out[i] = (int16_t) (state->old_out < -32768 ? -32768 : (state->old_out > 32767 ? 32767 : state->old_out));
+	}
+}
+
+/* sum of the squares, one sample at a time */
+static uint64_t audio_dsp_energy_reference(const int16_t* samples, size_t n)
+{
+	uint64_t energy = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		energy += (uint64_t) ((int64_t) samples[i] * samples[i]);
+	}
+	return energy;
+}
+
+bool audio_dsp_self_check(void)
+{
+	uint16_t* in = (uint16_t*) k_malloc(AUDIO_DSP_SELF_CHECK_SAMPLES * sizeof(uint16_t));
+	int16_t* out = (int16_t*) k_malloc(AUDIO_DSP_SELF_CHECK_SAMPLES * sizeof(int16_t));
+	int16_t* out_reference = (int16_t*) k_malloc(AUDIO_DSP_SELF_CHECK_SAMPLES * sizeof(int16_t));
+	bool ok = in != NULL && out != NULL && out_reference != NULL;
+
+	if (!ok)
+	{
+		LOG_ERR("Not enough memory for the self check of the audio kernels");
+	}
+	else
+	{
+		// a tone with noise, then runs of the extreme values that saturate the filter
+		uint32_t seed = AUDIO_DSP_SELF_CHECK_SEED;
+		for (size_t i = 0; i < AUDIO_DSP_SELF_CHECK_SAMPLES; i++)
+		{
+			seed ^= seed << 13;
+			seed ^= seed >> 17;
+			seed ^= seed << 5;
+			int32_t tone = ((i / 8) % 2 == 0 ? 12000 : -12000) + (int32_t) (seed % 2048) - 1024;
+			in[i] = (uint16_t) (int16_t) tone;
+		}
+		for (size_t i = 0; i < 64; i++)
+		{
+			static const uint16_t extremes[] = { 0x0000, 0x7FFF, 0x8000, 0xFFFF };
+			in[AUDIO_DSP_SELF_CHECK_SAMPLES / 2 + i] = extremes[(i / 16) % 4];
+		}
+
+		// the whole block, then the same signal split in blocks of odd lengths: the state continues the filter
+		audio_dsp_hp_state_t state_reference = { 0, 0 };
+		audio_dsp_hp_state_t state = { 0, 0 };
+		uint32_t start = k_cycle_get_32();
+		audio_dsp_hp_filter_reference(&state_reference, in, out_reference, AUDIO_DSP_SELF_CHECK_SAMPLES);
+		uint32_t cycles_filter_reference = k_cycle_get_32() - start;
+		start = k_cycle_get_32();
+		audio_dsp_hp_filter(&state, in, out, AUDIO_DSP_SELF_CHECK_SAMPLES);
+		uint32_t cycles_filter = k_cycle_get_32() - start;
+		ok = memcmp(out, out_reference, AUDIO_DSP_SELF_CHECK_SAMPLES * sizeof(int16_t)) == 0 &&
+			 state.old_out == state_reference.old_out && state.old_in == state_reference.old_in;
+
+		memset(&state, 0, sizeof(state));
+		for (size_t offset = 0, len = 1; offset < AUDIO_DSP_SELF_CHECK_SAMPLES; offset += len, len += 2)
+		{
+			len = MIN(len, AUDIO_DSP_SELF_CHECK_SAMPLES - offset);
+			audio_dsp_hp_filter(&state, in + offset, out + offset, len);
+		}
+		ok = ok && memcmp(out, out_reference, AUDIO_DSP_SELF_CHECK_SAMPLES * sizeof(int16_t)) == 0;
+
+		start = k_cycle_get_32();
+		uint64_t energy_reference = audio_dsp_energy_reference(out_reference, AUDIO_DSP_SELF_CHECK_SAMPLES);
+		uint32_t cycles_energy_reference = k_cycle_get_32() - start;
+		start = k_cycle_get_32();
+		uint64_t energy = audio_dsp_energy(out_reference, AUDIO_DSP_SELF_CHECK_SAMPLES);
+		uint32_t cycles_energy = k_cycle_get_32() - start;
+		ok = ok && energy == energy_reference;
+		for (size_t len = 0; len < 8; len++)
+		{
+			ok = ok && audio_dsp_energy(out_reference + 1, len) == audio_dsp_energy_reference(out_reference + 1, len);
+		}
+
+		LOG_INF("Audio kernels (%u samples): filter %u cycles (reference %u), energy %u cycles (reference %u)",
+				AUDIO_DSP_SELF_CHECK_SAMPLES, cycles_filter, cycles_filter_reference, cycles_energy, cycles_energy_reference);
+		LOG_INF("Audio kernels self check %s", ok ? "passed" : "FAILED");
+	}
+
+	k_free(in);
+	k_free(out);
+	k_free(out_reference);
+	return ok;
+}
@@ -0,0 +1,79 @@
+/*
+ * @file
+ * @brief Headers of the fixed-point kernels of the audio front end: high-pass filter and energy of the blocks of samples.
+ * On Cortex-M with DSP extension they use its instructions (SSAT, PKHBT, SMLALD), elsewhere they fall back to portable C
+ * with the same results
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(CONFIG_CPU_CORTEX_M) && defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP == 1
+#define AUDIO_DSP_SIMD
+#endif
+
+/* Mean square of a full scale square wave of q15 samples (0 dBFS) */
+#define AUDIO_DSP_FULL_SCALE_MEAN_SQUARE (32768.0f * 32768.0f)
+/* Level of silence: 10 * log10(1 / AUDIO_DSP_FULL_SCALE_MEAN_SQUARE), rounded down */
+#define AUDIO_DSP_DBFS_MIN (-91.0f)
+
+/* State of the high-pass filter y[n] = 252/256 * (y[n-1] + x[n] - x[n-1]), that removes the DC component and low frequency noise */
+typedef struct audio_dsp_hp_state_t {
+	int32_t old_out;
+	int32_t old_in;
+} audio_dsp_hp_state_t;
+
+/**
+ * @brief Filter a block of samples with the high-pass filter, saturating the output to q15.
+ * Samples are read as unsigned, like the filter of SENSING1 this is ported from: the thresholds of the volume peaks are tuned on it
+ *
+ * @param state updated at the end of the block, so the next block continues the filter
+ * @param in samples as written by the DMA
+ * @param out filtered samples (can't overlap in)
+ * @param n number of samples
+ */
+void audio_dsp_hp_filter(audio_dsp_hp_state_t* state, const uint16_t* in, int16_t* out, size_t n);
+
+/**
+ * @brief Energy of a block of q15 samples: sum of their squares, without rounding
+ *
+ * @param samples
+ * @param n number of samples
+ * @return uint64_t
+ */
+uint64_t audio_dsp_energy(const int16_t* samples, size_t n);
+
+/**
+ * @brief RMS of a window of q15 samples, by the mean square of its samples (energy / number of samples)
+ *
+ * @param mean_square
+ * @return int32_t RMS in q15 units, rounded down
+ */
+int32_t audio_dsp_rms(uint32_t mean_square);
+
+/**
+ * @brief Level of a window of q15 samples relative to full scale, by the mean square of its samples
+ *
+ * @param mean_square
+ * @return float dBFS, AUDIO_DSP_DBFS_MIN for silence
+ */
+float audio_dsp_dbfs(uint32_t mean_square);
+
+/**
+ * @brief Check that the kernels give the same results of the scalar implementation they replace (bit-exact),
+ * on a synthetic signal with the extreme values and blocks of odd lengths. The cycles of both are printed to the log
+ *
+ * @return true if all the results match
+ * @return false
+ */
+bool audio_dsp_self_check(void);
+
+#endif
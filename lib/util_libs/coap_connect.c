@@ -10,252 +10,512 @@
  */
 
 #include <coap_connect.h>
+#include <misc_utils.h>
 
 #include <zephyr.h>
 #include <sys/printk.h>
 #include <kernel.h>
 #include <logging/log.h>
+#include <random/rand32.h>
 
 LOG_MODULE_REGISTER(COAP_CONNECT, LOG_LEVEL_INF);
 
 #include <net_private.h>
 
-/* CoAP socket fd */
-struct pollfd fds[1];
-int nfds;
-int coap_sock;
-
-struct coap_block_context blk_ctx;
+/* Client connected to the COAP Server of the configuration */
+coap_client_t coap_client;
+
+/* Fields of the value of a Block2 option (RFC 7959, 2.2) */
+#define COAP_BLOCK2_NUM(value) ((size_t)(value) >> 4)
+#define COAP_BLOCK2_MORE(value) (((value) & 0x8) != 0)
+#define COAP_BLOCK2_SZX(value) ((value) & 0x7)
+
+/* Max time from the first transmission of a CON request to its reply (RFC 7252, 4.8.2), with ACK_RANDOM_FACTOR 1.5 */
+#define COAP_CLIENT_MAX_TRANSMIT_WAIT_MS (CONFIG_COAP_CLIENT_ACK_TIMEOUT_MS * ((2 << CONFIG_COAP_CLIENT_MAX_RETRANSMIT) - 1) * 3 / 2)
+
+/* Max time the RX thread waits for a datagram, before checking if the client is closed */
+#define COAP_CLIENT_RX_POLL_MS 250
+/* Delay before a transfer without blocks in flight asks again a reply buffer */
+#define COAP_BLOCK_BUFFER_RETRY_MS 20
+/* Empty ACK or RST (RFC 7252, 4.1): header only */
+#define COAP_EMPTY_MSG_LEN 4
+
+/* Freshness of a notification without Max-Age option (RFC 7252, 5.10.5) */
+#define COAP_DEFAULT_MAX_AGE 60
+/* Notifications are ordered by their Observe option, a 24 bits sequence (RFC 7641, 3.4) */
+#define COAP_OBSERVE_SEQUENCE_WINDOW (1UL << 23)
+#define COAP_OBSERVE_SEQUENCE_TIMEOUT_MS (128 * MSEC_PER_SEC)
+
+/* Large msg reassembled in place, block after block */
+typedef struct _coap_msg_buffer_t {
+	char* _data;		// null terminated
+	size_t _len;
+	size_t _capacity;	// including the termination
+} coap_msg_buffer_t;
+
+/* Block asked by a windowed transfer, until it's delivered in order */
+typedef struct _coap_block_slot_t {
+	coap_client_exchange_t _exchange;	// token and message ID, the same for all the retransmissions
+	struct _coap_large_transfer_t* _transfer;
+	size_t _num;
+	bool _pending;				// asked, reply not received yet
+	bool _acked;				// empty ACK received: the reply will be a separate response, no more retransmissions
+	uint8_t _retransmissions;
+	uint32_t _timeout;			// ms, doubled at each retransmission
+	int64_t _deadline;			// uptime (ms) to retransmit (or to fail) if the reply is not received
+	bool _received;				// received, waiting for the previous blocks
+	uint8_t* _payload;			// block to stream (in _reply if received out of order)
+	uint16_t _len;
+	struct _coap_large_reply_t* _reply;	// reserved when the block is asked, taken by the RX thread to queue the reply, then kept until delivered
+	bool _replied;				// the reply has been queued: duplicates are dropped
+	bool _empty_replied;			// an empty ACK or RST has been queued: duplicates are dropped
+} coap_block_slot_t;
+
+/* State of a block-wise transfer handled concurrently with the others */
+typedef struct _coap_large_transfer_t {
+	coap_client_t* _client;
+	struct k_fifo* _replies;			// replies queued by the RX thread, shared by the transfers of the same call
+	const char * const * _path;
+	large_coap_block_callback_t* _block_callback;	// NULL if the msg is rebuilt in _msg
+	uint16_t _accept_format;
+	const uint8_t* _etag;				// sent with the first block, for a conditional GET
+	uint8_t _etag_len;
+	large_coap_response_t _response;
+	struct coap_block_context _blk_ctx;	// block size and total size sent by the server
+	coap_block_slot_t _window[CONFIG_COAP_BLOCK_WINDOW];	// blocks in flight, indexed by number modulo window
+	size_t _next_num;					// next block to ask
+	size_t _delivered;					// blocks delivered in order
+	size_t _block_count;				// 0 until known
+	int _content_format;
+	coap_msg_buffer_t _msg;				// msg rebuilt until now
+	bool _completed;
+} coap_large_transfer_t;
+
+/* Reply copied by the RX thread, waiting to be processed by the thread of the transfer */
+typedef struct _coap_large_reply_t {
+	void* _fifo_reserved;				// first word is used by k_fifo
+	coap_block_slot_t* _slot;
+	struct k_mem_slab* _slab;
+	uint16_t _len;
+	uint8_t _data[];
+} coap_large_reply_t;
+
+/* Replies of the blocks asked, shared by all the transfers instead of taken from the heap by the RX thread */
+K_MEM_SLAB_DEFINE(coap_reply_slab, ROUND_UP(sizeof(coap_large_reply_t) + MAX_COAP_MSG_LEN, 4), CONFIG_COAP_BLOCK_BUFFERS, 4);
+/* Empty ACKs and RSTs, at most one for each block asked */
+K_MEM_SLAB_DEFINE(coap_empty_reply_slab, ROUND_UP(sizeof(coap_large_reply_t) + COAP_EMPTY_MSG_LEN, 4), CONFIG_COAP_BLOCK_BUFFERS, 4);
+
+BUILD_ASSERT(CONFIG_COAP_BLOCK_BUFFERS >= MAX_COAP_CONCURRENT_TRANSFERS, "Concurrent transfers can't ask their first block at the same time");
 
 /*** PRIVATE ***/
-void extract_data_result(struct coap_packet packet, uint8_t* data_result, bool add_termination);
-int send_obs_reply_ack(uint16_t id, uint8_t *token, uint8_t tkl, const char * const * obs_path);
+void coap_client_rx_thread(void *p1, void *p2, void *p3);
+void dispatch_coap_client_reply(coap_client_t* client, uint8_t *data, size_t len);
+coap_client_exchange_t* find_coap_client_exchange(coap_client_t* client, const struct coap_packet *reply);
+int send_large_coap_block_request(coap_client_t* client, const char * const * large_path, uint16_t accept_format, const uint8_t *etag, uint8_t etag_len, struct coap_block_context *ctx, const uint8_t *token, uint16_t id);
+int send_coap_empty_reply(coap_client_t* client, uint8_t type, uint16_t id);
+int send_coap_observe_request(coap_client_observation_t* observation, uint32_t observe);
+void process_coap_notification(coap_client_exchange_t* exchange, const struct coap_packet *reply, void* user_data);
+bool coap_observe_is_newer(uint32_t sequence, uint32_t new_sequence, int64_t timestamp, int64_t new_timestamp);
+int write_coap_msg_buffer(coap_msg_buffer_t *msg, size_t offset, const uint8_t *payload, size_t len, size_t total_size);
+int get_coap_content_format(const struct coap_packet *reply);
+int get_coap_etag(const struct coap_packet *reply, uint8_t *etag);
+void store_large_coap_msg(size_t idx, char* data_result, void* user_data);
+void queue_large_coap_reply(coap_client_exchange_t* exchange, const struct coap_packet *reply, void* user_data);
+int fill_large_coap_window(coap_large_transfer_t *transfer);
+int send_large_coap_block_slot(coap_large_transfer_t *transfer, coap_block_slot_t *slot);
+int dispatch_large_coap_reply(coap_large_transfer_t *transfers, coap_block_slot_t *slot, struct coap_packet *reply, void* user_data);
+int process_large_coap_transfer_reply(coap_large_transfer_t *transfer, size_t idx, coap_block_slot_t *slot, struct coap_packet *reply, void* user_data);
+int retransmit_large_coap_window(coap_large_transfer_t *transfer);
+int32_t next_large_coap_timeout(coap_large_transfer_t *transfers, size_t count);
+void complete_large_coap_transfer(coap_large_transfer_t *transfers, const large_coap_request_t *request, coap_large_transfer_t *transfer, int result, large_coap_msg_callback_t* callback, void* user_data);
+void release_large_coap_window(coap_large_transfer_t *transfer);
+void release_large_coap_reply(coap_block_slot_t *slot);
 
 /*** PUBLIC ***/
-int get_coap_sock(void)
+int coap_client_init(coap_client_t* client, const char* address, uint16_t port)
 {
-	return coap_sock;
-}
+	struct sockaddr_in addr;
+	int r;
 
-struct coap_block_context get_block_context(void)
-{
-	return blk_ctx;
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+
+	inet_pton(AF_INET, address, &addr.sin_addr);
+
+	client->_sock = socket(addr.sin_family, SOCK_DGRAM, IPPROTO_UDP);
+	if (client->_sock < 0) {
+		LOG_ERR("Failed to create UDP socket %d", errno);
+		return -errno;
+	}
+
+	r = connect(client->_sock, (struct sockaddr *)&addr, sizeof(addr));
+	if (r < 0) {
+		r = -errno;
+		LOG_ERR("Cannot connect to UDP remote : %d", errno);
+		(void)close(client->_sock);
+		return r;
+	}
+
+	k_mutex_init(&client->_lock);
+	memset(client->_exchanges, 0, sizeof(client->_exchanges));
+	client->_running = true;
+
+	// replies are received by a dedicated thread, so many threads can wait for them at the same time
+	k_thread_create(&client->_rx_thread, client->_rx_stack, K_THREAD_STACK_SIZEOF(client->_rx_stack),
+			coap_client_rx_thread, client, NULL, NULL,
+			CONFIG_COAP_CLIENT_RX_PRIORITY, 0, K_NO_WAIT);
+	k_thread_name_set(&client->_rx_thread, "coap_client_rx");
+
+	return 0;
 }
 
-struct coap_block_context* get_block_context_ptr(void)
+void coap_client_close(coap_client_t* client)
 {
-	return &blk_ctx;
+	if (!client->_running) {
+		return;
+	}
+
+	// the RX thread checks the flag at least every COAP_CLIENT_RX_POLL_MS
+	client->_running = false;
+	k_thread_join(&client->_rx_thread, K_FOREVER);
+	(void)close(client->_sock);
 }
 
-void wait(void)
+int coap_client_register(coap_client_t* client, coap_client_exchange_t* exchange)
 {
-	if (poll(fds, nfds, -1) < 0) {
-		LOG_ERR("Error in poll:%d", errno);
+	int r = -ENOMEM;
+
+	k_mutex_lock(&client->_lock, K_FOREVER);
+	for (size_t i = 0; i < CONFIG_COAP_CLIENT_MAX_EXCHANGES; i++) {
+		if (client->_exchanges[i] == NULL) {
+			client->_exchanges[i] = exchange;
+			r = 0;
+			break;
+		}
+	}
+	k_mutex_unlock(&client->_lock);
+
+	if (r < 0) {
+		LOG_ERR("Too many CoAP requests waiting for a reply");
 	}
+	return r;
 }
 
-void prepare_fds(void)
+void coap_client_unregister(coap_client_t* client, coap_client_exchange_t* exchange)
 {
-	fds[nfds].fd = coap_sock;
-	fds[nfds].events = POLLIN;
-	nfds++;
+	k_mutex_lock(&client->_lock, K_FOREVER);
+	for (size_t i = 0; i < CONFIG_COAP_CLIENT_MAX_EXCHANGES; i++) {
+		if (client->_exchanges[i] == exchange) {
+			client->_exchanges[i] = NULL;
+			break;
+		}
+	}
+	k_mutex_unlock(&client->_lock);
 }
 
-int start_coap_client(void)
+int coap_client_send(coap_client_t* client, const uint8_t *data, size_t len)
 {
-	int ret = 0;
-	struct sockaddr_in addr;
-
-	addr.sin_family = AF_INET;
-	addr.sin_port = htons(PEER_PORT);
-
-	inet_pton(AF_INET, IP_ADDRESS_COAP_SERVER,
-		  &addr.sin_addr);
+	int r;
 
-	coap_sock = socket(addr.sin_family, SOCK_DGRAM, IPPROTO_UDP);
-	if (coap_sock < 0) {
-		LOG_ERR("Failed to create UDP socket %d", errno);
-		return -errno;
+	if (!client->_running) {
+		return -ENOTCONN;
 	}
 
-	ret = connect(coap_sock, (struct sockaddr *)&addr, sizeof(addr));
-	if (ret < 0) {
-		LOG_ERR("Cannot connect to UDP remote : %d", errno);
-		return -errno;
+	k_mutex_lock(&client->_lock, K_FOREVER);
+	r = send(client->_sock, data, len, 0);
+	if (r < 0) {
+		r = -errno;
+		LOG_ERR("Error sending CoAP msg: %d", errno);
 	}
+	k_mutex_unlock(&client->_lock);
 
-	prepare_fds();
-
-	return 0;
+	return r;
 }
 
-int process_simple_coap_reply(uint8_t * data_result)
+int coap_client_post_non(coap_client_t* client, const char * const * path, uint16_t content_format, const uint8_t *payload, size_t len)
 {
-	struct coap_packet reply = {};
+	struct coap_packet request;
+	const char * const *p;
 	uint8_t *data;
-	int rcvd;
-	int ret;
-
-	wait();
+	int r;
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
+	data = (uint8_t *)k_malloc(len + COAP_MSG_HEADROOM);
 	if (!data) {
 		return -ENOMEM;
 	}
 
-	rcvd = recv(coap_sock, data, MAX_COAP_MSG_LEN, MSG_DONTWAIT);
-	if (rcvd == 0) {
-		ret = -EIO;
+	// replies are not expected: if the server sends one, the RX thread ignores it because no exchange has its token
+	r = coap_packet_init(&request, data, len + COAP_MSG_HEADROOM,
+			     COAP_VERSION_1, COAP_TYPE_NON_CON,
+			     COAP_TOKEN_MAX_LEN, coap_next_token(),
+			     COAP_METHOD_POST, coap_next_id());
+	if (r < 0) {
+		LOG_ERR("Failed to init CoAP message");
 		goto end;
 	}
 
-	if (rcvd < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			ret = 0;
-		} else {
-			ret = -errno;
+	for (p = path; p && *p; p++) {
+		r = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
+					      *p, strlen(*p));
+		if (r < 0) {
+			LOG_ERR("Unable add option to request");
+			goto end;
 		}
+	}
 
+	r = coap_append_option_int(&request, COAP_OPTION_CONTENT_FORMAT, content_format);
+	if (r < 0) {
+		LOG_ERR("Unable to add content format option.");
 		goto end;
 	}
 
-	net_hexdump("Raw response", data, rcvd);
-
-	ret = coap_packet_parse(&reply, data, rcvd, NULL, 0);
-	extract_data_result(reply, data_result, true);
-	printk("Response %s\n", data_result);
+	r = coap_packet_append_payload_marker(&request);
+	if (r < 0) {
+		LOG_ERR("Unable to append payload marker");
+		goto end;
+	}
 
-	if (ret < 0) {
-		LOG_ERR("Invalid data received");
+	r = coap_packet_append_payload(&request, payload, len);
+	if (r < 0) {
+		LOG_ERR("Not able to append payload");
+		goto end;
 	}
 
+	r = coap_client_send(client, request.data, request.offset);
+
 end:
 	k_free(data);
 
-	return ret;
+	return r;
 }
 
-int process_large_coap_reply(uint8_t * data_result)
+coap_client_t* get_coap_client(void)
 {
-	struct coap_packet reply = {};
-	uint8_t *data;
-	bool last_block;
-	int rcvd;
-	int ret;
+	return &coap_client;
+}
 
-	wait();
+int start_coap_client(void)
+{
+	return coap_client_init(&coap_client, IP_ADDRESS_COAP_SERVER, PEER_PORT);
+}
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
-	if (!data) {
-		return -ENOMEM;
+void stop_coap_client(void)
+{
+	coap_client_close(&coap_client);
+}
+
+int coap_client_observe(coap_client_t* client, coap_client_observation_t* observation, const char * const * path, uint16_t accept_format, coap_client_notification_callback_t* callback, void* user_data)
+{
+	int r;
+
+	memset(observation, 0, sizeof(coap_client_observation_t));
+	observation->_client = client;
+	observation->_path = path;
+	observation->_accept_format = accept_format;
+	observation->_callback = callback;
+	observation->_user_data = user_data;
+	// the token identifies the notifications for all the life of the observation
+	memcpy(observation->_exchange._token, coap_next_token(), COAP_TOKEN_MAX_LEN);
+	observation->_exchange._callback = process_coap_notification;
+	observation->_exchange._user_data = observation;
+
+	r = coap_client_register(client, &observation->_exchange);
+	if (r < 0) {
+		return r;
 	}
 
-	rcvd = recv(coap_sock, data, MAX_COAP_MSG_LEN, MSG_DONTWAIT);
-	if (rcvd == 0) {
-		ret = -EIO;
-		goto end;
+	r = coap_client_observe_refresh(observation);
+	if (r < 0) {
+		coap_client_unregister(client, &observation->_exchange);
 	}
+	return r;
+}
 
-	if (rcvd < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			ret = 0;
-		} else {
-			ret = -errno;
-		}
+int coap_client_observe_refresh(coap_client_observation_t* observation)
+{
+	// a registration with the same token replaces the previous one on the server (RFC 7641, 4.1)
+	k_mutex_lock(&observation->_client->_lock, K_FOREVER);
+	observation->_exchange._id = coap_next_id();
+	k_mutex_unlock(&observation->_client->_lock);
 
-		goto end;
-	}
+	LOG_INF("Observing COAP: %s", log_strdup(observation->_path[0]));
+	return send_coap_observe_request(observation, 0);
+}
 
-	// net_hexdump("Raw response", data, rcvd);
+void coap_client_observe_cancel(coap_client_observation_t* observation)
+{
+	coap_client_unregister(observation->_client, &observation->_exchange);
+	observation->_registered = false;
 
-	ret = coap_packet_parse(&reply, data, rcvd, NULL, 0);
-	if (ret < 0) {
-		LOG_ERR("Invalid data received");
-		goto end;
-	}
+	// deregistration (RFC 7641, 3.6): a new message, with the token of the observation
+	k_mutex_lock(&observation->_client->_lock, K_FOREVER);
+	observation->_exchange._id = coap_next_id();
+	k_mutex_unlock(&observation->_client->_lock);
 
-	ret = coap_update_from_block(&reply, &blk_ctx);
-	if (ret < 0) {
-		goto end;
-	}
+	// later notifications are rejected anyway, because the token is unknown
+	(void)send_coap_observe_request(observation, 1);
+}
 
-	extract_data_result(reply, data_result, false);
-	// printk("Response block %zd: %s\n", get_block_context().current / 64, data_result);
+bool coap_client_observe_is_fresh(coap_client_observation_t* observation)
+{
+	bool fresh;
 
-	last_block = coap_next_block(&reply, &blk_ctx);
-	if (!last_block) {
-		ret = 1;
-		goto end;
-	}
+	// notifications stop silently if the server forgets the client: Max-Age bounds the validity of the last one
+	k_mutex_lock(&observation->_client->_lock, K_FOREVER);
+	fresh = observation->_registered &&
+		k_uptime_get() - observation->_timestamp <= (int64_t)observation->_max_age * MSEC_PER_SEC;
+	k_mutex_unlock(&observation->_client->_lock);
 
-	ret = 0;
+	return fresh;
+}
 
-end:
-	k_free(data);
+void coap_client_rx_thread(void *p1, void *p2, void *p3)
+{
+	coap_client_t* client = (coap_client_t*)p1;
+	struct pollfd fds[1] = { { .fd = client->_sock, .events = POLLIN } };
+	int rcvd;
+	int r;
+
+	while (client->_running) {
+		r = poll(fds, 1, COAP_CLIENT_RX_POLL_MS);
+		if (r < 0) {
+			LOG_ERR("Error in poll:%d", errno);
+			break;
+		}
+		if (r == 0) {
+			continue;
+		}
+
+		rcvd = recv(client->_sock, client->_rx_buffer, MAX_COAP_MSG_LEN, MSG_DONTWAIT);
+		if (rcvd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			continue;
+		}
+		if (rcvd <= 0) {
+			LOG_ERR("Error receiving CoAP replies: %d", errno);
+			break;
+		}
+
+		dispatch_coap_client_reply(client, client->_rx_buffer, rcvd);
+	}
 
-	return ret;
+	// requests waiting for a reply fail by timeout
+	LOG_DBG("CoAP client RX thread stopped");
 }
 
-int process_obs_coap_reply(const char * const *  obs_path)
+void dispatch_coap_client_reply(coap_client_t* client, uint8_t *data, size_t len)
 {
 	struct coap_packet reply;
-	uint16_t id;
-	uint8_t token[COAP_TOKEN_MAX_LEN];
-	uint8_t *data;
-	uint8_t type;
-	uint8_t tkl;
-	int rcvd;
-	int ret;
+	coap_client_exchange_t* exchange;
+
+	if (coap_packet_parse(&reply, data, len, NULL, 0) < 0) {
+		LOG_ERR("Invalid data received");
+		return;
+	}
 
-	wait();
+	// the lock keeps the exchange registered until its callback returns
+	k_mutex_lock(&client->_lock, K_FOREVER);
+	exchange = find_coap_client_exchange(client, &reply);
 
-	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
-	if (!data) {
-		return -ENOMEM;
+	// separate responses and notifications are confirmable: they are acknowledged also when they are duplicates,
+	// and rejected when nobody waits for them, so the server stops sending them (RFC 7641, 3.6)
+	if (coap_header_get_type(&reply) == COAP_TYPE_CON) {
+		send_coap_empty_reply(client, exchange != NULL ? COAP_TYPE_ACK : COAP_TYPE_RESET, coap_header_get_id(&reply));
 	}
 
-	rcvd = recv(coap_sock, data, MAX_COAP_MSG_LEN, MSG_DONTWAIT);
-	if (rcvd == 0) {
-		ret = -EIO;
-		goto end;
+	if (exchange != NULL) {
+		exchange->_callback(exchange, &reply, exchange->_user_data);
+	} else {
+		// reply of an old request or duplicate, nothing to do
+		LOG_DBG("CoAP reply %d without request", coap_header_get_id(&reply));
 	}
+	k_mutex_unlock(&client->_lock);
+}
 
-	if (rcvd < 0) {
-		if (errno == EAGAIN || errno == EWOULDBLOCK) {
-			ret = 0;
-		} else {
-			ret = -errno;
+coap_client_exchange_t* find_coap_client_exchange(coap_client_t* client, const struct coap_packet *reply)
+{
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t tkl;
+
+	// empty ACK and RST have no token: they are matched by message ID
+	if (coap_header_get_code(reply) == COAP_CODE_EMPTY) {
+		uint16_t id = coap_header_get_id(reply);
+		for (size_t i = 0; i < CONFIG_COAP_CLIENT_MAX_EXCHANGES; i++) {
+			if (client->_exchanges[i] != NULL && client->_exchanges[i]->_id == id) {
+				return client->_exchanges[i];
+			}
 		}
+		return NULL;
+	}
 
-		goto end;
+	tkl = coap_header_get_token(reply, token);
+	if (tkl != COAP_TOKEN_MAX_LEN) {
+		return NULL;
 	}
+	for (size_t i = 0; i < CONFIG_COAP_CLIENT_MAX_EXCHANGES; i++) {
+		if (client->_exchanges[i] != NULL && memcmp(client->_exchanges[i]->_token, token, tkl) == 0) {
+			return client->_exchanges[i];
+		}
+	}
+	return NULL;
+}
 
-	// net_hexdump("Response", data, rcvd);
+void process_coap_notification(coap_client_exchange_t* exchange, const struct coap_packet *reply, void* user_data)
+{
+	coap_client_observation_t* observation = (coap_client_observation_t*)user_data;
+	uint8_t code = coap_header_get_code(reply);
+	int64_t now = k_uptime_get();
+	const uint8_t *payload;
+	uint16_t len = 0;
+	int observe;
+	int max_age;
+	int block2;
+
+	if (code == COAP_CODE_EMPTY) {
+		if (coap_header_get_type(reply) == COAP_TYPE_RESET) {
+			LOG_ERR("Observation of %s rejected", log_strdup(observation->_path[0]));
+			observation->_registered = false;
+		}
+		return;
+	}
+	if (code != COAP_RESPONSE_CODE_CONTENT) {
+		// an error response ends the observation (RFC 7641, 3.2)
+		LOG_ERR("Unexpected response code %d observing %s", code, log_strdup(observation->_path[0]));
+		observation->_registered = false;
+		return;
+	}
 
-	ret = coap_packet_parse(&reply, data, rcvd, NULL, 0);
-	if (ret < 0) {
-		LOG_ERR("Invalid data received");
-		goto end;
+	observe = coap_get_option_int(reply, COAP_OPTION_OBSERVE);
+	if (observe >= 0 && observation->_registered &&
+	    !coap_observe_is_newer(observation->_sequence, observe, observation->_timestamp, now)) {
+		LOG_DBG("Notification %d of %s older than %d", observe, log_strdup(observation->_path[0]), observation->_sequence);
+		return;
 	}
 
-	tkl = coap_header_get_token(&reply, token);
-	id = coap_header_get_id(&reply);
+	// without Observe option the server sent a plain response: the registration will be retried
+	observation->_registered = observe >= 0;
+	observation->_sequence = MAX(observe, 0);
+	observation->_timestamp = now;
+	max_age = coap_get_option_int(reply, COAP_OPTION_MAX_AGE);
+	observation->_max_age = max_age >= 0 ? max_age : COAP_DEFAULT_MAX_AGE;
 
-	type = coap_header_get_type(&reply);
-	if (type == COAP_TYPE_ACK) {
-		ret = 0;
-	} else if (type == COAP_TYPE_CON) {
-		ret = send_obs_reply_ack(id, token, tkl, obs_path);
+	block2 = coap_get_option_int(reply, COAP_OPTION_BLOCK2);
+	if (block2 >= 0 && COAP_BLOCK2_MORE(block2)) {
+		LOG_WRN("Notification of %s larger than a block: only the first one is notified", log_strdup(observation->_path[0]));
 	}
-end:
-	k_free(data);
 
-	return ret;
+	payload = coap_packet_get_payload(reply, &len);
+	observation->_callback(observation, payload, payload != NULL ? len : 0, get_coap_content_format(reply), observation->_user_data);
+}
+
+bool coap_observe_is_newer(uint32_t sequence, uint32_t new_sequence, int64_t timestamp, int64_t new_timestamp)
+{
+	return (sequence < new_sequence && new_sequence - sequence < COAP_OBSERVE_SEQUENCE_WINDOW) ||
+	       (sequence > new_sequence && sequence - new_sequence > COAP_OBSERVE_SEQUENCE_WINDOW) ||
+	       new_timestamp > timestamp + COAP_OBSERVE_SEQUENCE_TIMEOUT_MS;
 }
 
-int send_simple_coap_request(uint8_t method, const char * const *  simple_path)
+int send_coap_observe_request(coap_client_observation_t* observation, uint32_t observe)
 {
-	uint8_t payload[] = "payload";
 	struct coap_packet request;
 	const char * const *p;
 	uint8_t *data;
@@ -268,14 +528,21 @@ int send_simple_coap_request(uint8_t method, const char * const *  simple_path)
 
 	r = coap_packet_init(&request, data, MAX_COAP_MSG_LEN,
 			     COAP_VERSION_1, COAP_TYPE_CON,
-			     COAP_TOKEN_MAX_LEN, coap_next_token(),
-			     method, coap_next_id());
+			     COAP_TOKEN_MAX_LEN, observation->_exchange._token,
+			     COAP_METHOD_GET, observation->_exchange._id);
 	if (r < 0) {
 		LOG_ERR("Failed to init CoAP message");
 		goto end;
 	}
 
-	for (p = simple_path; p && *p; p++) {
+	// Observe (6) is before Uri-Path (11) and Accept (17)
+	r = coap_append_option_int(&request, COAP_OPTION_OBSERVE, observe);
+	if (r < 0) {
+		LOG_ERR("Failed to append Observe option");
+		goto end;
+	}
+
+	for (p = observation->_path; p && *p; p++) {
 		r = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
 					      *p, strlen(*p));
 		if (r < 0) {
@@ -284,54 +551,31 @@ int send_simple_coap_request(uint8_t method, const char * const *  simple_path)
 		}
 	}
 
-	switch (method) {
-	case COAP_METHOD_GET:
-	case COAP_METHOD_DELETE:
-		break;
-
-	case COAP_METHOD_PUT:
-	case COAP_METHOD_POST:
-		r = coap_packet_append_payload_marker(&request);
-		if (r < 0) {
-			LOG_ERR("Unable to append payload marker");
-			goto end;
-		}
-
-		r = coap_packet_append_payload(&request, (uint8_t *)payload,
-					       sizeof(payload) - 1);
+	if (observation->_accept_format != 0) {
+		r = coap_append_option_int(&request, COAP_OPTION_ACCEPT, observation->_accept_format);
 		if (r < 0) {
-			LOG_ERR("Not able to append payload");
+			LOG_ERR("Unable to add accept option.");
 			goto end;
 		}
-
-		break;
-	default:
-		r = -EINVAL;
-		goto end;
 	}
 
 	net_hexdump("Request", request.data, request.offset);
 
-	r = send(get_coap_sock(), request.data, request.offset, 0);
+	r = coap_client_send(observation->_client, request.data, request.offset);
 
 end:
 	k_free(data);
 
-	return 0;
+	return r;
 }
 
-int send_large_coap_request(const char * const * large_path)
+int send_large_coap_block_request(coap_client_t* client, const char * const * large_path, uint16_t accept_format, const uint8_t *etag, uint8_t etag_len, struct coap_block_context *ctx, const uint8_t *token, uint16_t id)
 {
 	struct coap_packet request;
 	const char * const *p;
 	uint8_t *data;
 	int r;
 
-	if (get_block_context().total_size == 0) {
-		coap_block_transfer_init(get_block_context_ptr(), COAP_BLOCK_64,
-					 BLOCK_WISE_TRANSFER_SIZE_GET);
-	}
-
 	data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
 	if (!data) {
 		return -ENOMEM;
@@ -339,13 +583,22 @@ int send_large_coap_request(const char * const * large_path)
 
 	r = coap_packet_init(&request, data, MAX_COAP_MSG_LEN,
 			     COAP_VERSION_1, COAP_TYPE_CON,
-			     COAP_TOKEN_MAX_LEN, coap_next_token(),
-			     COAP_METHOD_GET, coap_next_id());
+			     COAP_TOKEN_MAX_LEN, token,
+			     COAP_METHOD_GET, id);
 	if (r < 0) {
 		LOG_ERR("Failed to init CoAP message");
 		goto end;
 	}
 
+	// the ETag of the copy stored (4) is the first option: it's validated with the first block only
+	if (etag_len > 0 && ctx->current == 0) {
+		r = coap_packet_append_option(&request, COAP_OPTION_ETAG, etag, etag_len);
+		if (r < 0) {
+			LOG_ERR("Unable to add etag option.");
+			goto end;
+		}
+	}
+
 	for (p = large_path; p && *p; p++) {
 		r = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
 					      *p, strlen(*p));
@@ -355,15 +608,33 @@ int send_large_coap_request(const char * const * large_path)
 		}
 	}
 
-	r = coap_append_block2_option(&request, get_block_context_ptr());
+	// options have to be appended in ascending order: Accept (17) is between Uri-Path (11) and Block2 (23)
+	if (accept_format != 0) {
+		r = coap_append_option_int(&request, COAP_OPTION_ACCEPT, accept_format);
+		if (r < 0) {
+			LOG_ERR("Unable to add accept option.");
+			goto end;
+		}
+	}
+
+	r = coap_append_block2_option(&request, ctx);
 	if (r < 0) {
 		LOG_ERR("Unable to add block2 option.");
 		goto end;
 	}
 
+	// ask the total size with the first block (RFC 7959, 4), to allocate the msg only once
+	if (ctx->current == 0) {
+		r = coap_append_option_int(&request, COAP_OPTION_SIZE2, 0);
+		if (r < 0) {
+			LOG_ERR("Unable to add size2 option.");
+			goto end;
+		}
+	}
+
 	net_hexdump("Request", request.data, request.offset);
 
-	r = send(get_coap_sock(), request.data, request.offset, 0);
+	r = coap_client_send(client, request.data, request.offset);
 
 end:
 	k_free(data);
@@ -371,284 +642,518 @@ end:
 	return r;
 }
 
-char* get_large_coap_msgs(const char * const * large_path)
+char* get_large_coap_msgs(coap_client_t* client, const char * const * large_path)
+{
+	// a single transfer, with the same window and retransmissions of the concurrent ones
+	large_coap_request_t request = { ._path = large_path };
+	char* data_result = NULL;
+
+	get_large_coap_msgs_concurrent(client, &request, 1, store_large_coap_msg, &data_result);
+	return data_result;
+}
+
+void store_large_coap_msg(size_t idx, char* data_result, void* user_data)
+{
+	*(char**)user_data = data_result;
+}
+
+int get_large_coap_msgs_concurrent(coap_client_t* client, const large_coap_request_t* requests, size_t count, large_coap_msg_callback_t* callback, void* user_data)
 {
+	coap_large_transfer_t transfers[MAX_COAP_CONCURRENT_TRANSFERS];
+	struct k_fifo replies;
+	struct coap_packet reply;
+	coap_large_transfer_t *transfer;
+	coap_block_slot_t *slot;
+	coap_large_reply_t *item;
+	bool kept;
+	size_t pending = 0;
+	int failed = 0;
 	int r;
-	uint8_t data_single_result[MAX_COAP_MSG_LEN];
-	char * data_large_result_tmp = NULL;
-
-	// loop until there are blocks
-	while (1) {
-		LOG_DBG("\nCoAP client Large GET (block %zd)\n",
-		       get_block_context().current / 64 /*COAP_BLOCK_64*/);
-		LOG_INF("Calling COAP (block %zd): %s", get_block_context().current / 64 /*COAP_BLOCK_64*/, log_strdup(large_path[0]));
-		r = send_large_coap_request(large_path);
+
+	if (count > MAX_COAP_CONCURRENT_TRANSFERS) {
+		return -EINVAL;
+	}
+
+	k_fifo_init(&replies);
+	memset(transfers, 0, sizeof(transfers));
+
+	// send the first block request of every transfer, without waiting for replies
+	for (size_t i = 0; i < count; i++) {
+		transfer = &transfers[i];
+		transfer->_client = client;
+		transfer->_replies = &replies;
+		transfer->_path = requests[i]._path;
+		transfer->_block_callback = requests[i]._block_callback;
+		transfer->_accept_format = requests[i]._accept_format;
+		transfer->_etag = requests[i]._etag;
+		transfer->_etag_len = MIN(requests[i]._etag_len, COAP_ETAG_MAX_LEN);
+		transfer->_content_format = -1;
+		transfer->_response._content_format = -1;
+		// the total size is unknown until the server sends it (Size2 option)
+		coap_block_transfer_init(&transfer->_blk_ctx, COAP_BLOCK_SIZE_PREFERRED, 0);
+
+		r = fill_large_coap_window(transfer);
 		if (r < 0) {
-			return NULL;
+			complete_large_coap_transfer(transfers, &requests[transfer - transfers], transfer, r, callback, user_data);
+			failed++;
+		} else {
+			pending++;
 		}
-		
-		// reset old single result
-		memset(data_single_result, 0, MAX_COAP_MSG_LEN);
-		r = process_large_coap_reply(data_single_result);
+	}
+
+	// process the replies queued by the RX thread, until all the transfers are completed
+	while (pending > 0) {
+		// wake up at the first deadline of the requests without reply
+		item = k_fifo_get(&replies, K_MSEC(next_large_coap_timeout(transfers, count)));
+		if (item != NULL) {
+			slot = item->_slot;
+			transfer = slot->_transfer;
+			// the block keeps its reply until it's delivered (the RX thread doesn't touch it anymore)
+			kept = item->_slab == &coap_reply_slab && !transfer->_completed;
+			if (kept) {
+				slot->_reply = item;
+			}
+			if (coap_packet_parse(&reply, item->_data, item->_len, NULL, 0) == 0) {
+				r = dispatch_large_coap_reply(transfers, slot, &reply, user_data);
+				if (r != 0) {
+					/* Received last block or found an error */
+					complete_large_coap_transfer(transfers, &requests[transfer - transfers], transfer, r, callback, user_data);
+					pending--;
+					failed += r < 0 ? 1 : 0;
+				}
+			}
+			if (!kept) {
+				k_mem_slab_free(item->_slab, (void **)&item);
+			}
+		}
+
+		// retransmit the requests without reply, failing the transfers after the last retransmission
+		for (size_t i = 0; i < count; i++) {
+			if (transfers[i]._completed) {
+				continue;
+			}
+			r = retransmit_large_coap_window(&transfers[i]);
+			if (r == 0 && transfers[i]._next_num == transfers[i]._delivered) {
+				// no reply buffer was free to ask the next block
+				r = fill_large_coap_window(&transfers[i]);
+			}
+			if (r < 0) {
+				complete_large_coap_transfer(transfers, &requests[i], &transfers[i], r, callback, user_data);
+				pending--;
+				failed++;
+			}
+		}
+	}
+
+	// all the exchanges are unregistered: replies still queued belong to completed transfers
+	while ((item = k_fifo_get(&replies, K_NO_WAIT)) != NULL) {
+		k_mem_slab_free(item->_slab, (void **)&item);
+	}
+
+	return failed;
+}
+
+void queue_large_coap_reply(coap_client_exchange_t* exchange, const struct coap_packet *reply, void* user_data)
+{
+	coap_block_slot_t *slot = CONTAINER_OF(exchange, coap_block_slot_t, _exchange);
+	coap_large_reply_t *item = NULL;
+
+	// the reply is processed by the thread of the transfer: the RX thread only copies it, in the buffer
+	// reserved when the block was asked, so it never runs out of memory
+	if (slot->_replied) {
+		// duplicate of the reply already queued
+		return;
+	}
+	if (coap_header_get_code(reply) == COAP_CODE_EMPTY) {
+		if (slot->_empty_replied || reply->offset > COAP_EMPTY_MSG_LEN ||
+		    k_mem_slab_alloc(&coap_empty_reply_slab, (void **)&item, K_NO_WAIT) != 0) {
+			return;
+		}
+		item->_slab = &coap_empty_reply_slab;
+		slot->_empty_replied = true;
+	} else {
+		item = slot->_reply;
+		slot->_reply = NULL;
+		slot->_replied = true;
+	}
+	item->_slot = slot;
+	item->_len = reply->offset;
+	memcpy(item->_data, reply->data, reply->offset);
+	k_fifo_put((struct k_fifo *)user_data, item);
+}
+
+int fill_large_coap_window(coap_large_transfer_t *transfer)
+{
+	coap_block_slot_t *slot;
+	int r;
+
+	// until the number of blocks is known, a block is asked only after the previous one is delivered
+	while (transfer->_next_num - transfer->_delivered < CONFIG_COAP_BLOCK_WINDOW &&
+	       (transfer->_block_count != 0 ? transfer->_next_num < transfer->_block_count : transfer->_next_num == transfer->_delivered)) {
+		// the reply is copied in a buffer reserved now: without a free buffer the window shrinks, and a transfer
+		// without blocks in flight asks again later
+		coap_large_reply_t *item;
+		if (k_mem_slab_alloc(&coap_reply_slab, (void **)&item, K_NO_WAIT) != 0) {
+			break;
+		}
+		item->_slab = &coap_reply_slab;
+
+		slot = &transfer->_window[transfer->_next_num % CONFIG_COAP_BLOCK_WINDOW];
+		memset(slot, 0, sizeof(coap_block_slot_t));
+		slot->_reply = item;
+		slot->_transfer = transfer;
+		slot->_num = transfer->_next_num;
+		memcpy(slot->_exchange._token, coap_next_token(), COAP_TOKEN_MAX_LEN);
+		slot->_exchange._id = coap_next_id();
+		slot->_exchange._callback = queue_large_coap_reply;
+		slot->_exchange._user_data = transfer->_replies;
+		// initial timeout between ACK_TIMEOUT and ACK_TIMEOUT * ACK_RANDOM_FACTOR (1.5)
+		slot->_timeout = CONFIG_COAP_CLIENT_ACK_TIMEOUT_MS + sys_rand32_get() % (CONFIG_COAP_CLIENT_ACK_TIMEOUT_MS / 2 + 1);
+		slot->_deadline = k_uptime_get() + slot->_timeout;
+
+		// registered before sending, so the reply can't arrive before the client knows the token
+		r = coap_client_register(transfer->_client, &slot->_exchange);
 		if (r < 0) {
-			return NULL;
+			return r;
 		}
+		slot->_pending = true;
+		transfer->_next_num++;
 
-		if (data_large_result_tmp != NULL) 
-		{
-			// concat results
-			char * data_large_result_concat = append_strings(data_large_result_tmp, (char*)data_single_result);
-			k_free(data_large_result_tmp);
-			data_large_result_tmp = k_malloc(strlen(data_large_result_concat-1));
-			strcpy(data_large_result_tmp, data_large_result_concat);
-			k_free(data_large_result_concat);
-		} else {
-			// first execution, so concat to empty string
-			data_large_result_tmp = append_strings("", (char*)data_single_result);
+		LOG_INF("Calling COAP (block %zd): %s", slot->_num, log_strdup(transfer->_path[0]));
+		r = send_large_coap_block_slot(transfer, slot);
+		if (r < 0) {
+			return r;
 		}
-		
-		/* Received last block */
-		if (r == 1) {
-			memset(get_block_context_ptr(), 0, sizeof(get_block_context()));
+	}
+
+	return 0;
+}
 
-			// concat full result and return
-			char * data_large_result_concat = append_strings(data_large_result_tmp, "");
-			k_free(data_large_result_tmp);
-			return data_large_result_concat;
+int send_large_coap_block_slot(coap_large_transfer_t *transfer, coap_block_slot_t *slot)
+{
+	struct coap_block_context ctx = transfer->_blk_ctx;
+
+	ctx.current = slot->_num * coap_block_size_to_bytes(ctx.block_size);
+	return send_large_coap_block_request(transfer->_client, transfer->_path, transfer->_accept_format, transfer->_etag, transfer->_etag_len,
+					     &ctx, slot->_exchange._token, slot->_exchange._id);
+}
+
+int dispatch_large_coap_reply(coap_large_transfer_t *transfers, coap_block_slot_t *slot, struct coap_packet *reply, void* user_data)
+{
+	coap_large_transfer_t *transfer = slot->_transfer;
+	uint8_t token[COAP_TOKEN_MAX_LEN];
+	uint8_t type = coap_header_get_type(reply);
+
+	// the slot could have been completed (and reused) after the RX thread queued the reply
+	if (transfer->_completed || !slot->_pending) {
+		return 0;
+	}
+
+	if (coap_header_get_code(reply) == COAP_CODE_EMPTY) {
+		if (coap_header_get_id(reply) != slot->_exchange._id) {
+			return 0;
+		}
+		if (type == COAP_TYPE_RESET) {
+			LOG_ERR("Request of block %zd of %s rejected", slot->_num, log_strdup(transfer->_path[0]));
+			return -ECONNRESET;
 		}
+		if (type == COAP_TYPE_ACK && !slot->_acked) {
+			// the server has the request: wait for the separate response, without retransmitting
+			slot->_acked = true;
+			slot->_deadline = k_uptime_get() + COAP_CLIENT_MAX_TRANSMIT_WAIT_MS;
+		}
+		return 0;
 	}
-	return NULL;
+
+	if (coap_header_get_token(reply, token) != COAP_TOKEN_MAX_LEN ||
+	    memcmp(token, slot->_exchange._token, COAP_TOKEN_MAX_LEN) != 0) {
+		// reply of an old request or duplicate, nothing to do
+		return 0;
+	}
+	return process_large_coap_transfer_reply(transfer, transfer - transfers, slot, reply, user_data);
 }
 
-void extract_data_result(struct coap_packet packet, uint8_t* data_result, bool add_termination)
+int process_large_coap_transfer_reply(coap_large_transfer_t *transfer, size_t idx, coap_block_slot_t *slot, struct coap_packet *reply, void* user_data)
 {
+	const uint8_t *payload;
 	uint16_t len = 0;
-	uint8_t* payload = coap_packet_get_payload(&packet, &len);
-	if (payload != NULL) 
-	{
-		memcpy(data_result, payload, len * sizeof(uint8_t)); 
-		if (add_termination) 
-		{
-			char tmp[2] = ""; 
-			strcat(data_result, tmp);
-		}
-	}
-	else {
-		memset(data_result, 0, MAX_COAP_MSG_LEN);
-	} 
-}
-
-int send_simple_coap_msgs_and_wait_for_reply(uint8_t * data_result, const char * const * simple_path)
-{
-    uint8_t test_type = 0U;
-    int r;
-
-    while (1) {
-        switch (test_type) {
-        case 0:
-            /* Test CoAP GET method */
-            printk("\nCoAP client GET\n");
-            r = send_simple_coap_request(COAP_METHOD_GET, simple_path);
-            if (r < 0) {
-                return r;
-            }
-
-            break;
-        case 1:
-            /* Test CoAP PUT method */
-            printk("\nCoAP client PUT\n");
-            r = send_simple_coap_request(COAP_METHOD_PUT, simple_path);
-            if (r < 0) {
-                return r;
-            }
-
-            break;
-        case 2:
-            /* Test CoAP POST method*/
-            printk("\nCoAP client POST\n");
-            r = send_simple_coap_request(COAP_METHOD_POST, simple_path);
-            if (r < 0) {
-                return r;
-            }
-
-            break;
-        case 3:
-            /* Test CoAP DELETE method*/
-            printk("\nCoAP client DELETE\n");
-            r = send_simple_coap_request(COAP_METHOD_DELETE, simple_path);
-            if (r < 0) {
-                return r;
-            }
-
-            break;
-        default:
-            return 0;
-        }
-
-        memset(data_result, 0, MAX_COAP_MSG_LEN);
-        r = process_simple_coap_reply(data_result);
-        if (r < 0) {
-            return r;
-        }
-        test_type++;
-    }
-
-    return 0;
-}
-
-int send_obs_reply_ack(uint16_t id, uint8_t *token, uint8_t tkl, const char * const * obs_path)
-{
-    struct coap_packet request;
-    uint8_t *data;
-    int r;
-
-    data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
-    if (!data) {
-        return -ENOMEM;
-    }
-
-    r = coap_packet_init(&request, data, MAX_COAP_MSG_LEN,
-                COAP_VERSION_1, COAP_TYPE_ACK, tkl, token, 0, id);
-    if (r < 0) {
-        LOG_ERR("Failed to init CoAP message");
-        goto end;
-    }
-
-    net_hexdump("Request", request.data, request.offset);
-
-    r = send(get_coap_sock(), request.data, request.offset, 0);
-end:
-    k_free(data);
+	size_t num = 0;
+	bool more = false;
+	int block2;
+	int size2;
+	int r;
+
+	if (coap_header_get_code(reply) == COAP_RESPONSE_CODE_VALID && slot->_num == 0 && transfer->_etag_len > 0) {
+		// the copy of the caller is up to date: there is no msg to transfer
+		LOG_INF("COAP %s not changed", log_strdup(transfer->_path[0]));
+		transfer->_response._valid = true;
+		r = get_coap_etag(reply, transfer->_response._etag);
+		transfer->_response._etag_len = r > 0 ? r : 0;
+		slot->_pending = false;
+		coap_client_unregister(transfer->_client, &slot->_exchange);
+		return 1;
+	}
+	if (coap_header_get_code(reply) != COAP_RESPONSE_CODE_CONTENT) {
+		LOG_ERR("Unexpected response code %d for %s", coap_header_get_code(reply), log_strdup(transfer->_path[0]));
+		return -EINVAL;
+	}
+
+	// every block has the ETag of the first one, unless the msg changed during the transfer (RFC 7959, 2.4)
+	uint8_t etag[COAP_ETAG_MAX_LEN];
+	int etag_len = get_coap_etag(reply, etag);
+	if (slot->_num == 0) {
+		transfer->_response._etag_len = MAX(etag_len, 0);
+		memcpy(transfer->_response._etag, etag, transfer->_response._etag_len);
+	} else if (etag_len >= 0 && (etag_len != transfer->_response._etag_len || memcmp(etag, transfer->_response._etag, etag_len) != 0)) {
+		LOG_ERR("%s changed during the transfer", log_strdup(transfer->_path[0]));
+		return -EAGAIN;
+	}
+
+	// without Block2 option the server sent the entire msg
+	block2 = coap_get_option_int(reply, COAP_OPTION_BLOCK2);
+	if (block2 >= 0) {
+		num = COAP_BLOCK2_NUM(block2);
+		more = COAP_BLOCK2_MORE(block2);
+	}
+	if (num != slot->_num) {
+		LOG_ERR("Block %zd received instead of %zd for %s", num, slot->_num, log_strdup(transfer->_path[0]));
+		return -EINVAL;
+	}
+
+	if (num == 0) {
+		// the server can reply with smaller blocks than asked: the next ones are asked with its size
+		if (block2 >= 0) {
+			if (COAP_BLOCK2_SZX(block2) > transfer->_blk_ctx.block_size) {
+				return -EINVAL;
+			}
+			transfer->_blk_ctx.block_size = COAP_BLOCK2_SZX(block2);
+		}
+		size2 = coap_get_option_int(reply, COAP_OPTION_SIZE2);
+		if (size2 > 0) {
+			uint16_t bytes = coap_block_size_to_bytes(transfer->_blk_ctx.block_size);
+			transfer->_blk_ctx.total_size = size2;
+			transfer->_block_count = (size2 + bytes - 1) / bytes;
+		}
+		transfer->_content_format = get_coap_content_format(reply);
+		transfer->_response._content_format = transfer->_content_format;
+	} else if (COAP_BLOCK2_SZX(block2) != transfer->_blk_ctx.block_size) {
+		LOG_ERR("Block size changed during the transfer of %s", log_strdup(transfer->_path[0]));
+		return -EINVAL;
+	}
+
+	if (!more) {
+		transfer->_block_count = num + 1;
+	} else if (transfer->_block_count != 0 && num + 1 >= transfer->_block_count) {
+		LOG_ERR("Block %zd of %s exceeds the size sent by the server", num, log_strdup(transfer->_path[0]));
+		return -EINVAL;
+	}
+
+	payload = coap_packet_get_payload(reply, &len);
+	if (payload == NULL) {
+		len = 0;
+	}
+	slot->_pending = false;
+	coap_client_unregister(transfer->_client, &slot->_exchange);
+
+	if (transfer->_block_callback == NULL) {
+		// blocks are copied at their offset, also when they arrive out of order
+		r = write_coap_msg_buffer(&transfer->_msg, num * coap_block_size_to_bytes(transfer->_blk_ctx.block_size),
+					  payload, len, transfer->_blk_ctx.total_size);
+		release_large_coap_reply(slot);
+		if (r < 0) {
+			return r;
+		}
+	} else {
+		// a block received out of order stays in its reply until the previous ones are streamed
+		slot->_payload = (uint8_t *)payload;
+		slot->_len = len;
+	}
+	slot->_received = true;
+
+	// deliver the blocks received in order
+	while (transfer->_delivered < transfer->_next_num) {
+		slot = &transfer->_window[transfer->_delivered % CONFIG_COAP_BLOCK_WINDOW];
+		if (!slot->_received) {
+			break;
+		}
+		if (transfer->_block_callback != NULL) {
+			bool last = transfer->_block_count != 0 && transfer->_delivered + 1 == transfer->_block_count;
+			r = transfer->_block_callback(idx, slot->_payload, slot->_len, last, transfer->_content_format, user_data);
+			slot->_payload = NULL;
+			release_large_coap_reply(slot);
+			if (r < 0) {
+				return r;
+			}
+		}
+		slot->_received = false;
+		transfer->_delivered++;
+	}
 
-    return r;
+	/* Received last block */
+	if (transfer->_block_count != 0 && transfer->_delivered >= transfer->_block_count) {
+		return 1;
+	}
+
+	return fill_large_coap_window(transfer);
 }
 
-int send_obs_coap_request(const char * const * obs_path)
+int retransmit_large_coap_window(coap_large_transfer_t *transfer)
 {
-    struct coap_packet request;
-    const char * const *p;
-    uint8_t *data;
-    int r;
+	int64_t now = k_uptime_get();
+	coap_block_slot_t *slot;
+	int r;
 
-    data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
-    if (!data) {
-        return -ENOMEM;
-    }
+	for (size_t i = 0; i < CONFIG_COAP_BLOCK_WINDOW; i++) {
+		slot = &transfer->_window[i];
+		if (!slot->_pending || slot->_deadline > now) {
+			continue;
+		}
+		if (slot->_acked || slot->_retransmissions >= CONFIG_COAP_CLIENT_MAX_RETRANSMIT) {
+			LOG_ERR("Timeout asking block %zd of %s", slot->_num, log_strdup(transfer->_path[0]));
+			return -ETIMEDOUT;
+		}
 
-    r = coap_packet_init(&request, data, MAX_COAP_MSG_LEN,
-                COAP_VERSION_1, COAP_TYPE_CON,
-                COAP_TOKEN_MAX_LEN, coap_next_token(),
-                COAP_METHOD_GET, coap_next_id());
-    if (r < 0) {
-        LOG_ERR("Failed to init CoAP message");
-        goto end;
-    }
+		// exponential backoff (RFC 7252, 4.2): same message ID and token
+		slot->_retransmissions++;
+		slot->_timeout *= 2;
+		slot->_deadline = now + slot->_timeout;
+		LOG_WRN("Retransmitting block %zd of %s (%d)", slot->_num, log_strdup(transfer->_path[0]), slot->_retransmissions);
+		r = send_large_coap_block_slot(transfer, slot);
+		if (r < 0) {
+			return r;
+		}
+	}
 
-    r = coap_append_option_int(&request, COAP_OPTION_OBSERVE, 0);
-    if (r < 0) {
-        LOG_ERR("Failed to append Observe option");
-        goto end;
-    }
+	return 0;
+}
 
-    for (p = obs_path; p && *p; p++) {
-        r = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
-                        *p, strlen(*p));
-        if (r < 0) {
-            LOG_ERR("Unable add option to request");
-            goto end;
-        }
-    }
+int32_t next_large_coap_timeout(coap_large_transfer_t *transfers, size_t count)
+{
+	int64_t next = INT64_MAX;
 
-    net_hexdump("Request", request.data, request.offset);
+	for (size_t i = 0; i < count; i++) {
+		for (size_t w = 0; !transfers[i]._completed && w < CONFIG_COAP_BLOCK_WINDOW; w++) {
+			if (transfers[i]._window[w]._pending) {
+				next = MIN(next, transfers[i]._window[w]._deadline);
+			}
+		}
+		if (!transfers[i]._completed && transfers[i]._next_num == transfers[i]._delivered) {
+			// waiting for a free reply buffer
+			next = MIN(next, k_uptime_get() + COAP_BLOCK_BUFFER_RETRY_MS);
+		}
+	}
 
-    r = send(get_coap_sock(), request.data, request.offset, 0);
+	if (next == INT64_MAX) {
+		return 0;
+	}
+	return (int32_t)MAX(next - k_uptime_get(), 0);
+}
 
-end:
-    k_free(data);
+void complete_large_coap_transfer(coap_large_transfer_t *transfers, const large_coap_request_t *request, coap_large_transfer_t *transfer, int result, large_coap_msg_callback_t* callback, void* user_data)
+{
+	transfer->_completed = true;
+	release_large_coap_window(transfer);
+	if (result < 0) {
+		k_free(transfer->_msg._data);
+		transfer->_msg._data = NULL;
+		transfer->_response._valid = false;
+	}
+	if (request->_response != NULL) {
+		*request->_response = transfer->_response;
+	}
+	callback(transfer - transfers, transfer->_msg._data, user_data);
+}
 
-    return r;
+void release_large_coap_window(coap_large_transfer_t *transfer)
+{
+	for (size_t i = 0; i < CONFIG_COAP_BLOCK_WINDOW; i++) {
+		// once unregistered, the RX thread doesn't take the reply buffer anymore: replies already queued are freed by the thread of the transfer
+		coap_client_unregister(transfer->_client, &transfer->_window[i]._exchange);
+		transfer->_window[i]._pending = false;
+		transfer->_window[i]._payload = NULL;
+		release_large_coap_reply(&transfer->_window[i]);
+	}
 }
 
-int send_obs_reset_coap_request(const char * const * obs_path)
+void release_large_coap_reply(coap_block_slot_t *slot)
 {
-    struct coap_packet request;
-    const char * const *p;
-    uint8_t *data;
-    int r;
+	if (slot->_reply != NULL) {
+		k_mem_slab_free(&coap_reply_slab, (void **)&slot->_reply);
+		slot->_reply = NULL;
+	}
+}
 
-    data = (uint8_t *)k_malloc(MAX_COAP_MSG_LEN);
-    if (!data) {
-        return -ENOMEM;
-    }
+int write_coap_msg_buffer(coap_msg_buffer_t *msg, size_t offset, const uint8_t *payload, size_t len, size_t total_size)
+{
+	size_t required = offset + len + 1;
 
-    r = coap_packet_init(&request, data, MAX_COAP_MSG_LEN,
-                COAP_VERSION_1, COAP_TYPE_RESET,
-                COAP_TOKEN_MAX_LEN, coap_next_token(),
-                0, coap_next_id());
-    if (r < 0) {
-        LOG_ERR("Failed to init CoAP message");
-        goto end;
-    }
+	if (required > msg->_capacity) {
+		// the size sent by the server is allocated at once, otherwise the capacity is doubled
+		size_t capacity = total_size >= required - 1 ? total_size + 1 : MAX(msg->_capacity * 2, BLOCK_WISE_TRANSFER_SIZE_GET);
+		capacity = MAX(capacity, required);
 
-    r = coap_append_option_int(&request, COAP_OPTION_OBSERVE, 0);
-    if (r < 0) {
-        LOG_ERR("Failed to append Observe option");
-        goto end;
-    }
+		char *data = (char *)k_malloc(capacity);
+		if (data == NULL) {
+			LOG_ERR("Not enough memory for a large msg of %zu bytes", capacity);
+			return -ENOMEM;
+		}
+		if (msg->_data != NULL) {
+			memcpy(data, msg->_data, msg->_len);
+			k_free(msg->_data);
+		}
+		LOG_DBG("Large msg buffer: %zu -> %zu bytes", msg->_capacity, capacity);
+		msg->_data = data;
+		msg->_capacity = capacity;
+	}
 
-    for (p = obs_path; p && *p; p++) {
-        r = coap_packet_append_option(&request, COAP_OPTION_URI_PATH,
-                        *p, strlen(*p));
-        if (r < 0) {
-            LOG_ERR("Unable add option to request");
-            goto end;
-        }
-    }
+	if (len > 0) {
+		memcpy(msg->_data + offset, payload, len);
+	}
+	// blocks before the offset can still be missing, they are copied when they arrive
+	if (offset + len >= msg->_len) {
+		msg->_len = offset + len;
+		msg->_data[msg->_len] = '\0';
+	}
 
-    net_hexdump("Request", request.data, request.offset);
+	return 0;
+}
 
-    r = send(get_coap_sock(), request.data, request.offset, 0);
+int get_coap_content_format(const struct coap_packet *reply)
+{
+	struct coap_option option;
 
-end:
-    k_free(data);
-
-    return r;
-}
-
-int register_observer(const char * const * obs_path)
-{
-    uint8_t counter = 0U;
-    int r;
-
-    while (1) {
-        /* Test CoAP OBS GET method */
-        if (!counter) {
-            printk("\nCoAP client OBS GET\n");
-            r = send_obs_coap_request(obs_path);
-            if (r < 0) {
-                return r;
-            }
-        } else {
-            printk("\nCoAP OBS Notification\n");
-        }
-
-        r = process_obs_coap_reply(obs_path);
-        if (r < 0) {
-            return r;
-        }
-
-        counter++;
-
-        /* Unregister */
-        if (counter == 5U) {
-            /* TODO: Functionality can be verified byt waiting for
-            * some time and make sure client shouldn't receive
-            * any notifications. If client still receives
-            * notifications means, Observer is not removed.
-            */
-            return send_obs_reset_coap_request(obs_path);
-        }
-    }
-
-    return 0;
-}
\ No newline at end of file
+	if (coap_find_options(reply, COAP_OPTION_CONTENT_FORMAT, &option, 1) <= 0) {
+		return -1;
+	}
+	return coap_option_value_to_int(&option);
+}
+
+int get_coap_etag(const struct coap_packet *reply, uint8_t *etag)
+{
+	struct coap_option option;
+
+	if (coap_find_options(reply, COAP_OPTION_ETAG, &option, 1) <= 0) {
+		return -1;
+	}
+	if (option.len > COAP_ETAG_MAX_LEN) {
+		return -EINVAL;
+	}
+	memcpy(etag, option.value, option.len);
+	return option.len;
+}
+
+int send_coap_empty_reply(coap_client_t* client, uint8_t type, uint16_t id)
+{
+	struct coap_packet ack;
+	uint8_t data[4];
+	int r;
+
+	r = coap_packet_init(&ack, data, sizeof(data),
+			     COAP_VERSION_1, type, 0, NULL, COAP_CODE_EMPTY, id);
+	if (r < 0) {
+		LOG_ERR("Failed to init CoAP message");
+		return r;
+	}
+
+	return coap_client_send(client, ack.data, ack.offset);
+}
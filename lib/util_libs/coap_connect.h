@@ -10,6 +10,7 @@
 #ifndef COAP_CONNECT_H_
 #define COAP_CONNECT_H_
 
+#include <kernel.h>
 #include <net/socket.h>
 #include <net/net_mgmt.h>
 #include <net/net_ip.h>
@@ -21,33 +22,192 @@
 
 /* COAP Port used */
 #define PEER_PORT CONFIG_COAP_SERVER_PORT
-#define MAX_COAP_MSG_LEN 256
 
+/* Block size asked to the COAP Server: if it replies with smaller blocks, the transfer goes on with them */
+#define COAP_BLOCK_SIZE_PREFERRED (CONFIG_COAP_BLOCK_SIZE >= 1024 ? COAP_BLOCK_1024 : \
+	CONFIG_COAP_BLOCK_SIZE >= 512 ? COAP_BLOCK_512 : \
+	CONFIG_COAP_BLOCK_SIZE >= 256 ? COAP_BLOCK_256 : \
+	CONFIG_COAP_BLOCK_SIZE >= 128 ? COAP_BLOCK_128 : \
+	CONFIG_COAP_BLOCK_SIZE >= 64 ? COAP_BLOCK_64 : \
+	CONFIG_COAP_BLOCK_SIZE >= 32 ? COAP_BLOCK_32 : COAP_BLOCK_16)
+/* Room for header, token and options of a msg, besides the payload of a block */
+#define COAP_MSG_HEADROOM 128
+#define MAX_COAP_MSG_LEN (CONFIG_COAP_BLOCK_SIZE + COAP_MSG_HEADROOM)
+
+/* Initial capacity of a large msg when the server doesn't send its size (Size2 option): then it grows geometrically */
 #define BLOCK_WISE_TRANSFER_SIZE_GET 4096
 #define IP_ADDRESS_COAP_SERVER CONFIG_COAP_SERVER_IPV4_ADDR
 
+/* Max number of block-wise transfers in flight at the same time (each one with CONFIG_COAP_BLOCK_WINDOW blocks asked) */
+#define MAX_COAP_CONCURRENT_TRANSFERS 8
+
 /**
- * @brief Get the coap sock object
+ * @brief Callback called when one of the concurrent block-wise transfers is completed
  * 
- * @return int 
+ * @param idx index of the transfer, in the same order of the requested paths
+ * @param data_result entire large coap msg (NULL on error), the callee has to free it
+ * @param user_data data passed to get_large_coap_msgs_concurrent
+ */
+typedef void (large_coap_msg_callback_t)(size_t idx, char* data_result, void* user_data);
+
+/**
+ * @brief Callback called for each block received by a streamed block-wise transfer, in order
+ * 
+ * @param idx index of the transfer, in the same order of the requests
+ * @param block payload of the block
+ * @param len length of the payload
+ * @param last true if this is the last block of the msg
+ * @param content_format Content-Format option of the reply (-1 if not present)
+ * @param user_data data passed to get_large_coap_msgs_concurrent
+ * @return int 0 to go on, a negative value to abort the transfer
+ */
+typedef int (large_coap_block_callback_t)(size_t idx, const uint8_t* block, size_t len, bool last, int content_format, void* user_data);
+
+/* Max length of the ETag option (RFC 7252, 5.10.6) */
+#define COAP_ETAG_MAX_LEN 8
+
+/* Details of the reply of a block-wise transfer, filled before calling the callback */
+typedef struct _large_coap_response_t {
+	bool _valid;									// 2.03 Valid: the copy with the ETag of the request is up to date, no msg is sent
+	uint8_t _etag[COAP_ETAG_MAX_LEN];				// ETag of the msg (or of the copy validated)
+	uint8_t _etag_len;								// 0 if the server didn't send it
+	int _content_format;							// Content-Format option of the reply (-1 if not present)
+} large_coap_response_t;
+
+/* Block-wise transfer to handle concurrently with the others */
+typedef struct _large_coap_request_t {
+	const char * const * _path;
+	large_coap_block_callback_t* _block_callback;	// NULL to rebuild the entire msg, otherwise blocks are streamed to it
+	uint16_t _accept_format;						// Content-Format asked with the Accept option (0 to not send it)
+	const uint8_t* _etag;							// ETag of a copy already stored, for a conditional GET (NULL to not send it)
+	uint8_t _etag_len;
+	large_coap_response_t* _response;				// where the details of the reply are stored (NULL if not needed)
+} large_coap_request_t;
+
+/* Exchange of a coap client: a request waiting for its reply */
+typedef struct _coap_client_exchange_t coap_client_exchange_t;
+
+/**
+ * @brief Callback called by the RX thread of the client when a reply of the exchange is received.
+ * It's called with the lock of the client: it has to return quickly, without waiting
+ * 
+ * @param exchange exchange of the reply
+ * @param reply reply received, valid only during the call
+ * @param user_data data of the exchange
+ */
+typedef void (coap_client_reply_callback_t)(coap_client_exchange_t* exchange, const struct coap_packet *reply, void* user_data);
+
+struct _coap_client_exchange_t {
+	uint8_t _token[COAP_TOKEN_MAX_LEN];		// replies are matched by token
+	uint16_t _id;							// empty ACK and RST are matched by message ID
+	coap_client_reply_callback_t* _callback;
+	void* _user_data;
+};
+
+/* CoAP client: many threads can send requests over its socket, a dedicated thread receives the replies */
+typedef struct _coap_client_t {
+	int _sock;
+	volatile bool _running;
+	struct k_mutex _lock;					// guards the exchanges and the socket
+	coap_client_exchange_t* _exchanges[CONFIG_COAP_CLIENT_MAX_EXCHANGES];
+	uint8_t _rx_buffer[MAX_COAP_MSG_LEN];
+	struct k_thread _rx_thread;
+	K_THREAD_STACK_MEMBER(_rx_stack, CONFIG_COAP_CLIENT_RX_STACK_SIZE);
+} coap_client_t;
+
+/* Observation of a resource of the COAP Server (RFC 7641) */
+typedef struct _coap_client_observation_t coap_client_observation_t;
+
+/**
+ * @brief Callback called by the RX thread of the client for each notification of an observed resource, in order
+ * (the response to the registration is the first one). It's called with the lock of the client: it has to return quickly
+ * 
+ * @param observation observation of the notification
+ * @param payload content of the resource, valid only during the call (only the first block if it's larger)
+ * @param len length of the payload
+ * @param content_format Content-Format option of the notification (-1 if not present)
+ * @param user_data data passed to coap_client_observe
  */
-int get_coap_sock(void);
+typedef void (coap_client_notification_callback_t)(coap_client_observation_t* observation, const uint8_t* payload, size_t len, int content_format, void* user_data);
+
+struct _coap_client_observation_t {
+	coap_client_exchange_t _exchange;		// same token for all the notifications
+	coap_client_t* _client;
+	const char * const * _path;
+	uint16_t _accept_format;
+	coap_client_notification_callback_t* _callback;
+	void* _user_data;
+	bool _registered;						// a notification confirmed the registration
+	uint32_t _sequence;						// Observe option of the last notification
+	int64_t _timestamp;						// uptime (ms) of the last notification
+	uint32_t _max_age;						// s, freshness of the last notification
+};
 
 /**
- * @brief Get the block context object
+ * @brief Open the socket of the client and start its RX thread
  * 
- * @return struct coap_block_context 
+ * @param client client to initialize
+ * @param address IPV4 address of the COAP Server
+ * @param port port of the COAP Server
+ * @return int 0 on success, a negative value on error (the socket is closed)
  */
-struct coap_block_context get_block_context(void);
+int coap_client_init(coap_client_t* client, const char* address, uint16_t port);
 
 /**
- * @brief Get the block context pointer object
+ * @brief Stop the RX thread and close the socket of the client.
+ * Exchanges still registered don't receive replies anymore
  * 
- * @return struct coap_block_context* 
+ * @param client 
  */
-struct coap_block_context* get_block_context_ptr(void);
+void coap_client_close(coap_client_t* client);
 
-void wait(void);
+/**
+ * @brief Register an exchange before sending its request, so its replies are passed to its callback.
+ * The exchange has to stay valid until it's unregistered
+ * 
+ * @param client 
+ * @param exchange 
+ * @return int 0 on success, -ENOMEM if CONFIG_COAP_CLIENT_MAX_EXCHANGES are already registered
+ */
+int coap_client_register(coap_client_t* client, coap_client_exchange_t* exchange);
+
+/**
+ * @brief Unregister an exchange: when it returns, its callback is not running and won't be called anymore
+ * 
+ * @param client 
+ * @param exchange 
+ */
+void coap_client_unregister(coap_client_t* client, coap_client_exchange_t* exchange);
+
+/**
+ * @brief Send a msg to the COAP Server, from any thread
+ * 
+ * @param client 
+ * @param data encoded msg
+ * @param len length of the msg
+ * @return int bytes sent, or a negative value on error
+ */
+int coap_client_send(coap_client_t* client, const uint8_t *data, size_t len);
+
+/**
+ * @brief Send a non-confirmable POST to the COAP Server (RFC 7252, 4.3): it's not retransmitted
+ * and the caller doesn't wait for a reply, so it could be lost without errors
+ * 
+ * @param client 
+ * @param path path of the resource, terminated by NULL
+ * @param content_format Content-Format of the payload
+ * @param payload 
+ * @param len length of the payload
+ * @return int bytes sent, or a negative value on error
+ */
+int coap_client_post_non(coap_client_t* client, const char * const * path, uint16_t content_format, const uint8_t *payload, size_t len);
+
+/**
+ * @brief Get the client connected to the COAP Server of the configuration
+ * 
+ * @return coap_client_t* 
+ */
+coap_client_t* get_coap_client(void);
 
 /**
  * @brief Initialize coap client
@@ -57,48 +217,81 @@ void wait(void);
 int start_coap_client(void);
 
 /**
- * @brief Send a COAP request with the specified method and path
- * 
- * @param method COAP METHOD (GET, POST ecc..)
- * @param simple_path COAP URL
- * @return int 
+ * @brief Close coap client, when it's no longer useful
  */
-int send_simple_coap_request(uint8_t method, const char * const * simple_path);
+void stop_coap_client(void);
 
 /**
- * @brief Send a COAP request using block logic of protocol
+ * @brief Observe a resource of the COAP Server: the callback is called with its content
+ * at the registration and then each time it changes, until the observation is cancelled.
+ * The registration is not retransmitted: the caller refreshes it while it's not fresh
  * 
- * @param large_path 
- * @return int 
+ * @param client 
+ * @param observation observation to initialize, it has to stay valid until it's cancelled
+ * @param path path of the resource, it has to stay valid until the observation is cancelled
+ * @param accept_format Content-Format asked with the Accept option (0 to not send it)
+ * @param callback called for each notification
+ * @param user_data data passed to the callback
+ * @return int bytes of the registration sent, or a negative value on error
  */
-int send_large_coap_request(const char * const * large_path);
+int coap_client_observe(coap_client_t* client, coap_client_observation_t* observation, const char * const * path, uint16_t accept_format, coap_client_notification_callback_t* callback, void* user_data);
 
 /**
- * @brief Process simple result returning from coap server
+ * @brief Send again the registration of an observation (i.e. when it was lost, or the server forgot it)
  * 
- * @param data_result data binary
- * @return int 
+ * @param observation 
+ * @return int bytes sent, or a negative value on error
  */
-int process_simple_coap_reply(uint8_t * data_result);
+int coap_client_observe_refresh(coap_client_observation_t* observation);
 
 /**
- * @brief Process large result (grouped in blocks) from coap server
+ * @brief Cancel an observation: its callback won't be called anymore
  * 
- * @param data_result data binary
- * @return int 
+ * @param observation 
  */
-int process_large_coap_reply(uint8_t * data_result);
+void coap_client_observe_cancel(coap_client_observation_t* observation);
 
+/**
+ * @brief Check if the registration of an observation is confirmed and its last notification is still fresh (Max-Age option)
+ * 
+ * @param observation 
+ * @return true 
+ * @return false if it has to be refreshed
+ */
+bool coap_client_observe_is_fresh(coap_client_observation_t* observation);
 
 /**
- * @brief Rebuild entire large coap msgs
+ * @brief Rebuild entire large coap msgs: blocks are appended in place to a single buffer,
+ * preallocated with the size sent by the server (Size2 option) or grown geometrically.
+ * It's a transfer of get_large_coap_msgs_concurrent, so it has the same window and retransmissions
  * 
- * @return char* 
+ * @param client 
+ * @param large_path 
+ * @return char* entire msg, null terminated (NULL on error), the callee has to free it
  */
-char* get_large_coap_msgs(const char * const * large_path);
+char* get_large_coap_msgs(coap_client_t* client, const char * const * large_path);
 
-// TODO: to test observer
-int register_observer(const char * const * obs_path);
-int process_obs_coap_reply(const char * const * obs_path);
+/**
+ * @brief Rebuild many large coap msgs concurrently: every transfer uses its own block context
+ * and a CoAP token for each block, so the replies are matched to the right transfer in the arrival order.
+ * Replies are queued by the RX thread of the client: many threads can call it at the same time with the same client.
+ * When the server sends the size of the msg (Size2 option) with the first block, up to CONFIG_COAP_BLOCK_WINDOW
+ * blocks of each transfer are asked without waiting for the replies, and reordered when they arrive.
+ * Block requests are confirmable: without reply they are retransmitted after CONFIG_COAP_CLIENT_ACK_TIMEOUT_MS
+ * (doubled at each retransmission, RFC 7252 4.2), and the transfer fails after CONFIG_COAP_CLIENT_MAX_RETRANSMIT retransmissions.
+ * The callback is called as soon as each msg is completed.
+ * Transfers with a block callback are not rebuilt: each block is passed to the block callback
+ * as soon as it arrives, in order, and the callback is called with NULL data_result when the transfer ends.
+ * Transfers with an ETag are conditional (RFC 7252, 5.10.6.2): if the copy is still valid, the server replies 2.03 Valid
+ * and the callback is called with NULL data_result and _valid set in the response of the request.
+ * 
+ * @param client client used for all the transfers
+ * @param requests list of transfers to do
+ * @param count number of transfers (max MAX_COAP_CONCURRENT_TRANSFERS)
+ * @param callback called after each transfer is completed (or failed)
+ * @param user_data data passed to the callbacks
+ * @return int number of failed transfers, or a negative value on error
+ */
+int get_large_coap_msgs_concurrent(coap_client_t* client, const large_coap_request_t* requests, size_t count, large_coap_msg_callback_t* callback, void* user_data);
 
 #endif /* COAP_CONNECT_H_ */
\ No newline at end of file
@@ -41,6 +41,7 @@
 
 static struct net_mgmt_event_callback cb;
 static struct k_sem net_cb_sem;
+static atomic_t wifi_connected = ATOMIC_INIT(0);
 
 
 static void Wifi_check_connect_result( struct net_if *iface, struct net_mgmt_event_callback *cb)
@@ -48,6 +49,7 @@ static void Wifi_check_connect_result( struct net_if *iface, struct net_mgmt_eve
 	const struct wifi_status *status = (const struct wifi_status *) cb->info;
 	if (!status->status) {
 		// Connected
+		atomic_set(&wifi_connected, 1);
 		k_sem_give(&net_cb_sem);
 	}
 }
@@ -58,6 +60,9 @@ void Wifi_event_listener( struct net_mgmt_event_callback *cb, uint32_t mgmt_even
 		case NET_EVENT_WIFI_CONNECT_RESULT:
 			Wifi_check_connect_result( iface, cb );
 			break;
+		case NET_EVENT_WIFI_DISCONNECT_RESULT:
+			atomic_set(&wifi_connected, 0);
+			break;
 	}
 }
 
@@ -102,4 +107,13 @@ void wifi_connect(void)
 	Wifi_autoconnect();
 #endif
 
+}
+
+bool wifi_is_connected(void)
+{
+#if AUTO_CONNECT
+	return atomic_get(&wifi_connected) != 0;
+#else
+	return true;
+#endif
 }
\ No newline at end of file
@@ -13,7 +13,12 @@
 #ifndef SRC_WIFI_CONNECT_H_
 #define SRC_WIFI_CONNECT_H_
 
+#include <stdbool.h>
+
 // Declare demo funtion
 void wifi_connect(void);
 
+// Link status, updated by the events of the interface (always connected without AUTO_CONNECT)
+bool wifi_is_connected(void);
+
 #endif /* SRC_WIFI_CONNECT_H_ */
\ No newline at end of file
@@ -24,6 +24,10 @@ LOG_MODULE_REGISTER(MAIN, LOG_LEVEL_INF);
 #include "button_svc.h"
 #include "led_svc.h"
 #include <aif_controller.h>
+#include <boot_trace.h>
+#ifdef CONFIG_MPAI_METADATA_PARSER_BENCHMARK
+#include <aif_metadata_benchmark.h>
+#endif
 
 /*** START BT ***/
 /* Button value. */
@@ -187,7 +191,8 @@ void main(void)
 	static const struct device *led0, *led1;
 	int i, on = 1;
 	int cnt = 1;
-	
+	int trace_boot = MPAI_BOOT_TRACE_BEGIN("Boot", NULL);
+	int trace_leds = MPAI_BOOT_TRACE_BEGIN("LEDs self-test", NULL);
 
 	// LEDs
 	led0 = device_get_binding(DT_GPIO_LABEL(DT_ALIAS(led0), gpios));
@@ -211,6 +216,7 @@ void main(void)
 
 	gpio_pin_set(led0, DT_GPIO_PIN(DT_ALIAS(led0), gpios), 0);
 	gpio_pin_set(led1, DT_GPIO_PIN(DT_ALIAS(led1), gpios), 1);
+	MPAI_BOOT_TRACE_END(trace_leds);
 
 	printk("IoT node INITIALIZING...\n");
 
@@ -228,15 +234,25 @@ void main(void)
 	}
 
 	/* Initialize the Bluetooth Subsystem */
+	int trace_bt = MPAI_BOOT_TRACE_BEGIN("BLE enable", NULL);
 	err = bt_enable(bt_ready);
 	if (err) {
 		LOG_ERR("Bluetooth init failed (err %d)", err);
 	}
+	MPAI_BOOT_TRACE_END(trace_bt);
 
 	/** END BLUETOOTH **/
 
+#ifdef CONFIG_MPAI_METADATA_PARSER_BENCHMARK
+	MPAI_Metadata_Parser_Benchmark();
+#endif
+
 	// Initialize MPAI Controller
+	int trace_controller = MPAI_BOOT_TRACE_BEGIN("MPAI Controller init", NULL);
 	mpai_error_t err_mpai_controller = MPAI_AIFU_Controller_Initialize();
+	MPAI_BOOT_TRACE_END(trace_controller);
+	MPAI_BOOT_TRACE_END(trace_boot);
+	MPAI_BOOT_TRACE_REPORT();
 
 	if (err_mpai_controller.code != MPAI_AIF_OK) 
 	{
@@ -0,0 +1,38 @@
+/*
+ * @file
+ * @brief Stub of CMSIS for the tests on the host: the DSP instructions used by the audio kernels, emulated in C
+ * as described by the Armv7-M Architecture Reference Manual
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_CMSIS_H
+#define NATIVE_STUBS_CMSIS_H
+
+#include <stdint.h>
+
+/* saturate to a signed value of the specified bits */
+static inline int32_t __SSAT(int32_t value, uint32_t bits)
+{
+	int32_t max = (int32_t)((1u << (bits - 1)) - 1);
+	int32_t min = -max - 1;
+	return value < min ? min : (value > max ? max : value);
+}
+
+/* bottom halfword of the first operand, top halfword of the second one shifted left */
+static inline uint32_t __PKHBT(uint32_t bottom, uint32_t top, uint32_t shift)
+{
+	return (bottom & 0x0000FFFFu) | ((top << shift) & 0xFFFF0000u);
+}
+
+/* two signed 16 bits multiplications, added to a 64 bits accumulator */
+static inline uint64_t __SMLALD(uint32_t x, uint32_t y, uint64_t accumulator)
+{
+	int64_t bottom = (int64_t)(int16_t)(x & 0xFFFFu) * (int16_t)(y & 0xFFFFu);
+	int64_t top = (int64_t)(int16_t)(x >> 16) * (int16_t)(y >> 16);
+	return (uint64_t)((int64_t)accumulator + bottom + top);
+}
+
+#endif
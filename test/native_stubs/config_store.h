@@ -0,0 +1,21 @@
+/*
+ * @file
+ * @brief Stub of MPAI Config Store for the tests on the host: only the types of the resources, as in lib/mpai_core/config_store.h
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_CONFIG_STORE_H
+#define NATIVE_STUBS_CONFIG_STORE_H
+
+typedef enum
+{
+    MPAI_CONFIG_STORE_AIF,
+    MPAI_CONFIG_STORE_AIW,
+    MPAI_CONFIG_STORE_AIM,
+    MPAI_CONFIG_STORE_PARAMETERS
+} MPAI_CONFIG_STORE_RESOURCE_TYPE;
+
+#endif
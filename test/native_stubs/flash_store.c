@@ -0,0 +1,160 @@
+/*
+ * @file
+ * @brief Stub of the flash memory for the tests on the host: built by the sources of the tests that use it
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <flash_store.h>
+
+static uint8_t native_flash[NATIVE_FLASH_SIZE];
+static struct device native_flash_dev = { .name = "native_flash" };
+static int native_flash_operations_left = -1;
+static bool native_flash_off = false;
+static size_t native_flash_count = 0;
+K_MUTEX_DEFINE(native_flash_lock);
+
+/************* PRIVATE HEADER *************/
+/* check the region of an access */
+bool _native_flash_check(off_t offset, size_t len);
+/* count an operation: false if it's torn by a power loss */
+bool _native_flash_operation();
+
+/************* PUBLIC **************/
+struct device* init_flash()
+{
+	return &native_flash_dev;
+}
+
+int erase_flash_region(const struct device* dev, off_t offset, size_t size)
+{
+	ARG_UNUSED(dev);
+
+	if (offset % FLASH_SECTOR_SIZE != 0 || size % FLASH_SECTOR_SIZE != 0 || !_native_flash_check(offset, size))
+	{
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	if (native_flash_off)
+	{
+		k_mutex_unlock(&native_flash_lock);
+		return -EIO;
+	}
+	bool complete = _native_flash_operation();
+	memset(&native_flash[offset], 0xFF, complete ? size : FLASH_SECTOR_SIZE / 2);
+	k_mutex_unlock(&native_flash_lock);
+	return complete ? 0 : -EIO;
+}
+
+int write_flash_region(const struct device* dev, off_t offset, size_t len, const void* data)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	ARG_UNUSED(dev);
+
+	if (!_native_flash_check(offset, len))
+	{
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	if (native_flash_off)
+	{
+		k_mutex_unlock(&native_flash_lock);
+		return -EIO;
+	}
+	// NOR flash: programming clears bits, only an erase sets them again
+	bool complete = _native_flash_operation();
+	size_t programmed = complete ? len : len / 2;
+	for (size_t i = 0; i < programmed; i++)
+	{
+		native_flash[offset + i] &= bytes[i];
+	}
+	k_mutex_unlock(&native_flash_lock);
+	return complete ? 0 : -EIO;
+}
+
+int read_flash_region(const struct device* dev, off_t offset, size_t len, void* buf)
+{
+	ARG_UNUSED(dev);
+
+	if (!_native_flash_check(offset, len))
+	{
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	int r = native_flash_off ? -EIO : 0;
+	if (r == 0)
+	{
+		memcpy(buf, &native_flash[offset], len);
+	}
+	k_mutex_unlock(&native_flash_lock);
+	return r;
+}
+
+void native_flash_reset(void)
+{
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	memset(native_flash, 0xFF, sizeof(native_flash));
+	native_flash_operations_left = -1;
+	native_flash_off = false;
+	native_flash_count = 0;
+	k_mutex_unlock(&native_flash_lock);
+}
+
+void native_flash_power_loss_after(int operations)
+{
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	native_flash_operations_left = operations;
+	k_mutex_unlock(&native_flash_lock);
+}
+
+void native_flash_power_on(void)
+{
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	native_flash_operations_left = -1;
+	native_flash_off = false;
+	k_mutex_unlock(&native_flash_lock);
+}
+
+bool native_flash_power_lost(void)
+{
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	bool off = native_flash_off;
+	k_mutex_unlock(&native_flash_lock);
+	return off;
+}
+
+size_t native_flash_operations(void)
+{
+	k_mutex_lock(&native_flash_lock, K_FOREVER);
+	size_t count = native_flash_count;
+	k_mutex_unlock(&native_flash_lock);
+	return count;
+}
+
+/************* PRIVATE **************/
+bool _native_flash_check(off_t offset, size_t len)
+{
+	return offset >= 0 && (size_t)offset <= NATIVE_FLASH_SIZE && len <= NATIVE_FLASH_SIZE - (size_t)offset;
+}
+
+bool _native_flash_operation()
+{
+	native_flash_count++;
+	if (native_flash_operations_left < 0)
+	{
+		return true;
+	}
+	if (native_flash_operations_left > 0)
+	{
+		native_flash_operations_left--;
+		return true;
+	}
+	native_flash_operations_left = -1;
+	native_flash_off = true;
+	return false;
+}
@@ -0,0 +1,81 @@
+/*
+ * @file
+ * @brief Stub of the flash memory for the tests on the host: a NOR flash in RAM (writes only clear bits), with the regions
+ * of lib/mpai_core/flash_store.h used by the tests, that can lose the power in the middle of a write or an erase
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_FLASH_STORE_H
+#define NATIVE_STUBS_FLASH_STORE_H
+
+#include <kernel.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <logging/log.h>
+
+#define FLASH_SECTOR_SIZE 4096
+#define NATIVE_FLASH_SECTORS 64
+#define NATIVE_FLASH_SIZE (NATIVE_FLASH_SECTORS * FLASH_SECTOR_SIZE)
+
+/* Each test uses one region, from the start of the flash memory */
+#ifdef CONFIG_MPAI_KV_STORE
+#define FLASH_KV_STORE_REGION_SIZE   (CONFIG_MPAI_KV_STORE_SECTORS * FLASH_SECTOR_SIZE)
+#define FLASH_KV_STORE_REGION_OFFSET 0
+BUILD_ASSERT(CONFIG_MPAI_KV_STORE_SECTORS <= NATIVE_FLASH_SECTORS, "The key/record store doesn't fit the flash memory of the tests");
+#endif
+
+#ifdef CONFIG_MPAI_FLASH_RING
+#define FLASH_RING_REGION_SIZE   (CONFIG_MPAI_FLASH_RING_SECTORS * FLASH_SECTOR_SIZE)
+#define FLASH_RING_REGION_OFFSET 0
+BUILD_ASSERT(CONFIG_MPAI_FLASH_RING_SECTORS <= NATIVE_FLASH_SECTORS, "The flash ring doesn't fit the flash memory of the tests");
+#endif
+
+struct device {
+	const char* name;
+};
+
+struct device* init_flash();
+
+int erase_flash_region(const struct device* dev, off_t offset, size_t size);
+
+int write_flash_region(const struct device* dev, off_t offset, size_t len, const void* data);
+
+int read_flash_region(const struct device* dev, off_t offset, size_t len, void* buf);
+
+/**
+ * @brief Erase all the flash memory and power it on
+ */
+void native_flash_reset(void);
+
+/**
+ * @brief Lose the power after some writes and erases: the next one is torn (a write programs only the first half of its bytes,
+ * an erase erases only the first half of the sector), then every access fails with -EIO until native_flash_power_on
+ *
+ * @param operations writes and erases completed before the power is lost, -1 to never lose it
+ */
+void native_flash_power_loss_after(int operations);
+
+/**
+ * @brief Power the flash memory on again, after a power loss (the contents are kept)
+ */
+void native_flash_power_on(void);
+
+/**
+ * @brief Check if the power was lost
+ *
+ * @return true if the accesses fail
+ */
+bool native_flash_power_lost(void);
+
+/**
+ * @brief Writes and erases since native_flash_reset
+ *
+ * @return size_t
+ */
+size_t native_flash_operations(void);
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * @file
+ * @brief Stub of the Zephyr kernel for the tests on the host: heap, cycles (nanoseconds), mutexes, semaphores, atomics,
+ * threads (POSIX threads, without priorities) and the utilities of sys/util.h
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_KERNEL_H
+#define NATIVE_STUBS_KERNEL_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define ARG_UNUSED(x) (void)(x)
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#define __aligned(x) __attribute__((__aligned__(x)))
+#define ROUND_UP(x, align) ((((unsigned long)(x) + ((unsigned long)(align) - 1)) / (unsigned long)(align)) * (unsigned long)(align))
+#define ROUND_DOWN(x, align) (((unsigned long)(x) / (unsigned long)(align)) * (unsigned long)(align))
+#define BUILD_ASSERT(expr, msg) _Static_assert(expr, msg)
+
+static inline void* k_malloc(size_t size)
+{
+	return malloc(size);
+}
+
+static inline void k_free(void* ptr)
+{
+	free(ptr);
+}
+
+/* the cycles of the host are nanoseconds of the monotonic clock */
+static inline uint32_t k_cycle_get_32(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)((uint64_t)now.tv_sec * 1000000000u + now.tv_nsec);
+}
+
+static inline uint32_t sys_clock_hw_cycles_per_sec(void)
+{
+	return 1000000000u;
+}
+
+static inline uint64_t k_cyc_to_us_floor64(uint64_t cycles)
+{
+	return cycles / 1000u;
+}
+
+/* timeouts in milliseconds */
+typedef int32_t k_timeout_t;
+#define K_FOREVER (-1)
+#define K_NO_WAIT 0
+#define K_MSEC(ms) (ms)
+
+/* the mutexes of Zephyr can be locked again by the thread that owns them */
+struct k_mutex {
+	pthread_mutex_t _mutex;
+	pthread_t _owner;
+	uint32_t _lock_count;						// written only by the owner
+};
+
+#define K_MUTEX_DEFINE(name) struct k_mutex name = { ._mutex = PTHREAD_MUTEX_INITIALIZER }
+
+static inline int k_mutex_lock(struct k_mutex* mutex, k_timeout_t timeout)
+{
+	ARG_UNUSED(timeout);
+	if (__atomic_load_n(&mutex->_lock_count, __ATOMIC_ACQUIRE) > 0 && pthread_equal(mutex->_owner, pthread_self()))
+	{
+		__atomic_add_fetch(&mutex->_lock_count, 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	int r = pthread_mutex_lock(&mutex->_mutex);
+	if (r == 0)
+	{
+		mutex->_owner = pthread_self();
+		__atomic_store_n(&mutex->_lock_count, 1, __ATOMIC_RELEASE);
+	}
+	return r;
+}
+
+static inline int k_mutex_unlock(struct k_mutex* mutex)
+{
+	if (__atomic_sub_fetch(&mutex->_lock_count, 1, __ATOMIC_RELEASE) > 0)
+	{
+		return 0;
+	}
+	return pthread_mutex_unlock(&mutex->_mutex);
+}
+
+struct k_sem {
+	pthread_mutex_t _mutex;
+	pthread_cond_t _cond;
+	unsigned int _count;
+	unsigned int _limit;
+};
+
+#define K_SEM_DEFINE(name, initial_count, count_limit) \
+	struct k_sem name = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, (initial_count), (count_limit) }
+
+static inline void k_sem_give(struct k_sem* sem)
+{
+	pthread_mutex_lock(&sem->_mutex);
+	if (sem->_count < sem->_limit)
+	{
+		sem->_count++;
+	}
+	pthread_cond_signal(&sem->_cond);
+	pthread_mutex_unlock(&sem->_mutex);
+}
+
+static inline int k_sem_take(struct k_sem* sem, k_timeout_t timeout)
+{
+	struct timespec deadline;
+	int r = 0;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout / 1000;
+	deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&sem->_mutex);
+	while (sem->_count == 0 && r == 0)
+	{
+		if (timeout == K_NO_WAIT)
+		{
+			r = -EBUSY;
+		}
+		else if (timeout == K_FOREVER)
+		{
+			pthread_cond_wait(&sem->_cond, &sem->_mutex);
+		}
+		else if (pthread_cond_timedwait(&sem->_cond, &sem->_mutex, &deadline) == ETIMEDOUT && sem->_count == 0)
+		{
+			r = -EAGAIN;
+		}
+	}
+	if (r == 0)
+	{
+		sem->_count--;
+	}
+	pthread_mutex_unlock(&sem->_mutex);
+	return r;
+}
+
+static inline void k_sem_reset(struct k_sem* sem)
+{
+	pthread_mutex_lock(&sem->_mutex);
+	sem->_count = 0;
+	pthread_mutex_unlock(&sem->_mutex);
+}
+
+typedef long atomic_t;
+#define ATOMIC_INIT(value) (value)
+
+static inline bool atomic_cas(atomic_t* target, atomic_t old_value, atomic_t new_value)
+{
+	return __atomic_compare_exchange_n(target, &old_value, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline atomic_t atomic_set(atomic_t* target, atomic_t value)
+{
+	return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+}
+
+/* the stacks are not used: the POSIX threads allocate their own */
+typedef char k_thread_stack_t;
+#define K_THREAD_STACK_DEFINE(name, size) k_thread_stack_t name[size]
+#define K_THREAD_STACK_SIZEOF(name) sizeof(name)
+
+typedef void (*k_thread_entry_t)(void* p1, void* p2, void* p3);
+
+struct k_thread {
+	pthread_t _thread;
+	k_thread_entry_t _entry;
+	void* _p1;
+	void* _p2;
+	void* _p3;
+};
+
+typedef struct k_thread* k_tid_t;
+
+static inline void* _native_thread_start(void* thread)
+{
+	struct k_thread* t = (struct k_thread*)thread;
+	t->_entry(t->_p1, t->_p2, t->_p3);
+	return NULL;
+}
+
+static inline k_tid_t k_thread_create(struct k_thread* thread, k_thread_stack_t* stack, size_t stack_size, k_thread_entry_t entry,
+									  void* p1, void* p2, void* p3, int priority, uint32_t options, k_timeout_t delay)
+{
+	ARG_UNUSED(stack);
+	ARG_UNUSED(stack_size);
+	ARG_UNUSED(priority);
+	ARG_UNUSED(options);
+	ARG_UNUSED(delay);
+	thread->_entry = entry;
+	thread->_p1 = p1;
+	thread->_p2 = p2;
+	thread->_p3 = p3;
+	pthread_create(&thread->_thread, NULL, _native_thread_start, thread);
+	pthread_detach(thread->_thread);
+	return thread;
+}
+
+static inline int k_thread_name_set(k_tid_t thread, const char* name)
+{
+	ARG_UNUSED(thread);
+	ARG_UNUSED(name);
+	return 0;
+}
+
+static inline int32_t k_msleep(int32_t ms)
+{
+	struct timespec duration = { ms / 1000, (long)(ms % 1000) * 1000000 };
+	nanosleep(&duration, NULL);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * @file
+ * @brief Stub of the Zephyr logging for the tests on the host: messages up to NATIVE_LOG_LEVEL are printed to stdout
+ * (0 to print nothing, i.e. fuzzing)
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_LOGGING_LOG_H
+#define NATIVE_STUBS_LOGGING_LOG_H
+
+#include <stdio.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERR 1
+#define LOG_LEVEL_WRN 2
+#define LOG_LEVEL_INF 3
+#define LOG_LEVEL_DBG 4
+
+#ifndef NATIVE_LOG_LEVEL
+#define NATIVE_LOG_LEVEL LOG_LEVEL_INF
+#endif
+
+/* a declaration, so more modules can be compiled in the same translation unit */
+#define LOG_MODULE_REGISTER(name, level) extern int native_log_module_##name
+
+#define NATIVE_LOG(level, tag, fmt, ...)                 \
+	do {                                                 \
+		if ((level) <= NATIVE_LOG_LEVEL) {               \
+			printf("<" tag "> " fmt "\n", ##__VA_ARGS__); \
+		}                                                \
+	} while (0)
+
+#define LOG_ERR(fmt, ...) NATIVE_LOG(LOG_LEVEL_ERR, "err", fmt, ##__VA_ARGS__)
+#define LOG_WRN(fmt, ...) NATIVE_LOG(LOG_LEVEL_WRN, "wrn", fmt, ##__VA_ARGS__)
+#define LOG_INF(fmt, ...) NATIVE_LOG(LOG_LEVEL_INF, "inf", fmt, ##__VA_ARGS__)
+#define LOG_DBG(fmt, ...) NATIVE_LOG(LOG_LEVEL_DBG, "dbg", fmt, ##__VA_ARGS__)
+
+#define log_strdup(str) (str)
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * @file
+ * @brief Stub of the CRCs of Zephyr for the tests on the host: CRC32 IEEE, bit by bit
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_SYS_CRC_H
+#define NATIVE_STUBS_SYS_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+static inline uint32_t crc32_ieee_update(uint32_t crc, const uint8_t* data, size_t len)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1u));
+		}
+	}
+	return ~crc;
+}
+
+static inline uint32_t crc32_ieee(const uint8_t* data, size_t len)
+{
+	return crc32_ieee_update(0, data, len);
+}
+
+#endif
@@ -0,0 +1,17 @@
+/*
+ * @file
+ * @brief Stub of printk for the tests on the host
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_SYS_PRINTK_H
+#define NATIVE_STUBS_SYS_PRINTK_H
+
+#include <stdio.h>
+
+#define printk printf
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * @file
+ * @brief Stub of the Zephyr headers for the tests on the host (native env): only what the libraries tested use
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef NATIVE_STUBS_ZEPHYR_H
+#define NATIVE_STUBS_ZEPHYR_H
+
+#include <kernel.h>
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * @file
+ * @brief Sources of the audio kernels built on the host as on Cortex-M with DSP extension, with the instructions
+ * emulated by test/native_stubs/arch/arm/aarch32/cortex_m/cmsis.h. The functions are renamed with the audio_dsp_simd_ prefix
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CONFIG_CPU_CORTEX_M 1
+#define __ARM_FEATURE_DSP 1
+
+#define audio_dsp_hp_filter audio_dsp_simd_hp_filter
+#define audio_dsp_energy audio_dsp_simd_energy
+#define audio_dsp_rms audio_dsp_simd_rms
+#define audio_dsp_dbfs audio_dsp_simd_dbfs
+#define audio_dsp_self_check audio_dsp_simd_self_check
+
+#include "../../lib/util_libs/audio_dsp.c"
+
+#ifndef AUDIO_DSP_SIMD
+#error "The kernels with the DSP instructions aren't built"
+#endif
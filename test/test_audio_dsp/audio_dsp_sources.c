@@ -0,0 +1,10 @@
+/*
+ * @file
+ * @brief Sources of the audio kernels built on the host: portable C, as on targets without the DSP extension
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../../lib/util_libs/audio_dsp.c"
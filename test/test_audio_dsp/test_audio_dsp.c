@@ -0,0 +1,209 @@
+/*
+ * @file
+ * @brief Unit tests of the audio kernels on the host (pio test -e native): both the portable C and the DSP
+ * instructions (emulated) have to give the same results of the filter and of the energy of the mic AIM they replace,
+ * bit by bit
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <audio_dsp.h>
+
+/* Samples of the signals: 50 ms at 16 kHz, the longest audio block */
+#define TEST_SAMPLES 800
+/* Signals filtered by each test */
+#define TEST_SIGNALS 200
+#define TEST_SEED 0x4D504149
+
+/* kernels with the DSP instructions, built by audio_dsp_simd_sources.c */
+void audio_dsp_simd_hp_filter(audio_dsp_hp_state_t* state, const uint16_t* in, int16_t* out, size_t n);
+uint64_t audio_dsp_simd_energy(const int16_t* samples, size_t n);
+bool audio_dsp_simd_self_check(void);
+
+typedef void (test_hp_filter_t)(audio_dsp_hp_state_t* state, const uint16_t* in, int16_t* out, size_t n);
+typedef uint64_t (test_energy_t)(const int16_t* samples, size_t n);
+
+static uint32_t test_random_state;
+static uint16_t test_in[TEST_SAMPLES];
+static int16_t test_out[TEST_SAMPLES];
+static int16_t test_out_reference[TEST_SAMPLES];
+
+/* xorshift32 */
+static uint32_t test_random(void)
+{
+	uint32_t x = test_random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	test_random_state = x;
+	return x;
+}
+
+/* high-pass filter of the mic AIM, before the kernels */
+static void test_hp_filter_reference(audio_dsp_hp_state_t* state, const uint16_t* in, int16_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		int32_t z = (int32_t) in[i];
+		state->old_out = (0xFC * (state->old_out + z - state->old_in)) / 256;
+		state->old_in = z;
+		out[i] = (int16_t) ((state->old_out < -32768) ? -32768 : ((state->old_out > 32767) ? 32767 : state->old_out));
+	}
+}
+
+/* a signal of the specified kind: noise, tones with noise, extreme values (that saturate the filter) or a mix of them */
+static void test_signal(uint16_t* samples, size_t n, uint32_t kind)
+{
+	static const uint16_t extremes[] = { 0x0000, 0x7FFF, 0x8000, 0xFFFF };
+	uint32_t period = 2 + test_random() % 64;
+	int32_t amplitude = (int32_t) (test_random() % 32768);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		switch (kind % 4)
+		{
+		case 0:
+			samples[i] = (uint16_t) test_random();
+			break;
+		case 1:
+			samples[i] = (uint16_t) (int16_t) (((i / period) % 2 == 0 ? amplitude : -amplitude) / 2 + (int32_t) (test_random() % 2048) - 1024);
+			break;
+		case 2:
+			samples[i] = extremes[(i / period) % 4];
+			break;
+		default:
+			samples[i] = test_random() % 8 == 0 ? extremes[test_random() % 4] : (uint16_t) (int16_t) (test_random() % 4096 - 2048);
+			break;
+		}
+	}
+}
+
+/* filter random signals in random blocks, continuing the state of the filter */
+static void test_hp_filter_blocks(test_hp_filter_t* hp_filter)
+{
+	test_random_state = TEST_SEED;
+	for (size_t signal = 0; signal < TEST_SIGNALS; signal++)
+	{
+		audio_dsp_hp_state_t state_reference = { (int32_t) (test_random() % 65536) - 32768, (int32_t) (test_random() % 65536) };
+		audio_dsp_hp_state_t state = state_reference;
+		test_signal(test_in, TEST_SAMPLES, signal);
+
+		test_hp_filter_reference(&state_reference, test_in, test_out_reference, TEST_SAMPLES);
+		for (size_t offset = 0, len = 0; offset < TEST_SAMPLES; offset += len)
+		{
+			len = 1 + test_random() % (TEST_SAMPLES - offset);
+			hp_filter(&state, test_in + offset, test_out + offset, len);
+		}
+
+		TEST_ASSERT_EQUAL_INT16_ARRAY(test_out_reference, test_out, TEST_SAMPLES);
+		TEST_ASSERT_EQUAL_INT32(state_reference.old_out, state.old_out);
+		TEST_ASSERT_EQUAL_INT32(state_reference.old_in, state.old_in);
+	}
+}
+
+/* energy of random windows of the filtered signals, at every alignment */
+static void test_energy_windows(test_energy_t* energy)
+{
+	test_random_state = TEST_SEED;
+	for (size_t signal = 0; signal < TEST_SIGNALS; signal++)
+	{
+		audio_dsp_hp_state_t state = { 0, 0 };
+		test_signal(test_in, TEST_SAMPLES, signal);
+		test_hp_filter_reference(&state, test_in, test_out_reference, TEST_SAMPLES);
+
+		size_t offset = test_random() % TEST_SAMPLES;
+		size_t len = test_random() % (TEST_SAMPLES - offset + 1);
+		uint64_t energy_reference = 0;
+		for (size_t i = offset; i < offset + len; i++)
+		{
+			energy_reference += (uint64_t) ((int64_t) test_out_reference[i] * test_out_reference[i]);
+		}
+		TEST_ASSERT_EQUAL_UINT64(energy_reference, energy(test_out_reference + offset, len));
+	}
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_hp_filter(void)
+{
+	test_hp_filter_blocks(audio_dsp_hp_filter);
+}
+
+void test_hp_filter_simd(void)
+{
+	test_hp_filter_blocks(audio_dsp_simd_hp_filter);
+}
+
+void test_energy(void)
+{
+	test_energy_windows(audio_dsp_energy);
+}
+
+void test_energy_simd(void)
+{
+	test_energy_windows(audio_dsp_simd_energy);
+}
+
+/* the largest energy of a window: every sample at -32768 */
+void test_energy_full_scale(void)
+{
+	for (size_t i = 0; i < TEST_SAMPLES; i++)
+	{
+		test_out[i] = INT16_MIN;
+	}
+	uint64_t energy_reference = (uint64_t) TEST_SAMPLES * 32768u * 32768u;
+	TEST_ASSERT_EQUAL_UINT64(energy_reference, audio_dsp_energy(test_out, TEST_SAMPLES));
+	TEST_ASSERT_EQUAL_UINT64(energy_reference, audio_dsp_simd_energy(test_out, TEST_SAMPLES));
+}
+
+void test_self_check(void)
+{
+	TEST_ASSERT_TRUE(audio_dsp_self_check());
+	TEST_ASSERT_TRUE(audio_dsp_simd_self_check());
+}
+
+void test_rms(void)
+{
+	TEST_ASSERT_EQUAL_INT32(0, audio_dsp_rms(0));
+	TEST_ASSERT_EQUAL_INT32(32768, audio_dsp_rms(32768u * 32768u));
+	test_random_state = TEST_SEED;
+	for (size_t i = 0; i < 10000; i++)
+	{
+		uint32_t rms = test_random() % 32768;
+		// rounded down between the squares
+		TEST_ASSERT_EQUAL_INT32(rms, audio_dsp_rms(rms * rms));
+		TEST_ASSERT_EQUAL_INT32(rms, audio_dsp_rms(rms * rms + 2 * rms));
+	}
+}
+
+void test_dbfs(void)
+{
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, AUDIO_DSP_DBFS_MIN, audio_dsp_dbfs(0));
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.0f, audio_dsp_dbfs(32768u * 32768u));
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, -6.021f, audio_dsp_dbfs(16384u * 16384u));
+	TEST_ASSERT_FLOAT_WITHIN(0.1f, -90.3f, audio_dsp_dbfs(1));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_hp_filter);
+	RUN_TEST(test_hp_filter_simd);
+	RUN_TEST(test_energy);
+	RUN_TEST(test_energy_simd);
+	RUN_TEST(test_energy_full_scale);
+	RUN_TEST(test_self_check);
+	RUN_TEST(test_rms);
+	RUN_TEST(test_dbfs);
+	return UNITY_END();
+}
@@ -0,0 +1,292 @@
+/*
+ * @file
+ * @brief Unit tests of the flash ring on the host (pio test -e native), on a flash memory in RAM:
+ * records are forwarded once and in order, the oldest ones are dropped when the ring wraps, and the records synced
+ * survive the power lost in any write or erase
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+#include <flash_ring.h>
+
+#define TEST_RECORD_MIN_LEN 8
+#define TEST_RECORD_MAX_LEN 188
+#define TEST_RECORDS_MAX 16384
+/* records between two syncs */
+#define TEST_SYNC_PERIOD 10
+#define TEST_POWER_LOSSES 150
+/* writes and erases before the power is lost: more than the pages of the ring, so it wraps in some trials */
+#define TEST_POWER_LOSS_MAX_AFTER 1000
+#define TEST_RECORDS_AFTER_RECOVERY 20
+
+/* Records forwarded by a call of MPAI_Flash_Ring_Forward */
+typedef struct _test_forwarded_t {
+	uint32_t _ids[TEST_RECORDS_MAX];
+	size_t _count;
+	size_t _corrupted;
+	size_t _fail_at;							// the callback fails at this record
+} test_forwarded_t;
+
+static test_forwarded_t test_forwarded;
+static uint32_t test_next_id;
+
+/* a record: its ID, then bytes depending on it */
+static size_t test_record(uint8_t* data, uint32_t id)
+{
+	size_t len = TEST_RECORD_MIN_LEN + (id * 29) % (TEST_RECORD_MAX_LEN - TEST_RECORD_MIN_LEN + 1);
+
+	memcpy(data, &id, sizeof(id));
+	for (size_t i = sizeof(id); i < len; i++)
+	{
+		data[i] = (uint8_t)(id * 7 + i);
+	}
+	return len;
+}
+
+static int test_append(void)
+{
+	uint8_t data[TEST_RECORD_MAX_LEN];
+	return MPAI_Flash_Ring_Append(data, test_record(data, test_next_id++));
+}
+
+static int test_forward_callback(const uint8_t* data, size_t len, void* user_data)
+{
+	test_forwarded_t* forwarded = (test_forwarded_t*)user_data;
+	uint8_t expected[TEST_RECORD_MAX_LEN];
+	uint32_t id;
+
+	if (forwarded->_count == forwarded->_fail_at)
+	{
+		return -EAGAIN;
+	}
+	if (len < sizeof(id) || len > TEST_RECORD_MAX_LEN || forwarded->_count == TEST_RECORDS_MAX)
+	{
+		forwarded->_corrupted++;
+		return 0;
+	}
+
+	memcpy(&id, data, sizeof(id));
+	if (test_record(expected, id) != len || memcmp(data, expected, len) != 0)
+	{
+		forwarded->_corrupted++;
+		return 0;
+	}
+	forwarded->_ids[forwarded->_count++] = id;
+	return 0;
+}
+
+/* forward all the records, checking their data */
+static int test_forward(size_t fail_at)
+{
+	test_forwarded._count = 0;
+	test_forwarded._corrupted = 0;
+	test_forwarded._fail_at = fail_at;
+	int r = MPAI_Flash_Ring_Forward(test_forward_callback, &test_forwarded, TEST_RECORDS_MAX);
+	TEST_ASSERT_EQUAL_INT(0, test_forwarded._corrupted);
+	return r;
+}
+
+/* the records forwarded have consecutive IDs, from the first one */
+static void test_check_consecutive(uint32_t first, size_t count)
+{
+	TEST_ASSERT_EQUAL_INT(count, test_forwarded._count);
+	for (size_t i = 0; i < test_forwarded._count && i < count; i++)
+	{
+		TEST_ASSERT_EQUAL_UINT32(first + i, test_forwarded._ids[i]);
+	}
+}
+
+void setUp(void)
+{
+	native_flash_reset();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	test_next_id = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_append_forward(void)
+{
+	mpai_flash_ring_stats_t stats;
+
+	for (size_t i = 0; i < 100; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&stats));
+	TEST_ASSERT_EQUAL_UINT32(100, stats._pending);
+
+	// records still in the page in memory are forwarded too
+	TEST_ASSERT_EQUAL_INT(100, test_forward(SIZE_MAX));
+	test_check_consecutive(0, 100);
+	TEST_ASSERT_EQUAL_INT(0, test_forward(SIZE_MAX));
+
+	// forwarded also after a reboot
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	TEST_ASSERT_EQUAL_INT(0, test_forward(SIZE_MAX));
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&stats));
+	TEST_ASSERT_EQUAL_UINT32(0, stats._pending);
+}
+
+void test_forward_error(void)
+{
+	for (size_t i = 0; i < 10; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+
+	// the record not forwarded is kept, with the ones after it
+	TEST_ASSERT_EQUAL_INT(3, test_forward(3));
+	test_check_consecutive(0, 3);
+	TEST_ASSERT_EQUAL_INT(-EAGAIN, test_forward(0));
+	TEST_ASSERT_EQUAL_INT(7, test_forward(SIZE_MAX));
+	test_check_consecutive(3, 7);
+}
+
+void test_sync_reboot(void)
+{
+	for (size_t i = 0; i < 50; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Sync());
+	for (size_t i = 0; i < 3; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+
+	// the records not synced can be lost, only after the ones synced
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	int r = test_forward(SIZE_MAX);
+	TEST_ASSERT_TRUE(r >= 50 && r <= 53);
+	test_check_consecutive(0, r);
+
+	// records appended after the reboot follow them
+	test_next_id = 53;
+	for (size_t i = 0; i < 10; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Sync());
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	TEST_ASSERT_EQUAL_INT(10, test_forward(SIZE_MAX));
+	test_check_consecutive(53, 10);
+}
+
+void test_wrap(void)
+{
+	mpai_flash_ring_stats_t before;
+	mpai_flash_ring_stats_t stats;
+
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&before));
+	size_t ring_size = before._sectors * FLASH_SECTOR_SIZE;
+
+	// some records are forwarded before the ring wraps: they are erased, not dropped
+	for (size_t i = 0; i < 100; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+	TEST_ASSERT_EQUAL_INT(100, test_forward(SIZE_MAX));
+
+	// one ring and a half of records
+	for (size_t appended = 0; appended < ring_size * 3 / 2; )
+	{
+		uint8_t data[TEST_RECORD_MAX_LEN];
+		appended += test_record(data, test_next_id);
+		TEST_ASSERT_EQUAL_INT(0, test_append());
+	}
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Sync());
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&stats));
+	uint32_t dropped = stats._dropped - before._dropped;
+	uint32_t appended = stats._appended - before._appended;
+	TEST_ASSERT_TRUE(dropped > 0);
+	TEST_ASSERT_EQUAL_UINT32(appended - 100, stats._pending + dropped);
+	TEST_ASSERT_EQUAL_INT(stats._sectors, stats._used_sectors);
+
+	// after a reboot, the records left are the newest ones: the oldest ones were dropped
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	TEST_ASSERT_EQUAL_INT(stats._pending, test_forward(SIZE_MAX));
+	test_check_consecutive(100 + dropped, stats._pending);
+	TEST_ASSERT_EQUAL_UINT32(test_next_id - 1, test_forwarded._ids[test_forwarded._count - 1]);
+}
+
+void test_power_loss(void)
+{
+	mpai_flash_ring_stats_t stats;
+
+	for (size_t trial = 0; trial < TEST_POWER_LOSSES; trial++)
+	{
+		native_flash_reset();
+		TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+		TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&stats));
+		uint32_t dropped_before = stats._dropped;
+		test_next_id = 0;
+
+		// records appended and synced until a write or an erase is interrupted
+		native_flash_power_loss_after((trial * 53) % TEST_POWER_LOSS_MAX_AFTER);
+		uint32_t synced = 0;
+		uint32_t dropped = 0;
+		while (true)
+		{
+			if (test_append() != 0)
+			{
+				break;
+			}
+			TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&stats));
+			dropped = stats._dropped - dropped_before;
+			if (test_next_id % TEST_SYNC_PERIOD == 0)
+			{
+				if (MPAI_Flash_Ring_Sync() != 0)
+				{
+					break;
+				}
+				synced = test_next_id;
+			}
+		}
+		TEST_ASSERT_TRUE(native_flash_power_lost());
+		// the interrupted append can have erased the oldest sector
+		TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Stats(&stats));
+		uint32_t dropped_interrupted = stats._dropped - dropped_before;
+
+		// the records synced are forwarded after a reboot, the ones after them can be lost
+		native_flash_power_on();
+		TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+		int r = test_forward(SIZE_MAX);
+		TEST_ASSERT_TRUE(r > 0 || synced == 0);
+		if (r > 0)
+		{
+			uint32_t first = test_forwarded._ids[0];
+			TEST_ASSERT_TRUE(first == dropped || first == dropped_interrupted);
+			test_check_consecutive(first, r);
+			TEST_ASSERT_TRUE(first + r >= synced);
+		}
+
+		// the ring is still usable, also after another reboot
+		for (size_t i = 0; i < TEST_RECORDS_AFTER_RECOVERY; i++)
+		{
+			TEST_ASSERT_EQUAL_INT(0, test_append());
+		}
+		TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Sync());
+		TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+		TEST_ASSERT_EQUAL_INT(TEST_RECORDS_AFTER_RECOVERY, test_forward(SIZE_MAX));
+		test_check_consecutive(test_next_id - TEST_RECORDS_AFTER_RECOVERY, TEST_RECORDS_AFTER_RECOVERY);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_append_forward);
+	RUN_TEST(test_forward_error);
+	RUN_TEST(test_sync_reboot);
+	RUN_TEST(test_wrap);
+	RUN_TEST(test_power_loss);
+	return UNITY_END();
+}
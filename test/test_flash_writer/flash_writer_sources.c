@@ -0,0 +1,25 @@
+/*
+ * @file
+ * @brief Sources of the writer of the flash ring built on the host, with the configuration of zephyr/prj.conf,
+ * on the flash memory in RAM of test/native_stubs
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CONFIG_MPAI_FLASH_RING 1
+#ifndef CONFIG_MPAI_FLASH_RING_SECTORS
+#define CONFIG_MPAI_FLASH_RING_SECTORS 32
+#endif
+#define CONFIG_MPAI_FLASH_WRITER 1
+#ifndef CONFIG_MPAI_FLASH_WRITER_BUFFER_SIZE
+#define CONFIG_MPAI_FLASH_WRITER_BUFFER_SIZE 2048
+#endif
+#ifndef CONFIG_MPAI_FLASH_WRITER_PRIORITY
+#define CONFIG_MPAI_FLASH_WRITER_PRIORITY 10
+#endif
+
+#include "../native_stubs/flash_store.c"
+#include "../../lib/mpai_core/flash_ring.c"
+#include "../../lib/mpai_core/flash_writer.c"
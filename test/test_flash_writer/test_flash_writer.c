@@ -0,0 +1,245 @@
+/*
+ * @file
+ * @brief Unit tests of the writer of the flash ring on the host (pio test -e native), on a flash memory in RAM:
+ * the records submitted reach the flash ring in order across the swaps of the buffers, and a flush writes all of them
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <unity.h>
+#include <string.h>
+#include <flash_writer.h>
+
+#define TEST_RECORD_MIN_LEN 8
+#define TEST_RECORD_MAX_LEN 120
+#define TEST_RECORDS 600
+#define TEST_SUBMITTERS 2
+/* records of a submitter between two flushes */
+#define TEST_FLUSH_PERIOD 50
+/* the IDs of the records have the index of their submitter in the high bits */
+#define TEST_SUBMITTER_SHIFT 24
+#define TEST_FLUSH_TIMEOUT_MS 20
+
+/* Records forwarded from the flash ring, or completed by the writer */
+typedef struct _test_records_t {
+	uint32_t _ids[TEST_RECORDS];
+	int _results[TEST_RECORDS];
+	size_t _count;
+	size_t _corrupted;
+} test_records_t;
+
+static test_records_t test_forwarded;
+static test_records_t test_completed;
+/* first error of each submitter thread: the assertions are checked by the test */
+static int test_submitter_results[TEST_SUBMITTERS];
+/* the callback of the first record of test_swap waits for the test, to keep the writer busy */
+K_SEM_DEFINE(test_writer_busy, 0, 1);
+K_SEM_DEFINE(test_writer_release, 0, 1);
+
+/* a record: its ID, then bytes depending on it */
+static size_t test_record(uint8_t* data, uint32_t id)
+{
+	size_t len = TEST_RECORD_MIN_LEN + (id * 29) % (TEST_RECORD_MAX_LEN - TEST_RECORD_MIN_LEN + 1);
+
+	memcpy(data, &id, sizeof(id));
+	for (size_t i = sizeof(id); i < len; i++)
+	{
+		data[i] = (uint8_t)(id * 7 + i);
+	}
+	return len;
+}
+
+/* completion of a record: called by the thread of the writer */
+static void test_completed_callback(int result, void* user_data)
+{
+	uint32_t id = (uint32_t)(uintptr_t)user_data;
+
+	if (test_completed._count < TEST_RECORDS)
+	{
+		test_completed._ids[test_completed._count] = id;
+		test_completed._results[test_completed._count] = result;
+		test_completed._count++;
+	}
+}
+
+static void test_busy_callback(int result, void* user_data)
+{
+	test_completed_callback(result, user_data);
+	k_sem_give(&test_writer_busy);
+	k_sem_take(&test_writer_release, K_FOREVER);
+}
+
+/* submit a record, retrying while the buffers are full */
+static int test_submit(uint32_t id, mpai_flash_writer_callback_t* callback)
+{
+	uint8_t data[TEST_RECORD_MAX_LEN];
+	size_t len = test_record(data, id);
+	int r;
+
+	while ((r = MPAI_Flash_Writer_Submit(data, len, callback, (void*)(uintptr_t)id)) == -ENOBUFS)
+	{
+		k_msleep(1);
+	}
+	return r;
+}
+
+static int test_forward_callback(const uint8_t* data, size_t len, void* user_data)
+{
+	test_records_t* forwarded = (test_records_t*)user_data;
+	uint8_t expected[TEST_RECORD_MAX_LEN];
+	uint32_t id;
+
+	memcpy(&id, data, sizeof(id));
+	if (forwarded->_count == TEST_RECORDS || test_record(expected, id) != len || memcmp(data, expected, len) != 0)
+	{
+		forwarded->_corrupted++;
+		return 0;
+	}
+	forwarded->_ids[forwarded->_count++] = id;
+	return 0;
+}
+
+/* forward the records of the flash ring */
+static int test_forward(void)
+{
+	test_forwarded._count = 0;
+	test_forwarded._corrupted = 0;
+	int r = MPAI_Flash_Ring_Forward(test_forward_callback, &test_forwarded, TEST_RECORDS);
+	TEST_ASSERT_EQUAL_INT(0, test_forwarded._corrupted);
+	return r;
+}
+
+/* the records of each submitter have consecutive IDs, in order */
+static void test_check_order(const test_records_t* records, size_t submitters, size_t per_submitter)
+{
+	uint32_t next[TEST_SUBMITTERS] = { 0 };
+
+	TEST_ASSERT_EQUAL_INT(submitters * per_submitter, records->_count);
+	for (size_t i = 0; i < records->_count; i++)
+	{
+		uint32_t submitter = records->_ids[i] >> TEST_SUBMITTER_SHIFT;
+		TEST_ASSERT_TRUE(submitter < submitters);
+		if (submitter < submitters)
+		{
+			TEST_ASSERT_EQUAL_UINT32(next[submitter], records->_ids[i] & ((1u << TEST_SUBMITTER_SHIFT) - 1));
+			next[submitter]++;
+		}
+	}
+}
+
+static void* test_submitter(void* arg)
+{
+	uint32_t submitter = (uint32_t)(uintptr_t)arg;
+	int r = 0;
+
+	for (uint32_t i = 0; r == 0 && i < TEST_RECORDS / TEST_SUBMITTERS; i++)
+	{
+		r = test_submit((submitter << TEST_SUBMITTER_SHIFT) | i, test_completed_callback);
+		if (r == 0 && (i + 1) % TEST_FLUSH_PERIOD == 0)
+		{
+			r = MPAI_Flash_Writer_Flush(K_FOREVER);
+		}
+	}
+	test_submitter_results[submitter] = r;
+	return NULL;
+}
+
+void setUp(void)
+{
+	// the writer is idle: the tests end with a flush
+	native_flash_reset();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	memset(&test_completed, 0, sizeof(test_completed));
+}
+
+void tearDown(void)
+{
+}
+
+void test_submit_flush(void)
+{
+	for (uint32_t id = 0; id < TEST_RECORDS; id++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_submit(id, test_completed_callback));
+	}
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Writer_Flush(K_FOREVER));
+
+	test_check_order(&test_completed, 1, TEST_RECORDS);
+	for (size_t i = 0; i < test_completed._count; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_completed._results[i]);
+	}
+
+	// the flush wrote the last page: the records survive a reboot
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	TEST_ASSERT_EQUAL_INT(TEST_RECORDS, test_forward());
+	test_check_order(&test_forwarded, 1, TEST_RECORDS);
+}
+
+void test_swap(void)
+{
+	mpai_flash_writer_stats_t before;
+	mpai_flash_writer_stats_t stats;
+	uint8_t data[TEST_RECORD_MAX_LEN];
+	uint32_t id = 0;
+
+	MPAI_Flash_Writer_Stats(&before);
+
+	// the writer is busy with the first buffer: the records are gathered in the other one, until it's full
+	TEST_ASSERT_EQUAL_INT(0, test_submit(id++, test_busy_callback));
+	k_sem_take(&test_writer_busy, K_FOREVER);
+	while (MPAI_Flash_Writer_Submit(data, test_record(data, id), test_completed_callback, (void*)(uintptr_t)id) == 0)
+	{
+		id++;
+	}
+	TEST_ASSERT_EQUAL_INT(-ENOBUFS, MPAI_Flash_Writer_Submit(data, test_record(data, id), test_completed_callback, (void*)(uintptr_t)id));
+	TEST_ASSERT_EQUAL_INT(-EAGAIN, MPAI_Flash_Writer_Flush(K_MSEC(TEST_FLUSH_TIMEOUT_MS)));
+
+	MPAI_Flash_Writer_Stats(&stats);
+	TEST_ASSERT_EQUAL_UINT32(id, stats._submitted - before._submitted);
+	TEST_ASSERT_EQUAL_UINT32(2, stats._rejected - before._rejected);
+
+	// the records of the second buffer follow the one of the first buffer
+	k_sem_give(&test_writer_release);
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Writer_Flush(K_FOREVER));
+	test_check_order(&test_completed, 1, id);
+	TEST_ASSERT_EQUAL_INT(id, test_forward());
+	test_check_order(&test_forwarded, 1, id);
+
+	MPAI_Flash_Writer_Stats(&stats);
+	TEST_ASSERT_EQUAL_UINT32(id, stats._written - before._written);
+	TEST_ASSERT_EQUAL_UINT32(0, stats._failed - before._failed);
+}
+
+void test_concurrent_submitters(void)
+{
+	pthread_t submitters[TEST_SUBMITTERS];
+
+	// each submitter flushes while the other one is submitting
+	for (size_t i = 0; i < TEST_SUBMITTERS; i++)
+	{
+		pthread_create(&submitters[i], NULL, test_submitter, (void*)(uintptr_t)i);
+	}
+	for (size_t i = 0; i < TEST_SUBMITTERS; i++)
+	{
+		pthread_join(submitters[i], NULL);
+		TEST_ASSERT_EQUAL_INT(0, test_submitter_results[i]);
+	}
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Writer_Flush(K_FOREVER));
+
+	test_check_order(&test_completed, TEST_SUBMITTERS, TEST_RECORDS / TEST_SUBMITTERS);
+	TEST_ASSERT_EQUAL_INT(0, MPAI_Flash_Ring_Mount());
+	TEST_ASSERT_EQUAL_INT(TEST_RECORDS, test_forward());
+	test_check_order(&test_forwarded, TEST_SUBMITTERS, TEST_RECORDS / TEST_SUBMITTERS);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_submit_flush);
+	RUN_TEST(test_swap);
+	RUN_TEST(test_concurrent_submitters);
+	return UNITY_END();
+}
@@ -0,0 +1,23 @@
+/*
+ * @file
+ * @brief Sources of the key/record store built on the host, with the configuration of zephyr/prj.conf,
+ * on the flash memory in RAM of test/native_stubs
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define CONFIG_MPAI_KV_STORE 1
+#ifndef CONFIG_MPAI_KV_STORE_SECTORS
+#define CONFIG_MPAI_KV_STORE_SECTORS 8
+#endif
+#ifndef CONFIG_MPAI_KV_STORE_MAX_KEYS
+#define CONFIG_MPAI_KV_STORE_MAX_KEYS 32
+#endif
+#ifndef CONFIG_MPAI_KV_STORE_WEAR_DELTA
+#define CONFIG_MPAI_KV_STORE_WEAR_DELTA 16
+#endif
+
+#include "../native_stubs/flash_store.c"
+#include "../../lib/mpai_core/kv_store.c"
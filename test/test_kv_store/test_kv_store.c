@@ -0,0 +1,377 @@
+/*
+ * @file
+ * @brief Unit tests of the key/record store on the host (pio test -e native), on a flash memory in RAM:
+ * the last record of each key has to survive replacements, deletions, compactions and the power lost in any write or erase
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <kv_store.h>
+
+#define TEST_KEYS 12
+#define TEST_DATA_MAX_LEN 300
+/* keys with records of a fixed size, after the others: 6 fill a sector */
+#define TEST_LARGE_KEYS 24
+#define TEST_LARGE_DATA_LEN 600
+#define TEST_LARGE_KEYS_PER_SECTOR 6
+#define TEST_SEED 0x4D504B56
+/* operations before the power is lost: the sectors are already compacted */
+#define TEST_WARM_UP_OPERATIONS 400
+#define TEST_POWER_LOSSES 300
+#define TEST_OPERATIONS_AFTER_RECOVERY 50
+
+static uint32_t test_random_state;
+/* version of the last record acknowledged of each key, 0 if it's deleted (or never written) */
+static uint32_t test_versions[TEST_KEYS + TEST_LARGE_KEYS];
+static uint32_t test_next_version;
+
+/* xorshift32 */
+static uint32_t test_random(void)
+{
+	uint32_t x = test_random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	test_random_state = x;
+	return x;
+}
+
+static void test_key(char* key, size_t size, size_t idx)
+{
+	if (idx < TEST_KEYS)
+	{
+		snprintf(key, size, "sensor/%u", (unsigned)idx);
+	}
+	else
+	{
+		snprintf(key, size, "record/%u", (unsigned)(idx - TEST_KEYS));
+	}
+}
+
+/* data of a version of a key: the version, then bytes depending on both */
+static size_t test_data(uint8_t* data, size_t idx, uint32_t version)
+{
+	size_t len = idx < TEST_KEYS ? sizeof(version) + (version * 37 + idx * 11) % (TEST_DATA_MAX_LEN - sizeof(version)) : TEST_LARGE_DATA_LEN;
+
+	memcpy(data, &version, sizeof(version));
+	for (size_t i = sizeof(version); i < len; i++)
+	{
+		data[i] = (uint8_t)(idx * 31 + version + i);
+	}
+	return len;
+}
+
+/* version of a key in the store: 0 if it's not found, -1 if its data is wrong */
+static int64_t test_read_version(size_t idx)
+{
+	char key[MPAI_KV_STORE_KEY_MAX_LEN + 1];
+	uint8_t data[TEST_LARGE_DATA_LEN];
+	uint8_t expected[TEST_LARGE_DATA_LEN];
+	uint32_t version;
+
+	test_key(key, sizeof(key), idx);
+	int r = MPAI_KV_Store_Read(key, data, sizeof(data));
+	if (r == -ENOENT)
+	{
+		return 0;
+	}
+	if (r < (int)sizeof(version))
+	{
+		return -1;
+	}
+
+	memcpy(&version, data, sizeof(version));
+	size_t len = test_data(expected, idx, version);
+	return (size_t)r == len && memcmp(data, expected, len) == 0 ? version : -1;
+}
+
+/* write a new version of a key, or delete it */
+static int test_operation(size_t idx, bool delete, uint32_t* version)
+{
+	char key[MPAI_KV_STORE_KEY_MAX_LEN + 1];
+	uint8_t data[TEST_LARGE_DATA_LEN];
+
+	test_key(key, sizeof(key), idx);
+	if (delete)
+	{
+		*version = 0;
+		return MPAI_KV_Store_Delete(key);
+	}
+	*version = test_next_version++;
+	return MPAI_KV_Store_Write(key, data, test_data(data, idx, *version));
+}
+
+/* a random write (or deletion, of a key written) that has to succeed */
+static void test_random_operation(void)
+{
+	size_t idx = test_random() % TEST_KEYS;
+	bool delete = test_versions[idx] != 0 && test_random() % 5 == 0;
+	uint32_t version;
+
+	TEST_ASSERT_EQUAL_INT(0, test_operation(idx, delete, &version));
+	test_versions[idx] = version;
+}
+
+static void test_check_versions(void)
+{
+	for (size_t idx = 0; idx < TEST_KEYS + TEST_LARGE_KEYS; idx++)
+	{
+		TEST_ASSERT_EQUAL_INT64(test_versions[idx], test_read_version(idx));
+	}
+}
+
+static void test_count(const char* key, size_t len, void* user_data)
+{
+	ARG_UNUSED(key);
+	ARG_UNUSED(len);
+	(*(size_t*)user_data)++;
+}
+
+void setUp(void)
+{
+	native_flash_reset();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	memset(test_versions, 0, sizeof(test_versions));
+	test_next_version = 1;
+	test_random_state = TEST_SEED;
+}
+
+void tearDown(void)
+{
+}
+
+void test_write_read(void)
+{
+	for (size_t idx = 0; idx < TEST_KEYS; idx++)
+	{
+		uint32_t version;
+		TEST_ASSERT_EQUAL_INT(0, test_operation(idx, false, &version));
+		test_versions[idx] = version;
+	}
+	test_check_versions();
+
+	// rebooted: the index is rebuilt from the flash memory
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	test_check_versions();
+	TEST_ASSERT_EQUAL_INT(-ENOENT, MPAI_KV_Store_Read("sensor/none", NULL, 0));
+}
+
+void test_compactions(void)
+{
+	mpai_kv_store_stats_t stats;
+
+	// many times the size of the store: its sectors are compacted again and again
+	for (size_t i = 0; i < 2000; i++)
+	{
+		test_random_operation();
+	}
+	test_check_versions();
+
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Stats(&stats));
+	TEST_ASSERT_TRUE(stats._compactions > 0);
+	TEST_ASSERT_TRUE(stats._free_sectors >= 1);
+
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	test_check_versions();
+}
+
+void test_tombstones(void)
+{
+	mpai_kv_store_stats_t stats;
+	char key[MPAI_KV_STORE_KEY_MAX_LEN + 1];
+	uint32_t version;
+	size_t count = 0;
+
+	for (size_t idx = 0; idx < TEST_KEYS; idx++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_operation(idx, false, &version));
+		test_versions[idx] = version;
+	}
+	for (size_t idx = 0; idx < TEST_KEYS; idx += 2)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_operation(idx, true, &version));
+		test_versions[idx] = version;
+		test_key(key, sizeof(key), idx);
+		TEST_ASSERT_EQUAL_INT(-ENOENT, MPAI_KV_Store_Delete(key));
+	}
+	test_check_versions();
+	TEST_ASSERT_EQUAL_INT(TEST_KEYS / 2, MPAI_KV_Store_Foreach("sensor/", test_count, &count));
+	TEST_ASSERT_EQUAL_INT(TEST_KEYS / 2, count);
+
+	// the keys left are replaced until every sector is compacted: the records deleted never come back
+	for (size_t i = 0; i < 1000; i++)
+	{
+		size_t idx = 1 + 2 * (test_random() % (TEST_KEYS / 2));
+		TEST_ASSERT_EQUAL_INT(0, test_operation(idx, false, &version));
+		test_versions[idx] = version;
+	}
+	test_check_versions();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	test_check_versions();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Stats(&stats));
+	TEST_ASSERT_EQUAL_INT(TEST_KEYS / 2, stats._keys);
+
+	// a key deleted can be written again
+	TEST_ASSERT_EQUAL_INT(0, test_operation(0, false, &version));
+	test_versions[0] = version;
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	test_check_versions();
+}
+
+/* a store used long enough to compact its sectors, the same for the same trial */
+static void test_warm_up(size_t trial)
+{
+	native_flash_reset();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	memset(test_versions, 0, sizeof(test_versions));
+	test_next_version = 1;
+	test_random_state = TEST_SEED + trial;
+	for (size_t i = 0; i < TEST_WARM_UP_OPERATIONS; i++)
+	{
+		test_random_operation();
+	}
+}
+
+void test_power_loss(void)
+{
+	for (size_t trial = 0; trial < TEST_POWER_LOSSES; trial++)
+	{
+		// the writes and erases of the next operation that compacts a sector (more than the writes of a record and the opening of a sector)
+		test_warm_up(trial);
+		size_t warm_up_operations = native_flash_operations();
+		size_t compaction_start;
+		size_t compaction_operations;
+		do
+		{
+			compaction_start = native_flash_operations();
+			test_random_operation();
+			compaction_operations = native_flash_operations() - compaction_start;
+		} while (compaction_operations <= 3);
+
+		// the power is lost at a step of that operation: its key can have the previous record or the new one
+		test_warm_up(trial);
+		native_flash_power_loss_after(compaction_start - warm_up_operations + trial % compaction_operations);
+		size_t idx;
+		uint32_t version;
+		while (true)
+		{
+			idx = test_random() % TEST_KEYS;
+			if (test_operation(idx, test_versions[idx] != 0 && test_random() % 5 == 0, &version) != 0)
+			{
+				break;
+			}
+			test_versions[idx] = version;
+		}
+		TEST_ASSERT_TRUE(native_flash_power_lost());
+
+		native_flash_power_on();
+		TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+		int64_t found = test_read_version(idx);
+		TEST_ASSERT_TRUE(found == test_versions[idx] || found == version);
+		test_versions[idx] = (uint32_t)found;
+		test_check_versions();
+
+		// the store is still usable, also after another reboot
+		for (size_t i = 0; i < TEST_OPERATIONS_AFTER_RECOVERY; i++)
+		{
+			test_random_operation();
+		}
+		test_check_versions();
+		TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+		test_check_versions();
+	}
+}
+
+/* a store whose sectors are full of large records, then replaced one per sector: a compaction has to copy records
+ * the head sector can't hold, so it opens the last free sector */
+static void test_fill_large(void)
+{
+	uint32_t version;
+
+	native_flash_reset();
+	TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+	memset(test_versions, 0, sizeof(test_versions));
+	test_next_version = 1;
+	for (size_t idx = TEST_KEYS; idx < TEST_KEYS + TEST_LARGE_KEYS; idx++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, test_operation(idx, false, &version));
+		test_versions[idx] = version;
+	}
+}
+
+static size_t test_large_key_replaced(size_t i)
+{
+	return TEST_KEYS + (i * TEST_LARGE_KEYS_PER_SECTOR + i / (TEST_LARGE_KEYS / TEST_LARGE_KEYS_PER_SECTOR)) % TEST_LARGE_KEYS;
+}
+
+void test_interrupted_compaction(void)
+{
+	uint32_t version;
+
+	// the writes and erases of the first replacement that compacts a sector
+	test_fill_large();
+	size_t fill_operations = native_flash_operations();
+	size_t compaction_start;
+	size_t compaction_operations;
+	for (size_t i = 0; ; i++)
+	{
+		compaction_start = native_flash_operations();
+		TEST_ASSERT_EQUAL_INT(0, test_operation(test_large_key_replaced(i), false, &version));
+		compaction_operations = native_flash_operations() - compaction_start;
+		if (compaction_operations > 3)
+		{
+			break;
+		}
+	}
+
+	// the power is lost at each step of the compaction
+	for (size_t step = 0; step < compaction_operations; step++)
+	{
+		test_fill_large();
+		native_flash_power_loss_after(compaction_start - fill_operations + step);
+		size_t idx;
+		for (size_t i = 0; ; i++)
+		{
+			idx = test_large_key_replaced(i);
+			if (test_operation(idx, false, &version) != 0)
+			{
+				break;
+			}
+			test_versions[idx] = version;
+		}
+		TEST_ASSERT_TRUE(native_flash_power_lost());
+
+		native_flash_power_on();
+		TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+		int64_t found = test_read_version(idx);
+		TEST_ASSERT_TRUE(found == test_versions[idx] || found == version);
+		test_versions[idx] = (uint32_t)found;
+		test_check_versions();
+
+		// compactions go on after the recovery
+		for (size_t i = 0; i < TEST_LARGE_KEYS; i++)
+		{
+			idx = test_large_key_replaced(i);
+			TEST_ASSERT_EQUAL_INT(0, test_operation(idx, false, &version));
+			test_versions[idx] = version;
+		}
+		TEST_ASSERT_EQUAL_INT(0, MPAI_KV_Store_Mount());
+		test_check_versions();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_write_read);
+	RUN_TEST(test_compactions);
+	RUN_TEST(test_tombstones);
+	RUN_TEST(test_power_loss);
+	RUN_TEST(test_interrupted_compaction);
+	return UNITY_END();
+}
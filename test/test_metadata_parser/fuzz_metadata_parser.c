@@ -0,0 +1,120 @@
+/*
+ * @file
+ * @brief libFuzzer target of the metadata parser: each input is parsed as AIF, AIW and AIM, then as an AIW
+ * received in blocks (JSON and CBOR). It aborts if the parser arena is exhausted, if a name of the topology
+ * isn't terminated, or if the AIW parsed in blocks gives a different result than parsed whole.
+ *
+ * Build with clang and run from the root of the project, with the documents in docs as seed corpus:
+ *   clang -g -O1 -fsanitize=fuzzer,address,undefined -DNATIVE_LOG_LEVEL=0 -Itest/native_stubs -Ilib/mpai_core -Ilib/mpai_libs \
+ *     test/test_metadata_parser/fuzz_metadata_parser.c test/test_metadata_parser/metadata_parser_sources.c -lm -o fuzz_metadata_parser
+ *   ./fuzz_metadata_parser -max_len=4096 fuzz_corpus docs
+ * The unit tests of the native env (pio test -e native) run it on the same documents, without libFuzzer
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <aif_metadata_parser.h>
+
+/* Max bytes of the AIW blocks, as CoAP blocks */
+#define FUZZ_BLOCK_LEN_MAX 64
+
+/* Elements extracted from an AIW by the callbacks */
+typedef struct _fuzz_aiw_result_t {
+	bool _ok;
+	size_t _aims;
+	size_t _topology;
+} fuzz_aiw_result_t;
+
+static fuzz_aiw_result_t fuzz_aiw_result;
+static mpai_metadata_aiw_stream_t fuzz_aiw_stream;
+
+/************* PRIVATE HEADER *************/
+/* abort if the last document exhausted the parser arena: the state of the parser doesn't depend on the input */
+void _fuzz_check_arena();
+/* parse an AIW in blocks of the specified length */
+fuzz_aiw_result_t _fuzz_aiw_blocks(const uint8_t* data, size_t size, size_t block_len, MPAI_METADATA_FORMAT format);
+/* AIM callback counting the AIMs */
+bool _fuzz_aim_callback(const char* aim_name);
+/* topology callback counting the outputs, checking the names */
+void _fuzz_topology_callback(const char* aim_name, const char* port_name);
+
+/************* PUBLIC **************/
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	// the parsers of whole documents read strings
+	char* document = (char *)malloc(size + 1);
+	if (document == NULL)
+	{
+		return 0;
+	}
+	memcpy(document, data, size);
+	document[size] = '\0';
+
+	MPAI_Metadata_Parser_Parse_AIF_JSON(document);
+	_fuzz_check_arena();
+
+	memset(&fuzz_aiw_result, 0, sizeof(fuzz_aiw_result));
+	bool whole_ok = MPAI_Metadata_Parser_Parse_AIW_JSON(document, -1, _fuzz_aim_callback, _fuzz_topology_callback);
+	fuzz_aiw_result_t whole = fuzz_aiw_result;
+	whole._ok = whole_ok;
+	_fuzz_check_arena();
+
+	MPAI_Metadata_Parser_Parse_AIM_JSON(document);
+	_fuzz_check_arena();
+
+	// the size chooses the length of the blocks, so their boundaries fall everywhere
+	size_t block_len = 1 + size % FUZZ_BLOCK_LEN_MAX;
+	fuzz_aiw_result_t blocks = _fuzz_aiw_blocks(data, size, block_len, MPAI_METADATA_FORMAT_JSON);
+	if (memchr(data, '\0', size) == NULL && (blocks._ok != whole._ok || (whole._ok && (blocks._aims != whole._aims || blocks._topology != whole._topology))))
+	{
+		abort();
+	}
+	_fuzz_aiw_blocks(data, size, block_len, MPAI_METADATA_FORMAT_CBOR);
+
+	free(document);
+	return 0;
+}
+
+/************* PRIVATE **************/
+void _fuzz_check_arena()
+{
+	mpai_metadata_parser_stats_t stats;
+	MPAI_Metadata_Parser_Get_Last_Stats(&stats);
+	if (stats._exhausted)
+	{
+		abort();
+	}
+}
+
+fuzz_aiw_result_t _fuzz_aiw_blocks(const uint8_t* data, size_t size, size_t block_len, MPAI_METADATA_FORMAT format)
+{
+	memset(&fuzz_aiw_result, 0, sizeof(fuzz_aiw_result));
+	MPAI_Metadata_Parser_AIW_Stream_Init(&fuzz_aiw_stream, -1, _fuzz_aim_callback, _fuzz_topology_callback);
+	MPAI_Metadata_Parser_AIW_Stream_Set_Format(&fuzz_aiw_stream, format);
+
+	bool ok = true;
+	for (size_t i = 0; ok && i < size; i += block_len)
+	{
+		ok = MPAI_Metadata_Parser_AIW_Stream_Feed(&fuzz_aiw_stream, (const char *)&data[i], MIN(block_len, size - i));
+	}
+	fuzz_aiw_result._ok = ok && MPAI_Metadata_Parser_AIW_Stream_End(&fuzz_aiw_stream);
+	return fuzz_aiw_result;
+}
+
+bool _fuzz_aim_callback(const char* aim_name)
+{
+	ARG_UNUSED(aim_name);
+	fuzz_aiw_result._aims++;
+	return true;
+}
+
+void _fuzz_topology_callback(const char* aim_name, const char* port_name)
+{
+	if (memchr(aim_name, '\0', MPAI_METADATA_NAME_LEN) == NULL || memchr(port_name, '\0', MPAI_METADATA_NAME_LEN) == NULL)
+	{
+		abort();
+	}
+	fuzz_aiw_result._topology++;
+}
@@ -0,0 +1,34 @@
+/*
+ * @file
+ * @brief Sources of the metadata parser built on the host, with the configuration of zephyr/prj.conf
+ * and the defaults of zephyr/Kconfig for its benchmark
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CONFIG_MPAI_METADATA_PARSER_ARENA_SIZE
+#define CONFIG_MPAI_METADATA_PARSER_ARENA_SIZE 3072
+#endif
+#define CONFIG_MPAI_METADATA_PARSER_BENCHMARK 1
+#ifndef CONFIG_MPAI_METADATA_PARSER_BENCHMARK_ITERATIONS
+#define CONFIG_MPAI_METADATA_PARSER_BENCHMARK_ITERATIONS 10
+#endif
+#ifndef CONFIG_MPAI_METADATA_PARSER_BENCHMARK_AIMS
+#define CONFIG_MPAI_METADATA_PARSER_BENCHMARK_AIMS 200
+#endif
+#ifndef CONFIG_MPAI_METADATA_PARSER_BENCHMARK_MUTATIONS
+#define CONFIG_MPAI_METADATA_PARSER_BENCHMARK_MUTATIONS 500
+#endif
+#ifndef CONFIG_MPAI_METADATA_PARSER_BENCHMARK_SEED
+#define CONFIG_MPAI_METADATA_PARSER_BENCHMARK_SEED 0x4D504149
+#endif
+
+#include "../../lib/mpai_core/mem_arena.c"
+#include "../../lib/mpai_libs/aif_metadata_stream.c"
+#include "../../lib/mpai_libs/aif_metadata_schema.c"
+#include "../../lib/mpai_libs/aif_metadata_schema_tables.c"
+#include "../../lib/mpai_libs/aif_metadata_parser.c"
+#include "../../lib/mpai_libs/aif_metadata_benchmark.c"
+#include "../../lib/mpai_libs/aif_metadata_corpus.c"
@@ -0,0 +1,82 @@
+/*
+ * @file
+ * @brief Unit tests of the metadata parser on the host (pio test -e native), under AddressSanitizer:
+ * the benchmark run at boot by CONFIG_MPAI_METADATA_PARSER_BENCHMARK and the fuzz target on the corpus
+ *
+ * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <unity.h>
+#include <aif_metadata_benchmark.h>
+
+/* Max bytes of the AIW blocks of the fuzz target */
+#define FUZZ_BLOCK_LEN_MAX 64
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+/* documents in docs, synthetic AIW and mutations of the documents, as on the board */
+void test_benchmark(void)
+{
+	TEST_ASSERT_TRUE(MPAI_Metadata_Parser_Benchmark());
+}
+
+void test_corpus_documents_are_valid(void)
+{
+	for (size_t i = 0; i < MPAI_METADATA_CORPUS_COUNT; i++)
+	{
+		const mpai_metadata_corpus_document_t* document = &MPAI_METADATA_CORPUS[i];
+		bool ok = false;
+		switch (document->_type)
+		{
+		case MPAI_CONFIG_STORE_AIF:
+			ok = MPAI_Metadata_Parser_Parse_AIF_JSON(document->_document);
+			break;
+		case MPAI_CONFIG_STORE_AIW:
+			ok = MPAI_Metadata_Parser_Parse_AIW_JSON(document->_document, -1, NULL, NULL);
+			break;
+		default:
+			ok = MPAI_Metadata_Parser_Parse_AIM_JSON(document->_document);
+			break;
+		}
+		TEST_ASSERT_TRUE_MESSAGE(ok, document->_name);
+	}
+}
+
+/* the fuzz target on each document, followed by whitespace: its length chooses the length of the AIW blocks */
+void test_fuzz_target_on_corpus(void)
+{
+	for (size_t i = 0; i < MPAI_METADATA_CORPUS_COUNT; i++)
+	{
+		const char* document = MPAI_METADATA_CORPUS[i]._document;
+		size_t len = strlen(document);
+		char* padded = (char *)malloc(len + FUZZ_BLOCK_LEN_MAX);
+		TEST_ASSERT_NOT_NULL(padded);
+		memcpy(padded, document, len);
+		memset(&padded[len], ' ', FUZZ_BLOCK_LEN_MAX);
+
+		for (size_t padding = 0; padding < FUZZ_BLOCK_LEN_MAX; padding++)
+		{
+			TEST_ASSERT_EQUAL_INT(0, LLVMFuzzerTestOneInput((const uint8_t *)padded, len + padding));
+		}
+		free(padded);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_benchmark);
+	RUN_TEST(test_corpus_documents_are_valid);
+	RUN_TEST(test_fuzz_target_on_corpus);
+	return UNITY_END();
+}
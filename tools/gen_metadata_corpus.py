@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+#
+# Embed the metadata documents of docs/*.json in the firmware, as the corpus of the
+# metadata parser benchmark (lib/mpai_libs/aif_metadata_corpus.c).
+#
+# Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Usage: gen_metadata_corpus.py [--check]
+
+import argparse
+import json
+import sys
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parent.parent
+DOCS = ROOT / "docs"
+OUTPUT = ROOT / "lib" / "mpai_libs" / "aif_metadata_corpus.c"
+
+
+def document_type(path):
+    if path.name.startswith("mpai_aif"):
+        return "MPAI_CONFIG_STORE_AIF"
+    if path.name.startswith("mpai_aiw"):
+        return "MPAI_CONFIG_STORE_AIW"
+    if path.name.startswith("mpai_aim"):
+        return "MPAI_CONFIG_STORE_AIM"
+    return None
+
+
+def c_literal(text):
+    """Split the document in one C string literal per line"""
+    return "\n".join("\t\t%s" % json.dumps(line + "\n") for line in text.splitlines())
+
+
+def generate():
+    lines = [
+        "/*",
+        " * @file",
+        " * @brief Corpus of the metadata parser benchmark: the documents in docs",
+        " *",
+        " * Generated by tools/gen_metadata_corpus.py: do not edit",
+        " *",
+        " * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>",
+        " *",
+        " * SPDX-License-Identifier: Apache-2.0",
+        " */",
+        "",
+        '#include "aif_metadata_benchmark.h"',
+        "",
+        "#ifdef CONFIG_MPAI_METADATA_PARSER_BENCHMARK",
+        "const mpai_metadata_corpus_document_t MPAI_METADATA_CORPUS[] = {",
+    ]
+    paths = [p for p in sorted(DOCS.glob("*.json")) if document_type(p) is not None]
+    for path in paths:
+        text = path.read_text()
+        json.loads(text)
+        lines.append("\t{")
+        lines.append("\t\t._name = %s," % json.dumps(path.name))
+        lines.append("\t\t._type = %s," % document_type(path))
+        lines.append("\t\t._document =")
+        lines.append(c_literal(text))
+        lines.append("\t},")
+    lines.append("};")
+    lines.append("")
+    lines.append("const size_t MPAI_METADATA_CORPUS_COUNT = ARRAY_SIZE(MPAI_METADATA_CORPUS);")
+    lines.append("#endif")
+    lines.append("")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Embed docs/*.json as the corpus of the metadata parser benchmark")
+    parser.add_argument("--check", action="store_true", help="only check that the corpus is up to date")
+    args = parser.parse_args()
+
+    corpus = generate()
+    if args.check:
+        if not OUTPUT.exists() or OUTPUT.read_text() != corpus:
+            print("%s is out of date: run %s" % (OUTPUT.relative_to(ROOT), Path(__file__).name))
+            return 1
+        return 0
+    OUTPUT.write_text(corpus)
+    print("Written %s" % OUTPUT.relative_to(ROOT))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
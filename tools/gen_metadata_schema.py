@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+#
+# Compile the MPAI-AIF metadata JSON schemas (docs/schemas) into the validation tables
+# used by the device (lib/mpai_libs/aif_metadata_schema_tables.c).
+#
+# Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Usage: gen_metadata_schema.py [--check]
+# Supported keywords: type, properties, required, items, enum, minLength, maxLength, $ref (to #/$defs).
+# Any other keyword is rejected, so a schema is never validated partially without noticing it.
+
+import argparse
+import json
+import sys
+from pathlib import Path
+
+ROOT = Path(__file__).resolve().parent.parent
+SCHEMAS = [
+    ("AIF", ROOT / "docs" / "schemas" / "AIF-metadata.schema.json"),
+    ("AIW", ROOT / "docs" / "schemas" / "AIW-metadata.schema.json"),
+    ("AIM", ROOT / "docs" / "schemas" / "AIM-metadata.schema.json"),
+]
+OUTPUT = ROOT / "lib" / "mpai_libs" / "aif_metadata_schema_tables.c"
+
+TYPES = {
+    "object": "MPAI_SCHEMA_TYPE_OBJECT",
+    "array": "MPAI_SCHEMA_TYPE_ARRAY",
+    "string": "MPAI_SCHEMA_TYPE_STRING",
+    "integer": "MPAI_SCHEMA_TYPE_INTEGER",
+    "number": "MPAI_SCHEMA_TYPE_NUMBER | MPAI_SCHEMA_TYPE_INTEGER",
+    "boolean": "MPAI_SCHEMA_TYPE_BOOLEAN",
+    "null": "MPAI_SCHEMA_TYPE_NULL",
+}
+IGNORED_KEYWORDS = {"$schema", "$id", "$defs", "title", "description"}
+SUPPORTED_KEYWORDS = {"type", "properties", "required", "items", "enum", "minLength", "maxLength", "$ref"}
+MAX_PROPERTIES = 32
+MAX_LENGTH = 255
+
+
+class Node:
+    def __init__(self, key, schema):
+        self.key = key
+        self.schema = schema
+        self.children = []
+        self.first_child = None
+        self.required = 0
+
+
+def resolve(root, schema):
+    while "$ref" in schema:
+        ref = schema["$ref"]
+        if not ref.startswith("#/$defs/"):
+            raise ValueError("Unsupported $ref %s" % ref)
+        schema = root["$defs"][ref[len("#/$defs/"):]]
+    unknown = set(schema) - SUPPORTED_KEYWORDS - IGNORED_KEYWORDS
+    if unknown:
+        raise ValueError("Unsupported keywords %s" % ", ".join(sorted(unknown)))
+    return schema
+
+
+def compile_schema(root):
+    """Flatten the schema breadth first, so the children of each node are contiguous"""
+    nodes = [Node(None, resolve(root, root))]
+    i = 0
+    while i < len(nodes):
+        node = nodes[i]
+        properties = node.schema.get("properties", {})
+        if len(properties) > MAX_PROPERTIES:
+            raise ValueError("Too many properties (max %d)" % MAX_PROPERTIES)
+        if properties and "items" in node.schema:
+            raise ValueError("A node can't have both properties and items")
+        if properties or "items" in node.schema:
+            node.first_child = len(nodes)
+        for idx, (key, child) in enumerate(properties.items()):
+            node.children.append(Node(key, resolve(root, child)))
+            if key in node.schema.get("required", []):
+                node.required |= 1 << idx
+        for key in node.schema.get("required", []):
+            if key not in properties:
+                raise ValueError("Required property %s is not described" % key)
+        if "items" in node.schema:
+            node.children.append(Node(None, resolve(root, node.schema["items"])))
+        nodes.extend(node.children)
+        i += 1
+    return nodes
+
+
+def c_string(value):
+    return "NULL" if value is None else json.dumps(value)
+
+
+def c_types(schema):
+    types = schema.get("type")
+    if types is None:
+        return "MPAI_SCHEMA_TYPE_ANY"
+    if isinstance(types, str):
+        types = [types]
+    return " | ".join(TYPES[t] for t in types)
+
+
+def generate():
+    lines = [
+        "/*",
+        " * @file",
+        " * @brief Validation tables of the MPAI-AIF metadata schemas",
+        " *",
+        " * Generated by tools/gen_metadata_schema.py from docs/schemas: do not edit",
+        " *",
+        " * Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>",
+        " *",
+        " * SPDX-License-Identifier: Apache-2.0",
+        " */",
+        "",
+        '#include "aif_metadata_schema.h"',
+        "",
+    ]
+    for name, path in SCHEMAS:
+        root = json.loads(path.read_text())
+        nodes = compile_schema(root)
+        prefix = "schema_%s" % name.lower()
+
+        for idx, node in enumerate(nodes):
+            if "enum" in node.schema:
+                values = ", ".join(c_string(v) for v in node.schema["enum"])
+                lines.append("static const char* const %s_enum_%d[] = {%s, NULL};" % (prefix, idx, values))
+        lines.append("")
+        lines.append("static const mpai_schema_node_t %s_nodes[] = {" % prefix)
+        for idx, node in enumerate(nodes):
+            min_length = node.schema.get("minLength", 0)
+            max_length = node.schema.get("maxLength", 0)
+            if min_length > MAX_LENGTH or max_length > MAX_LENGTH:
+                raise ValueError("%s: length limits greater than %d are not supported" % (node.key, MAX_LENGTH))
+            lines.append("\t/* %d */ {._key = %s, ._types = %s, ._child_count = %d, ._first_child = %s, ._required = 0x%08X, "
+                         "._min_length = %d, ._max_length = %d, ._enum = %s}," % (
+                             idx, c_string(node.key), c_types(node.schema), len(node.children),
+                             "MPAI_SCHEMA_NO_NODE" if node.first_child is None else node.first_child,
+                             node.required, min_length, max_length,
+                             "%s_enum_%d" % (prefix, idx) if "enum" in node.schema else "NULL"))
+        lines.append("};")
+        lines.append("")
+        lines.append("const mpai_schema_t MPAI_SCHEMA_%s = {._name = %s, ._nodes = %s_nodes, ._node_count = %d};" % (
+            name, c_string(name), prefix, len(nodes)))
+        lines.append("")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile MPAI-AIF metadata schemas into validation tables")
+    parser.add_argument("--check", action="store_true", help="only check that the tables are up to date")
+    args = parser.parse_args()
+
+    tables = generate()
+    if args.check:
+        if not OUTPUT.exists() or OUTPUT.read_text() != tables:
+            print("%s is out of date: run %s" % (OUTPUT.relative_to(ROOT), Path(__file__).name))
+            return 1
+        return 0
+    OUTPUT.write_text(tables)
+    print("Written %s" % OUTPUT.relative_to(ROOT))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# Convert MPAI metadata documents (AIF/AIW/AIM) from JSON to CBOR (RFC 8949),
+# the compact binary format served by MPAI Store to the device.
+#
+# Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Usage: json_to_cbor.py [--strip] [--block-size N] file.json [...]
+# Writes file.cbor next to each input and prints the sizes.
+
+import argparse
+import json
+import math
+import struct
+import sys
+from pathlib import Path
+
+# Members ignored by the device parser, dropped with --strip
+STRIPPED_KEYS = ("$schema", "$id", "Description")
+
+
+def _head(major, argument):
+    if argument < 24:
+        return bytes([(major << 5) | argument])
+    if argument < 0x100:
+        return bytes([(major << 5) | 24, argument])
+    if argument < 0x10000:
+        return bytes([(major << 5) | 25]) + struct.pack(">H", argument)
+    if argument < 0x100000000:
+        return bytes([(major << 5) | 26]) + struct.pack(">I", argument)
+    return bytes([(major << 5) | 27]) + struct.pack(">Q", argument)
+
+
+def encode(value):
+    """Encode a JSON value with the preferred (shortest) serialization"""
+    if value is None:
+        return b"\xf6"
+    if value is True:
+        return b"\xf5"
+    if value is False:
+        return b"\xf4"
+    if isinstance(value, int):
+        return _head(0, value) if value >= 0 else _head(1, -1 - value)
+    if isinstance(value, float):
+        if value.is_integer() and abs(value) < 2 ** 63:
+            return encode(int(value))
+        single = struct.pack(">f", value)
+        if struct.unpack(">f", single)[0] == value or math.isnan(value):
+            return b"\xfa" + single
+        return b"\xfb" + struct.pack(">d", value)
+    if isinstance(value, str):
+        text = value.encode("utf-8")
+        return _head(3, len(text)) + text
+    if isinstance(value, list):
+        return _head(4, len(value)) + b"".join(encode(v) for v in value)
+    if isinstance(value, dict):
+        return _head(5, len(value)) + b"".join(encode(k) + encode(v) for k, v in value.items())
+    raise TypeError("Unsupported value %r" % (value,))
+
+
+def strip(value):
+    if isinstance(value, list):
+        return [strip(v) for v in value]
+    if isinstance(value, dict):
+        return {k: strip(v) for k, v in value.items() if k not in STRIPPED_KEYS}
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert MPAI metadata documents from JSON to CBOR")
+    parser.add_argument("--strip", action="store_true", help="drop %s members" % ", ".join(STRIPPED_KEYS))
+    parser.add_argument("--block-size", type=int, default=64, help="CoAP block size used to count blocks")
+    parser.add_argument("files", nargs="+", type=Path)
+    args = parser.parse_args()
+
+    for path in args.files:
+        text = path.read_bytes()
+        document = json.loads(text)
+        if args.strip:
+            document = strip(document)
+        data = encode(document)
+        out = path.with_suffix(".cbor")
+        out.write_bytes(data)
+        print("%s: JSON %d bytes (%d blocks), CBOR %d bytes (%d blocks), %.0f%%" % (
+            path.name, len(text), math.ceil(len(text) / args.block_size),
+            len(data), math.ceil(len(data) / args.block_size), 100.0 * len(data) / len(text)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
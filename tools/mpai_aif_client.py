@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+#
+# Client of the AIF APIs exposed by the devices over CoAP (CONFIG_MPAI_API_SERVER), as a gateway managing many nodes:
+# each command is sent to all the devices given, with confirmable requests retransmitted as the devices do.
+#
+# Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Usage: mpai_aif_client.py --devices 192.168.1.10,192.168.1.11 [--port 5683] COMMAND [ARGUMENT]
+# Commands: aiw-start <AIW>, aiw-pause|aiw-resume|aiw-stop <AIW ID>, aim-start|aim-stop|aim-pause|aim-resume <AIM>,
+#           status, metrics [--interval 10] (CPU load of the threads between two scrapes)
+# It needs only the Python standard library.
+
+import argparse
+import json
+import random
+import socket
+import sys
+import time
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+from mpai_store_server import TYPE_CON, TYPE_ACK, CODE_GET, CODE_POST, OPTION_URI_PATH, parse, build  # noqa: E402
+
+ACK_TIMEOUT = 2.0
+MAX_RETRANSMIT = 4
+
+COMMANDS = {
+    "aiw-start": (CODE_POST, "aiw/start"),
+    "aiw-pause": (CODE_POST, "aiw/pause"),
+    "aiw-resume": (CODE_POST, "aiw/resume"),
+    "aiw-stop": (CODE_POST, "aiw/stop"),
+    "aim-start": (CODE_POST, "aim/start"),
+    "aim-stop": (CODE_POST, "aim/stop"),
+    "aim-pause": (CODE_POST, "aim/pause"),
+    "aim-resume": (CODE_POST, "aim/resume"),
+    "status": (CODE_GET, "aim/status"),
+    "metrics": (CODE_GET, "metrics"),
+}
+
+
+def code_str(code):
+    return "%d.%02d" % (code >> 5, code & 0x1F)
+
+
+def request(sock, device, method, path, payload=b""):
+    """Confirmable request, retransmitted with the same message ID (the device replies again without executing it)"""
+    mid = random.getrandbits(16)
+    token = random.getrandbits(32).to_bytes(4, "big")
+    options = [(OPTION_URI_PATH, segment.encode("utf-8")) for segment in path.split("/")]
+    datagram = build(TYPE_CON, method, mid, token, options, payload)
+    timeout = ACK_TIMEOUT * random.uniform(1.0, 1.5)
+    for _ in range(MAX_RETRANSMIT + 1):
+        sock.sendto(datagram, device)
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            sock.settimeout(max(deadline - time.monotonic(), 0.01))
+            try:
+                reply, peer = sock.recvfrom(2048)
+            except socket.timeout:
+                break
+            msg_type, code, reply_mid, reply_token, _, reply_payload = parse(reply)
+            if peer == device and msg_type == TYPE_ACK and reply_mid == mid and reply_token == token:
+                return code, reply_payload
+        timeout *= 2
+    raise TimeoutError("no reply from %s:%d" % device)
+
+
+def cpu_load(previous, current):
+    """Share of the CPU of each thread between two scrapes, from the cycles since boot"""
+    elapsed = current["cycles"] - previous["cycles"]
+    cycles = {name: value for name, value, _ in previous.get("threads", [])}
+    return {name: round(100.0 * (value - cycles.get(name, 0)) / elapsed, 1) if elapsed > 0 else 0.0
+            for name, value, _ in current.get("threads", [])}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Client of the AIF APIs of the devices")
+    parser.add_argument("--devices", required=True, help="addresses of the devices, separated by commas")
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--interval", type=float, default=0, help="scrape the metrics every these seconds")
+    parser.add_argument("command", choices=sorted(COMMANDS))
+    parser.add_argument("argument", nargs="?", default="", help="AIW name, AIW ID or AIM name")
+    args = parser.parse_args()
+
+    method, path = COMMANDS[args.command]
+    devices = [(address, args.port) for address in args.devices.split(",")]
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    previous = {}
+
+    while True:
+        for device in devices:
+            try:
+                code, payload = request(sock, device, method, path, args.argument.encode("utf-8"))
+            except (TimeoutError, ValueError) as error:
+                print("%s: %s" % (device[0], error))
+                continue
+            text = payload.decode("utf-8", "replace")
+            if args.command == "metrics" and code >> 5 == 2:
+                metrics = json.loads(text)
+                if device in previous and "cycles" in metrics:
+                    metrics["load"] = cpu_load(previous[device], metrics)
+                previous[device] = metrics
+                text = json.dumps(metrics)
+            print("%s: %s %s" % (device[0], code_str(code), text))
+        if args.command != "metrics" or args.interval <= 0:
+            break
+        time.sleep(args.interval)
+
+
+if __name__ == "__main__":
+    main()
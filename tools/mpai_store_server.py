@@ -0,0 +1,366 @@
+#!/usr/bin/env python3
+#
+# Local stand-in of MPAI Store: serves the metadata documents in docs over CoAP (RFC 7252),
+# with block-wise transfers (RFC 7959), Size2 and CBOR on Accept, dropping datagrams on purpose
+# to exercise retransmissions of the device. Resources can be observed (RFC 7641): editing a document
+# in docs notifies the devices observing it, i.e. to tune the parameters of the AIMs while they run.
+# Replies carry an ETag: a GET with the ETag of the current document is answered 2.03 Valid without the document,
+# as the devices revalidate the configurations in their flash cache.
+# Telemetry batches posted by the devices to telemetry/<device> are decoded and printed (see mpai_telemetry.py).
+#
+# Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Usage: mpai_store_server.py [--host 0.0.0.0] [--port 5683] [--block-size 1024] [--loss 0.2] [--seed N] [--max-age 300]
+#        [--telemetry-output records.jsonl]
+# Only GET of config/aif/<name>, config/aiw/<name>, config/aim/<name> and config/parameters/<AIM>
+# and POST of telemetry/<device> are supported.
+# It needs only the Python standard library.
+
+import argparse
+import json
+import random
+import socket
+import struct
+import sys
+import zlib
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+from json_to_cbor import encode as cbor_encode  # noqa: E402
+from mpai_telemetry import Telemetry  # noqa: E402
+
+ROOT = Path(__file__).resolve().parent.parent
+DOCS = ROOT / "docs"
+
+TYPE_CON, TYPE_NON, TYPE_ACK, TYPE_RST = range(4)
+CODE_GET = 0x01
+CODE_POST = 0x02
+CODE_CHANGED = (2 << 5) | 4
+CODE_VALID = (2 << 5) | 3
+CODE_CONTENT = (2 << 5) | 5
+CODE_BAD_OPTION = (4 << 5) | 2
+CODE_NOT_FOUND = (4 << 5) | 4
+CODE_NOT_ACCEPTABLE = (4 << 5) | 6
+CODE_NOT_ALLOWED = (4 << 5) | 5
+CODE_BAD_REQUEST = (4 << 5) | 0
+
+OPTION_ETAG = 4
+OPTION_OBSERVE = 6
+OPTION_URI_PATH = 11
+OPTION_CONTENT_FORMAT = 12
+OPTION_MAX_AGE = 14
+OPTION_ACCEPT = 17
+OPTION_BLOCK2 = 23
+OPTION_SIZE2 = 28
+
+FORMAT_JSON = 50
+FORMAT_CBOR = 60
+
+# sequence numbers of the notifications are 24 bits (RFC 7641, 4.4)
+OBSERVE_SEQUENCE_MASK = 0xFFFFFF
+# seconds between checks of the documents changed
+POLL_INTERVAL = 1.0
+
+
+def load_documents(docs):
+    """Index the documents by the path asked by the device"""
+    documents = {}
+    for path in sorted(docs.glob("mpai_*.json")):
+        try:
+            document = json.loads(path.read_text())
+        except ValueError as error:
+            # a document could be read while it's edited: the previous one is kept
+            print("Invalid document %s: %s" % (path.name, error))
+            continue
+        specification = document.get("Identifier", {}).get("Specification", {})
+        if path.name.startswith("mpai_aif"):
+            documents["config/aif/"] = document
+        elif path.name.startswith("mpai_aiw"):
+            documents["config/aiw/" + specification.get("AIW", "")] = document
+        elif path.name.startswith("mpai_aim"):
+            documents["config/aim/" + specification.get("AIM", "")] = document
+        elif path.name.startswith("mpai_parameters_"):
+            # values of the parameters of an AIM, named after it
+            documents["config/parameters/" + path.stem[len("mpai_parameters_"):]] = document
+    return documents
+
+
+def docs_mtime(docs):
+    return max((path.stat().st_mtime_ns for path in docs.glob("mpai_*.json")), default=0)
+
+
+class Observers:
+    """Devices observing a resource, by peer and token (RFC 7641)"""
+
+    def __init__(self, max_age):
+        self.max_age = max_age
+        self.sequence = 0
+        self.observers = {}
+        self.notifications = {}
+
+    def next_sequence(self):
+        self.sequence = (self.sequence + 1) & OBSERVE_SEQUENCE_MASK
+        return self.sequence
+
+    def options(self):
+        """Options of a notification: the device registers again when Max-Age expires without notifications"""
+        return [(OPTION_OBSERVE, uint_option(self.next_sequence())), (OPTION_MAX_AGE, uint_option(self.max_age))]
+
+    def register(self, peer, token, uri, accept):
+        if (peer, token) not in self.observers:
+            print("%s:%d observes %s" % (peer[0], peer[1], uri))
+        self.observers[(peer, token)] = (uri, accept)
+
+    def deregister(self, peer, token):
+        if self.observers.pop((peer, token), None) is not None:
+            print("%s:%d stopped observing" % peer)
+
+    def confirm(self, peer, mid, rejected):
+        """A notification rejected with RST ends its observation"""
+        key = self.notifications.pop((peer, mid), None)
+        if key is not None and rejected:
+            self.deregister(*key)
+
+    def notify(self, sock, documents, block_size, changed, loss, probability):
+        for (peer, token), (uri, accept) in list(self.observers.items()):
+            if uri not in changed:
+                continue
+            mid = loss.getrandbits(16)
+            notification = content(documents, block_size, uri, accept, self.options(), TYPE_CON, mid, token)
+            # notifications are confirmable, so a device that forgot the observation can reject them
+            self.notifications[(peer, mid)] = (peer, token)
+            if loss.random() < probability:
+                print("Dropped notification to %s:%d" % peer)
+                continue
+            sock.sendto(notification, peer)
+
+
+def find_document(documents, uri):
+    if uri in documents:
+        return documents[uri]
+    # a single AIF is served, whatever its name
+    if uri.startswith("config/aif/"):
+        return documents.get("config/aif/")
+    return None
+
+
+def parse(datagram):
+    if len(datagram) < 4 or datagram[0] >> 6 != 1:
+        raise ValueError("not a CoAP message")
+    msg_type = (datagram[0] >> 4) & 0x3
+    tkl = datagram[0] & 0xF
+    code = datagram[1]
+    mid = struct.unpack(">H", datagram[2:4])[0]
+    token = datagram[4:4 + tkl]
+    options = []
+    pos = 4 + tkl
+    number = 0
+    while pos < len(datagram) and datagram[pos] != 0xFF:
+        delta, length = datagram[pos] >> 4, datagram[pos] & 0xF
+        pos += 1
+        values = []
+        for nibble in (delta, length):
+            if nibble == 13:
+                values.append(datagram[pos] + 13)
+                pos += 1
+            elif nibble == 14:
+                values.append(struct.unpack(">H", datagram[pos:pos + 2])[0] + 269)
+                pos += 2
+            elif nibble == 15:
+                raise ValueError("invalid option")
+            else:
+                values.append(nibble)
+        number += values[0]
+        options.append((number, datagram[pos:pos + values[1]]))
+        pos += values[1]
+    return msg_type, code, mid, token, options, datagram[pos + 1:]
+
+
+def uint_option(value):
+    length = (value.bit_length() + 7) // 8
+    return value.to_bytes(length, "big")
+
+
+def option_uint(options, number):
+    for option_number, value in options:
+        if option_number == number:
+            return int.from_bytes(value, "big")
+    return None
+
+
+def build(msg_type, code, mid, token, options, payload=b""):
+    datagram = bytearray([(1 << 6) | (msg_type << 4) | len(token), code]) + struct.pack(">H", mid) + token
+    previous = 0
+    for number, value in sorted(options, key=lambda option: option[0]):
+        header = bytearray([0])
+        for shift, field in ((4, number - previous), (0, len(value))):
+            if field < 13:
+                header[0] |= field << shift
+            elif field < 269:
+                header[0] |= 13 << shift
+                header.append(field - 13)
+            else:
+                header[0] |= 14 << shift
+                header += struct.pack(">H", field - 269)
+        datagram += header + value
+        previous = number
+    if payload:
+        datagram += b"\xff" + payload
+    return bytes(datagram)
+
+
+def encode_document(document, accept):
+    if accept in (None, FORMAT_JSON):
+        return FORMAT_JSON, json.dumps(document, indent=2).encode("utf-8")
+    if accept == FORMAT_CBOR:
+        return FORMAT_CBOR, cbor_encode(document)
+    return None, None
+
+
+def etag(body):
+    """ETag of a representation: the CRC32 of the body"""
+    return struct.pack(">I", zlib.crc32(body))
+
+
+def reply(documents, block_size, observers, telemetry, peer, datagram):
+    msg_type, code, mid, token, options, payload = parse(datagram)
+    reply_type = TYPE_ACK if msg_type == TYPE_CON else TYPE_NON
+    if code == 0:
+        if msg_type in (TYPE_ACK, TYPE_RST):
+            # empty ACK or RST of a notification
+            observers.confirm(peer, mid, msg_type == TYPE_RST)
+            return None
+        # ping
+        return build(TYPE_RST, 0, mid, b"", [])
+
+    uri = "/".join(value.decode("utf-8") for number, value in options if number == OPTION_URI_PATH)
+    if code == CODE_POST and uri.startswith("telemetry/"):
+        return receive_telemetry(telemetry, uri[len("telemetry/"):], msg_type, mid, token, payload)
+    if code != CODE_GET:
+        return build(reply_type, CODE_NOT_ALLOWED, mid, token, [])
+
+    observe = option_uint(options, OPTION_OBSERVE)
+    if observe == 1:
+        observers.deregister(peer, token)
+    accept = option_uint(options, OPTION_ACCEPT)
+    reply_options = []
+    # only the first block can be observed (RFC 7959, 2.6)
+    if observe == 0 and option_uint(options, OPTION_BLOCK2) in (None, 0) and find_document(documents, uri) is not None:
+        observers.register(peer, token, uri, accept)
+        reply_options += observers.options()
+    return content(documents, block_size, uri, accept, reply_options, reply_type, mid, token, options)
+
+
+def receive_telemetry(telemetry, device, msg_type, mid, token, payload):
+    """Batches are non-confirmable: they are acknowledged only if the device asks it"""
+    try:
+        telemetry.receive(device, payload)
+    except ValueError as error:
+        print("Invalid telemetry batch of %s: %s" % (device, error))
+        return build(TYPE_ACK, CODE_BAD_REQUEST, mid, token, []) if msg_type == TYPE_CON else None
+    return build(TYPE_ACK, CODE_CHANGED, mid, token, []) if msg_type == TYPE_CON else None
+
+
+def content(documents, block_size, uri, accept, reply_options, reply_type, mid, token, options=()):
+    """Reply with a block of a document (the first one if not asked)"""
+    document = find_document(documents, uri)
+    if document is None:
+        return build(reply_type, CODE_NOT_FOUND, mid, token, [])
+
+    content_format, body = encode_document(document, accept)
+    if body is None:
+        return build(reply_type, CODE_NOT_ACCEPTABLE, mid, token, [])
+
+    # conditional GET: the copy of the device is still valid (RFC 7252, 5.10.6.2)
+    tag = etag(body)
+    if any(number == OPTION_ETAG and value == tag for number, value in options):
+        print("GET %s valid (format %d)" % (uri, content_format))
+        return build(reply_type, CODE_VALID, mid, token, reply_options + [(OPTION_ETAG, tag)])
+
+    # the smaller between the block asked and the one of the server (late negotiation, RFC 7959 2.4)
+    szx = min(block_size.bit_length() - 5, 6)
+    num = 0
+    block2 = option_uint(options, OPTION_BLOCK2)
+    if block2 is not None:
+        asked_szx = block2 & 0x7
+        if asked_szx == 7:
+            return build(reply_type, CODE_BAD_OPTION, mid, token, [])
+        offset = (block2 >> 4) << (asked_szx + 4)
+        szx = min(szx, asked_szx)
+        num = offset >> (szx + 4)
+    size = 1 << (szx + 4)
+    if num * size >= len(body) and num > 0:
+        return build(reply_type, CODE_BAD_OPTION, mid, token, [])
+
+    payload = body[num * size:(num + 1) * size]
+    more = (num + 1) * size < len(body)
+    # every block has the ETag, so the device detects a document changed during the transfer
+    reply_options = reply_options + [(OPTION_ETAG, tag), (OPTION_CONTENT_FORMAT, uint_option(content_format))]
+    if block2 is not None or more:
+        reply_options.append((OPTION_BLOCK2, uint_option((num << 4) | (int(more) << 3) | szx)))
+    if option_uint(options, OPTION_SIZE2) is not None:
+        reply_options.append((OPTION_SIZE2, uint_option(len(body))))
+    print("%s %s block %d (%d bytes, format %d)%s" % ("GET" if reply_type != TYPE_CON else "NOTIFY", uri, num, len(payload),
+                                                    content_format, "" if more else " last"))
+    return build(reply_type, CODE_CONTENT, mid, token, reply_options, payload)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Local stand-in of MPAI Store, dropping datagrams on purpose")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--docs", type=Path, default=DOCS, help="directory of the metadata documents")
+    parser.add_argument("--block-size", type=int, default=1024, choices=[16, 32, 64, 128, 256, 512, 1024],
+                        help="max block size of the replies")
+    parser.add_argument("--loss", type=float, default=0.0, help="probability of dropping each request and each reply")
+    parser.add_argument("--seed", type=int, default=None, help="seed of the dropped datagrams, to replay a run")
+    parser.add_argument("--max-age", type=int, default=300,
+                        help="seconds a notification is fresh: then the device registers again its observation")
+    parser.add_argument("--telemetry-output", type=Path, default=None,
+                        help="file where the telemetry records are appended as JSON lines")
+    args = parser.parse_args()
+
+    documents = load_documents(args.docs)
+    mtime = docs_mtime(args.docs)
+    observers = Observers(args.max_age)
+    telemetry = Telemetry(output=args.telemetry_output)
+    loss = random.Random(args.seed)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.host, args.port))
+    sock.settimeout(POLL_INTERVAL)
+    print("Serving %s on %s:%d (loss %.0f%%)" % (", ".join(sorted(documents)), args.host, args.port, args.loss * 100))
+
+    while True:
+        if docs_mtime(args.docs) != mtime:
+            # documents edited: the devices observing them are notified
+            mtime = docs_mtime(args.docs)
+            previous, documents = documents, load_documents(args.docs)
+            documents = {**previous, **documents}
+            changed = {uri for uri in documents if documents[uri] != previous.get(uri)}
+            if changed:
+                print("Changed %s" % ", ".join(sorted(changed)))
+                observers.notify(sock, documents, args.block_size, changed, loss, args.loss)
+        try:
+            datagram, peer = sock.recvfrom(2048)
+        except socket.timeout:
+            continue
+        if loss.random() < args.loss:
+            print("Dropped request from %s:%d" % peer)
+            continue
+        try:
+            response = reply(documents, args.block_size, observers, telemetry, peer, datagram)
+        except ValueError as error:
+            print("Invalid datagram from %s:%d: %s" % (peer[0], peer[1], error))
+            continue
+        if response is None:
+            continue
+        if loss.random() < args.loss:
+            print("Dropped reply to %s:%d" % peer)
+            continue
+        sock.sendto(response, peer)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
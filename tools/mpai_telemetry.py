@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+#
+# Decoder of the telemetry batches sent by the devices (AIM Telemetry) with non-confirmable POSTs to telemetry/<device>.
+# It's used by mpai_store_server.py, that receives them on the same port of MPAI Store, or alone as a local sink.
+#
+# Batch (integers are little endian):
+# - header: magic "MT", version, count of channels, CRC16 of the name of each channel (uint16), random ID of the boot (uint32,
+#   only from version 2), sequence of the batch in the boot (uint16), count of records (uint16), timestamp of the first record (int64, ms of uptime)
+# - each record: index of the channel in the header, delta from the timestamp of the previous record (zigzag varint, ms),
+#   count of values, each value in thousandths (zigzag varint)
+#
+# Batches stored in flash memory while the network was down are sent again later, as they are: the ones already received
+# (same boot and sequence) are discarded.
+#
+# Copyright (c) 2022 University of Turin, Daniele Bortoluzzi <danieleb88@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Usage: mpai_telemetry.py [--host 0.0.0.0] [--port 5683] [--channels SensorsDataChannel,...] [--output records.jsonl]
+# It needs only the Python standard library.
+
+import argparse
+import json
+import socket
+import struct
+import sys
+from pathlib import Path
+
+MAGIC = b"MT"
+VERSIONS = (1, 2)
+VALUE_SCALE = 1000
+
+# channels of AIW IOT-REV, recognized by the CRC16 of their names
+CHANNELS = ["SensorsDataChannel", "MicBufferDataChannel", "MicPeakDataChannel", "MotionDataChannel"]
+
+
+def crc16_ccitt(data, seed=0):
+    """Same CRC16 of Zephyr crc16_ccitt, used by the device to identify the channels"""
+    crc = seed
+    for byte in data:
+        e = (crc ^ byte) & 0xFF
+        f = (e ^ (e << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (f << 8) ^ (f << 3) ^ (f >> 4)) & 0xFFFF
+    return crc
+
+
+def read_varint(payload, pos):
+    value, shift = 0, 0
+    while True:
+        if pos >= len(payload) or shift > 63:
+            raise ValueError("truncated varint")
+        byte = payload[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            break
+    # zigzag
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode(payload, channel_names=CHANNELS):
+    """Decode a batch: channels unknown are named by their CRC16"""
+    names = {crc16_ccitt(name.encode("utf-8")): name for name in channel_names}
+    if len(payload) < 4 or payload[:2] != MAGIC:
+        raise ValueError("not a telemetry batch")
+    version = payload[2]
+    if version not in VERSIONS:
+        raise ValueError("version %d not supported" % version)
+    count_channels = payload[3]
+    pos = 4
+    channels = []
+    for _ in range(count_channels):
+        hash_, = struct.unpack_from("<H", payload, pos)
+        channels.append(names.get(hash_, "%04x" % hash_))
+        pos += 2
+    boot = 0
+    if version >= 2:
+        boot, = struct.unpack_from("<I", payload, pos)
+        pos += 4
+    sequence, count_records, timestamp = struct.unpack_from("<HHq", payload, pos)
+    pos += 12
+    records = []
+    for _ in range(count_records):
+        if pos >= len(payload):
+            raise ValueError("truncated batch")
+        channel = payload[pos]
+        delta, pos = read_varint(payload, pos + 1)
+        timestamp += delta
+        count_values = payload[pos]
+        pos += 1
+        values = []
+        for _ in range(count_values):
+            value, pos = read_varint(payload, pos)
+            values.append(value / VALUE_SCALE)
+        if channel >= len(channels):
+            raise ValueError("channel %d not in header" % channel)
+        records.append({"channel": channels[channel], "timestamp": timestamp, "values": values})
+    if pos != len(payload):
+        raise ValueError("%d bytes after the records" % (len(payload) - pos))
+    return {"boot": boot, "sequence": sequence, "records": records}
+
+
+class Telemetry:
+    """Batches received by device: sequences skipped in a boot are counted as lost until they arrive"""
+
+    def __init__(self, channel_names=CHANNELS, output=None):
+        self.channel_names = channel_names
+        self.output = output
+        self.devices = {}
+
+    def receive(self, device, payload):
+        batch = decode(payload, self.channel_names)
+        stats = self.devices.setdefault(device, {"boots": {}, "batches": 0, "duplicates": 0, "lost": 0, "records": 0, "bytes": 0})
+        boot = stats["boots"].setdefault(batch["boot"], {"received": set(), "first": None, "last": None})
+        # sequences of 16 bits, unwrapped around the last one (batches sent again arrive late)
+        sequence = batch["sequence"]
+        if boot["last"] is not None:
+            delta = (sequence - boot["last"]) & 0xFFFF
+            sequence = boot["last"] + delta if delta < 0x8000 else boot["last"] - (0x10000 - delta)
+        if sequence in boot["received"]:
+            stats["duplicates"] += 1
+            print("TELEMETRY %s batch %d: already received" % (device, batch["sequence"]))
+            return None
+        boot["received"].add(sequence)
+        boot["first"] = sequence if boot["first"] is None else min(boot["first"], sequence)
+        boot["last"] = sequence if boot["last"] is None else max(boot["last"], sequence)
+        stats["lost"] = sum(b["last"] - b["first"] + 1 - len(b["received"]) for b in stats["boots"].values())
+        stats["batches"] += 1
+        stats["records"] += len(batch["records"])
+        stats["bytes"] += len(payload)
+        print("TELEMETRY %s batch %d: %d records in %d bytes (%d batches lost, %.1f bytes per record)" % (
+            device, batch["sequence"], len(batch["records"]), len(payload), stats["lost"],
+            stats["bytes"] / max(stats["records"], 1)))
+        if self.output is not None:
+            with self.output.open("a") as output:
+                for record in batch["records"]:
+                    output.write(json.dumps({"device": device, **record}) + "\n")
+        return batch
+
+
+def main():
+    sys.path.insert(0, str(Path(__file__).resolve().parent))
+    from mpai_store_server import TYPE_CON, TYPE_ACK, CODE_CHANGED, OPTION_URI_PATH, parse, build  # noqa: E402
+
+    parser = argparse.ArgumentParser(description="Local sink of the telemetry batches of the devices")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=5683)
+    parser.add_argument("--channels", default=",".join(CHANNELS), help="names of the channels sent by the devices")
+    parser.add_argument("--output", type=Path, default=None, help="file where the records are appended as JSON lines")
+    args = parser.parse_args()
+
+    telemetry = Telemetry(args.channels.split(","), args.output)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.host, args.port))
+    print("Receiving telemetry on %s:%d" % (args.host, args.port))
+
+    while True:
+        datagram, peer = sock.recvfrom(2048)
+        try:
+            msg_type, code, mid, token, options, payload = parse(datagram)
+            uri = [value.decode("utf-8") for number, value in options if number == OPTION_URI_PATH]
+            if len(uri) != 2 or uri[0] != "telemetry":
+                raise ValueError("unknown resource %s" % "/".join(uri))
+            telemetry.receive(uri[1], payload)
+        except ValueError as error:
+            print("Invalid datagram from %s:%d: %s" % (peer[0], peer[1], error))
+            continue
+        if msg_type == TYPE_CON:
+            sock.sendto(build(TYPE_ACK, CODE_CHANGED, mid, token, []), peer)
+
+
+if __name__ == "__main__":
+    main()